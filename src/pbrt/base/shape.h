@@ -9,6 +9,7 @@
 
 #include <pbrt/util/buffercache.h>
 #include <pbrt/util/float.h>
+#include <pbrt/util/loopsubdiv.h>
 #include <pbrt/util/taggedptr.h>
 #include <pbrt/util/vecmath.h>
 
@@ -40,6 +41,7 @@ class ShapeHandle
                                             const Transform *objectFromRender,
                                             bool reverseOrientation,
                                             const ParameterDictionary &parameters,
+                                            const LoopSubdivisionView &subdivisionView,
                                             const FileLoc *loc, Allocator alloc);
     std::string ToString() const;
 
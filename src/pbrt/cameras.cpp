@@ -103,6 +103,22 @@ std::string CameraHandle::ToString() const {
     return DispatchCPU(ts);
 }
 
+LoopSubdivisionView GetLoopSubdivisionView(CameraHandle camera) {
+    // Generate rays through the center of the film and one pixel over
+    SampledWavelengths lambda = SampledWavelengths::SampleUniform(0.5f);
+    CameraSample sample;
+    sample.pFilm = Point2f(camera.GetFilm().FullResolution()) / 2;
+    sample.pLens = Point2f(0.5f, 0.5f);
+    CameraRay cr = camera.GenerateRay(sample, lambda);
+    ++sample.pFilm.x;
+    CameraRay crx = camera.GenerateRay(sample, lambda);
+    if (!cr.weight || !crx.weight)
+        return {};
+
+    return LoopSubdivisionView{cr.ray.o,
+                               AngleBetween(Normalize(cr.ray.d), Normalize(crx.ray.d))};
+}
+
 // CameraBase Method Definitions
 CameraBase::CameraBase(const CameraTransform &cameraTransform, Float shutterOpen,
                        Float shutterClose, FilmHandle film, MediumHandle medium)
@@ -14,6 +14,7 @@
 #include <pbrt/ray.h>
 #include <pbrt/samplers.h>
 #include <pbrt/util/image.h>
+#include <pbrt/util/loopsubdiv.h>
 #include <pbrt/util/scattering.h>
 
 #include <memory>
@@ -521,6 +522,10 @@ class RealisticCamera : public CameraBase {
     pstd::vector<Bounds2f> exitPupilBounds;
 };
 
+// Returns the camera's position and the angle between the rays through two
+// neighboring pixels at the center of its film, for adaptive subdivision.
+LoopSubdivisionView GetLoopSubdivisionView(CameraHandle camera);
+
 inline CameraRay CameraHandle::GenerateRay(CameraSample sample,
                                            SampledWavelengths &lambda) const {
     auto generate = [&](auto ptr) { return ptr->GenerateRay(sample, lambda); };
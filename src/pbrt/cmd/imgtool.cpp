@@ -14,6 +14,7 @@
 #include <pbrt/util/image.h>
 #include <pbrt/util/log.h>
 #include <pbrt/util/math.h>
+#include <pbrt/util/mipmap.h>
 #include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/rng.h>
@@ -150,6 +151,15 @@ static std::map<std::string, CommandUsage> commandUsage = {
     {"makeemitters", {"makeemitters [options] <filename>", std::string(R"(
     --downsample <n>   Downsample the image by a factor of n in both dimensions
                        (using simple box filtering). Default: 1.
+)")}},
+    {"maketx", {"maketx [options] <filename>", std::string(R"(
+    --encoding <name>  Color encoding of 8-bit input images ("linear", "sRGB", or
+                       "gamma <value>"). Default: sRGB
+    --outfile <name>   Filename of the tiled MIP map. Default: the input
+                       filename with a ".txp" extension.
+    --wrapmode <mode>  Wrap mode used when filtering the MIP levels ("repeat",
+                       "clamp", "black", or "octahedralsphere"). Should match
+                       the texture's "wrap" parameter. Default: repeat
 )")}},
     {"makesky", {"makesky [options] <filename>", std::string(R"(
     --albedo <a>       Albedo of ground-plane (range 0-1). Default: 0.5
@@ -1769,6 +1779,58 @@ int makeemitters(int argc, char *argv[]) {
     return 0;
 }
 
+int maketx(int argc, char *argv[]) {
+    std::string inFilename, outFilename;
+    std::string encodingName = "sRGB", wrapModeName = "repeat";
+
+    auto onError = [](const std::string &err) {
+        usage("maketx", "%s", err.c_str());
+        exit(1);
+    };
+    while (*argv != nullptr) {
+        if (ParseArg(&argv, "encoding", &encodingName, onError) ||
+            ParseArg(&argv, "outfile", &outFilename, onError) ||
+            ParseArg(&argv, "wrapmode", &wrapModeName, onError)) {
+            // success
+        } else if (argv[0][0] == '-')
+            usage("maketx", "%s: unknown command flag", *argv);
+        else if (inFilename.empty()) {
+            inFilename = *argv;
+            ++argv;
+        } else
+            usage("maketx", "multiple input filenames provided.");
+    }
+    if (inFilename.empty())
+        usage("maketx", "input image filename must be provided.");
+    if (outFilename.empty())
+        outFilename = RemoveExtension(inFilename) + ".txp";
+    pstd::optional<WrapMode> wrapMode = ParseWrapMode(wrapModeName.c_str());
+    if (!wrapMode)
+        usage("maketx", "%s: wrap mode unknown", wrapModeName.c_str());
+
+    ImageAndMetadata imageAndMetadata =
+        Image::Read(inFilename, Allocator(), ColorEncodingHandle::Get(encodingName));
+    Image &image = imageAndMetadata.image;
+    if (image.NChannels() != 1) {
+        ImageChannelDesc rgbDesc = image.GetChannelDesc({"R", "G", "B"});
+        if (!rgbDesc) {
+            fprintf(stderr, "%s: image doesn't have R, G, and B channels.\n",
+                    inFilename.c_str());
+            return 1;
+        }
+        image = image.SelectChannels(rgbDesc);
+    }
+    // Only linear and sRGB encodings are stored; convert others to linear
+    if (Is8Bit(image.Format()) && image.Encoding().Is<GammaColorEncoding>())
+        image = image.ConvertToFormat(PixelFormat::Half);
+
+    pstd::vector<Image> pyramid = Image::GenerateMIPMap(std::move(image), *wrapMode);
+    if (!TiledImagePyramid::Write(outFilename, pyramid, *wrapMode,
+                                  imageAndMetadata.metadata.GetColorSpace()))
+        return 1;
+    return 0;
+}
+
 int makeenv(int argc, char *argv[]) {
     std::string inFilename, outFilename;
     int resolution = 0;
@@ -2282,6 +2344,8 @@ int main(int argc, char *argv[]) {
         return makeemitters(argc - 2, argv + 2);
     else if (strcmp(argv[1], "makesky") == 0)
         return makesky(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "maketx") == 0)
+        return maketx(argc - 2, argv + 2);
     else if (strcmp(argv[1], "whitebalance") == 0)
         return whitebalance(argc - 2, argv + 2);
     else if (strcmp(argv[1], "noisybit") == 0) {
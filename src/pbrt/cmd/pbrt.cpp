@@ -45,6 +45,12 @@ static void usage(const std::string &msg = {}) {
             R"(usage: pbrt [<options>] <filename.pbrt...>
 
 Rendering options:
+  --auto-instances             Replace triangle meshes that are repeated with
+                               different transformations by object instances.
+  --compress-meshes            Store triangle and bilinear patch mesh indices,
+                               normals, and uvs in compressed form. (CPU only.)
+  --compress-textures          Store image texture MIP levels block-compressed in
+                               memory, decoding texels on lookup.
   --cropwindow <x0,x1,y0,y1>   Specify an image crop window w.r.t. [0,1]^2
   --debugstart <values>        Inform the Integrator where to start rendering for
                                faster debugging. (<values> are Integrator-specific
@@ -53,7 +59,10 @@ Rendering options:
   --disable-wavelength-jitter  Always sample the same %d wavelengths of light.
   --display-server <addr:port> Connect to display server at given address and port
                                to display the image as it's being rendered.
-  --force-diffuse              Convert all materials to be diffuse.)"
+  --force-diffuse              Convert all materials to be diffuse.
+  --geometry-cache-mb <n>      Keep triangle mesh indices and positions in a mapped
+                               file, with at most <n> MB of them resident in memory.
+                               (Default: 0, disabled. CPU only.))"
 #ifdef PBRT_BUILD_GPU_RENDERER
             R"(
   --gpu                        Use the GPU for rendering. (Default: disabled)
@@ -61,6 +70,18 @@ Rendering options:
 #endif
             R"(
   --help                       Print this help text.
+  --instance-lod               Intersect distant triangle mesh object instances with
+                               simplified versions chosen using the ray footprint.
+                               (CPU only.)
+  --lazy-instances             Build the BVHs of object instance definitions when
+                               they are first intersected. (CPU only.)
+  --memory-budget <n>          Exit with a per-subsystem breakdown if the scene uses
+                               more than <n> MB of memory after loading, or before
+                               loading if its estimated size does. Enables
+                               --compress-meshes and --compress-textures if its
+                               geometry alone may approach that. (CPU only.)
+  --memory-report <filename>   Write a per-subsystem JSON report of the memory the
+                               scene uses after loading. (CPU only.)
   --mse-reference-image        Filename for reference image to use for MSE computation.
   --mse-reference-out          File to write MSE error vs spp results.
   --nthreads <num>             Use specified number of threads for rendering.
@@ -75,8 +96,12 @@ Rendering options:
   --render-coord-sys <name>    Coordinate system to use for the scene when rendering,
                                where name is "camera", "cameraworld", or "world".
   --seed <n>                   Set random number generator seed. Default: 0.
+  --split-curves               Split curves into more segments where doing so gives
+                               them tighter bounds. (CPU only.)
   --spp <n>                    Override number of pixel samples specified in scene
                                description file.
+  --texture-cache-mb <n>       Page image texture tiles in on demand, keeping at most
+                               <n> MB of them in memory. (Default: 0, disabled.)
 
 Logging options:
   --log-level <level>          Log messages at or above this level, where <level>
@@ -84,6 +109,10 @@ Logging options:
   --vlog-level <n>             Set VLOG verbosity. (Default: 0, disabled.)
 
 Reformatting options:
+  --binary                     With --format, write a compact binary
+                               version of the input file(s) to standard output.
+                               Included files are merged and triangle mesh data
+                               is stored as typed arrays.
   --format                     Print a reformatted version of the input file(s) to
                                standard output. Does not render an image.
   --toply                      Print a reformatted version of the input file(s) to
@@ -106,7 +135,7 @@ int main(int argc, char *argv[]) {
 
     std::string logLevel = "error";
     std::string renderCoordSys = "cameraworld";
-    bool format = false, toPly = false;
+    bool format = false, toPly = false, binary = false;
 
     // Process command-line arguments
     ++argv;
@@ -152,6 +181,10 @@ int main(int argc, char *argv[]) {
             ParseArg(&argv, "gpu", &options.useGPU, onError) ||
             ParseArg(&argv, "gpu-device", &options.gpuDevice, onError) ||
 #endif
+            ParseArg(&argv, "auto-instances", &options.autoInstances, onError) ||
+            ParseArg(&argv, "binary", &binary, onError) ||
+            ParseArg(&argv, "compress-meshes", &options.compressMeshes, onError) ||
+            ParseArg(&argv, "compress-textures", &options.compressTextures, onError) ||
             ParseArg(&argv, "debugstart", &options.debugStart, onError) ||
             ParseArg(&argv, "disable-pixel-jitter", &options.disablePixelJitter,
                      onError) ||
@@ -159,8 +192,13 @@ int main(int argc, char *argv[]) {
                      onError) ||
             ParseArg(&argv, "display-server", &options.displayServer, onError) ||
             ParseArg(&argv, "force-diffuse", &options.forceDiffuse, onError) ||
+            ParseArg(&argv, "geometry-cache-mb", &options.geometryCacheMB, onError) ||
             ParseArg(&argv, "format", &format, onError) ||
+            ParseArg(&argv, "instance-lod", &options.instanceLOD, onError) ||
+            ParseArg(&argv, "lazy-instances", &options.lazyInstances, onError) ||
             ParseArg(&argv, "log-level", &logLevel, onError) ||
+            ParseArg(&argv, "memory-budget", &options.memoryBudgetMB, onError) ||
+            ParseArg(&argv, "memory-report", &options.memoryReportFile, onError) ||
             ParseArg(&argv, "mse-reference-image", &options.mseReferenceImage, onError) ||
             ParseArg(&argv, "mse-reference-out", &options.mseReferenceOutput, onError) ||
             ParseArg(&argv, "nthreads", &options.nThreads, onError) ||
@@ -170,7 +208,9 @@ int main(int argc, char *argv[]) {
             ParseArg(&argv, "quiet", &options.quiet, onError) ||
             ParseArg(&argv, "render-coord-sys", &renderCoordSys, onError) ||
             ParseArg(&argv, "seed", &options.seed, onError) ||
+            ParseArg(&argv, "split-curves", &options.splitCurves, onError) ||
             ParseArg(&argv, "spp", &options.pixelSamples, onError) ||
+            ParseArg(&argv, "texture-cache-mb", &options.textureCacheMB, onError) ||
             ParseArg(&argv, "toply", &toPly, onError) ||
             ParseArg(&argv, "upgrade", &options.upgrade, onError) ||
             ParseArg(&argv, "vlog-level", &options.logConfig.vlogLevel, onError)) {
@@ -218,13 +258,54 @@ int main(int argc, char *argv[]) {
 
     InitPBRT(options);
 
-    if (format || toPly || options.upgrade) {
+    if (binary && (!format || toPly || options.upgrade))
+        ErrorExit("--binary must be used with --format and can't be combined with "
+                  "--toply or --upgrade.");
+
+    if (binary) {
+        BinarySceneWriter binaryScene(stdout);
+        ParseFiles(&binaryScene, filenames);
+    } else if (format || toPly || options.upgrade) {
         FormattingScene formattingScene(toPly, options.upgrade);
         ParseFiles(&formattingScene, filenames);
     } else {
         // Parse provided scene description files
         ParsedScene scene;
         ParseFiles(&scene, filenames);
+        if (Options->autoInstances)
+            scene.CreateAutomaticInstances();
+
+        // Check the scene's estimated memory use against its budget (CPU only)
+        if (Options->memoryBudgetMB > 0 && !options.useGPU) {
+            // Acceleration structures and per-primitive data typically need about
+            // as much memory as the meshes themselves.
+            GeometryEstimate geometry = scene.EstimateGeometryBytes();
+            int64_t geometryBytes = geometry.TotalBytes();
+            int64_t budgetBytes = int64_t(Options->memoryBudgetMB) << 20;
+
+            // Use compact representations if the scene may exceed its memory budget
+            if (2 * geometryBytes > budgetBytes &&
+                (!Options->compressMeshes || !Options->compressTextures)) {
+                Warning("Scene geometry is estimated to use %d MB, which may exceed "
+                        "the %d MB memory budget. Enabling --compress-meshes and "
+                        "--compress-textures.",
+                        geometryBytes >> 20, Options->memoryBudgetMB);
+                Options->compressMeshes = Options->compressTextures = true;
+            }
+
+            // Compact representations don't shrink the acceleration structures,
+            // so don't bother loading the scene if they alone won't fit.
+            if (geometryBytes > budgetBytes)
+                ErrorExit("Scene is estimated to use %d MB of memory, and at least %d MB "
+                          "with --compress-meshes and --compress-textures, which "
+                          "exceeds the %d MB memory budget:\n"
+                          "  %-44s %d MB\n  %-44s %d MB\n  %-44s %d MB",
+                          (2 * geometryBytes) >> 20, geometryBytes >> 20,
+                          Options->memoryBudgetMB, "shape parameters",
+                          geometry.parameterBytes >> 20, "PLY files",
+                          geometry.plyFileBytes >> 20,
+                          "acceleration structures and primitives", geometryBytes >> 20);
+        }
 
         // Render scene
         if (options.useGPU)
@@ -793,6 +793,35 @@ struct BoundEdge {
     EdgeType type;
 };
 
+// LazyBVHAccel Method Definitions
+STAT_PERCENT("BVH/Lazy instance BVHs built", nLazyBVHsBuilt, nLazyBVHs);
+
+LazyBVHAccel::LazyBVHAccel(std::vector<PrimitiveHandle> p) : primitives(std::move(p)) {
+    CHECK(!primitives.empty());
+    CHECK_LE(primitives.size(), MaxLazyPrimitives);
+    for (PrimitiveHandle prim : primitives)
+        bounds = Union(bounds, prim.Bounds());
+    ++nLazyBVHs;
+}
+
+BVHAccel *LazyBVHAccel::Build() const {
+    std::call_once(buildFlag, [this]() {
+        bvh.store(new BVHAccel(std::move(primitives)), std::memory_order_release);
+        primitives = std::vector<PrimitiveHandle>();
+        ++nLazyBVHsBuilt;
+    });
+    return bvh.load(std::memory_order_acquire);
+}
+
+pstd::optional<ShapeIntersection> LazyBVHAccel::Intersect(const Ray &ray,
+                                                          Float tMax) const {
+    return GetBVH()->Intersect(ray, tMax);
+}
+
+bool LazyBVHAccel::IntersectP(const Ray &ray, Float tMax) const {
+    return GetBVH()->IntersectP(ray, tMax);
+}
+
 STAT_PIXEL_COUNTER("Kd-Tree/Nodes visited", kdNodesVisited);
 
 // KdTreeAccel Method Definitions
@@ -11,6 +11,7 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace pbrt {
@@ -69,6 +70,42 @@ class BVHAccel {
     LinearBVHNode *nodes = nullptr;
 };
 
+// LazyBVHAccel Definition
+// Used for object instance definitions with the --lazy-instances option:
+// only the primitives' bounds are computed up front and the BVH is built
+// when the first ray reaches it. Rays that arrive while it is being built
+// wait for the build to finish.
+class LazyBVHAccel {
+  public:
+    // LazyBVHAccel Public Methods
+    LazyBVHAccel(std::vector<PrimitiveHandle> p);
+
+    Bounds3f Bounds() const { return bounds; }
+    pstd::optional<ShapeIntersection> Intersect(const Ray &ray, Float tMax) const;
+    bool IntersectP(const Ray &ray, Float tMax) const;
+
+    bool IsBuilt() const { return bvh.load(std::memory_order_acquire) != nullptr; }
+
+    // Definitions with more primitives than this are built up front, since
+    // BVHAccel parallelizes their construction, which can't be done from
+    // within the rendering loop.
+    static constexpr size_t MaxLazyPrimitives = 1024 * 1024;
+
+  private:
+    // LazyBVHAccel Private Methods
+    BVHAccel *GetBVH() const {
+        BVHAccel *b = bvh.load(std::memory_order_acquire);
+        return b ? b : Build();
+    }
+    BVHAccel *Build() const;
+
+    // LazyBVHAccel Private Members
+    Bounds3f bounds;
+    mutable std::vector<PrimitiveHandle> primitives;
+    mutable std::once_flag buildFlag;
+    mutable std::atomic<BVHAccel *> bvh{nullptr};
+};
+
 struct KdAccelNode;
 struct BoundEdge;
 
@@ -232,6 +232,7 @@ void ImageTileIntegrator::Render() {
         });
 
         // Update start and end wave
+        EndWave(endWave);
         startWave = endWave;
         endWave = std::min(spp, endWave + waveDelta);
         if (!referenceImage)
@@ -293,6 +294,7 @@ void RayIntegrator::EvaluatePixelSample(const Point2i &pPixel, int sampleIndex,
             std::max<Float>(.125, 1 / std::sqrt((Float)sampler.SamplesPerPixel()));
         if (!Options->disablePixelJitter)
             cameraRay->ray.ScaleDifferentials(rayDiffScale);
+        cameraRay->ray.spread = cameraRay->ray.DifferentialSpread();
 
         ++nCameraRays;
         // Evaluate radiance along camera ray
@@ -653,16 +655,114 @@ STAT_PERCENT("Integrator/Zero-radiance paths", zeroRadiancePaths, totalPaths);
 STAT_PERCENT("Integrator/Regularized BSDFs", regularizedBSDFs, totalBSDFs);
 STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
 
+STAT_PERCENT("Integrator/Adjoint Russian roulette terminations", adjointTerminations,
+             adjointDecisions);
+STAT_COUNTER("Integrator/Adjoint split paths", adjointSplitPaths);
+STAT_MEMORY_COUNTER("Memory/Radiance cache", radianceCacheBytes);
+
+// RadianceCache Method Definitions
+RadianceCache::RadianceCache(const Bounds3f &bounds, int gridResolution, int logTableSize)
+    : bounds(bounds),
+      sums(size_t(1) << logTableSize),
+      counts(size_t(1) << logTableSize),
+      estimates(size_t(1) << logTableSize, Float(0)),
+      estimateCounts(size_t(1) << logTableSize, 0) {
+    // Compute cell size and hash table mask for radiance cache
+    tableMask = (size_t(1) << logTableSize) - 1;
+    Float maxExtent = bounds.IsEmpty() ? 0 : bounds.Diagonal()[bounds.MaxDimension()];
+    invCellSize = maxExtent > 0 ? gridResolution / maxExtent : 1;
+
+    radianceCacheBytes += sums.size() * (sizeof(AtomicFloat) + sizeof(std::atomic<int>) +
+                                         sizeof(Float) + sizeof(int));
+}
+
+size_t RadianceCache::CellIndex(const Point3f &p, const Normal3f &n) const {
+    // Find grid cell containing _p_ and classify _n_ by its dominant axis
+    Vector3f pg = (p - bounds.pMin) * invCellSize;
+    Point3i pi(std::floor(pg.x), std::floor(pg.y), std::floor(pg.z));
+    int normalBin = 6;
+    if (n != Normal3f(0, 0, 0)) {
+        int axis = MaxComponentIndex(Abs(n));
+        normalBin = 2 * axis + (n[axis] > 0 ? 1 : 0);
+    }
+
+    return Hash(pi, normalBin) & tableMask;
+}
+
+void RadianceCache::UpdateEstimates() {
+    ParallelFor(0, sums.size(), [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; ++i) {
+            estimateCounts[i] = counts[i].load(std::memory_order_relaxed);
+            estimates[i] = estimateCounts[i] > 0 ? Float(sums[i]) / estimateCounts[i] : 0;
+        }
+    });
+}
+
+std::string RadianceCache::ToString() const {
+    return StringPrintf("[ RadianceCache bounds: %s invCellSize: %f tableSize: %d ]",
+                        bounds, invCellSize, sums.size());
+}
+
+// Adjoint-Driven Russian Roulette and Splitting Definitions
+struct AdjointVertex {
+    Point3f p;
+    Normal3f n;
+    Float beta, L;
+    size_t nPendingPaths;
+};
+
+struct PendingSplitPath {
+    RayDifferential ray;
+    SampledSpectrum beta;
+    int depth;
+    Float etaScale, bsdfPDF;
+    bool specularBounce, anyNonSpecularBounces;
+    SurfaceInteraction prevIntr;
+};
+
+// Returns the number of paths that should continue from a vertex with
+// throughput _beta_ and estimated reflected radiance _Lr_ using the weight
+// window of Vorba and Krivanek (2016); zero is returned if the path should
+// be terminated. The scale factor that must be applied to each
+// continuation's throughput is returned in _betaScale_.
+static int AdjointSplitFactor(Float beta, Float Lr, Float pixelEstimate, int maxSplit,
+                              Float u, Float *betaScale) {
+    // Compute weight window bounds for the expected path contribution
+    constexpr Float windowRatio = 5;
+    Float windowLow = 2 / (1 + windowRatio), windowHigh = windowRatio * windowLow;
+    Float contribution = beta * Lr / pixelEstimate;
+
+    *betaScale = 1;
+    if (contribution < windowLow) {
+        // Apply Russian roulette to path below the weight window
+        Float pSurvive = std::max<Float>(contribution / windowLow, 0.05f);
+        if (u >= pSurvive)
+            return 0;
+        *betaScale = 1 / pSurvive;
+        return 1;
+    } else if (contribution > windowHigh && maxSplit > 1) {
+        // Split path above the weight window
+        int nSplit = std::min<int>(maxSplit, std::ceil(contribution / windowHigh));
+        *betaScale = Float(1) / nSplit;
+        return nSplit;
+    }
+    return 1;
+}
+
 // PathIntegrator Method Definitions
 PathIntegrator::PathIntegrator(int maxDepth, CameraHandle camera, SamplerHandle sampler,
                                PrimitiveHandle aggregate, std::vector<LightHandle> lights,
                                Float rrThreshold, const std::string &lightSampleStrategy,
-                               bool regularize)
+                               bool regularize, bool adjointRR, int maxSplit)
     : RayIntegrator(camera, sampler, aggregate, lights),
       maxDepth(maxDepth),
       rrThreshold(rrThreshold),
       lightSampler(LightSamplerHandle::Create(lightSampleStrategy, lights, Allocator())),
-      regularize(regularize) {}
+      regularize(regularize),
+      maxSplit(maxSplit) {
+    if (adjointRR)
+        radianceCache = std::make_unique<RadianceCache>(SceneBounds(), 256);
+}
 
 SampledSpectrum PathIntegrator::Li(RayDifferential ray, SampledWavelengths &lambda,
                                    SamplerHandle sampler, ScratchBuffer &scratchBuffer,
@@ -672,126 +772,208 @@ SampledSpectrum PathIntegrator::Li(RayDifferential ray, SampledWavelengths &lamb
     int depth = 0;
     Float etaScale = 1, bsdfPDF;
     SurfaceInteraction prevIntr;
+    // Declare state for adjoint-driven Russian roulette and splitting
+    thread_local std::vector<AdjointVertex> adjointVertices;
+    thread_local std::vector<PendingSplitPath> pendingPaths;
+    Float pixelEstimate = 0;
+    int nPaths = 1, maxPaths = maxSplit * maxSplit;
 
     while (true) {
-        // Find next path vertex and accumulate contribution
-        pstd::optional<ShapeIntersection> si = Intersect(ray);
-        // Add emitted light at path vertex or from the environment
-        if (!si) {
-            // Incorporate emission from infinite lights for escaped ray
-            for (const auto &light : infiniteLights) {
-                SampledSpectrum Le = light.Le(ray, lambda);
+        while (true) {
+            // Find next path vertex and accumulate contribution
+            pstd::optional<ShapeIntersection> si = Intersect(ray);
+            // Add emitted light at path vertex or from the environment
+            if (!si) {
+                // Incorporate emission from infinite lights for escaped ray
+                for (const auto &light : infiniteLights) {
+                    SampledSpectrum Le = light.Le(ray, lambda);
+                    if (depth == 0 || specularBounce)
+                        L += beta * Le;
+                    else {
+                        // Compute MIS weight for infinite light
+                        Float lightPDF =
+                            lightSampler.PDF(prevIntr, light) *
+                            light.PDF_Li(prevIntr, ray.d, LightSamplingMode::WithMIS);
+                        Float weight = PowerHeuristic(1, bsdfPDF, 1, lightPDF);
+
+                        L += beta * weight * Le;
+                    }
+                }
+
+                break;
+            }
+            // Incorporate emission from emissive surface hit by ray
+            SampledSpectrum Le = si->intr.Le(-ray.d, lambda);
+            if (Le) {
                 if (depth == 0 || specularBounce)
                     L += beta * Le;
                 else {
-                    // Compute MIS weight for infinite light
+                    // Compute MIS weight for area light
+                    LightHandle areaLight(si->intr.areaLight);
                     Float lightPDF =
-                        lightSampler.PDF(prevIntr, light) *
-                        light.PDF_Li(prevIntr, ray.d, LightSamplingMode::WithMIS);
+                        lightSampler.PDF(prevIntr, areaLight) *
+                        areaLight.PDF_Li(prevIntr, ray.d, LightSamplingMode::WithMIS);
                     Float weight = PowerHeuristic(1, bsdfPDF, 1, lightPDF);
 
                     L += beta * weight * Le;
                 }
             }
 
-            break;
-        }
-        // Incorporate emission from emissive surface hit by ray
-        SampledSpectrum Le = si->intr.Le(-ray.d, lambda);
-        if (Le) {
-            if (depth == 0 || specularBounce)
-                L += beta * Le;
-            else {
-                // Compute MIS weight for area light
-                LightHandle areaLight(si->intr.areaLight);
-                Float lightPDF =
-                    lightSampler.PDF(prevIntr, areaLight) *
-                    areaLight.PDF_Li(prevIntr, ray.d, LightSamplingMode::WithMIS);
-                Float weight = PowerHeuristic(1, bsdfPDF, 1, lightPDF);
+            SurfaceInteraction &isect = si->intr;
 
-                L += beta * weight * Le;
+            // Compute scattering functions and skip over medium boundaries
+            BSDF bsdf = isect.GetBSDF(ray, lambda, camera, scratchBuffer, sampler);
+            if (!bsdf) {
+                isect.SkipIntersection(&ray, si->tHit);
+                continue;
             }
-        }
 
-        SurfaceInteraction &isect = si->intr;
+            // Initialize _visibleSurface_ at first intersection
+            if (depth == 0 && visibleSurface != nullptr) {
+                // Estimate BSDF's albedo
+                constexpr int nRhoSamples = 16;
+                SampledSpectrum rho(0.f);
+                for (int i = 0; i < nRhoSamples; ++i) {
+                    // Generate sample for hemispherical-directional reflectance
+                    Float uc = RadicalInverse(0, i + 1);
+                    Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
+
+                    // Estimate one term of $\rho_\roman{hd}$
+                    auto bs = bsdf.Sample_f(si->intr.wo, uc, u);
+                    if (bs && bs.pdf > 0)
+                        rho += bs.f * AbsDot(bs.wi, si->intr.shading.n) / bs.pdf;
+                }
+                SampledSpectrum albedo = rho / nRhoSamples;
 
-        // Compute scattering functions and skip over medium boundaries
-        BSDF bsdf = isect.GetBSDF(ray, lambda, camera, scratchBuffer, sampler);
-        if (!bsdf) {
-            isect.SkipIntersection(&ray, si->tHit);
-            continue;
-        }
+                *visibleSurface =
+                    VisibleSurface(si->intr, camera.GetCameraTransform(), albedo, lambda);
+            }
 
-        // Initialize _visibleSurface_ at first intersection
-        if (depth == 0 && visibleSurface != nullptr) {
-            // Estimate BSDF's albedo
-            constexpr int nRhoSamples = 16;
-            SampledSpectrum rho(0.f);
-            for (int i = 0; i < nRhoSamples; ++i) {
-                // Generate sample for hemispherical-directional reflectance
-                Float uc = RadicalInverse(0, i + 1);
-                Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
-
-                // Estimate one term of $\rho_\roman{hd}$
-                auto bs = bsdf.Sample_f(si->intr.wo, uc, u);
-                if (bs && bs.pdf > 0)
-                    rho += bs.f * AbsDot(bs.wi, si->intr.shading.n) / bs.pdf;
+            // End path if maximum depth reached
+            if (depth++ == maxDepth)
+                break;
+
+            int nSplit = 1;
+            bool adjointDecided = false;
+            if (radianceCache) {
+                // Record path vertex and look up its reflected radiance estimate
+                Normal3f n = FaceForward(isect.n, isect.wo);
+                adjointVertices.push_back(
+                    {isect.p(), n, beta.Average(), L.Average(), pendingPaths.size()});
+                pstd::optional<Float> Lr = radianceCache->Lookup(isect.p(), n);
+
+                if (depth == 1)
+                    // Estimate pixel value from first vertex's cached radiance
+                    pixelEstimate = Lr ? L.Average() + beta.Average() * *Lr : 0;
+                else if (Lr && pixelEstimate > 0) {
+                    // Apply adjoint-driven Russian roulette and splitting
+                    ++adjointDecisions;
+                    adjointDecided = true;
+                    Float betaScale;
+                    nSplit = AdjointSplitFactor(beta.Average(), *Lr, pixelEstimate,
+                                                std::min(maxSplit, maxPaths - nPaths + 1),
+                                                sampler.Get1D(), &betaScale);
+                    if (nSplit == 0) {
+                        ++adjointTerminations;
+                        break;
+                    }
+                    beta *= betaScale;
+                }
             }
-            SampledSpectrum albedo = rho / nRhoSamples;
 
-            *visibleSurface =
-                VisibleSurface(si->intr, camera.GetCameraTransform(), albedo, lambda);
-        }
+            // Possibly regularize the BSDF
+            if (regularize && anyNonSpecularBounces) {
+                ++regularizedBSDFs;
+                bsdf.Regularize();
+            }
 
-        // End path if maximum depth reached
-        if (depth++ == maxDepth)
-            break;
+            ++totalBSDFs;
+            // Sample direct illumination from the light sources
+            if (bsdf.IsNonSpecular()) {
+                ++totalPaths;
+                SampledSpectrum Ld = SampleLd(isect, bsdf, lambda, sampler);
+                if (!Ld)
+                    ++zeroRadiancePaths;
+                // Undo splitting factor for direct lighting, which isn't split
+                L += beta * nSplit * Ld;
+            }
 
-        // Possibly regularize the BSDF
-        if (regularize && anyNonSpecularBounces) {
-            ++regularizedBSDFs;
-            bsdf.Regularize();
+            // Sample BSDF to get new path direction
+            Vector3f wo = -ray.d;
+            for (int i = 1; i < nSplit; ++i) {
+                // Sample direction for additional split path and save its state
+                Float u = sampler.Get1D();
+                BSDFSample bs = bsdf.Sample_f(wo, u, sampler.Get2D());
+                if (!bs)
+                    continue;
+                ++adjointSplitPaths;
+                ++nPaths;
+                Float pathEtaScale = etaScale * (bs.IsTransmission() ? Sqr(bsdf.eta) : 1);
+                pendingPaths.push_back(
+                    {isect.SpawnRay(ray, bsdf, bs.wi, bs.flags),
+                     beta * bs.f * AbsDot(bs.wi, isect.shading.n) / bs.pdf, depth,
+                     pathEtaScale,
+                     bsdf.SampledPDFIsProportional() ? bsdf.PDF(wo, bs.wi) : bs.pdf,
+                     bs.IsSpecular(), anyNonSpecularBounces || !bs.IsSpecular(),
+                     si->intr});
+            }
+            Float u = sampler.Get1D();
+            BSDFSample bs = bsdf.Sample_f(wo, u, sampler.Get2D());
+            if (!bs)
+                break;
+            // Update path state variables for after surface scattering
+            beta *= bs.f * AbsDot(bs.wi, isect.shading.n) / bs.pdf;
+            bsdfPDF = bsdf.SampledPDFIsProportional() ? bsdf.PDF(wo, bs.wi) : bs.pdf;
+            DCHECK(!std::isinf(beta.y(lambda)));
+            specularBounce = bs.IsSpecular();
+            anyNonSpecularBounces |= !bs.IsSpecular();
+            if (bs.IsTransmission())
+                etaScale *= Sqr(bsdf.eta);
+            prevIntr = si->intr;
+
+            ray = isect.SpawnRay(ray, bsdf, bs.wi, bs.flags);
+
+            // Possibly terminate the path with Russian roulette
+            // (unless the adjoint-driven decision was made at this vertex,
+            // which isn't possible where the radiance cache has no estimate.)
+            SampledSpectrum rrBeta = beta * etaScale;
+            if (rrBeta.MaxComponentValue() < rrThreshold && depth > 1 &&
+                !adjointDecided) {
+                Float q = std::max<Float>(0, 1 - rrBeta.MaxComponentValue());
+                if (sampler.Get1D() < q)
+                    break;
+                beta /= 1 - q;
+                DCHECK(!std::isinf(beta.y(lambda)));
+            }
         }
+        ReportValue(pathLength, depth);
+        if (!radianceCache)
+            break;
 
-        ++totalBSDFs;
-        // Sample direct illumination from the light sources
-        if (bsdf.IsNonSpecular()) {
-            ++totalPaths;
-            SampledSpectrum Ld = SampleLd(isect, bsdf, lambda, sampler);
-            if (!Ld)
-                ++zeroRadiancePaths;
-            L += beta * Ld;
+        // Add radiance estimates for vertices whose subpaths are complete
+        Float LAverage = L.Average();
+        while (!adjointVertices.empty() &&
+               adjointVertices.back().nPendingPaths >= pendingPaths.size()) {
+            const AdjointVertex &v = adjointVertices.back();
+            if (v.beta > 0)
+                radianceCache->Add(v.p, v.n, (LAverage - v.L) / v.beta);
+            adjointVertices.pop_back();
         }
 
-        // Sample BSDF to get new path direction
-        Vector3f wo = -ray.d;
-        Float u = sampler.Get1D();
-        BSDFSample bs = bsdf.Sample_f(wo, u, sampler.Get2D());
-        if (!bs)
+        // Continue with the next pending split path, if any
+        if (pendingPaths.empty())
             break;
-        // Update path state variables for after surface scattering
-        beta *= bs.f * AbsDot(bs.wi, isect.shading.n) / bs.pdf;
-        bsdfPDF = bsdf.SampledPDFIsProportional() ? bsdf.PDF(wo, bs.wi) : bs.pdf;
-        DCHECK(!std::isinf(beta.y(lambda)));
-        specularBounce = bs.IsSpecular();
-        anyNonSpecularBounces |= !bs.IsSpecular();
-        if (bs.IsTransmission())
-            etaScale *= Sqr(bsdf.eta);
-        prevIntr = si->intr;
-
-        ray = isect.SpawnRay(ray, bsdf, bs.wi, bs.flags);
-
-        // Possibly terminate the path with Russian roulette
-        SampledSpectrum rrBeta = beta * etaScale;
-        if (rrBeta.MaxComponentValue() < rrThreshold && depth > 1) {
-            Float q = std::max<Float>(0, 1 - rrBeta.MaxComponentValue());
-            if (sampler.Get1D() < q)
-                break;
-            beta /= 1 - q;
-            DCHECK(!std::isinf(beta.y(lambda)));
-        }
+        const PendingSplitPath &path = pendingPaths.back();
+        ray = path.ray;
+        beta = path.beta;
+        depth = path.depth;
+        etaScale = path.etaScale;
+        bsdfPDF = path.bsdfPDF;
+        specularBounce = path.specularBounce;
+        anyNonSpecularBounces = path.anyNonSpecularBounces;
+        prevIntr = path.prevIntr;
+        pendingPaths.pop_back();
     }
-    ReportValue(pathLength, depth);
     return L;
 }
 
@@ -832,8 +1014,11 @@ SampledSpectrum PathIntegrator::SampleLd(const SurfaceInteraction &intr, const B
 
 std::string PathIntegrator::ToString() const {
     return StringPrintf("[ PathIntegrator maxDepth: %d rrThreshold: %f "
-                        "lightSampler: %s regularize: %s ]",
-                        maxDepth, rrThreshold, lightSampler, regularize);
+                        "lightSampler: %s regularize: %s radianceCache: %s "
+                        "maxSplit: %d ]",
+                        maxDepth, rrThreshold, lightSampler, regularize,
+                        radianceCache ? radianceCache->ToString() : std::string("(nullptr)"),
+                        maxSplit);
 }
 
 std::unique_ptr<PathIntegrator> PathIntegrator::Create(
@@ -843,8 +1028,15 @@ std::unique_ptr<PathIntegrator> PathIntegrator::Create(
     Float rrThreshold = parameters.GetOneFloat("rrthreshold", 1.);
     std::string lightStrategy = parameters.GetOneString("lightsampler", "bvh");
     bool regularize = parameters.GetOneBool("regularize", false);
+    std::string rrStrategy = parameters.GetOneString("russianroulette", "throughput");
+    if (rrStrategy != "throughput" && rrStrategy != "adjoint")
+        ErrorExit(loc, "%s: unknown Russian roulette strategy.", rrStrategy);
+    int maxSplit = parameters.GetOneInt("maxsplit", 4);
+    if (maxSplit < 1)
+        ErrorExit(loc, "\"maxsplit\" must be at least one.");
     return std::make_unique<PathIntegrator>(maxDepth, camera, sampler, aggregate, lights,
-                                            rrThreshold, lightStrategy, regularize);
+                                            rrThreshold, lightStrategy, regularize,
+                                            rrStrategy == "adjoint", maxSplit);
 }
 
 // SimpleVolPathIntegrator Method Definitions
@@ -969,12 +1161,15 @@ SampledSpectrum VolPathIntegrator::Li(RayDifferential ray, SampledWavelengths &l
     pstd::optional<SurfaceInteraction> prevSurfaceIntr;
     pstd::optional<MediumInteraction> prevMediumIntr;
     int depth = 0;
+    // Declare state for adjoint-driven Russian roulette
+    thread_local std::vector<AdjointVertex> adjointVertices;
+    Float pixelEstimate = 0;
 
     while (true) {
         // Sample segment of volumetric scattering path
         VLOG(2, "Path tracer depth %d, current L = %s, beta = %s", depth, L, beta);
         pstd::optional<ShapeIntersection> si = Intersect(ray);
-        bool scattered = false, terminated = false;
+        bool scattered = false, terminated = false, adjointDecided = false;
         if (ray.medium) {
             // Sample the participating medium
             Float tMax = si ? si->tHit : Infinity;
@@ -1058,7 +1253,7 @@ SampledSpectrum VolPathIntegrator::Li(RayDifferential ray, SampledWavelengths &l
                 });
         }
         if (terminated)
-            return L;
+            break;
         if (scattered)
             continue;
         // Handle scattering at point on surface for volumetric path tracer
@@ -1124,7 +1319,29 @@ SampledSpectrum VolPathIntegrator::Li(RayDifferential ray, SampledWavelengths &l
         prevMediumIntr.reset();
         // Terminate path if maximum depth reached
         if (depth++ >= maxDepth)
-            return L;
+            break;
+
+        if (radianceCache) {
+            // Record path vertex and apply adjoint-driven Russian roulette
+            Normal3f n = FaceForward(isect.n, isect.wo);
+            Float throughput = beta.Average() / pdfUni.Average();
+            adjointVertices.push_back({isect.p(), n, throughput, L.Average(), 0});
+            pstd::optional<Float> Lr = radianceCache->Lookup(isect.p(), n);
+            if (depth == 1)
+                pixelEstimate = Lr ? L.Average() + throughput * *Lr : 0;
+            else if (Lr && pixelEstimate > 0) {
+                ++adjointDecisions;
+                adjointDecided = true;
+                Float betaScale;
+                if (AdjointSplitFactor(throughput, *Lr, pixelEstimate, 1, sampler.Get1D(),
+                                       &betaScale) == 0) {
+                    ++adjointTerminations;
+                    break;
+                }
+                pdfUni /= betaScale;
+                pdfNEE /= betaScale;
+            }
+        }
 
         // Possibly regularize BSDF
         if (regularize && anyNonSpecularBounces) {
@@ -1237,7 +1454,7 @@ SampledSpectrum VolPathIntegrator::Li(RayDifferential ray, SampledWavelengths &l
             break;
         SampledSpectrum rrBeta = beta * etaScale / pdfUni.Average();
         VLOG(2, "etaScale %f -> rrBeta %s", etaScale, rrBeta);
-        if (rrBeta.MaxComponentValue() < rrThreshold && depth > 1) {
+        if (rrBeta.MaxComponentValue() < rrThreshold && depth > 1 && !adjointDecided) {
             Float q = std::max<Float>(0, 1 - rrBeta.MaxComponentValue());
             if (sampler.Get1D() < q)
                 break;
@@ -1245,6 +1462,12 @@ SampledSpectrum VolPathIntegrator::Li(RayDifferential ray, SampledWavelengths &l
             pdfNEE *= 1 - q;
         }
     }
+    // Add radiance estimates for path's surface vertices to the cache
+    for (const AdjointVertex &v : adjointVertices)
+        if (v.beta > 0)
+            radianceCache->Add(v.p, v.n, (L.Average() - v.L) / v.beta);
+    adjointVertices.clear();
+
     return L;
 }
 
@@ -1347,8 +1570,9 @@ SampledSpectrum VolPathIntegrator::SampleLd(const Interaction &intr, const BSDF
 
 std::string VolPathIntegrator::ToString() const {
     return StringPrintf("[ VolPathIntegrator maxDepth: %d rrThreshold: %f "
-                        "lightSampler: %s regularize: %s ]",
-                        maxDepth, rrThreshold, lightSampler, regularize);
+                        "lightSampler: %s regularize: %s radianceCache: %s ]",
+                        maxDepth, rrThreshold, lightSampler, regularize,
+                        radianceCache ? radianceCache->ToString() : std::string("(nullptr)"));
 }
 
 std::unique_ptr<VolPathIntegrator> VolPathIntegrator::Create(
@@ -1358,9 +1582,12 @@ std::unique_ptr<VolPathIntegrator> VolPathIntegrator::Create(
     Float rrThreshold = parameters.GetOneFloat("rrthreshold", 1.);
     std::string lightStrategy = parameters.GetOneString("lightsampler", "bvh");
     bool regularize = parameters.GetOneBool("regularize", false);
+    std::string rrStrategy = parameters.GetOneString("russianroulette", "throughput");
+    if (rrStrategy != "throughput" && rrStrategy != "adjoint")
+        ErrorExit(loc, "%s: unknown Russian roulette strategy.", rrStrategy);
     return std::make_unique<VolPathIntegrator>(maxDepth, camera, sampler, aggregate,
                                                lights, rrThreshold, lightStrategy,
-                                               regularize);
+                                               regularize, rrStrategy == "adjoint");
 }
 
 // AOIntegrator Method Definitions
@@ -1444,11 +1671,13 @@ SampledSpectrum ConnectBDPT(const Integrator &integrator, SampledWavelengths &la
                             Vertex *lightVertices, Vertex *cameraVertices, int s, int t,
                             LightSamplerHandle lightSampler, CameraHandle camera,
                             SamplerHandle sampler, pstd::optional<Point2f> *pRaster,
-                            Float *misWeightPtr = nullptr);
+                            Float *misWeightPtr = nullptr, bool incrementalMIS = true);
 
 Float InfiniteLightDensity(const std::vector<LightHandle> &infiniteLights,
                            LightSamplerHandle lightSampler, const Vector3f &w);
 
+void ComputeMISPartialSums(Vertex *path, int nVertices, TransportMode mode);
+
 // VertexType Definition
 enum class VertexType { Camera, Light, Surface, Medium };
 
@@ -1523,6 +1752,8 @@ struct Vertex {
     BSDF bsdf;
     bool delta = false;
     Float pdfFwd = 0, pdfRev = 0;
+    // Sum of MIS ratios $r_i$ for the strategies that connect up to this vertex
+    Float misSumRi = 0;
 
     // Vertex Public Methods
     // Need to define these two to make compilers happy with the non-POD
@@ -1774,7 +2005,7 @@ struct Vertex {
     }
 
     Float PdfLightOrigin(const std::vector<LightHandle> &infiniteLights, const Vertex &v,
-                         LightSamplerHandle lightSampler) {
+                         LightSamplerHandle lightSampler) const {
         Vector3f w = v.p() - p();
         if (LengthSquared(w) == 0)
             return 0.;
@@ -1873,10 +2104,12 @@ int GenerateCameraSubpath(const Integrator &integrator, const RayDifferential &r
     Float pdfPos, pdfDir;
     path[0] = Vertex::CreateCamera(camera, ray, beta);
     camera.PDF_We(ray, &pdfPos, &pdfDir);
-    return RandomWalk(integrator, lambda, ray, sampler, camera, scratchBuffer, beta,
-                      pdfDir, maxDepth - 1, TransportMode::Radiance, path + 1,
-                      regularize) +
-           1;
+    int nVertices = RandomWalk(integrator, lambda, ray, sampler, camera, scratchBuffer,
+                               beta, pdfDir, maxDepth - 1, TransportMode::Radiance,
+                               path + 1, regularize) +
+                    1;
+    ComputeMISPartialSums(path, nVertices, TransportMode::Radiance);
+    return nVertices;
 }
 
 int GenerateLightSubpath(const Integrator &integrator, SampledWavelengths &lambda,
@@ -1921,6 +2154,7 @@ int GenerateLightSubpath(const Integrator &integrator, SampledWavelengths &lambd
             InfiniteLightDensity(integrator.infiniteLights, lightSampler, ray.d);
     }
 
+    ComputeMISPartialSums(path, nVertices + 1, TransportMode::Importance);
     return nVertices + 1;
 }
 
@@ -2155,6 +2389,82 @@ Float MISWeight(const Integrator &integrator, Vertex *lightVertices,
     return 1 / (1 + sumRi);
 }
 
+void ComputeMISPartialSums(Vertex *path, int nVertices, TransportMode mode) {
+    // Accumulate $r_i$ products from the subpath origin toward its end
+    auto remap0 = [](float f) -> Float { return f != 0 ? f : 1; };
+    Float sumRi = 0;
+    for (int i = 0; i < nVertices; ++i) {
+        // The camera vertex is never the endpoint of a hypothetical strategy
+        if (i == 0 && mode == TransportMode::Radiance) {
+            path[0].misSumRi = 0;
+            continue;
+        }
+        bool deltaPrev = i > 0 ? path[i - 1].delta : path[0].IsDeltaLight();
+        Float ri = remap0(path[i].pdfRev) / remap0(path[i].pdfFwd);
+        sumRi = ri * ((!path[i].delta && !deltaPrev ? 1 : 0) + sumRi);
+        path[i].misSumRi = sumRi;
+    }
+}
+
+Float IncrementalMISWeight(const Integrator &integrator, const Vertex *lightVertices,
+                           const Vertex *cameraVertices, const Vertex &sampled, int s,
+                           int t, LightSamplerHandle lightSampler) {
+    if (s + t == 2)
+        return 1;
+    auto remap0 = [](float f) -> Float { return f != 0 ? f : 1; };
+
+    // Look up connection vertices and their predecessors
+    const Vertex *qs = s == 1 ? &sampled : (s > 1 ? &lightVertices[s - 1] : nullptr);
+    const Vertex *pt = t == 1 ? &sampled : (t > 1 ? &cameraVertices[t - 1] : nullptr);
+    const Vertex *qsMinus = s > 1 ? &lightVertices[s - 2] : nullptr;
+    const Vertex *ptMinus = t > 1 ? &cameraVertices[t - 2] : nullptr;
+
+    // Compute reverse densities of the connection vertices for this strategy
+    Float ptPdfRev = 0, ptMinusPdfRev = 0, qsPdfRev = 0, qsMinusPdfRev = 0;
+    if (pt)
+        ptPdfRev = s > 0 ? qs->PDF(integrator, qsMinus, *pt)
+                         : pt->PdfLightOrigin(integrator.infiniteLights, *ptMinus,
+                                              lightSampler);
+    if (ptMinus)
+        ptMinusPdfRev = s > 0 ? pt->PDF(integrator, qs, *ptMinus)
+                              : pt->PdfLight(integrator, *ptMinus);
+    if (qs)
+        qsPdfRev = pt->PDF(integrator, ptMinus, *qs);
+    if (qsMinus)
+        qsMinusPdfRev = qs->PDF(integrator, pt, *qsMinus);
+
+    // Extend the camera subpath's partial sum through $\pt{}_{t-2}$ and $\pt{}_{t-1}$
+    Float sumRi = 0;
+    if (t > 1) {
+        Float tail = 0;
+        if (t > 2) {
+            const Vertex &ptMinus2 = cameraVertices[t - 3];
+            bool valid = !ptMinus->delta && !ptMinus2.delta;
+            tail = remap0(ptMinusPdfRev) / remap0(ptMinus->pdfFwd) *
+                   ((valid ? 1 : 0) + ptMinus2.misSumRi);
+        }
+        // $\pt{}_{t-1}$ is treated as non-degenerate for the connection
+        sumRi +=
+            remap0(ptPdfRev) / remap0(pt->pdfFwd) * ((!ptMinus->delta ? 1 : 0) + tail);
+    }
+
+    // Extend the light subpath's partial sum through $\pq{}_{s-2}$ and $\pq{}_{s-1}$
+    if (s > 0) {
+        Float tail = 0;
+        if (s > 1) {
+            bool deltaPrev =
+                s > 2 ? lightVertices[s - 3].delta : qsMinus->IsDeltaLight();
+            bool valid = !qsMinus->delta && !deltaPrev;
+            tail = remap0(qsMinusPdfRev) / remap0(qsMinus->pdfFwd) *
+                   ((valid ? 1 : 0) + (s > 2 ? lightVertices[s - 3].misSumRi : 0));
+        }
+        bool deltaPrev = s > 1 ? qsMinus->delta : qs->IsDeltaLight();
+        sumRi += remap0(qsPdfRev) / remap0(qs->pdfFwd) * ((!deltaPrev ? 1 : 0) + tail);
+    }
+
+    return 1 / (1 + sumRi);
+}
+
 Float InfiniteLightDensity(const std::vector<LightHandle> &infiniteLights,
                            LightSamplerHandle lightSampler, const Vector3f &w) {
     Float pdf = 0;
@@ -2227,7 +2537,8 @@ SampledSpectrum BDPTIntegrator::Li(RayDifferential ray, SampledWavelengths &lamb
             Float misWeight = 0.f;
             SampledSpectrum Lpath =
                 ConnectBDPT(*this, lambda, lightVertices, cameraVertices, s, t,
-                            lightSampler, camera, sampler, &pFilmNew, &misWeight);
+                            lightSampler, camera, sampler, &pFilmNew, &misWeight,
+                            incrementalMIS);
             VLOG(2, "Connect bdpt s: %d, t: %d, Lpath: %s, misWeight: %f", s, t, Lpath,
                  misWeight);
             if (visualizeStrategies || visualizeWeights) {
@@ -2255,7 +2566,7 @@ SampledSpectrum ConnectBDPT(const Integrator &integrator, SampledWavelengths &la
                             Vertex *lightVertices, Vertex *cameraVertices, int s, int t,
                             LightSamplerHandle lightSampler, CameraHandle camera,
                             SamplerHandle sampler, pstd::optional<Point2f> *pRaster,
-                            Float *misWeightPtr) {
+                            Float *misWeightPtr, bool incrementalMIS) {
     SampledSpectrum L(0.f);
     // Ignore invalid connections related to infinite area lights
     if (t > 1 && s != 0 && cameraVertices[t - 1].type == VertexType::Light)
@@ -2351,9 +2662,13 @@ SampledSpectrum ConnectBDPT(const Integrator &integrator, SampledWavelengths &la
         ++zeroRadiancePaths;
     ReportValue(pathLength, s + t - 2);
     // Compute MIS weight for connection strategy
-    Float misWeight = L ? MISWeight(integrator, lightVertices, cameraVertices, sampled, s,
-                                    t, lightSampler)
-                        : 0.f;
+    Float misWeight = 0.f;
+    if (L)
+        misWeight = incrementalMIS
+                        ? IncrementalMISWeight(integrator, lightVertices, cameraVertices,
+                                               sampled, s, t, lightSampler)
+                        : MISWeight(integrator, lightVertices, cameraVertices, sampled, s,
+                                    t, lightSampler);
     VLOG(2, "MIS weight for (s,t) = (%d, %d) connection: %f", s, t, misWeight);
     DCHECK(!std::isnan(misWeight));
     L *= misWeight;
@@ -2366,9 +2681,9 @@ SampledSpectrum ConnectBDPT(const Integrator &integrator, SampledWavelengths &la
 std::string BDPTIntegrator::ToString() const {
     return StringPrintf("[ BDPTIntegrator maxDepth: %d visualizeStrategies: %s "
                         "visualizeWeights: %s lightSampleStrategy: %s regularize: %s "
-                        "lightSampler: %s ]",
+                        "incrementalMIS: %s lightSampler: %s ]",
                         maxDepth, visualizeStrategies, visualizeWeights,
-                        lightSampleStrategy, regularize, lightSampler);
+                        lightSampleStrategy, regularize, incrementalMIS, lightSampler);
 }
 
 std::unique_ptr<BDPTIntegrator> BDPTIntegrator::Create(
@@ -2386,9 +2701,10 @@ std::unique_ptr<BDPTIntegrator> BDPTIntegrator::Create(
 
     std::string lightStrategy = parameters.GetOneString("lightsampler", "power");
     bool regularize = parameters.GetOneBool("regularize", false);
+    bool incrementalMIS = parameters.GetOneBool("incrementalmis", true);
     return std::make_unique<BDPTIntegrator>(camera, sampler, aggregate, lights, maxDepth,
                                             visualizeStrategies, visualizeWeights,
-                                            lightStrategy, regularize);
+                                            lightStrategy, regularize, incrementalMIS);
 }
 
 STAT_PERCENT("Integrator/Acceptance rate", acceptedMutations, totalMutations);
@@ -2656,11 +2972,16 @@ STAT_RATIO("Stochastic Progressive Photon Mapping/Visible points checked per pho
            "intersection",
            visiblePointsChecked, totalPhotonSurfaceInteractions);
 STAT_COUNTER("Stochastic Progressive Photon Mapping/Photon paths followed", photonPaths);
+STAT_COUNTER("Stochastic Progressive Photon Mapping/Photons traced per second",
+             photonsPerSecond);
 STAT_INT_DISTRIBUTION(
     "Stochastic Progressive Photon Mapping/Grid cells per visible point",
     gridCellsPerVisiblePoint);
 STAT_MEMORY_COUNTER("Memory/SPPM Pixels", pixelMemoryBytes);
-STAT_MEMORY_COUNTER("Memory/SPPM BSDF and Grid Memory", sppmMemoryArenaBytes);
+STAT_MEMORY_COUNTER("Memory/SPPM BSDF Memory", sppmMemoryArenaBytes);
+STAT_MEMORY_COUNTER("Memory/SPPM Visible Point Grid", sppmGridBytes);
+STAT_COUNTER("Stochastic Progressive Photon Mapping/Grid coarsenings for memory limit",
+             sppmGridCoarsenings);
 
 // SPPMPixel Definition
 struct SPPMPixel {
@@ -2684,10 +3005,18 @@ struct SPPMPixel {
     RGB tau;
 };
 
-// SPPMPixelListNode Definition
-struct SPPMPixelListNode {
-    SPPMPixel *pixel;
-    SPPMPixelListNode *next;
+// SPPMPhotonBatch Definition
+struct SPPMPhotonBatch {
+    // SPPMPhotonBatch Public Members
+    static constexpr int maxSize = 512;
+    // Light selection, light sampling, time, and first BSDF sampling dimensions
+    static constexpr int nBlockDimensions = 10;
+    pstd::array<Float, maxSize * nBlockDimensions> u;
+    pstd::array<pstd::optional<SampledLight>, maxSize> sampledLights;
+    pstd::array<int, maxSize> order;
+    pstd::array<RayDifferential, maxSize> rays;
+    pstd::array<SampledSpectrum, maxSize> beta;
+    pstd::array<pstd::optional<ShapeIntersection>, maxSize> firstIntersections;
 };
 
 // SPPM Utility Functions
@@ -2707,6 +3036,136 @@ inline unsigned int hash(const Point3i &p, int hashSize) {
     return Hash(p.x, p.y, p.z) % hashSize;
 }
 
+// SPPMVisiblePointGrid Definition
+class SPPMVisiblePointGrid {
+  public:
+    // SPPMVisiblePointGrid Public Methods
+    SPPMVisiblePointGrid(pstd::span<SPPMPixel> pixels, size_t maxBytes);
+
+    template <typename F>
+    void ForEachCandidate(const Point3f &p, F func) {
+        Point3i pi;
+        if (!ToGrid(p, bounds, gridRes, &pi))
+            return;
+        int h = hash(pi, hashSize);
+        for (uint32_t i = cellOffsets[h]; i < cellOffsets[h + 1]; ++i)
+            func(pixels[entries[i]]);
+    }
+
+    size_t BytesAllocated() const {
+        return cellOffsets.size() * sizeof(uint32_t) + entries.size() * sizeof(uint32_t);
+    }
+
+  private:
+    // SPPMVisiblePointGrid Private Methods
+    template <typename F>
+    void ForEachOverlappedCell(const SPPMPixel &pixel, F func) const {
+        Float radius = pixel.radius;
+        Point3i pMin, pMax;
+        ToGrid(pixel.vp.p - Vector3f(radius, radius, radius), bounds, gridRes, &pMin);
+        ToGrid(pixel.vp.p + Vector3f(radius, radius, radius), bounds, gridRes, &pMax);
+        for (int z = pMin.z; z <= pMax.z; ++z)
+            for (int y = pMin.y; y <= pMax.y; ++y)
+                for (int x = pMin.x; x <= pMax.x; ++x)
+                    func(hash(Point3i(x, y, z), hashSize));
+    }
+
+    // SPPMVisiblePointGrid Private Members
+    pstd::span<SPPMPixel> pixels;
+    Bounds3f bounds;
+    int gridRes[3] = {1, 1, 1};
+    int hashSize;
+    std::vector<uint32_t> cellOffsets;
+    std::vector<uint32_t> entries;
+};
+
+// SPPMVisiblePointGrid Method Definitions
+SPPMVisiblePointGrid::SPPMVisiblePointGrid(pstd::span<SPPMPixel> pixels, size_t maxBytes)
+    : pixels(pixels), hashSize(NextPrime(pixels.size())), cellOffsets(hashSize + 1, 0) {
+    // Compute grid bounds for SPPM visible points
+    Float maxRadius = 0.;
+    for (const SPPMPixel &pixel : pixels) {
+        if (!pixel.vp.beta)
+            continue;
+        Bounds3f vpBound = Expand(Bounds3f(pixel.vp.p), pixel.radius);
+        bounds = Union(bounds, vpBound);
+        maxRadius = std::max(maxRadius, pixel.radius);
+    }
+    if (maxRadius == 0)
+        return;
+
+    // Find grid resolution that keeps the entries array within _maxBytes_
+    size_t offsetBytes = cellOffsets.size() * sizeof(uint32_t);
+    int64_t maxEntries =
+        std::min<int64_t>((maxBytes > offsetBytes ? maxBytes - offsetBytes : 0) /
+                              sizeof(uint32_t),
+                          std::numeric_limits<uint32_t>::max());
+    Vector3f diag = bounds.Diagonal();
+    Float maxDiag = MaxComponentValue(diag);
+    int baseGridRes = std::max<int>(maxDiag / maxRadius, 1);
+    int64_t nEntries;
+    while (true) {
+        // Compute resolution of SPPM grid in each dimension
+        for (int i = 0; i < 3; ++i)
+            gridRes[i] = std::max<int>(baseGridRes * diag[i] / maxDiag, 1);
+
+        // Count grid cell overlaps for all visible points
+        std::atomic<int64_t> overlapCount{0};
+        ParallelFor(0, pixels.size(), [&](int64_t start, int64_t end) {
+            int64_t count = 0;
+            for (int64_t i = start; i < end; ++i)
+                if (pixels[i].vp.beta)
+                    ForEachOverlappedCell(pixels[i], [&](int) { ++count; });
+            overlapCount += count;
+        });
+        nEntries = overlapCount;
+
+        if (nEntries <= maxEntries || baseGridRes == 1)
+            break;
+        // Coarsen grid to reduce the number of overlapped cells
+        ++sppmGridCoarsenings;
+        baseGridRes = std::max(1, baseGridRes / 2);
+    }
+    if (nEntries > maxEntries)
+        Warning("SPPM visible point grid requires %d bytes, which exceeds the limit of "
+                "%d bytes.",
+                nEntries * sizeof(uint32_t) + offsetBytes, maxBytes);
+
+    // Count visible points in each grid cell
+    std::vector<std::atomic<uint32_t>> cellCounts(hashSize);
+    ParallelFor(0, pixels.size(), [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; ++i) {
+            if (!pixels[i].vp.beta)
+                continue;
+            int nCells = 0;
+            ForEachOverlappedCell(pixels[i], [&](int h) {
+                cellCounts[h].fetch_add(1, std::memory_order_relaxed);
+                ++nCells;
+            });
+            ReportValue(gridCellsPerVisiblePoint, nCells);
+        }
+    });
+
+    // Compute cell offsets and reset counts for use as insertion cursors
+    for (int h = 0; h < hashSize; ++h) {
+        cellOffsets[h + 1] = cellOffsets[h] + cellCounts[h].load();
+        cellCounts[h] = 0;
+    }
+
+    // Scatter visible point indices into cells' contiguous ranges
+    entries.resize(nEntries);
+    ParallelFor(0, pixels.size(), [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; ++i) {
+            if (!pixels[i].vp.beta)
+                continue;
+            ForEachOverlappedCell(pixels[i], [&](int h) {
+                uint32_t offset = cellCounts[h].fetch_add(1, std::memory_order_relaxed);
+                entries[cellOffsets[h] + offset] = i;
+            });
+        }
+    });
+}
+
 // SPPM Method Definitions
 void SPPMIntegrator::Render() {
     // Initialize local variables for _SPPMIntegrator::Render()_
@@ -2739,6 +3198,8 @@ void SPPMIntegrator::Render() {
     for (int i = 0; i < MaxThreadIndex(); ++i)
         // TODO: size this
         perThreadScratchBuffers.push_back(ScratchBuffer(nPixels * 1024));
+    std::vector<SPPMPhotonBatch> photonBatches(MaxThreadIndex());
+    double photonSeconds = 0;
     const Sensor *sensor = camera.GetFilm().GetSensor();
     auto ToSensorRGB = [&](const SampledSpectrum &L,
                            const SampledWavelengths &lambda) -> RGB {
@@ -2857,63 +3318,8 @@ void SPPMIntegrator::Render() {
         }
         progress.Update();
         // Create grid of all SPPM visible points
-        // Allocate grid for SPPM visible points
-        const int hashSize = NextPrime(nPixels);
-        std::vector<std::atomic<SPPMPixelListNode *>> grid(hashSize);
-
-        // Compute grid bounds for SPPM visible points
-        Bounds3f gridBounds;
-        Float maxRadius = 0.;
-        for (const SPPMPixel &pixel : pixels) {
-            if (!pixel.vp.beta)
-                continue;
-            Bounds3f vpBound = Expand(Bounds3f(pixel.vp.p), pixel.radius);
-            gridBounds = Union(gridBounds, vpBound);
-            maxRadius = std::max(maxRadius, pixel.radius);
-        }
-
-        // Compute resolution of SPPM grid in each dimension
-        int gridRes[3];
-        Vector3f diag = gridBounds.Diagonal();
-        Float maxDiag = MaxComponentValue(diag);
-        int baseGridRes = (int)(maxDiag / maxRadius);
-        for (int i = 0; i < 3; ++i)
-            gridRes[i] = std::max<int>(baseGridRes * diag[i] / maxDiag, 1);
-
-        // Add visible points to SPPM grid
-        ParallelFor2D(pixelBounds, [&](Bounds2i tileBounds) {
-            ScratchBuffer &scratchBuffer = perThreadScratchBuffers[ThreadIndex];
-            for (Point2i pPixel : tileBounds) {
-                SPPMPixel &pixel = pixels[pPixel];
-                if (pixel.vp.beta) {
-                    // Add pixel's visible point to applicable grid cells
-                    Float radius = pixel.radius;
-                    Point3i pMin, pMax;
-                    ToGrid(pixel.vp.p - Vector3f(radius, radius, radius), gridBounds,
-                           gridRes, &pMin);
-                    ToGrid(pixel.vp.p + Vector3f(radius, radius, radius), gridBounds,
-                           gridRes, &pMax);
-                    for (int z = pMin.z; z <= pMax.z; ++z)
-                        for (int y = pMin.y; y <= pMax.y; ++y)
-                            for (int x = pMin.x; x <= pMax.x; ++x) {
-                                // Add visible point to grid cell $(x, y, z)$
-                                int h = hash(Point3i(x, y, z), hashSize);
-                                SPPMPixelListNode *node =
-                                    scratchBuffer.Alloc<SPPMPixelListNode>();
-                                node->pixel = &pixel;
-
-                                // Atomically add _node_ to the start of _grid[h]_'s
-                                // linked list
-                                node->next = grid[h];
-                                while (!grid[h].compare_exchange_weak(node->next, node))
-                                    ;
-                            }
-                    ReportValue(gridCellsPerVisiblePoint, (1 + pMax.x - pMin.x) *
-                                                              (1 + pMax.y - pMin.y) *
-                                                              (1 + pMax.z - pMin.z));
-                }
-            }
-        });
+        SPPMVisiblePointGrid grid(pixels, maxGridBytes);
+        sppmGridBytes = std::max<int64_t>(sppmGridBytes, grid.BytesAllocated());
 
         // Trace photons and accumulate contributions
         // Create per-thread scratch buffers for photon shooting
@@ -2921,85 +3327,116 @@ void SPPMIntegrator::Render() {
         for (int i = 0; i < MaxThreadIndex(); ++i)
             photonShootScratchBuffers.push_back(ScratchBuffer(65536));
 
-        ParallelFor(0, photonsPerIteration, [&](int64_t start, int64_t end) {
+        Timer photonTimer;
+        int64_t nPhotonBatches = (photonsPerIteration + SPPMPhotonBatch::maxSize - 1) /
+                                 SPPMPhotonBatch::maxSize;
+        ParallelFor(0, nPhotonBatches, [&](int64_t batchIndex) {
             ScratchBuffer &scratchBuffer = photonShootScratchBuffers[ThreadIndex];
-            for (int64_t photonIndex = start; photonIndex < end; ++photonIndex) {
-                // Follow photon path for _photonIndex_
-                // Define sampling lambda functions for photon shooting
-                uint64_t haltonIndex =
-                    (uint64_t)iter * (uint64_t)photonsPerIteration + photonIndex;
-                int haltonDim = 0;
-                auto Sample1D = [&]() {
-                    Float u = ScrambledRadicalInverse(haltonDim, haltonIndex,
-                                                      (*digitPermutations)[haltonDim]);
-                    ++haltonDim;
-                    return u;
-                };
-                auto Sample2D = [&]() {
-                    Point2f u(
-                        ScrambledRadicalInverse(haltonDim, haltonIndex,
-                                                (*digitPermutations)[haltonDim]),
-                        ScrambledRadicalInverse(haltonDim + 1, haltonIndex,
-                                                (*digitPermutations)[haltonDim + 1]));
-                    haltonDim += 2;
-                    return u;
-                };
+            SPPMPhotonBatch &batch = photonBatches[ThreadIndex];
+            int64_t batchStart = batchIndex * SPPMPhotonBatch::maxSize;
+            int batchSize = std::min<int64_t>(SPPMPhotonBatch::maxSize,
+                                              photonsPerIteration - batchStart);
+            constexpr int nBlockDims = SPPMPhotonBatch::nBlockDimensions;
+            auto HaltonIndex = [&](int i) {
+                return (uint64_t)iter * (uint64_t)photonsPerIteration + batchStart + i;
+            };
+
+            // Generate leading sample dimensions for batch's photons in blocks
+            for (int dim = 0; dim < nBlockDims; ++dim) {
+                const DigitPermutation &perm = (*digitPermutations)[dim];
+                for (int i = 0; i < batchSize; ++i)
+                    batch.u[i * nBlockDims + dim] =
+                        ScrambledRadicalInverse(dim, HaltonIndex(i), perm);
+            }
 
-                // Choose light to shoot photon from
-                pstd::optional<SampledLight> sampledLight =
-                    shootLightSampler.Sample(Sample1D());
-                if (!sampledLight)
+            // Choose lights to shoot photons from and group photons by light
+            for (int i = 0; i < batchSize; ++i) {
+                batch.sampledLights[i] = shootLightSampler.Sample(batch.u[i * nBlockDims]);
+                batch.order[i] = i;
+            }
+            auto LightKey = [&](int i) -> const void * {
+                return batch.sampledLights[i] ? batch.sampledLights[i]->light.ptr()
+                                              : nullptr;
+            };
+            std::stable_sort(batch.order.begin(), batch.order.begin() + batchSize,
+                             [&](int a, int b) { return LightKey(a) < LightKey(b); });
+
+            // Generate photon rays and trace their first segments in light order
+            for (int j = 0; j < batchSize; ++j) {
+                int i = batch.order[j];
+                batch.beta[i] = SampledSpectrum(0.f);
+                if (!batch.sampledLights[i])
                     continue;
-                LightHandle light = sampledLight->light;
-                Float lightPDF = sampledLight->pdf;
+                LightHandle light = batch.sampledLights[i]->light;
+                Float lightPDF = batch.sampledLights[i]->pdf;
 
                 // Compute sample values for photon ray leaving light source
-                Point2f uLight0 = Sample2D();
-                Point2f uLight1 = Sample2D();
-                Float uLightTime = camera.SampleTime(Sample1D());
+                const Float *u = &batch.u[i * nBlockDims];
+                Point2f uLight0(u[1], u[2]);
+                Point2f uLight1(u[3], u[4]);
+                Float uLightTime = camera.SampleTime(u[5]);
 
                 // Generate _photonRay_ from light source and initialize _beta_
                 LightLeSample les = light.SampleLe(uLight0, uLight1, lambda, uLightTime);
                 if (!les || les.pdfPos == 0 || les.pdfDir == 0 || !les.L)
                     continue;
-                RayDifferential photonRay = RayDifferential(les.ray);
-                SampledSpectrum beta = (les.AbsCosTheta(photonRay.d) * les.L) /
-                                       (lightPDF * les.pdfPos * les.pdfDir);
+                batch.rays[i] = RayDifferential(les.ray);
+                batch.beta[i] = (les.AbsCosTheta(batch.rays[i].d) * les.L) /
+                                (lightPDF * les.pdfPos * les.pdfDir);
+                if (batch.beta[i])
+                    batch.firstIntersections[i] = Intersect(batch.rays[i]);
+            }
+
+            for (int j = 0; j < batchSize; ++j) {
+                // Follow photon path for batch photon _i_
+                int i = batch.order[j];
+                SampledSpectrum beta = batch.beta[i];
                 if (!beta)
                     continue;
+                RayDifferential photonRay = batch.rays[i];
+
+                // Define sampling lambda functions for photon shooting
+                uint64_t haltonIndex = HaltonIndex(i);
+                int haltonDim = 6;
+                auto Sample1D = [&]() {
+                    Float u = haltonDim < nBlockDims
+                                  ? batch.u[i * nBlockDims + haltonDim]
+                                  : ScrambledRadicalInverse(
+                                        haltonDim, haltonIndex,
+                                        (*digitPermutations)[haltonDim]);
+                    ++haltonDim;
+                    return u;
+                };
+                auto Sample2D = [&]() {
+                    Float u0 = Sample1D();
+                    return Point2f(u0, Sample1D());
+                };
 
                 // Follow photon path through scene and record intersections
-                SurfaceInteraction isect;
+                bool firstSegment = true;
                 for (int depth = 0; depth < maxDepth; ++depth) {
-                    pstd::optional<ShapeIntersection> si = Intersect(photonRay);
+                    pstd::optional<ShapeIntersection> si =
+                        firstSegment ? std::move(batch.firstIntersections[i])
+                                     : Intersect(photonRay);
+                    firstSegment = false;
                     if (!si)
                         break;
                     SurfaceInteraction &isect = si->intr;
                     ++totalPhotonSurfaceInteractions;
                     if (depth > 0) {
                         // Add photon contribution to nearby visible points
-                        Point3i photonGridIndex;
-                        if (ToGrid(isect.p(), gridBounds, gridRes, &photonGridIndex)) {
-                            int h = hash(photonGridIndex, hashSize);
-                            // Add photon contribution to visible points in _grid[h]_
-                            for (SPPMPixelListNode *node =
-                                     grid[h].load(std::memory_order_relaxed);
-                                 node != nullptr; node = node->next) {
-                                ++visiblePointsChecked;
-                                SPPMPixel &pixel = *node->pixel;
-                                Float radius = pixel.radius;
-                                if (DistanceSquared(pixel.vp.p, isect.p()) >
-                                    radius * radius)
-                                    continue;
-                                // Update _pixel_ $\Phi$ and $M$ for nearby photon
-                                Vector3f wi = -photonRay.d;
-                                SampledSpectrum Phi =
-                                    beta * pixel.vp.bsdf.f(pixel.vp.wo, wi);
-                                for (int i = 0; i < NSpectrumSamples; ++i)
-                                    pixel.Phi[i].Add(Phi[i]);
-                                ++pixel.M;
-                            }
-                        }
+                        grid.ForEachCandidate(isect.p(), [&](SPPMPixel &pixel) {
+                            ++visiblePointsChecked;
+                            Float radius = pixel.radius;
+                            if (DistanceSquared(pixel.vp.p, isect.p()) > radius * radius)
+                                return;
+                            // Update _pixel_ $\Phi$ and $M$ for nearby photon
+                            Vector3f wi = -photonRay.d;
+                            SampledSpectrum Phi = beta * pixel.vp.bsdf.f(pixel.vp.wo, wi);
+                            for (int i = 0; i < NSpectrumSamples; ++i)
+                                pixel.Phi[i].Add(Phi[i]);
+                            ++pixel.M;
+                        });
                     }
                     // Sample new photon ray direction
                     // Compute BSDF at photon intersection point
@@ -3035,6 +3472,10 @@ void SPPMIntegrator::Render() {
                 scratchBuffer.Reset();
             }
         });
+        photonSeconds += photonTimer.ElapsedSeconds();
+        LOG_VERBOSE("SPPM iteration %d: traced %d photons (%.1f photons/sec)", iter,
+                    photonsPerIteration,
+                    photonsPerIteration / photonTimer.ElapsedSeconds());
         // CAN CUT THIS??
         for (ScratchBuffer &scratchBuffer : perThreadScratchBuffers)
             scratchBuffer.Reset();
@@ -3125,6 +3566,8 @@ void SPPMIntegrator::Render() {
                                                            return v + arena.BytesAllocated();
                                                        });
 #endif
+    if (photonSeconds > 0)
+        photonsPerSecond = int64_t(photonPaths / photonSeconds);
     progress.Done();
 }
 
@@ -3218,9 +3661,10 @@ SampledSpectrum SPPMIntegrator::SampleLd(const SurfaceInteraction &intr, const B
 std::string SPPMIntegrator::ToString() const {
     return StringPrintf("[ SPPMIntegrator camera: %s initialSearchRadius: %f "
                         "nIterations: %d maxDepth: %d photonsPerIteration: %d "
-                        "regularize: %s colorSpace: %s digitPermutations:(elided) ]",
+                        "regularize: %s colorSpace: %s maxGridBytes: %d "
+                        "digitPermutations:(elided) ]",
                         camera, initialSearchRadius, nIterations, maxDepth,
-                        photonsPerIteration, regularize, *colorSpace);
+                        photonsPerIteration, regularize, *colorSpace, maxGridBytes);
 }
 
 std::unique_ptr<SPPMIntegrator> SPPMIntegrator::Create(
@@ -3235,9 +3679,650 @@ std::unique_ptr<SPPMIntegrator> SPPMIntegrator::Create(
         nIterations = std::max(1, nIterations / 16);
     bool regularize = parameters.GetOneBool("regularize", false);
     int seed = parameters.GetOneInt("seed", 0);
+    int maxGridMB = parameters.GetOneInt("maxgridmemory", 1024);
+    if (maxGridMB <= 0)
+        ErrorExit(loc, "\"maxgridmemory\" must be positive.");
     return std::make_unique<SPPMIntegrator>(camera, aggregate, lights, nIterations,
                                             photonsPerIter, maxDepth, radius, regularize,
-                                            seed, colorSpace);
+                                            seed, colorSpace, size_t(maxGridMB) << 20);
+}
+
+// VCM Local Definitions
+STAT_COUNTER("Vertex Connection and Merging/Light vertices cached", vcmLightVertices);
+STAT_PERCENT("Vertex Connection and Merging/Merge candidates within radius",
+             vcmMergesAccepted, vcmMergeCandidates);
+STAT_MEMORY_COUNTER("Memory/VCM light vertex cache", vcmCacheBytes);
+
+// VCMLightVertex Definition
+struct VCMLightVertex {
+    // VCMLightVertex Public Members
+    Interaction intr;
+    Normal3f ns;
+    BSDF bsdf;
+    SampledSpectrum beta;
+    int depth;
+    Float dVCM, dVC, dVM;
+};
+
+// VCMSubpath Definition
+struct VCMSubpath {
+    // VCMSubpath Public Methods
+    void UpdateForScattering(const BSDFSample &bs, Float pdfFwd, Float pdfRev,
+                             Float cosTheta, Float vmWeightFactor, Float vcWeightFactor) {
+        if (bs.IsSpecular()) {
+            dVCM = 0;
+            dVC *= cosTheta;
+            dVM *= cosTheta;
+        } else {
+            dVC = cosTheta / pdfFwd * (dVC * pdfRev + dVCM + vmWeightFactor);
+            dVM = cosTheta / pdfFwd * (dVM * pdfRev + dVCM * vcWeightFactor + 1);
+            dVCM = 1 / pdfFwd;
+        }
+    }
+
+    // VCMSubpath Public Members
+    SampledSpectrum beta;
+    int depth = 1;
+    // Recursive MIS quantities of Georgiev et al.'s VCM formulation
+    Float dVCM = 0, dVC = 0, dVM = 0;
+};
+
+// VCM Utility Functions
+static BSDF CopyBSDF(BSDF bsdf, Allocator alloc) {
+    // Copy _bsdf_'s BxDF out of scratch memory so that it outlives the light subpath
+    BxDFHandle bxdf = bsdf.GetBxDF();
+    auto copy = [&](auto ptr) -> BxDFHandle {
+        using BxDF = typename std::remove_cv_t<std::remove_pointer_t<decltype(ptr)>>;
+        return alloc.new_object<BxDF>(*ptr);
+    };
+    bsdf.SetBxDF(bxdf.DispatchCPU(copy));
+    return bsdf;
+}
+
+static Float VCMEmissionPDF(LightHandle light, const Interaction &intr, Vector3f w) {
+    Float pdfPos = 0, pdfDir = 0;
+    if (light.Type() == LightType::Area)
+        light.PDF_Le(intr, w, &pdfPos, &pdfDir);
+    else
+        light.PDF_Le(Ray(intr.p(), w, intr.time), &pdfPos, &pdfDir);
+    // Omit the density of delta components, which all strategies share
+    if (light.Type() == LightType::DeltaPosition)
+        return pdfDir;
+    else if (light.Type() == LightType::DeltaDirection)
+        return pdfPos;
+    return pdfPos * pdfDir;
+}
+
+// VCMLightVertexGrid Definition
+class VCMLightVertexGrid {
+  public:
+    // VCMLightVertexGrid Public Methods
+    VCMLightVertexGrid(pstd::span<const VCMLightVertex> vertices, Float radius);
+
+    template <typename F>
+    void ForEachCandidate(const Point3f &p, F func) const {
+        if (vertices.empty())
+            return;
+        // Find the $2 \times 2 \times 2$ cells that may hold vertices within the radius
+        Vector3f pg = (p - origin) * invCellSize;
+        Point3i pMin;
+        for (int i = 0; i < 3; ++i) {
+            Float c = std::floor(pg[i]);
+            pMin[i] = (int)c - ((pg[i] - c < 0.5f) ? 1 : 0);
+        }
+
+        int visited[8], nVisited = 0;
+        for (int z = 0; z < 2; ++z)
+            for (int y = 0; y < 2; ++y)
+                for (int x = 0; x < 2; ++x) {
+                    int h = hash(Point3i(pMin.x + x, pMin.y + y, pMin.z + z), hashSize);
+                    // Skip cells that share an already-visited hash bucket
+                    if (std::find(visited, visited + nVisited, h) != visited + nVisited)
+                        continue;
+                    visited[nVisited++] = h;
+                    for (uint32_t i = cellOffsets[h]; i < cellOffsets[h + 1]; ++i)
+                        func(vertices[entries[i]]);
+                }
+    }
+
+    size_t BytesAllocated() const {
+        return cellOffsets.size() * sizeof(uint32_t) + entries.size() * sizeof(uint32_t);
+    }
+
+  private:
+    // VCMLightVertexGrid Private Methods
+    int CellHash(const Point3f &p) const {
+        Vector3f pg = (p - origin) * invCellSize;
+        return hash(Point3i((int)std::floor(pg.x), (int)std::floor(pg.y),
+                            (int)std::floor(pg.z)),
+                    hashSize);
+    }
+
+    // VCMLightVertexGrid Private Members
+    pstd::span<const VCMLightVertex> vertices;
+    Point3f origin;
+    Float invCellSize;
+    int hashSize;
+    std::vector<uint32_t> cellOffsets;
+    std::vector<uint32_t> entries;
+};
+
+// VCMLightVertexGrid Method Definitions
+VCMLightVertexGrid::VCMLightVertexGrid(pstd::span<const VCMLightVertex> vertices,
+                                       Float radius)
+    : vertices(vertices),
+      invCellSize(1 / (2 * radius)),
+      hashSize(NextPrime(std::max<int>(vertices.size(), 1))),
+      cellOffsets(hashSize + 1, 0),
+      entries(vertices.size()) {
+    if (vertices.empty())
+        return;
+    Bounds3f bounds;
+    for (const VCMLightVertex &v : vertices)
+        bounds = Union(bounds, v.intr.p());
+    origin = bounds.pMin;
+
+    // Count light vertices in each grid cell; cells are twice the radius wide
+    std::vector<std::atomic<uint32_t>> cellCounts(hashSize);
+    ParallelFor(0, vertices.size(), [&](int64_t i) {
+        cellCounts[CellHash(vertices[i].intr.p())].fetch_add(1,
+                                                             std::memory_order_relaxed);
+    });
+
+    // Compute cell offsets and reset counts for use as insertion cursors
+    for (int h = 0; h < hashSize; ++h) {
+        cellOffsets[h + 1] = cellOffsets[h] + cellCounts[h].load();
+        cellCounts[h] = 0;
+    }
+
+    // Scatter light vertex indices into cells' contiguous ranges
+    ParallelFor(0, vertices.size(), [&](int64_t i) {
+        int h = CellHash(vertices[i].intr.p());
+        uint32_t offset = cellCounts[h].fetch_add(1, std::memory_order_relaxed);
+        entries[cellOffsets[h] + offset] = i;
+    });
+}
+
+// VCM Method Definitions
+void VCMIntegrator::Render() {
+    // Initialize local variables for _VCMIntegrator::Render()_
+    Bounds2i pixelBounds = camera.GetFilm().PixelBounds();
+    CHECK(!pixelBounds.IsEmpty());
+    int nIterations = samplerPrototype.SamplesPerPixel();
+    // Trace one light subpath per pixel in each iteration. The camera's
+    // directional density is normalized over the whole film, which then
+    // accounts for the number of light subpaths in the MIS weights below.
+    int64_t nLightPaths = pixelBounds.Area();
+    int xResolution = pixelBounds.Diagonal().x;
+    FilterHandle filter = camera.GetFilm().GetFilter();
+    const Float invSqrtSPP = 1.f / std::sqrt(nIterations);
+
+    // Compute initial merging radius
+    Float radius0 = initialRadius;
+    if (radius0 <= 0) {
+        Point3f sceneCenter;
+        Float sceneRadius;
+        SceneBounds().BoundingSphere(&sceneCenter, &sceneRadius);
+        radius0 = 0.003f * sceneRadius;
+    }
+
+    // Allocate per-thread state for VCM rendering
+    std::vector<ScratchBuffer> scratchBuffers;
+    std::vector<std::unique_ptr<pstd::pmr::monotonic_buffer_resource>> bsdfResources;
+    for (int i = 0; i < MaxThreadIndex(); ++i) {
+        scratchBuffers.push_back(ScratchBuffer(65536));
+        bsdfResources.push_back(std::make_unique<pstd::pmr::monotonic_buffer_resource>());
+    }
+    std::vector<SamplerHandle> samplers =
+        samplerPrototype.Clone(MaxThreadIndex(), Allocator());
+    // Light subpaths use sample dimensions past those of camera subpaths so
+    // that the two are not correlated for the same pixel and sample index
+    constexpr int lightPathDimension = 256;
+
+    // Light subpaths are traced in fixed-size chunks so that the order of
+    // the light vertex cache doesn't depend on thread scheduling.
+    constexpr int lightPathChunkSize = 256;
+    int64_t nLightPathChunks =
+        (nLightPaths + lightPathChunkSize - 1) / lightPathChunkSize;
+    std::vector<std::vector<VCMLightVertex>> chunkVertices(nLightPathChunks);
+    std::vector<VCMLightVertex> lightVertices;
+
+    ProgressReporter progress(2 * nIterations, "Rendering", Options->quiet);
+    for (int iter = 0; iter < nIterations; ++iter) {
+        // Sample wavelengths for VCM iteration; light vertices are shared by all
+        // camera subpaths, so all paths in an iteration use the same wavelengths.
+        SampledWavelengths lambda =
+            Options->disableWavelengthJitter
+                ? camera.GetFilm().SampleWavelengths(0.5)
+                : camera.GetFilm().SampleWavelengths(RadicalInverse(1, iter));
+
+        // Compute merging radius and MIS factors for VCM iteration
+        Float radius = std::max<Float>(
+            radius0 / std::pow(Float(iter + 1), (1 - radiusAlpha) / 2), 1e-7f);
+        Float etaVCM = Pi * Sqr(radius) * nLightPaths;
+        Float vmWeightFactor = etaVCM, vcWeightFactor = 1 / etaVCM;
+        Float vmNormalization = 1 / etaVCM;
+
+        // Trace light subpaths, splat connections to the camera and cache vertices
+        ParallelFor(0, nLightPathChunks, [&](int64_t chunk) {
+            ScratchBuffer &scratchBuffer = scratchBuffers[ThreadIndex];
+            SamplerHandle &sampler = samplers[ThreadIndex];
+            Allocator alloc(bsdfResources[ThreadIndex].get());
+            std::vector<VCMLightVertex> &vertices = chunkVertices[chunk];
+            vertices.clear();
+
+            int64_t pathsEnd =
+                std::min<int64_t>(nLightPaths, (chunk + 1) * lightPathChunkSize);
+            for (int64_t pathIndex = chunk * lightPathChunkSize; pathIndex < pathsEnd;
+                 ++pathIndex) {
+                Point2i pPixel(pixelBounds.pMin.x + pathIndex % xResolution,
+                               pixelBounds.pMin.y + pathIndex / xResolution);
+                sampler.StartPixelSample(pPixel, iter, lightPathDimension);
+                SampledWavelengths pathLambda = lambda;
+
+                // Sample light and ray leaving it for light subpath
+                pstd::optional<SampledLight> sampledLight =
+                    lightSampler.Sample(sampler.Get1D());
+                Point2f uLight0 = sampler.Get2D(), uLight1 = sampler.Get2D();
+                Float time = camera.SampleTime(sampler.Get1D());
+                if (!sampledLight)
+                    continue;
+                LightHandle light = sampledLight->light;
+                LightLeSample les = light.SampleLe(uLight0, uLight1, pathLambda, time);
+                if (!les || les.pdfPos == 0 || les.pdfDir == 0 || !les.L)
+                    continue;
+                RayDifferential ray(les.ray);
+                Float emissionPDF = sampledLight->pdf * les.pdfPos * les.pdfDir;
+                Float cosLight = les.AbsCosTheta(ray.d);
+
+                // Initialize light subpath throughput and MIS quantities
+                VCMSubpath path;
+                path.beta = les.L * cosLight / emissionPDF;
+                path.dVC = IsDeltaLight(light.Type()) ? 0 : cosLight / emissionPDF;
+                path.dVM = path.dVC * vcWeightFactor;
+                Point3f pPrev = ray.o;
+
+                while (true) {
+                    pstd::optional<ShapeIntersection> si = Intersect(ray);
+                    if (!si)
+                        break;
+                    SurfaceInteraction &isect = si->intr;
+                    BSDF bsdf =
+                        isect.GetBSDF(ray, pathLambda, camera, scratchBuffer, sampler);
+                    if (!bsdf) {
+                        isect.SkipIntersection(&ray, si->tHit);
+                        continue;
+                    }
+
+                    // Update light subpath MIS quantities for new vertex
+                    Vector3f wo = isect.wo;
+                    Float cosIn = AbsDot(isect.n, wo);
+                    if (cosIn == 0)
+                        break;
+                    Float dist2 = DistanceSquared(pPrev, isect.p());
+                    if (path.depth == 1) {
+                        // Compute density of sampling the light's vertex with direct
+                        // lighting, with respect to area for finite lights
+                        Float directPDF;
+                        LightSampleContext ctx(isect);
+                        if (light.Type() == LightType::DeltaPosition)
+                            directPDF = dist2;
+                        else if (light.Type() == LightType::DeltaDirection)
+                            directPDF = 1;
+                        else if (light.Type() == LightType::Area)
+                            directPDF = light.PDF_Li(ctx, wo) * cosLight;
+                        else
+                            directPDF = light.PDF_Li(ctx, wo);
+                        path.dVCM = sampledLight->pdf * directPDF / emissionPDF;
+                    } else
+                        path.dVCM *= dist2;
+                    path.dVCM /= cosIn;
+                    path.dVC /= cosIn;
+                    path.dVM /= cosIn;
+
+                    if (bsdf.IsNonSpecular()) {
+                        // Add light vertex to the cache
+                        vertices.push_back(VCMLightVertex{isect, isect.shading.n,
+                                                          CopyBSDF(bsdf, alloc),
+                                                          path.beta, path.depth,
+                                                          path.dVCM, path.dVC, path.dVM});
+
+                        // Connect light vertex to the camera and splat its contribution
+                        pstd::optional<CameraWiSample> cs =
+                            camera.SampleWi(isect, sampler.Get2D(), pathLambda);
+                        if (cs && cs->pdf > 0) {
+                            SampledSpectrum f =
+                                bsdf.f(wo, cs->wi, TransportMode::Importance) *
+                                AbsDot(cs->wi, isect.shading.n);
+                            // Compute MIS weight for light subpath's camera connection
+                            Float pdfPos, pdfDir;
+                            camera.PDF_We(Ray(cs->pLens.p(), -cs->wi, isect.time),
+                                          &pdfPos, &pdfDir);
+                            Float cameraPDF = pdfDir * AbsDot(isect.n, cs->wi) /
+                                              DistanceSquared(cs->pLens.p(), isect.p());
+                            Float wLight =
+                                cameraPDF * (vmWeightFactor + path.dVCM +
+                                             path.dVC * bsdf.PDF(cs->wi, wo));
+
+                            SampledSpectrum L =
+                                path.beta * f * cs->Wi / (cs->pdf * (1 + wLight));
+                            if (L && Unoccluded(cs->pRef, cs->pLens))
+                                camera.GetFilm().AddSplat(cs->pRaster, L, pathLambda);
+                        }
+                    }
+
+                    // Sample BSDF to continue light subpath
+                    if (path.depth >= maxDepth)
+                        break;
+                    Float u = sampler.Get1D();
+                    BSDFSample bs =
+                        bsdf.Sample_f(wo, u, sampler.Get2D(), TransportMode::Importance);
+                    if (!bs)
+                        break;
+                    Float pdfFwd = bsdf.SampledPDFIsProportional()
+                                       ? bsdf.PDF(wo, bs.wi, TransportMode::Importance)
+                                       : bs.pdf;
+                    if (pdfFwd == 0)
+                        break;
+                    Float pdfRev = bs.IsSpecular() ? pdfFwd : bsdf.PDF(bs.wi, wo);
+                    path.beta *= bs.f * AbsDot(bs.wi, isect.shading.n) / bs.pdf;
+                    path.UpdateForScattering(bs, pdfFwd, pdfRev, AbsDot(bs.wi, isect.n),
+                                             vmWeightFactor, vcWeightFactor);
+                    pPrev = isect.p();
+                    ray = RayDifferential(isect.SpawnRay(bs.wi));
+                    ++path.depth;
+                }
+                scratchBuffer.Reset();
+            }
+        });
+
+        // Gather light vertex cache and build grid for merging
+        lightVertices.clear();
+        for (const std::vector<VCMLightVertex> &vertices : chunkVertices)
+            lightVertices.insert(lightVertices.end(), vertices.begin(), vertices.end());
+        vcmLightVertices += lightVertices.size();
+        VCMLightVertexGrid grid(lightVertices, radius);
+        vcmCacheBytes = std::max<int64_t>(
+            vcmCacheBytes,
+            lightVertices.capacity() * sizeof(VCMLightVertex) + grid.BytesAllocated());
+        progress.Update();
+
+        // Each camera vertex connects to randomly chosen cached light vertices; by
+        // default, as many as an average light subpath has.
+        int connectionsPerVertex =
+            nConnections > 0 ? nConnections
+                             : std::max<int>(1, std::ceil(Float(lightVertices.size()) /
+                                                          Float(nLightPaths)));
+        Float connectionScale =
+            Float(lightVertices.size()) / (Float(nLightPaths) * connectionsPerVertex);
+
+        // Trace camera subpaths and connect and merge them with cached light vertices
+        ParallelFor2D(pixelBounds, [&](Bounds2i tileBounds) {
+            ScratchBuffer &scratchBuffer = scratchBuffers[ThreadIndex];
+            SamplerHandle &sampler = samplers[ThreadIndex];
+            for (Point2i pPixel : tileBounds) {
+                sampler.StartPixelSample(pPixel, iter);
+                SampledWavelengths pathLambda = lambda;
+                CameraSample cameraSample = GetCameraSample(sampler, pPixel, filter);
+                pstd::optional<CameraRayDifferential> crd =
+                    camera.GenerateRayDifferential(cameraSample, pathLambda);
+
+                SampledSpectrum L(0.f);
+                Float pdfPos = 0, pdfDir = 0;
+                if (crd && crd->weight)
+                    camera.PDF_We(crd->ray, &pdfPos, &pdfDir);
+                if (pdfDir > 0) {
+                    RayDifferential ray = crd->ray;
+                    if (!Options->disablePixelJitter)
+                        ray.ScaleDifferentials(invSqrtSPP);
+                    // Initialize camera subpath throughput and MIS quantities
+                    VCMSubpath path;
+                    path.beta = crd->weight;
+                    path.dVCM = 1 / pdfDir;
+                    Point3f pPrev = ray.o;
+                    LightSampleContext prevCtx;
+
+                    while (true) {
+                        pstd::optional<ShapeIntersection> si = Intersect(ray);
+                        if (!si) {
+                            // Add infinite lights' emission for escaped camera subpath
+                            for (const auto &light : infiniteLights) {
+                                SampledSpectrum Le = light.Le(ray, pathLambda);
+                                if (!Le)
+                                    continue;
+                                if (path.depth == 1) {
+                                    L += path.beta * Le;
+                                    continue;
+                                }
+                                Float lightPDF = lightSampler.PDF(light);
+                                Float directPDF = lightPDF * light.PDF_Li(prevCtx, ray.d);
+                                Interaction intr(ray.o, ray.time, ray.medium);
+                                Float emissionPDF =
+                                    lightPDF * VCMEmissionPDF(light, intr, -ray.d);
+                                Float wCamera =
+                                    directPDF * path.dVCM + emissionPDF * path.dVC;
+                                L += path.beta * Le / (1 + wCamera);
+                            }
+                            break;
+                        }
+
+                        SurfaceInteraction &isect = si->intr;
+                        BSDF bsdf = isect.GetBSDF(ray, pathLambda, camera, scratchBuffer,
+                                                  sampler);
+                        if (!bsdf) {
+                            isect.SkipIntersection(&ray, si->tHit);
+                            continue;
+                        }
+
+                        // Update camera subpath MIS quantities for new vertex
+                        Vector3f wo = isect.wo;
+                        Float cosIn = AbsDot(isect.n, wo);
+                        if (cosIn == 0)
+                            break;
+                        Float dist2 = DistanceSquared(pPrev, isect.p());
+                        path.dVCM *= dist2 / cosIn;
+                        path.dVC /= cosIn;
+                        path.dVM /= cosIn;
+
+                        // Add emitted light at camera subpath vertex
+                        SampledSpectrum Le = isect.Le(wo, pathLambda);
+                        if (Le) {
+                            if (path.depth == 1)
+                                L += path.beta * Le;
+                            else {
+                                LightHandle areaLight(isect.areaLight);
+                                Float lightPDF = lightSampler.PDF(areaLight);
+                                Float directPDF = lightPDF *
+                                                  areaLight.PDF_Li(prevCtx, ray.d) *
+                                                  cosIn / dist2;
+                                Float emissionPDF =
+                                    lightPDF * VCMEmissionPDF(areaLight, isect, wo);
+                                Float wCamera =
+                                    directPDF * path.dVCM + emissionPDF * path.dVC;
+                                L += path.beta * Le / (1 + wCamera);
+                            }
+                        }
+                        if (path.depth > maxDepth)
+                            break;
+
+                        if (bsdf.IsNonSpecular()) {
+                            // Connect camera vertex to a sampled point on a light
+                            pstd::optional<SampledLight> sampledLight =
+                                lightSampler.Sample(sampler.Get1D());
+                            Point2f uLight = sampler.Get2D();
+                            if (sampledLight) {
+                                LightHandle light = sampledLight->light;
+                                LightLiSample ls = light.SampleLi(
+                                    LightSampleContext(isect), uLight, pathLambda);
+                                SampledSpectrum f;
+                                if (ls && ls.L)
+                                    f = bsdf.f(wo, ls.wi) *
+                                        AbsDot(ls.wi, isect.shading.n);
+                                if (f) {
+                                    // Compute MIS weight for direct lighting connection
+                                    LightType type = light.Type();
+                                    Float directPDF =
+                                        ls.pdf * (type == LightType::DeltaPosition
+                                                      ? DistanceSquared(isect.p(),
+                                                                        ls.pLight.p())
+                                                      : 1);
+                                    Float cosAtLight = (type == LightType::Area)
+                                                           ? AbsDot(ls.pLight.n, ls.wi)
+                                                           : 1;
+                                    Float emissionPDF =
+                                        VCMEmissionPDF(light, ls.pLight, -ls.wi);
+                                    Float bsdfPDF =
+                                        IsDeltaLight(type) ? 0 : bsdf.PDF(wo, ls.wi);
+                                    Float wLight =
+                                        bsdfPDF / (sampledLight->pdf * directPDF);
+                                    Float wCamera =
+                                        emissionPDF * AbsDot(isect.n, ls.wi) /
+                                        (directPDF * cosAtLight) *
+                                        (vmWeightFactor + path.dVCM +
+                                         path.dVC * bsdf.PDF(ls.wi, wo));
+
+                                    SampledSpectrum Ld = path.beta * f * ls.L /
+                                                         (sampledLight->pdf * ls.pdf *
+                                                          (wLight + 1 + wCamera));
+                                    if (Ld && Unoccluded(isect, ls.pLight))
+                                        L += Ld;
+                                }
+                            }
+
+                            // Connect camera vertex to light vertices from the cache
+                            int nCached = lightVertices.empty() ? 0 : connectionsPerVertex;
+                            for (int c = 0; c < nCached; ++c) {
+                                size_t index = std::min<size_t>(
+                                    sampler.Get1D() * lightVertices.size(),
+                                    lightVertices.size() - 1);
+                                const VCMLightVertex &lv = lightVertices[index];
+                                if (lv.depth + path.depth > maxDepth)
+                                    continue;
+                                Vector3f w = lv.intr.p() - isect.p();
+                                Float d2 = LengthSquared(w);
+                                if (d2 == 0)
+                                    continue;
+                                w /= std::sqrt(d2);
+                                SampledSpectrum fCamera =
+                                    bsdf.f(wo, w) * AbsDot(w, isect.shading.n);
+                                SampledSpectrum fLight =
+                                    lv.bsdf.f(lv.intr.wo, -w, TransportMode::Importance) *
+                                    AbsDot(w, lv.ns);
+                                if (!fCamera || !fLight)
+                                    continue;
+
+                                // Compute MIS weight for cached light vertex connection
+                                Float cameraPDF =
+                                    bsdf.PDF(wo, w) * AbsDot(lv.intr.n, w) / d2;
+                                Float lightPDF = lv.bsdf.PDF(lv.intr.wo, -w,
+                                                             TransportMode::Importance) *
+                                                 AbsDot(isect.n, w) / d2;
+                                Float wLight =
+                                    cameraPDF * (vmWeightFactor + lv.dVCM +
+                                                 lv.dVC * lv.bsdf.PDF(-w, lv.intr.wo));
+                                Float wCamera =
+                                    lightPDF * (vmWeightFactor + path.dVCM +
+                                                path.dVC * bsdf.PDF(w, wo));
+
+                                SampledSpectrum Lc =
+                                    path.beta * fCamera * fLight * lv.beta *
+                                    connectionScale / (d2 * (wLight + 1 + wCamera));
+                                if (Lc && Unoccluded(isect, lv.intr))
+                                    L += Lc;
+                            }
+
+                            // Merge camera vertex with nearby cached light vertices
+                            SampledSpectrum Lm(0.f);
+                            auto merge = [&](const VCMLightVertex &lv) {
+                                ++vcmMergeCandidates;
+                                if (DistanceSquared(lv.intr.p(), isect.p()) >
+                                        Sqr(radius) ||
+                                    lv.depth + path.depth > maxDepth + 1)
+                                    return;
+                                ++vcmMergesAccepted;
+                                SampledSpectrum f = bsdf.f(wo, lv.intr.wo);
+                                if (!f)
+                                    return;
+                                Float wLight = lv.dVCM * vcWeightFactor +
+                                               lv.dVM * bsdf.PDF(wo, lv.intr.wo);
+                                Float wCamera = path.dVCM * vcWeightFactor +
+                                                path.dVM * bsdf.PDF(lv.intr.wo, wo);
+                                Lm += f * lv.beta / (wLight + 1 + wCamera);
+                            };
+                            grid.ForEachCandidate(isect.p(), merge);
+                            L += path.beta * Lm * vmNormalization;
+                        }
+
+                        // Sample BSDF to continue camera subpath
+                        Float u = sampler.Get1D();
+                        BSDFSample bs = bsdf.Sample_f(wo, u, sampler.Get2D());
+                        if (!bs)
+                            break;
+                        Float pdfFwd = bsdf.SampledPDFIsProportional()
+                                           ? bsdf.PDF(wo, bs.wi)
+                                           : bs.pdf;
+                        if (pdfFwd == 0)
+                            break;
+                        Float pdfRev = bs.IsSpecular() ? pdfFwd : bsdf.PDF(bs.wi, wo);
+                        path.beta *= bs.f * AbsDot(bs.wi, isect.shading.n) / bs.pdf;
+                        path.UpdateForScattering(bs, pdfFwd, pdfRev,
+                                                 AbsDot(bs.wi, isect.n), vmWeightFactor,
+                                                 vcWeightFactor);
+                        prevCtx = LightSampleContext(isect);
+                        pPrev = isect.p();
+                        ray = isect.SpawnRay(ray, bsdf, bs.wi, bs.flags);
+                        ++path.depth;
+                    }
+                }
+
+                // Add camera subpath's contribution to image
+                if (L.HasNaNs() || std::isinf(L.y(pathLambda))) {
+                    LOG_ERROR("Invalid radiance value %s for pixel (%d, %d), "
+                              "iteration %d. Setting to black.",
+                              L, pPixel.x, pPixel.y, iter);
+                    L = SampledSpectrum(0.f);
+                }
+                VisibleSurface visibleSurface;
+                camera.GetFilm().AddSample(pPixel, L, pathLambda, &visibleSurface,
+                                           cameraSample.weight);
+                scratchBuffer.Reset();
+            }
+        });
+        // Release memory used by light vertex BSDFs
+        for (auto &resource : bsdfResources)
+            resource->release();
+        progress.Update();
+
+        // Periodically write VCM image
+        if (iter + 1 == nIterations || (iter + 1 <= 64 && IsPowerOf2(iter + 1)) ||
+            ((iter + 1) % 64 == 0)) {
+            ImageMetadata metadata;
+            metadata.renderTimeSeconds = progress.ElapsedSeconds();
+            metadata.samplesPerPixel = iter + 1;
+            camera.InitMetadata(&metadata);
+            camera.GetFilm().WriteImage(metadata, 1.f / (iter + 1));
+        }
+    }
+    progress.Done();
+}
+
+std::string VCMIntegrator::ToString() const {
+    return StringPrintf("[ VCMIntegrator maxDepth: %d initialRadius: %f radiusAlpha: %f "
+                        "nConnections: %d lightSampler: %s ]",
+                        maxDepth, initialRadius, radiusAlpha, nConnections, lightSampler);
+}
+
+std::unique_ptr<VCMIntegrator> VCMIntegrator::Create(
+    const ParameterDictionary &parameters, CameraHandle camera, SamplerHandle sampler,
+    PrimitiveHandle aggregate, std::vector<LightHandle> lights, const FileLoc *loc) {
+    int maxDepth = parameters.GetOneInt("maxdepth", 5);
+    Float radius = parameters.GetOneFloat("radius", -1.f);
+    Float radiusAlpha = parameters.GetOneFloat("radiusalpha", 0.75f);
+    if (radiusAlpha <= 0 || radiusAlpha > 1)
+        ErrorExit(loc, "\"radiusalpha\" must be in the range (0, 1].");
+    int nConnections = parameters.GetOneInt("connections", -1);
+    return std::make_unique<VCMIntegrator>(camera, sampler, aggregate, lights, maxDepth,
+                                           radius, radiusAlpha, nConnections);
 }
 
 std::unique_ptr<Integrator> Integrator::Create(
@@ -3274,6 +4359,9 @@ std::unique_ptr<Integrator> Integrator::Create(
     else if (name == "sppm")
         integrator = SPPMIntegrator::Create(parameters, colorSpace, camera, aggregate,
                                             lights, loc);
+    else if (name == "vcm")
+        integrator =
+            VCMIntegrator::Create(parameters, camera, sampler, aggregate, lights, loc);
     else
         ErrorExit(loc, "%s: integrator type unknown.", name);
 
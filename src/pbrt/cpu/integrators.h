@@ -17,11 +17,13 @@
 #include <pbrt/lights.h>
 #include <pbrt/lightsamplers.h>
 #include <pbrt/util/lowdiscrepancy.h>
+#include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/pstd.h>
 #include <pbrt/util/rng.h>
 #include <pbrt/util/sampling.h>
 
+#include <atomic>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -99,6 +101,9 @@ class ImageTileIntegrator : public Integrator {
                                      ScratchBuffer &scratchBuffer) = 0;
 
   protected:
+    // ImageTileIntegrator Protected Methods
+    virtual void EndWave(int samplesTaken) {}
+
     // ImageTileIntegrator Protected Members
     CameraHandle camera;
     SamplerHandle samplerPrototype;
@@ -172,6 +177,44 @@ class SimplePathIntegrator : public RayIntegrator {
     UniformLightSampler lightSampler;
 };
 
+// RadianceCache Definition
+class RadianceCache {
+  public:
+    // RadianceCache Public Methods
+    RadianceCache(const Bounds3f &bounds, int gridResolution, int logTableSize = 20);
+
+    pstd::optional<Float> Lookup(const Point3f &p, const Normal3f &n) const {
+        size_t index = CellIndex(p, n);
+        if (estimateCounts[index] < minSamples)
+            return {};
+        return estimates[index];
+    }
+
+    void Add(const Point3f &p, const Normal3f &n, Float L) {
+        size_t index = CellIndex(p, n);
+        sums[index].Add(L);
+        counts[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void UpdateEstimates();
+
+    std::string ToString() const;
+
+  private:
+    // RadianceCache Private Methods
+    size_t CellIndex(const Point3f &p, const Normal3f &n) const;
+
+    // RadianceCache Private Members
+    static constexpr int minSamples = 8;
+    Bounds3f bounds;
+    Float invCellSize;
+    size_t tableMask;
+    std::vector<AtomicFloat> sums;
+    std::vector<std::atomic<int>> counts;
+    std::vector<Float> estimates;
+    std::vector<int> estimateCounts;
+};
+
 // PathIntegrator Definition
 class PathIntegrator : public RayIntegrator {
   public:
@@ -179,7 +222,7 @@ class PathIntegrator : public RayIntegrator {
     PathIntegrator(int maxDepth, CameraHandle camera, SamplerHandle sampler,
                    PrimitiveHandle aggregate, std::vector<LightHandle> lights,
                    Float rrThreshold = 1, const std::string &lightSampleStrategy = "bvh",
-                   bool regularize = false);
+                   bool regularize = false, bool adjointRR = false, int maxSplit = 4);
 
     SampledSpectrum Li(RayDifferential ray, SampledWavelengths &lambda,
                        SamplerHandle sampler, ScratchBuffer &scratchBuffer,
@@ -191,6 +234,13 @@ class PathIntegrator : public RayIntegrator {
 
     std::string ToString() const;
 
+  protected:
+    // PathIntegrator Protected Methods
+    void EndWave(int samplesTaken) {
+        if (radianceCache)
+            radianceCache->UpdateEstimates();
+    }
+
   private:
     // PathIntegrator Private Methods
     SampledSpectrum SampleLd(const SurfaceInteraction &intr, const BSDF &bsdf,
@@ -201,6 +251,8 @@ class PathIntegrator : public RayIntegrator {
     Float rrThreshold;
     LightSamplerHandle lightSampler;
     bool regularize;
+    std::unique_ptr<RadianceCache> radianceCache;
+    int maxSplit;
 };
 
 // SimpleVolPathIntegrator Definition
@@ -233,13 +285,16 @@ class VolPathIntegrator : public RayIntegrator {
                       PrimitiveHandle aggregate, std::vector<LightHandle> lights,
                       Float rrThreshold = 1,
                       const std::string &lightSampleStrategy = "bvh",
-                      bool regularize = false)
+                      bool regularize = false, bool adjointRR = false)
         : RayIntegrator(camera, sampler, aggregate, lights),
           maxDepth(maxDepth),
           rrThreshold(rrThreshold),
           lightSampler(
               LightSamplerHandle::Create(lightSampleStrategy, lights, Allocator())),
-          regularize(regularize) {}
+          regularize(regularize) {
+        if (adjointRR)
+            radianceCache = std::make_unique<RadianceCache>(SceneBounds(), 256);
+    }
 
     SampledSpectrum Li(RayDifferential ray, SampledWavelengths &lambda,
                        SamplerHandle sampler, ScratchBuffer &scratchBuffer,
@@ -251,6 +306,13 @@ class VolPathIntegrator : public RayIntegrator {
 
     std::string ToString() const;
 
+  protected:
+    // VolPathIntegrator Protected Methods
+    void EndWave(int samplesTaken) {
+        if (radianceCache)
+            radianceCache->UpdateEstimates();
+    }
+
   private:
     // VolPathIntegrator Private Methods
     SampledSpectrum SampleLd(const Interaction &intr, const BSDF *bsdf,
@@ -274,6 +336,7 @@ class VolPathIntegrator : public RayIntegrator {
     const Float rrThreshold;
     LightSamplerHandle lightSampler;
     bool regularize;
+    std::unique_ptr<RadianceCache> radianceCache;
 };
 
 // AOIntegrator Definition
@@ -332,14 +395,15 @@ class BDPTIntegrator : public RayIntegrator {
                    std::vector<LightHandle> lights, int maxDepth,
                    bool visualizeStrategies, bool visualizeWeights,
                    const std::string &lightSampleStrategy = "power",
-                   bool regularize = false)
+                   bool regularize = false, bool incrementalMIS = true)
         : RayIntegrator(camera, sampler, aggregate, lights),
           maxDepth(maxDepth),
           visualizeStrategies(visualizeStrategies),
           visualizeWeights(visualizeWeights),
           lightSampleStrategy(lightSampleStrategy),
           lightSampler(new PowerLightSampler(lights, Allocator())),
-          regularize(regularize) {}
+          regularize(regularize),
+          incrementalMIS(incrementalMIS) {}
 
     SampledSpectrum Li(RayDifferential ray, SampledWavelengths &lambda,
                        SamplerHandle sampler, ScratchBuffer &scratchBuffer,
@@ -360,6 +424,7 @@ class BDPTIntegrator : public RayIntegrator {
     bool visualizeWeights;
     std::string lightSampleStrategy;
     bool regularize;
+    bool incrementalMIS;
     LightSamplerHandle lightSampler;
     mutable std::vector<FilmHandle> weightFilms;
 };
@@ -424,7 +489,8 @@ class SPPMIntegrator : public Integrator {
     SPPMIntegrator(CameraHandle camera, PrimitiveHandle aggregate,
                    std::vector<LightHandle> lights, int nIterations,
                    int photonsPerIteration, int maxDepth, Float initialSearchRadius,
-                   bool regularize, int seed, const RGBColorSpace *colorSpace)
+                   bool regularize, int seed, const RGBColorSpace *colorSpace,
+                   size_t maxGridBytes = size_t(1) << 30)
         : Integrator(aggregate, lights),
           camera(camera),
           initialSearchRadius(initialSearchRadius),
@@ -435,7 +501,8 @@ class SPPMIntegrator : public Integrator {
                                   : camera.GetFilm().PixelBounds().Area()),
           regularize(regularize),
           colorSpace(colorSpace),
-          digitPermutationsSeed(seed) {}
+          digitPermutationsSeed(seed),
+          maxGridBytes(maxGridBytes) {}
 
     static std::unique_ptr<SPPMIntegrator> Create(const ParameterDictionary &parameters,
                                                   const RGBColorSpace *colorSpace,
@@ -463,6 +530,44 @@ class SPPMIntegrator : public Integrator {
     int maxDepth;
     int photonsPerIteration;
     const RGBColorSpace *colorSpace;
+    size_t maxGridBytes;
+};
+
+// VCMIntegrator Definition
+class VCMIntegrator : public Integrator {
+  public:
+    // VCMIntegrator Public Methods
+    VCMIntegrator(CameraHandle camera, SamplerHandle sampler, PrimitiveHandle aggregate,
+                  std::vector<LightHandle> lights, int maxDepth, Float initialRadius,
+                  Float radiusAlpha, int nConnections)
+        : Integrator(aggregate, lights),
+          camera(camera),
+          samplerPrototype(sampler),
+          lightSampler(new PowerLightSampler(lights, Allocator())),
+          maxDepth(maxDepth),
+          initialRadius(initialRadius),
+          radiusAlpha(radiusAlpha),
+          nConnections(nConnections) {}
+
+    static std::unique_ptr<VCMIntegrator> Create(const ParameterDictionary &parameters,
+                                                 CameraHandle camera,
+                                                 SamplerHandle sampler,
+                                                 PrimitiveHandle aggregate,
+                                                 std::vector<LightHandle> lights,
+                                                 const FileLoc *loc);
+
+    std::string ToString() const;
+
+    void Render();
+
+  private:
+    // VCMIntegrator Private Members
+    CameraHandle camera;
+    SamplerHandle samplerPrototype;
+    LightSamplerHandle lightSampler;
+    int maxDepth;
+    Float initialRadius, radiusAlpha;
+    int nConnections;
 };
 
 }  // namespace pbrt
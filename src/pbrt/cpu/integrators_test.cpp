@@ -18,6 +18,7 @@
 #include <pbrt/util/color.h>
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/image.h>
+#include <pbrt/util/progressreporter.h>
 #include <pbrt/util/spectrum.h>
 #include <pbrt/util/vecmath.h>
 
@@ -311,6 +312,26 @@ std::vector<TestIntegrator> GetIntegrators() {
                  scene});
         }
 
+        // Path tracing with adjoint-driven Russian roulette and splitting
+        for (auto &sampler : GetSamplers(resolution)) {
+            FilterHandle filter = new BoxFilter(Vector2f(0.5, 0.5));
+            RGBFilm *film = new RGBFilm(Sensor::CreateDefault(), resolution,
+                                        Bounds2i(Point2i(0, 0), resolution), filter, 1.,
+                                        inTestDir("test.exr"), 1., RGBColorSpace::sRGB);
+            PerspectiveCamera *camera = new PerspectiveCamera(
+                CameraTransform(identity), Bounds2f(Point2f(-1, -1), Point2f(1, 1)), 0.,
+                1., 0., 10., 45, film, nullptr);
+
+            const FilmHandle filmp = camera->GetFilm();
+            Integrator *integrator =
+                new PathIntegrator(8, camera, sampler.first, scene.aggregate,
+                                   scene.lights, 1., "bvh", false, true /* adjointRR */);
+            integrators.push_back({integrator, filmp,
+                                   "Path, depth 8, ADRRS, Perspective, " +
+                                       sampler.second + ", " + scene.description,
+                                   scene});
+        }
+
         // Volume path tracing integrators
         for (auto &sampler : GetSamplers(resolution)) {
             FilterHandle filter = new BoxFilter(Vector2f(0.5, 0.5));
@@ -386,6 +407,26 @@ std::vector<TestIntegrator> GetIntegrators() {
                                    scene});
         }
 
+        // VCM
+        for (auto &sampler : GetSamplers(resolution)) {
+            FilterHandle filter = new BoxFilter(Vector2f(0.5, 0.5));
+            RGBFilm *film = new RGBFilm(Sensor::CreateDefault(), resolution,
+                                        Bounds2i(Point2i(0, 0), resolution), filter, 1.,
+                                        inTestDir("test.exr"), 1., RGBColorSpace::sRGB);
+            PerspectiveCamera *camera = new PerspectiveCamera(
+                CameraTransform(identity), Bounds2f(Point2f(-1, -1), Point2f(1, 1)), 0.,
+                1., 0., 10., 45, film, nullptr);
+            const FilmHandle filmp = camera->GetFilm();
+
+            Integrator *integrator = new VCMIntegrator(
+                camera, sampler.first, scene.aggregate, scene.lights, 8,
+                -1.f /* radius */, 0.75f /* radius alpha */, -1 /* connections */);
+            integrators.push_back({integrator, filmp,
+                                   "VCM, depth 8, Perspective, " + sampler.second +
+                                       ", " + scene.description,
+                                   scene});
+        }
+
         // MLT
         {
             FilterHandle filter = new BoxFilter(Vector2f(0.5, 0.5));
@@ -428,3 +469,59 @@ TEST_P(RenderTest, RadianceMatches) {
 
 INSTANTIATE_TEST_CASE_P(AnalyticTestScenes, RenderTest,
                         testing::ValuesIn(GetIntegrators()));
+
+static Image RenderBDPT(const TestScene &scene, int maxDepth, bool incrementalMIS,
+                        double *seconds = nullptr) {
+    Point2i resolution(16, 16);
+    static Transform id;
+    AnimatedTransform identity(id, 0, id, 1);
+    FilterHandle filter = new BoxFilter(Vector2f(0.5, 0.5));
+    RGBFilm *film = new RGBFilm(Sensor::CreateDefault(), resolution,
+                                Bounds2i(Point2i(0, 0), resolution), filter, 1.,
+                                inTestDir("bdpt-mis.exr"), 1., RGBColorSpace::sRGB);
+    PerspectiveCamera *camera = new PerspectiveCamera(
+        CameraTransform(identity), Bounds2f(Point2f(-1, -1), Point2f(1, 1)), 0., 1., 0.,
+        10., 45, film, nullptr);
+    SamplerHandle sampler = new PaddedSobolSampler(16, RandomizeStrategy::Owen);
+    BDPTIntegrator integrator(camera, sampler, scene.aggregate, scene.lights, maxDepth,
+                              false, false, "power", false, incrementalMIS);
+
+    Timer timer;
+    integrator.Render();
+    if (seconds)
+        *seconds = timer.ElapsedSeconds();
+
+    pstd::optional<ImageAndMetadata> im = Image::Read(inTestDir("bdpt-mis.exr"));
+    EXPECT_EQ(0, remove(inTestDir("bdpt-mis.exr").c_str()));
+    CHECK(im.has_value());
+    return std::move(im->image);
+}
+
+TEST(BDPT, IncrementalMISMatchesFullWalk) {
+    for (const TestScene &scene : GetScenes()) {
+        Image full = RenderBDPT(scene, 6, false);
+        Image incremental = RenderBDPT(scene, 6, true);
+        ASSERT_EQ(full.Resolution(), incremental.Resolution());
+        for (int y = 0; y < full.Resolution().y; ++y)
+            for (int x = 0; x < full.Resolution().x; ++x)
+                for (int c = 0; c < 3; ++c) {
+                    Float a = full.GetChannel({x, y}, c);
+                    Float b = incremental.GetChannel({x, y}, c);
+                    EXPECT_LE(std::abs(a - b), 1e-4f * std::max<Float>(1, a))
+                        << scene.description << " (" << x << ", " << y << ")";
+                }
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the cost of the two
+// MIS weight computations as the maximum path depth grows.
+TEST(BDPT, DISABLED_MISWeightBenchmark) {
+    TestScene scene = GetScenes()[0];
+    for (int maxDepth : {2, 5, 10, 20, 40}) {
+        double fullSeconds, incrementalSeconds;
+        RenderBDPT(scene, maxDepth, false, &fullSeconds);
+        RenderBDPT(scene, maxDepth, true, &incrementalSeconds);
+        printf("maxdepth %2d: full walk %.3fs, incremental %.3fs (%.2fx)\n", maxDepth,
+               fullSeconds, incrementalSeconds, fullSeconds / incrementalSeconds);
+    }
+}
@@ -10,10 +10,13 @@
 #include <pbrt/shapes.h>
 #include <pbrt/textures.h>
 #include <pbrt/util/check.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/log.h>
 #include <pbrt/util/taggedptr.h>
 #include <pbrt/util/vecmath.h>
 
+#include <atomic>
+
 namespace pbrt {
 
 Bounds3f PrimitiveHandle::Bounds() const {
@@ -32,34 +35,145 @@ bool PrimitiveHandle::IntersectP(const Ray &r, Float tMax) const {
     return DispatchCPU(isectp);
 }
 
+STAT_PERCENT("Intersections/Alpha tests resolved by opacity micromaps",
+             nMicromapResolved, nMicromapLookups);
+
+// OpacityMicromap Method Definitions
+OpacityMicromap *OpacityMicromap::Create(const Triangle *triangle,
+                                         FloatTextureHandle alpha) {
+    // The alpha texture must be an image whose texture coordinates are an
+    // affine function of the triangle's barycentrics
+    const FloatImageTexture *texture = alpha.CastOrNullptr<FloatImageTexture>();
+    if (!texture || !texture->mipmap ||
+        !(texture->mapping.Is<UVMapping2D>() || texture->mapping.Is<PlanarMapping2D>()))
+        return nullptr;
+
+    // Compute texture coordinates at the triangle's vertices
+    const TriangleMesh *mesh = triangle->Mesh();
+    int triIndex = triangle->TriangleIndex();
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
+    int faceIndex = mesh->faceIndices ? mesh->faceIndices[triIndex] : 0;
+    Point2i res = texture->mipmap->LevelResolution(0);
+    pstd::array<Point2f, 3> uv = {Point2f(0, 0), Point2f(1, 0), Point2f(1, 1)};
+    if (mesh->HasUVs())
+        uv = {mesh->GetUV(v[0]), mesh->GetUV(v[1]), mesh->GetUV(v[2])};
+    Point2f st[3];
+    for (int i = 0; i < 3; ++i) {
+        TextureEvalContext ctx(mesh->p[v[i]], Vector3f(), Vector3f(), uv[i], 0, 0, 0, 0,
+                               faceIndex);
+        Vector2f dstdx, dstdy;
+        st[i] = texture->mapping.Map(ctx, &dstdx, &dstdy);
+        // Convert to level 0 texel coordinates, as in _MIPMap::Bilerp()_
+        st[i] = Point2f(st[i][0] * res[0] - 0.5f, (1 - st[i][1]) * res[1] - 0.5f);
+    }
+
+    OpacityMicromap micromap;
+    bool anyKnown = false;
+    for (int j = 0; j < Resolution; ++j)
+        for (int i = 0; i < Resolution - j; ++i)
+            for (int upper = 0; upper < (i + j < Resolution - 1 ? 2 : 1); ++upper) {
+                // Find the texels that lookups in the subtriangle may use
+                Point2f b[3] = {Point2f(i, j), Point2f(i + 1, j), Point2f(i, j + 1)};
+                if (upper)
+                    b[0] = Point2f(i + 1, j + 1);
+                Bounds2f stBounds;
+                for (int k = 0; k < 3; ++k) {
+                    Float b1 = b[k][0] / Resolution, b2 = b[k][1] / Resolution;
+                    stBounds = Union(stBounds, Point2f((1 - b1 - b2) * st[0] +
+                                                       b1 * st[1] + b2 * st[2]));
+                }
+                constexpr Float eps = 1e-3f;
+                Point2f pMin = Floor(stBounds.pMin - Vector2f(eps, eps));
+                Point2f pMax = Floor(stBounds.pMax + Vector2f(eps, eps)) + Vector2f(1, 1);
+                if (!(pMax.x - pMin.x < 64 && pMax.y - pMin.y < 64))
+                    continue;
+
+                // Classify the subtriangle using the texels' values
+                bool anyZero = false, anyPositive = false, anyNegative = false;
+                for (int y = pMin.y; y <= pMax.y; ++y)
+                    for (int x = pMin.x; x <= pMax.x; ++x) {
+                        Float a =
+                            texture->scale * texture->mipmap->Texel<Float>(0, {x, y});
+                        anyZero |= (a == 0);
+                        anyPositive |= (a > 0);
+                        anyNegative |= (a < 0);
+                    }
+                State state = State::Unknown;
+                if (!anyPositive && !anyNegative)
+                    state = State::Transparent;
+                else if (!anyZero && !(anyPositive && anyNegative))
+                    state = State::Opaque;
+
+                int index = j * (2 * Resolution - j) + 2 * i + upper;
+                micromap.bits[index / 32] |= uint64_t(state) << (2 * (index % 32));
+                anyKnown |= (state != State::Unknown);
+            }
+
+    if (!anyKnown)
+        return nullptr;
+    primitiveMemory += sizeof(OpacityMicromap);
+    return new OpacityMicromap(micromap);
+}
+
+std::string OpacityMicromap::ToString() const {
+    std::string str = "[ OpacityMicromap states: ";
+    for (int i = 0; i < NumSubtriangles; ++i)
+        str += "?TO"[(bits[i / 32] >> (2 * (i % 32))) & 3];
+    return str + " ]";
+}
+
 // GeometricPrimitive Method Definitions
 GeometricPrimitive::GeometricPrimitive(ShapeHandle shape, MaterialHandle material,
                                        LightHandle areaLight,
                                        const MediumInterface &mediumInterface,
-                                       FloatTextureHandle alpha)
+                                       FloatTextureHandle alpha,
+                                       const OpacityMicromap *micromap)
     : shape(shape),
       material(material),
       areaLight(areaLight),
       mediumInterface(mediumInterface),
-      alpha(alpha) {
+      alpha(alpha),
+      micromap(micromap) {
+    CHECK(!micromap || (alpha && shape.Is<Triangle>()));
     primitiveMemory += sizeof(*this);
 }
 
 pstd::optional<ShapeIntersection> GeometricPrimitive::Intersect(const Ray &r,
                                                                 Float tMax) const {
-    pstd::optional<ShapeIntersection> si = shape.Intersect(r, tMax);
-    if (!si)
-        return {};
-    CHECK_LT(si->tHit, 1.001 * tMax);
-    // Test intersection against alpha texture, if present
-    if (alpha && alpha.Evaluate(si->intr) == 0) {
-        // Ignore this hit and trace a new ray.
-        Ray rNext = si->intr.SpawnRay(r.d);
-        pstd::optional<ShapeIntersection> siNext = Intersect(rNext, tMax - si->tHit);
-        if (siNext)
-            // The returned t value has to account for both ray segments.
-            siNext->tHit += si->tHit;
-        return siNext;
+    pstd::optional<ShapeIntersection> si;
+    if (micromap) {
+        // Intersect triangle and classify the hit using its opacity micromap
+        const Triangle *triangle = shape.Cast<Triangle>();
+        pstd::optional<TriangleIntersection> triIsect =
+            triangle->IntersectBarycentric(r, tMax);
+        if (!triIsect)
+            return {};
+        ++nMicromapLookups;
+        OpacityMicromap::State state = micromap->Lookup(triIsect->b1, triIsect->b2);
+        if (state != OpacityMicromap::State::Unknown)
+            ++nMicromapResolved;
+        // A ray can't hit the triangle again past a transparent point
+        if (state == OpacityMicromap::State::Transparent)
+            return {};
+        si = triangle->CompleteIntersection(*triIsect, r);
+        if (!si || (state == OpacityMicromap::State::Unknown &&
+                    alpha.Evaluate(si->intr) == 0))
+            return {};
+    } else {
+        si = shape.Intersect(r, tMax);
+        if (!si)
+            return {};
+        CHECK_LT(si->tHit, 1.001 * tMax);
+        // Test intersection against alpha texture, if present
+        if (alpha && alpha.Evaluate(si->intr) == 0) {
+            // Ignore this hit and trace a new ray.
+            Ray rNext = si->intr.SpawnRay(r.d);
+            pstd::optional<ShapeIntersection> siNext = Intersect(rNext, tMax - si->tHit);
+            if (siNext)
+                // The returned t value has to account for both ray segments.
+                siNext->tHit += si->tHit;
+            return siNext;
+        }
     }
 
     // Initialize _SurfaceInteraction_ after _Shape_ intersection
@@ -79,6 +193,24 @@ bool GeometricPrimitive::IntersectP(const Ray &r, Float tMax) const {
     if (material && material.IsTransparent())
         return false;
 
+    if (micromap) {
+        // Resolve opaque hits without computing a _SurfaceInteraction_
+        const Triangle *triangle = shape.Cast<Triangle>();
+        pstd::optional<TriangleIntersection> triIsect =
+            triangle->IntersectBarycentric(r, tMax);
+        if (!triIsect)
+            return false;
+        ++nMicromapLookups;
+        OpacityMicromap::State state = micromap->Lookup(triIsect->b1, triIsect->b2);
+        if (state != OpacityMicromap::State::Unknown) {
+            ++nMicromapResolved;
+            return state == OpacityMicromap::State::Opaque;
+        }
+        pstd::optional<ShapeIntersection> si =
+            triangle->CompleteIntersection(*triIsect, r);
+        return si && alpha.Evaluate(si->intr) != 0;
+    }
+
     if (alpha)
         return Intersect(r, tMax).has_value();
     else
@@ -146,7 +278,9 @@ AnimatedPrimitive::AnimatedPrimitive(PrimitiveHandle p,
                                      const AnimatedTransform &renderFromPrimitive)
     : primitive(p), renderFromPrimitive(renderFromPrimitive) {
     primitiveMemory += sizeof(*this);
-    CHECK(renderFromPrimitive.IsAnimated());
+    // Instances with projective transformations also end up here.
+    CHECK(renderFromPrimitive.IsAnimated() ||
+          !AffineTransform::IsAffine(renderFromPrimitive.startTransform));
 }
 
 pstd::optional<ShapeIntersection> AnimatedPrimitive::Intersect(const Ray &r,
@@ -169,4 +303,67 @@ bool AnimatedPrimitive::IntersectP(const Ray &r, Float tMax) const {
     return primitive.IntersectP(ray, tMax);
 }
 
+STAT_PERCENT("Intersections/Coarser LOD levels used", nCoarseLODLevels, nLODLookups);
+
+// A ray's _lodTag_ holds the id of the LODPrimitive it was spawned from in
+// its upper bits and the level that was used in the low two bits. Because
+// all instances of an object definition share its LODPrimitive, the tag is
+// only honored for rays that start inside the primitive's bounds, which in
+// instance space are those of the instance the ray left.
+static_assert(LODPrimitive::MaxLevels <= 4, "LOD level doesn't fit in lodTag");
+static std::atomic<uint32_t> nextLODPrimitiveId{1};
+
+// LODPrimitive Method Definitions
+LODPrimitive::LODPrimitive(std::vector<PrimitiveHandle> l, Float featureSize)
+    : levels(std::move(l)), featureSize(featureSize), id(nextLODPrimitiveId++) {
+    CHECK(!levels.empty());
+    for (PrimitiveHandle level : levels)
+        bounds = Union(bounds, level.Bounds());
+    primitiveMemory += sizeof(*this) + levels.size() * sizeof(PrimitiveHandle);
+}
+
+int LODPrimitive::Level(const Ray &r, Float tMax) const {
+    // Use the level that the ray's origin was found with, if it is on this primitive
+    ++nLODLookups;
+    if ((r.lodTag >> 2) == id &&
+        Inside(r.o, Expand(bounds, 1e-3f * Length(bounds.Diagonal())))) {
+        int level = r.lodTag & 3;
+        if (level > 0)
+            ++nCoarseLODLevels;
+        return level;
+    }
+
+    // Find the width of the ray's footprint where it enters the bounds
+    Float t0;
+    if (r.spread == 0 || levels.size() == 1 || !bounds.IntersectP(r.o, r.d, tMax, &t0))
+        return 0;
+    Float width = r.spread * t0 * Length(r.d);
+    if (width <= featureSize)
+        return 0;
+
+    // Choose between the two levels closest to the footprint's width
+    Float lod = std::log2(width / featureSize);
+    int level = int(lod);
+    Float u = Float(Hash(r.o, r.d) >> 40) * 0x1p-24f;
+    if (u < lod - level)
+        ++level;
+    level = std::min<int>(level, levels.size() - 1);
+    if (level > 0)
+        ++nCoarseLODLevels;
+    return level;
+}
+
+pstd::optional<ShapeIntersection> LODPrimitive::Intersect(const Ray &r,
+                                                          Float tMax) const {
+    int level = Level(r, tMax);
+    pstd::optional<ShapeIntersection> si = levels[level].Intersect(r, tMax);
+    if (si)
+        si->intr.lodTag = (id << 2) | level;
+    return si;
+}
+
+bool LODPrimitive::IntersectP(const Ray &r, Float tMax) const {
+    return levels[Level(r, tMax)].IntersectP(r, tMax);
+}
+
 }  // namespace pbrt
@@ -17,6 +17,7 @@
 #include <pbrt/util/transform.h>
 
 #include <memory>
+#include <vector>
 
 namespace pbrt {
 
@@ -27,12 +28,15 @@ class GeometricPrimitive;
 class TransformedPrimitive;
 class AnimatedPrimitive;
 class BVHAccel;
+class LazyBVHAccel;
 class KdTreeAccel;
+class LODPrimitive;
 
 // PrimitiveHandle Definition
 class PrimitiveHandle
     : public TaggedPointer<SimplePrimitive, GeometricPrimitive, TransformedPrimitive,
-                           AnimatedPrimitive, BVHAccel, KdTreeAccel> {
+                           AnimatedPrimitive, BVHAccel, LazyBVHAccel, KdTreeAccel,
+                           LODPrimitive> {
   public:
     // Primitive Interface
     using TaggedPointer::TaggedPointer;
@@ -44,13 +48,52 @@ class PrimitiveHandle
     bool IntersectP(const Ray &r, Float tMax = Infinity) const;
 };
 
+// OpacityMicromap Definition
+// Records, for each of the 4^Level subtriangles of a triangle's barycentric
+// domain, whether its alpha texture is zero everywhere in it, nonzero
+// everywhere in it, or varies, so that the texture only needs to be
+// evaluated for hits in the last case.
+class OpacityMicromap {
+  public:
+    // OpacityMicromap Public Methods
+    enum class State { Unknown, Transparent, Opaque };
+
+    static OpacityMicromap *Create(const Triangle *triangle, FloatTextureHandle alpha);
+
+    State Lookup(Float b1, Float b2) const {
+        // Find the subtriangle that contains barycentrics $(b_1,b_2)$
+        Float u = b1 * Resolution, v = b2 * Resolution;
+        int i = Clamp(int(u), 0, Resolution - 1), j = Clamp(int(v), 0, Resolution - 1);
+        bool upper = (u - i) + (v - j) > 1;
+        // Cells on the diagonal only have a lower subtriangle, though round-off
+        // may make _upper_ true in them when $b_1 + b_2 = 1$.
+        if (i + j >= Resolution - 1) {
+            i = Resolution - 1 - j;
+            upper = false;
+        }
+        int index = j * (2 * Resolution - j) + 2 * i + upper;
+        return State((bits[index / 32] >> (2 * (index % 32))) & 3);
+    }
+
+    std::string ToString() const;
+
+    static constexpr int Level = 3;
+    static constexpr int Resolution = 1 << Level;
+    static constexpr int NumSubtriangles = Resolution * Resolution;
+
+  private:
+    // OpacityMicromap Private Members
+    uint64_t bits[NumSubtriangles / 32] = {};
+};
+
 // GeometricPrimitive Definition
 class GeometricPrimitive {
   public:
     // GeometricPrimitive Public Methods
     GeometricPrimitive(ShapeHandle shape, MaterialHandle material, LightHandle areaLight,
                        const MediumInterface &mediumInterface,
-                       FloatTextureHandle alpha = nullptr);
+                       FloatTextureHandle alpha = nullptr,
+                       const OpacityMicromap *micromap = nullptr);
     Bounds3f Bounds() const;
     pstd::optional<ShapeIntersection> Intersect(const Ray &r, Float tMax) const;
     bool IntersectP(const Ray &r, Float tMax) const;
@@ -62,6 +105,8 @@ class GeometricPrimitive {
     LightHandle areaLight;
     MediumInterface mediumInterface;
     FloatTextureHandle alpha;
+    // Only non-null if _shape_ is a _Triangle_ and _alpha_ is set.
+    const OpacityMicromap *micromap;
 };
 
 // SimplePrimitive Definition
@@ -82,7 +127,8 @@ class SimplePrimitive {
 class TransformedPrimitive {
   public:
     // TransformedPrimitive Public Methods
-    TransformedPrimitive(PrimitiveHandle primitive, const Transform *renderFromPrimitive)
+    TransformedPrimitive(PrimitiveHandle primitive,
+                         const AffineTransform *renderFromPrimitive)
         : primitive(primitive), renderFromPrimitive(renderFromPrimitive) {
         primitiveMemory += sizeof(*this);
     }
@@ -95,7 +141,7 @@ class TransformedPrimitive {
   private:
     // TransformedPrimitive Private Members
     PrimitiveHandle primitive;
-    const Transform *renderFromPrimitive;
+    const AffineTransform *renderFromPrimitive;
 };
 
 // AnimatedPrimitive Definition
@@ -117,6 +163,37 @@ class AnimatedPrimitive {
     AnimatedTransform renderFromPrimitive;
 };
 
+// LODPrimitive Definition
+// Holds successively simplified versions of a primitive, where the features
+// of level i are about 2^i times _featureSize_. Each ray is intersected
+// with the level that matches the width of its footprint where it enters
+// the primitive's bounds, choosing randomly between the two closest levels
+// so that the transitions between them are dithered. The chosen level is
+// recorded in the intersection's _lodTag_, so that rays spawned from it,
+// including shadow rays, see the same level of this primitive.
+class LODPrimitive {
+  public:
+    // LODPrimitive Public Methods
+    LODPrimitive(std::vector<PrimitiveHandle> levels, Float featureSize);
+
+    Bounds3f Bounds() const { return bounds; }
+    pstd::optional<ShapeIntersection> Intersect(const Ray &r, Float tMax) const;
+    bool IntersectP(const Ray &r, Float tMax) const;
+
+    static constexpr int MaxLevels = 4;
+
+  private:
+    // LODPrimitive Private Methods
+    int Level(const Ray &r, Float tMax) const;
+
+    // LODPrimitive Private Members
+    std::vector<PrimitiveHandle> levels;
+    Float featureSize;
+    // The union of the levels' bounds
+    Bounds3f bounds;
+    uint32_t id;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_CPU_PRIMITIVE_H
@@ -12,21 +12,49 @@
 #include <pbrt/lights.h>
 #include <pbrt/materials.h>
 #include <pbrt/media.h>
+#include <pbrt/options.h>
 #include <pbrt/parsedscene.h>
 #include <pbrt/samplers.h>
 #include <pbrt/shapes.h>
 #include <pbrt/textures.h>
 #include <pbrt/util/colorspace.h>
+#include <pbrt/util/file.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/progressreporter.h>
+#include <pbrt/util/stats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 namespace pbrt {
 
 void CPURender(ParsedScene &parsedScene) {
     Allocator alloc;
 
+    // Scene creation runs as a small task graph on the thread pool: shapes,
+    // textures and materials, and lights are created concurrently, and the
+    // interval of each phase is recorded so that the critical path can be
+    // seen in the log.
+    struct SceneCreationPhase {
+        std::string name;
+        double start, end;
+    };
+    Timer creationTimer;
+    std::mutex phaseMutex;
+    std::vector<SceneCreationPhase> phases;
+    auto timePhase = [&](const char *name, auto func) {
+        double start = creationTimer.ElapsedSeconds();
+        func();
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        phases.push_back({name, start, creationTimer.ElapsedSeconds()});
+    };
+
     // Create media first (so have them for the camera...)
-    std::map<std::string, MediumHandle> media = parsedScene.CreateMedia(alloc);
+    std::map<std::string, MediumHandle> media;
+    timePhase("Media", [&]() { media = parsedScene.CreateMedia(alloc); });
 
-    bool haveScatteringMedia = false;
+    std::atomic<bool> haveScatteringMedia{false};
     auto findMedium = [&media, &haveScatteringMedia](const std::string &s,
                                                      const FileLoc *loc) -> MediumHandle {
         if (s.empty())
@@ -39,38 +67,156 @@ void CPURender(ParsedScene &parsedScene) {
         return iter->second;
     };
 
-    // Filter
-    FilterHandle filter =
-        FilterHandle::Create(parsedScene.filter.name, parsedScene.filter.parameters,
-                             &parsedScene.filter.loc, alloc);
-
-    // Film
-    FilmHandle film =
-        FilmHandle::Create(parsedScene.film.name, parsedScene.film.parameters,
-                           &parsedScene.film.loc, filter, alloc);
-
-    // Camera
-    MediumHandle cameraMedium =
-        findMedium(parsedScene.camera.medium, &parsedScene.camera.loc);
-    CameraHandle camera = CameraHandle::Create(
-        parsedScene.camera.name, parsedScene.camera.parameters, cameraMedium,
-        parsedScene.camera.cameraTransform, film, &parsedScene.camera.loc, alloc);
-
-    // Create _Sampler_ for rendering
-    SamplerHandle sampler = SamplerHandle::Create(
-        parsedScene.sampler.name, parsedScene.sampler.parameters,
-        camera.GetFilm().FullResolution(), &parsedScene.sampler.loc, alloc);
-
-    // Textures
-    std::map<std::string, FloatTextureHandle> floatTextures;
-    std::map<std::string, SpectrumTextureHandle> spectrumTextures;
-    parsedScene.CreateTextures(&floatTextures, &spectrumTextures, alloc, false);
-
-    // Materials
-    std::map<std::string, MaterialHandle> namedMaterials;
-    std::vector<MaterialHandle> materials;
-    parsedScene.CreateMaterials(floatTextures, spectrumTextures, alloc, &namedMaterials,
-                                &materials);
+    FilterHandle filter;
+    FilmHandle film;
+    CameraHandle camera;
+    SamplerHandle sampler;
+    auto createCamera = [&]() {
+        timePhase("Camera", [&]() {
+            // Filter
+            filter = FilterHandle::Create(parsedScene.filter.name,
+                                          parsedScene.filter.parameters,
+                                          &parsedScene.filter.loc, alloc);
+
+            // Film
+            film = FilmHandle::Create(parsedScene.film.name, parsedScene.film.parameters,
+                                      &parsedScene.film.loc, filter, alloc);
+
+            // Camera
+            MediumHandle cameraMedium =
+                findMedium(parsedScene.camera.medium, &parsedScene.camera.loc);
+            camera = CameraHandle::Create(parsedScene.camera.name,
+                                          parsedScene.camera.parameters, cameraMedium,
+                                          parsedScene.camera.cameraTransform, film,
+                                          &parsedScene.camera.loc, alloc);
+
+            // Create _Sampler_ for rendering
+            sampler = SamplerHandle::Create(
+                parsedScene.sampler.name, parsedScene.sampler.parameters,
+                camera.GetFilm().FullResolution(), &parsedScene.sampler.loc, alloc);
+        });
+    };
+
+    // Loop subdivision surfaces with an "edgelength" are refined based on the
+    // camera's view, so the camera must be created before the shapes if there
+    // are any. Only static shapes outside of object instance definitions are
+    // in render space when they are created, so only they are adaptive.
+    bool adaptiveSubdivision =
+        std::any_of(parsedScene.shapes.begin(), parsedScene.shapes.end(),
+                    [](const ShapeSceneEntity &sh) {
+                        return sh.name == "loopsubdiv" &&
+                               sh.parameters.GetOneFloat("edgelength", 0.f) > 0;
+                    });
+    LoopSubdivisionView subdivisionView;
+    if (adaptiveSubdivision) {
+        createCamera();
+        subdivisionView = GetLoopSubdivisionView(camera);
+    }
+
+    // Start creating shapes, which includes reading mesh files from disk and
+    // is often the longest phase. The shapes of each scene entity are created
+    // in parallel; they are turned into primitives once the materials are
+    // available.
+    using ShapeList = std::vector<pstd::vector<ShapeHandle>>;
+    auto createShapes = [&](const std::vector<ShapeSceneEntity> &entities,
+                            const LoopSubdivisionView &view) {
+        ShapeList shapes(entities.size());
+        ParallelFor(0, entities.size(), [&](int64_t i) {
+            const ShapeSceneEntity &sh = entities[i];
+            shapes[i] =
+                ShapeHandle::Create(sh.name, sh.renderFromObject, sh.objectFromRender,
+                                    sh.reverseOrientation, sh.parameters, view, &sh.loc,
+                                    alloc);
+        });
+        return shapes;
+    };
+    auto createAnimatedShapes = [&](const std::vector<AnimatedShapeSceneEntity> &entities) {
+        ShapeList shapes(entities.size());
+        ParallelFor(0, entities.size(), [&](int64_t i) {
+            const AnimatedShapeSceneEntity &sh = entities[i];
+            shapes[i] =
+                ShapeHandle::Create(sh.name, sh.identity, sh.identity,
+                                    sh.reverseOrientation, sh.parameters,
+                                    LoopSubdivisionView(), &sh.loc, alloc);
+        });
+        return shapes;
+    };
+
+    struct SceneShapes {
+        ShapeList shapes, animatedShapes;
+        // Indexed in the order of _parsedScene.instanceDefinitions_.
+        std::vector<ShapeList> instanceShapes, instanceAnimatedShapes;
+    };
+    AsyncJob<SceneShapes> *shapesJob = RunAsync([&]() {
+        SceneShapes sceneShapes;
+        timePhase("Shapes", [&]() {
+            sceneShapes.shapes = createShapes(parsedScene.shapes, subdivisionView);
+            sceneShapes.animatedShapes = createAnimatedShapes(parsedScene.animatedShapes);
+
+            std::vector<const InstanceDefinitionSceneEntity *> definitions;
+            for (const auto &inst : parsedScene.instanceDefinitions)
+                definitions.push_back(&inst.second);
+            sceneShapes.instanceShapes.resize(definitions.size());
+            sceneShapes.instanceAnimatedShapes.resize(definitions.size());
+            ParallelFor(0, definitions.size(), [&](int64_t i) {
+                sceneShapes.instanceShapes[i] =
+                    createShapes(definitions[i]->shapes, LoopSubdivisionView());
+                sceneShapes.instanceAnimatedShapes[i] =
+                    createAnimatedShapes(definitions[i]->animatedShapes);
+            });
+        });
+        return sceneShapes;
+    });
+
+    // Textures and then materials, which may use them
+    struct SceneMaterials {
+        std::map<std::string, FloatTextureHandle> floatTextures;
+        std::map<std::string, SpectrumTextureHandle> spectrumTextures;
+        std::map<std::string, MaterialHandle> namedMaterials;
+        std::vector<MaterialHandle> materials;
+    };
+    AsyncJob<SceneMaterials> *materialsJob = RunAsync([&]() {
+        SceneMaterials sm;
+        timePhase("Textures", [&]() {
+            parsedScene.CreateTextures(&sm.floatTextures, &sm.spectrumTextures, alloc,
+                                       false);
+        });
+        timePhase("Materials", [&]() {
+            parsedScene.CreateMaterials(sm.floatTextures, sm.spectrumTextures, alloc,
+                                        &sm.namedMaterials, &sm.materials);
+        });
+        return sm;
+    });
+
+    // Lights (area lights will be done later, with shapes...)
+    AsyncJob<std::vector<LightHandle>> *lightsJob = RunAsync([&]() {
+        std::vector<LightHandle> lights;
+        timePhase("Lights", [&]() {
+            lights.reserve(parsedScene.lights.size() + parsedScene.areaLights.size());
+            for (const auto &light : parsedScene.lights) {
+                MediumHandle outsideMedium = findMedium(light.medium, &light.loc);
+                if (light.renderFromObject.IsAnimated())
+                    Warning(&light.loc,
+                            "Animated lights aren't supported. Using the start transform.");
+                LightHandle l = LightHandle::Create(
+                    light.name, light.parameters, light.renderFromObject.startTransform,
+                    parsedScene.camera.cameraTransform, outsideMedium, &light.loc, alloc);
+                lights.push_back(l);
+            }
+        });
+        return lights;
+    });
+
+    if (!adaptiveSubdivision)
+        createCamera();
+
+    // Wait for the concurrent phases, helping out with them in the meantime
+    SceneMaterials sceneMaterials = materialsJob->GetResult();
+    delete materialsJob;
+    std::map<std::string, FloatTextureHandle> &floatTextures =
+        sceneMaterials.floatTextures;
+    std::map<std::string, MaterialHandle> &namedMaterials = sceneMaterials.namedMaterials;
+    std::vector<MaterialHandle> &materials = sceneMaterials.materials;
     bool haveSubsurface = false;
     for (const auto &mtl : parsedScene.materials)
         if (mtl.name == "subsurface")
@@ -79,19 +225,10 @@ void CPURender(ParsedScene &parsedScene) {
         if (namedMtl.second.name == "subsurface")
             haveSubsurface = true;
 
-    // Lights (area lights will be done later, with shapes...)
-    std::vector<LightHandle> lights;
-    lights.reserve(parsedScene.lights.size() + parsedScene.areaLights.size());
-    for (const auto &light : parsedScene.lights) {
-        MediumHandle outsideMedium = findMedium(light.medium, &light.loc);
-        if (light.renderFromObject.IsAnimated())
-            Warning(&light.loc,
-                    "Animated lights aren't supported. Using the start transform.");
-        LightHandle l = LightHandle::Create(
-            light.name, light.parameters, light.renderFromObject.startTransform,
-            parsedScene.camera.cameraTransform, outsideMedium, &light.loc, alloc);
-        lights.push_back(l);
-    }
+    std::vector<LightHandle> lights = lightsJob->GetResult();
+    delete lightsJob;
+    SceneShapes sceneShapes = shapesJob->GetResult();
+    delete shapesJob;
 
     // Primitives
     auto getAlphaTexture = [&](const ParameterDictionary &parameters,
@@ -111,12 +248,12 @@ void CPURender(ParsedScene &parsedScene) {
 
     // Non-animated shapes
     auto CreatePrimitivesForShapes =
-        [&](const std::vector<ShapeSceneEntity> &shapes) -> std::vector<PrimitiveHandle> {
+        [&](const std::vector<ShapeSceneEntity> &shapeEntities,
+            const ShapeList &shapeLists) -> std::vector<PrimitiveHandle> {
         std::vector<PrimitiveHandle> primitives;
-        for (const auto &sh : shapes) {
-            pstd::vector<ShapeHandle> shapes =
-                ShapeHandle::Create(sh.name, sh.renderFromObject, sh.objectFromRender,
-                                    sh.reverseOrientation, sh.parameters, &sh.loc, alloc);
+        for (size_t i = 0; i < shapeEntities.size(); ++i) {
+            const auto &sh = shapeEntities[i];
+            const pstd::vector<ShapeHandle> &shapes = shapeLists[i];
             if (shapes.empty())
                 continue;
 
@@ -137,7 +274,16 @@ void CPURender(ParsedScene &parsedScene) {
             MediumInterface mi(findMedium(sh.insideMedium, &sh.loc),
                                findMedium(sh.outsideMedium, &sh.loc));
 
-            for (auto &s : shapes) {
+            // Build opacity micromaps for alpha-tested triangles
+            std::vector<const OpacityMicromap *> micromaps(shapes.size(), nullptr);
+            if (alphaTex && shapes[0].Is<Triangle>())
+                ParallelFor(0, shapes.size(), [&](int64_t j) {
+                    micromaps[j] =
+                        OpacityMicromap::Create(shapes[j].Cast<Triangle>(), alphaTex);
+                });
+
+            for (size_t j = 0; j < shapes.size(); ++j) {
+                ShapeHandle s = shapes[j];
                 // Possibly create area light for shape
                 LightHandle areaHandle = nullptr;
                 if (sh.lightIndex != -1) {
@@ -154,27 +300,23 @@ void CPURender(ParsedScene &parsedScene) {
                 if (areaHandle == nullptr && !mi.IsMediumTransition() && !alphaTex)
                     primitives.push_back(new SimplePrimitive(s, mtl));
                 else
-                    primitives.push_back(
-                        new GeometricPrimitive(s, mtl, areaHandle, mi, alphaTex));
+                    primitives.push_back(new GeometricPrimitive(s, mtl, areaHandle, mi,
+                                                                alphaTex, micromaps[j]));
             }
         }
         return primitives;
     };
 
-    std::vector<PrimitiveHandle> primitives =
-        CreatePrimitivesForShapes(parsedScene.shapes);
-
     // Animated shapes
     auto CreatePrimitivesForAnimatedShapes =
-        [&](const std::vector<AnimatedShapeSceneEntity> &shapes)
-        -> std::vector<PrimitiveHandle> {
+        [&](const std::vector<AnimatedShapeSceneEntity> &shapeEntities,
+            const ShapeList &shapeLists) -> std::vector<PrimitiveHandle> {
         std::vector<PrimitiveHandle> primitives;
-        primitives.reserve(shapes.size());
+        primitives.reserve(shapeEntities.size());
 
-        for (const auto &sh : shapes) {
-            pstd::vector<ShapeHandle> shapes =
-                ShapeHandle::Create(sh.name, sh.identity, sh.identity,
-                                    sh.reverseOrientation, sh.parameters, &sh.loc, alloc);
+        for (size_t i = 0; i < shapeEntities.size(); ++i) {
+            const auto &sh = shapeEntities[i];
+            const pstd::vector<ShapeHandle> &shapes = shapeLists[i];
             if (shapes.empty())
                 continue;
 
@@ -236,35 +378,130 @@ void CPURender(ParsedScene &parsedScene) {
         }
         return primitives;
     };
-    std::vector<PrimitiveHandle> animatedPrimitives =
-        CreatePrimitivesForAnimatedShapes(parsedScene.animatedShapes);
-    primitives.insert(primitives.end(), animatedPrimitives.begin(),
-                      animatedPrimitives.end());
 
-    // Instance definitions
+    // Returns primitives for coarser levels of detail of an instance
+    // definition that only holds triangle meshes without area lights, and
+    // the mean edge length of its triangles in _featureSize_.
+    auto CreateInstanceLODs = [&](const InstanceDefinitionSceneEntity &def,
+                                  const ShapeList &shapeLists, Float *featureSize) {
+        std::vector<std::vector<PrimitiveHandle>> lods;
+        if (!def.animatedShapes.empty())
+            return lods;
+
+        // Find the definition's meshes
+        std::vector<const TriangleMesh *> meshes(def.shapes.size(), nullptr);
+        double edgeLengthSum = 0;
+        int64_t nTriangles = 0;
+        for (size_t i = 0; i < def.shapes.size(); ++i) {
+            const pstd::vector<ShapeHandle> &shapes = shapeLists[i];
+            if (shapes.empty())
+                continue;
+            if (def.shapes[i].lightIndex != -1 || !shapes[0].Is<Triangle>())
+                return lods;
+            const TriangleMesh *mesh = shapes[0].Cast<Triangle>()->Mesh();
+            for (ShapeHandle s : shapes)
+                if (!s.Is<Triangle>())
+                    return lods;
+            if (shapes.size() != mesh->nTriangles)
+                return lods;
+            meshes[i] = mesh;
+            edgeLengthSum += double(mesh->MeanEdgeLength()) * mesh->nTriangles;
+            nTriangles += mesh->nTriangles;
+        }
+        if (nTriangles == 0)
+            return lods;
+        *featureSize = Float(edgeLengthSum / nTriangles);
+
+        // Decimate the meshes with successively larger grid cells
+        int64_t prevTriangles = nTriangles;
+        for (int level = 1; level < LODPrimitive::MaxLevels; ++level) {
+            ShapeList levelShapes(meshes.size());
+            std::atomic<int64_t> levelTriangles{0};
+            ParallelFor(0, meshes.size(), [&](int64_t i) {
+                if (!meshes[i])
+                    return;
+                Float cellSize = *featureSize * (1 << level);
+                TriangleMesh *mesh = meshes[i]->Decimate(cellSize, alloc);
+                if (mesh) {
+                    levelShapes[i] = Triangle::CreateTriangles(mesh, alloc);
+                    levelTriangles += mesh->nTriangles;
+                }
+            });
+            // Stop once a level no longer saves much
+            if (levelTriangles == 0 || levelTriangles > prevTriangles * 3 / 4)
+                break;
+            prevTriangles = levelTriangles;
+            lods.push_back(CreatePrimitivesForShapes(def.shapes, levelShapes));
+        }
+        return lods;
+    };
+
+    std::vector<PrimitiveHandle> primitives;
     std::map<std::string, PrimitiveHandle> instanceDefinitions;
-    for (const auto &inst : parsedScene.instanceDefinitions) {
-        if (instanceDefinitions.find(inst.first) != instanceDefinitions.end())
-            ErrorExit("%s: object instance redefined", inst.first);
-
-        std::vector<PrimitiveHandle> instancePrimitives =
-            CreatePrimitivesForShapes(inst.second.shapes);
-        std::vector<PrimitiveHandle> movingInstancePrimitives =
-            CreatePrimitivesForAnimatedShapes(inst.second.animatedShapes);
-        instancePrimitives.insert(instancePrimitives.end(),
-                                  movingInstancePrimitives.begin(),
-                                  movingInstancePrimitives.end());
-        if (instancePrimitives.empty()) {
-            instanceDefinitions[inst.first] = nullptr;
-        } else {
-            if (instancePrimitives.size() > 1) {
-                PrimitiveHandle bvh = new BVHAccel(std::move(instancePrimitives));
-                instancePrimitives.clear();
-                instancePrimitives.push_back(bvh);
-            }
-            instanceDefinitions[inst.first] = instancePrimitives[0];
+    timePhase("Primitives", [&]() {
+        primitives = CreatePrimitivesForShapes(parsedScene.shapes, sceneShapes.shapes);
+        std::vector<PrimitiveHandle> animatedPrimitives = CreatePrimitivesForAnimatedShapes(
+            parsedScene.animatedShapes, sceneShapes.animatedShapes);
+        primitives.insert(primitives.end(), animatedPrimitives.begin(),
+                          animatedPrimitives.end());
+    });
+
+    // Instance definitions: their primitives are created in order, since
+    // that may add area lights, and then their BVHs are built in parallel,
+    // or on demand during rendering with --lazy-instances. With
+    // --instance-lod, simplified versions of them are created as well.
+    timePhase("Instance definitions", [&]() {
+        std::vector<std::vector<PrimitiveHandle>> definitionPrimitives;
+        std::vector<std::vector<std::vector<PrimitiveHandle>>> definitionLODs;
+        std::vector<Float> definitionFeatureSizes;
+        int index = 0;
+        for (const auto &inst : parsedScene.instanceDefinitions) {
+            std::vector<PrimitiveHandle> instancePrimitives = CreatePrimitivesForShapes(
+                inst.second.shapes, sceneShapes.instanceShapes[index]);
+            std::vector<PrimitiveHandle> movingInstancePrimitives =
+                CreatePrimitivesForAnimatedShapes(
+                    inst.second.animatedShapes, sceneShapes.instanceAnimatedShapes[index]);
+            instancePrimitives.insert(instancePrimitives.end(),
+                                      movingInstancePrimitives.begin(),
+                                      movingInstancePrimitives.end());
+            definitionPrimitives.push_back(std::move(instancePrimitives));
+
+            Float featureSize = 0;
+            if (Options->instanceLOD)
+                definitionLODs.push_back(CreateInstanceLODs(
+                    inst.second, sceneShapes.instanceShapes[index], &featureSize));
+            else
+                definitionLODs.push_back({});
+            definitionFeatureSizes.push_back(featureSize);
+            ++index;
         }
-    }
+
+        std::vector<PrimitiveHandle> definitionAccels(definitionPrimitives.size());
+        ParallelFor(0, definitionPrimitives.size(), [&](int64_t i) {
+            std::vector<PrimitiveHandle> &instancePrimitives = definitionPrimitives[i];
+            if (instancePrimitives.size() > 1 && Options->lazyInstances &&
+                instancePrimitives.size() <= LazyBVHAccel::MaxLazyPrimitives)
+                definitionAccels[i] = new LazyBVHAccel(std::move(instancePrimitives));
+            else if (instancePrimitives.size() > 1)
+                definitionAccels[i] = new BVHAccel(std::move(instancePrimitives));
+            else if (instancePrimitives.size() == 1)
+                definitionAccels[i] = instancePrimitives[0];
+
+            if (definitionAccels[i] && !definitionLODs[i].empty()) {
+                std::vector<PrimitiveHandle> levels = {definitionAccels[i]};
+                for (std::vector<PrimitiveHandle> &lodPrimitives : definitionLODs[i])
+                    levels.push_back(lodPrimitives.size() > 1
+                                         ? new BVHAccel(std::move(lodPrimitives))
+                                         : lodPrimitives[0]);
+                definitionAccels[i] =
+                    new LODPrimitive(std::move(levels), definitionFeatureSizes[i]);
+            }
+        });
+
+        index = 0;
+        for (const auto &inst : parsedScene.instanceDefinitions)
+            instanceDefinitions[inst.first] = definitionAccels[index++];
+    });
 
     // Instances
     for (const auto &inst : parsedScene.instances) {
@@ -286,9 +523,20 @@ void CPURender(ParsedScene &parsedScene) {
 
     // Accelerator
     PrimitiveHandle accel = nullptr;
-    if (!primitives.empty())
-        accel = CreateAccelerator(parsedScene.accelerator.name, std::move(primitives),
-                                  parsedScene.accelerator.parameters);
+    timePhase("Accelerator", [&]() {
+        if (!primitives.empty())
+            accel = CreateAccelerator(parsedScene.accelerator.name, std::move(primitives),
+                                      parsedScene.accelerator.parameters);
+    });
+
+    std::sort(phases.begin(), phases.end(),
+              [](const SceneCreationPhase &a, const SceneCreationPhase &b) {
+                  return a.start < b.start;
+              });
+    for (const SceneCreationPhase &phase : phases)
+        LOG_VERBOSE("Scene creation: %s from %.3fs to %.3fs (%.3fs)", phase.name,
+                    phase.start, phase.end, phase.end - phase.start);
+    LOG_VERBOSE("Scene creation: %.3fs total", creationTimer.ElapsedSeconds());
 
     // Integrator
     const RGBColorSpace *integratorColorSpace = parsedScene.film.parameters.ColorSpace();
@@ -325,6 +573,20 @@ void CPURender(ParsedScene &parsedScene) {
                 "to render them correctly.",
                 parsedScene.integrator.name);
 
+    // Report scene memory use and enforce the memory budget
+    if (!Options->memoryReportFile.empty() || Options->memoryBudgetMB > 0) {
+        MemoryReport memoryReport = GetMemoryReport();
+        if (!Options->memoryReportFile.empty() &&
+            !WriteFile(Options->memoryReportFile, memoryReport.ToJSON()))
+            ErrorExit("%s: unable to write memory report.", Options->memoryReportFile);
+        if (Options->memoryBudgetMB > 0 &&
+            memoryReport.TotalBytes() > (int64_t(Options->memoryBudgetMB) << 20))
+            ErrorExit("Scene uses %d MB of memory, which exceeds the %d MB memory "
+                      "budget:\n%s",
+                      memoryReport.TotalBytes() >> 20, Options->memoryBudgetMB,
+                      memoryReport.ToString());
+    }
+
     LOG_VERBOSE("Memory used after scene creation: %d", GetCurrentRSS());
 
     // Render!
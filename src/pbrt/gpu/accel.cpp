@@ -197,6 +197,7 @@ OptixTraversableHandle GPUAccel::createGASForTriangles(
     const std::map<std::string, MaterialHandle> &namedMaterials,
     const std::vector<MaterialHandle> &materials,
     const std::map<std::string, MediumHandle> &media,
+    const LoopSubdivisionView &subdivisionView,
     const std::map<int, pstd::vector<LightHandle> *> &shapeIndexToAreaLights,
     Bounds3f *gasBounds) {
     std::vector<OptixBuildInput> buildInputs;
@@ -222,6 +223,7 @@ OptixTraversableHandle GPUAccel::createGASForTriangles(
             } else if (shape.name == "loopsubdiv") {
                 // Copied from pbrt/shapes.cpp... :-p
                 int nLevels = shape.parameters.GetOneInt("levels", 3);
+                Float edgeLength = shape.parameters.GetOneFloat("edgelength", 0.f);
                 std::vector<int> vertexIndices = shape.parameters.GetIntArray("indices");
                 if (vertexIndices.empty())
                     ErrorExit(&shape.loc, "Vertex indices \"indices\" not "
@@ -236,7 +238,8 @@ OptixTraversableHandle GPUAccel::createGASForTriangles(
                 std::string scheme = shape.parameters.GetOneString("scheme", "loop");
 
                 mesh = LoopSubdivide(shape.renderFromObject, shape.reverseOrientation,
-                                     nLevels, vertexIndices, P, alloc);
+                                     nLevels, vertexIndices, P, alloc, edgeLength,
+                                     subdivisionView);
                 CHECK(mesh != nullptr);
             } else {
                 CHECK_EQ(shape.name, "plymesh");
@@ -451,7 +454,8 @@ OptixTraversableHandle GPUAccel::createGASForQuadrics(
 
         pstd::vector<ShapeHandle> shapeHandles = ShapeHandle::Create(
             shape.name, shape.renderFromObject, shape.objectFromRender,
-            shape.reverseOrientation, shape.parameters, &shape.loc, alloc);
+            shape.reverseOrientation, shape.parameters, LoopSubdivisionView(),
+            &shape.loc, alloc);
         if (shapeHandles.empty())
             continue;
         CHECK_EQ(1, shapeHandles.size());
@@ -523,6 +527,7 @@ GPUAccel::GPUAccel(
     const ParsedScene &scene, Allocator alloc, CUstream cudaStream,
     const std::map<int, pstd::vector<LightHandle> *> &shapeIndexToAreaLights,
     const std::map<std::string, MediumHandle> &media,
+    const LoopSubdivisionView &subdivisionView,
     pstd::array<bool, MaterialHandle::NumTags()> *haveBasicEvalMaterial,
     pstd::array<bool, MaterialHandle::NumTags()> *haveUniversalEvalMaterial,
     bool *haveSubsurface)
@@ -891,7 +896,8 @@ GPUAccel::GPUAccel(
 
     OptixTraversableHandle triangleGASTraversable = createGASForTriangles(
         scene.shapes, hitPGTriangle, anyhitPGShadowTriangle, hitPGRandomHitTriangle,
-        floatTextures, namedMaterials, materials, media, shapeIndexToAreaLights, &bounds);
+        floatTextures, namedMaterials, materials, media, subdivisionView,
+        shapeIndexToAreaLights, &bounds);
     int bilinearSBTOffset = intersectHGRecords.size();
     OptixTraversableHandle bilinearPatchGASTraversable =
         createGASForBLPs(scene.shapes, hitPGBilinearPatch, anyhitPGShadowBilinearPatch,
@@ -943,8 +949,8 @@ GPUAccel::GPUAccel(
         inst.sbtOffset = intersectHGRecords.size();
         inst.handle = createGASForTriangles(
             def.second.shapes, hitPGTriangle, anyhitPGShadowTriangle,
-            hitPGRandomHitTriangle, floatTextures, namedMaterials, materials, media, {},
-            &inst.bounds);
+            hitPGRandomHitTriangle, floatTextures, namedMaterials, materials, media,
+            LoopSubdivisionView(), {}, &inst.bounds);
         instanceMap[def.first] = inst;
     }
 
@@ -954,7 +960,9 @@ GPUAccel::GPUAccel(
             ErrorExit(&inst.loc, "%s: object instance not defined.", inst.name);
 
         if (inst.renderFromInstance == nullptr) {
-            Warning(&inst.loc, "%s: object instance has animated transformation. TODO",
+            Warning(&inst.loc,
+                    "%s: object instance has animated or projective transformation. "
+                    "TODO",
                     inst.name);
             continue;
         }
@@ -969,10 +977,10 @@ GPUAccel::GPUAccel(
         bounds = Union(bounds, (*inst.renderFromInstance)(instanceMap[inst.name].bounds));
 
         OptixInstance optixInstance = {};
+        SquareMatrix<4> renderFromInstance = inst.renderFromInstance->GetMatrix();
         for (int i = 0; i < 3; ++i)
             for (int j = 0; j < 4; ++j)
-                optixInstance.transform[4 * i + j] =
-                    inst.renderFromInstance->GetMatrix()[i][j];
+                optixInstance.transform[4 * i + j] = renderFromInstance[i][j];
         optixInstance.visibilityMask = 255;
         optixInstance.sbtOffset = instanceMap[inst.name].sbtOffset;
         optixInstance.flags =
@@ -12,6 +12,7 @@
 #include <pbrt/materials.h>
 #include <pbrt/parsedscene.h>
 #include <pbrt/util/containers.h>
+#include <pbrt/util/loopsubdiv.h>
 #include <pbrt/util/pstd.h>
 #include <pbrt/util/soa.h>
 
@@ -32,6 +33,7 @@ class GPUAccel {
     GPUAccel(const ParsedScene &scene, Allocator alloc, CUstream cudaStream,
              const std::map<int, pstd::vector<LightHandle> *> &shapeIndexToAreaLights,
              const std::map<std::string, MediumHandle> &media,
+             const LoopSubdivisionView &subdivisionView,
              pstd::array<bool, MaterialHandle::NumTags()> *haveBasicEvalMaterial,
              pstd::array<bool, MaterialHandle::NumTags()> *haveUniversalEvalMaterial,
              bool *haveSubsurface);
@@ -64,6 +66,7 @@ class GPUAccel {
         const std::map<std::string, MaterialHandle> &namedMaterials,
         const std::vector<MaterialHandle> &materials,
         const std::map<std::string, MediumHandle> &media,
+        const LoopSubdivisionView &subdivisionView,
         const std::map<int, pstd::vector<LightHandle> *> &shapeIndexToAreaLights,
         Bounds3f *gasBounds);
 
@@ -574,11 +574,9 @@ extern "C" __global__ void __intersection__bilinearPatch() {
     Float tMax = optixGetRayTmax();
     Ray ray(Point3f(org.x, org.y, org.z), Vector3f(dir.x, dir.y, dir.z));
 
-    int vertexIndex = 4 * optixGetPrimitiveIndex();
-    Point3f p00 = rec.mesh->p[rec.mesh->vertexIndices[vertexIndex]];
-    Point3f p10 = rec.mesh->p[rec.mesh->vertexIndices[vertexIndex + 1]];
-    Point3f p01 = rec.mesh->p[rec.mesh->vertexIndices[vertexIndex + 2]];
-    Point3f p11 = rec.mesh->p[rec.mesh->vertexIndices[vertexIndex + 3]];
+    pstd::array<int, 4> v = rec.mesh->VertexIndices(optixGetPrimitiveIndex());
+    Point3f p00 = rec.mesh->p[v[0]], p10 = rec.mesh->p[v[1]];
+    Point3f p01 = rec.mesh->p[v[2]], p11 = rec.mesh->p[v[3]];
     pstd::optional<BilinearIntersection> isect =
         BilinearPatch::Intersect(ray, tMax, p00, p10, p01, p11);
 
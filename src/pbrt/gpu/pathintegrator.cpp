@@ -91,6 +91,7 @@ GPUPathIntegrator::GPUPathIntegrator(Allocator alloc, const ParsedScene &scene)
     camera = CameraHandle::Create(scene.camera.name, scene.camera.parameters,
                                   cameraMedium, scene.camera.cameraTransform, film,
                                   &scene.camera.loc, alloc);
+    LoopSubdivisionView subdivisionView = GetLoopSubdivisionView(camera);
 
     pstd::vector<LightHandle> allLights;
 
@@ -127,7 +128,8 @@ GPUPathIntegrator::GPUPathIntegrator(Allocator alloc, const ParsedScene &scene)
 
         pstd::vector<ShapeHandle> shapeHandles = ShapeHandle::Create(
             shape.name, shape.renderFromObject, shape.objectFromRender,
-            shape.reverseOrientation, shape.parameters, &shape.loc, alloc);
+            shape.reverseOrientation, shape.parameters, subdivisionView, &shape.loc,
+            alloc);
 
         if (shapeHandles.empty())
             continue;
@@ -153,8 +155,8 @@ GPUPathIntegrator::GPUPathIntegrator(Allocator alloc, const ParsedScene &scene)
     haveUniversalEvalMaterial.fill(false);
     haveSubsurface = false;
     accel = new GPUAccel(scene, alloc, nullptr /* cuda stream */, shapeIndexToAreaLights,
-                         media, &haveBasicEvalMaterial, &haveUniversalEvalMaterial,
-                         &haveSubsurface);
+                         media, subdivisionView, &haveBasicEvalMaterial,
+                         &haveUniversalEvalMaterial, &haveSubsurface);
 
     // Preprocess the light sources
     for (LightHandle light : allLights)
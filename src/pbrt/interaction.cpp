@@ -117,6 +117,7 @@ RayDifferential SurfaceInteraction::SpawnRay(const RayDifferential &rayi,
                                              const BSDF &bsdf, const Vector3f &wi,
                                              BxDFFlags flags) const {
     RayDifferential rd(SpawnRay(wi));
+    rd.spread = rayi.spread;
     if (rayi.hasDifferentials) {
         // Compute ray differentials for specular reflection or transmission
         // Compute common factors for specular ray differentials
@@ -180,7 +181,11 @@ RayDifferential SurfaceInteraction::SpawnRay(const RayDifferential &rayi,
 }
 
 void SurfaceInteraction::SkipIntersection(RayDifferential *ray, Float t) const {
+    Float spread = ray->spread;
+    uint32_t lodTag = ray->lodTag;
     *((Ray *)ray) = SpawnRay(ray->d);
+    ray->spread = spread;
+    ray->lodTag = lodTag;
     if (ray->hasDifferentials) {
         ray->rxOrigin = ray->rxOrigin + t * ray->rxDirection;
         ray->ryOrigin = ray->ryOrigin + t * ray->ryDirection;
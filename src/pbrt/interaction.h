@@ -100,13 +100,16 @@ class Interaction {
 
     PBRT_CPU_GPU
     RayDifferential SpawnRay(const Vector3f &d) const {
-        return RayDifferential(OffsetRayOrigin(d), d, time, GetMedium(d));
+        RayDifferential r(OffsetRayOrigin(d), d, time, GetMedium(d));
+        r.lodTag = lodTag;
+        return r;
     }
 
     PBRT_CPU_GPU
     Ray SpawnRayTo(const Point3f &p2) const {
         Ray r = pbrt::SpawnRayTo(pi, n, time, p2);
         r.medium = GetMedium(r.d);
+        r.lodTag = lodTag;
         return r;
     }
 
@@ -114,6 +117,7 @@ class Interaction {
     Ray SpawnRayTo(const Interaction &it) const {
         Ray r = pbrt::SpawnRayTo(pi, n, time, it.pi, it.n);
         r.medium = GetMedium(r.d);
+        r.lodTag = lodTag;
         return r;
     }
 
@@ -139,6 +143,9 @@ class Interaction {
     Point2f uv;
     const MediumInterface *mediumInterface = nullptr;
     MediumHandle medium = nullptr;
+    // Set by LODPrimitive so that rays leaving the interaction use the same
+    // level of detail as the intersection did.
+    uint32_t lodTag = 0;
 };
 
 class MediumInteraction : public Interaction {
@@ -20,11 +20,16 @@ std::string PBRTOptions::ToString() const {
         "recordPixelStatistics: %s upgrade: %s disablePixelJitter: %s "
         "disableWavelengthJitter: %s forceDiffuse: %s useGPU: %s "
         "imageFile: %s mseReferenceImage: %s mseReferenceOutput: %s "
-        "debugStart: %s displayServer: %s cropWindow: %s pixelBounds: %s ]",
+        "debugStart: %s displayServer: %s cropWindow: %s pixelBounds: %s "
+        "textureCacheMB: %d geometryCacheMB: %d compressTextures: %s "
+        "compressMeshes: %s autoInstances: %s lazyInstances: %s instanceLOD: %s "
+        "splitCurves: %s memoryBudgetMB: %d memoryReportFile: %s ]",
         nThreads, seed, quickRender, quiet, recordPixelStatistics, upgrade,
         disablePixelJitter, disableWavelengthJitter, forceDiffuse, useGPU, imageFile,
         mseReferenceImage, mseReferenceOutput, debugStart, displayServer, cropWindow,
-        pixelBounds);
+        pixelBounds, textureCacheMB, geometryCacheMB, compressTextures, compressMeshes,
+        autoInstances, lazyInstances, instanceLOD, splitCurves, memoryBudgetMB,
+        memoryReportFile);
 }
 
 }  // namespace pbrt
@@ -42,6 +42,16 @@ struct PBRTOptions : BasicOptions {
     std::string displayServer;
     pstd::optional<Bounds2f> cropWindow;
     pstd::optional<Bounds2i> pixelBounds;
+    int textureCacheMB = 0;
+    int geometryCacheMB = 0;
+    bool compressTextures = false;
+    bool compressMeshes = false;
+    bool autoInstances = false;
+    bool lazyInstances = false;
+    bool instanceLOD = false;
+    bool splitCurves = false;
+    int memoryBudgetMB = 0;
+    std::string memoryReportFile;
 
     std::string ToString() const;
 };
@@ -11,11 +11,15 @@
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/memory.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/spectrum.h>
 
 #include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
 #include <utility>
 
 namespace pbrt {
@@ -36,7 +40,10 @@ struct ParameterTypeTraits<ParameterType::Float> {
     static constexpr char typeName[] = "float";
     static constexpr int nPerItem = 1;
     using ReturnType = Float;
-    static Float Convert(const double *v, const FileLoc *loc) { return *v; }
+    template <typename T>
+    static Float Convert(const T *v, const FileLoc *loc) {
+        return *v;
+    }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
 };
 
@@ -47,21 +54,23 @@ struct ParameterTypeTraits<ParameterType::Integer> {
     static constexpr char typeName[] = "integer";
     static constexpr int nPerItem = 1;
     using ReturnType = int;
-    static int Convert(const double *v, const FileLoc *loc) {
-        if (*v > std::numeric_limits<int>::max())
+    template <typename T>
+    static int Convert(const T *vp, const FileLoc *loc) {
+        double v = *vp;
+        if (v > std::numeric_limits<int>::max())
             Warning(loc,
                     "Numeric value %f too large to represent as an integer. "
                     "Clamping to %d",
-                    *v, std::numeric_limits<int>::max());
-        else if (*v < std::numeric_limits<int>::lowest())
+                    v, std::numeric_limits<int>::max());
+        else if (v < std::numeric_limits<int>::lowest())
             Warning(loc,
                     "Numeric value %f too low to represent as an integer. "
                     "Clamping to %d",
-                    *v, std::numeric_limits<int>::lowest());
-        else if (double(int(*v)) != *v)
-            Warning(loc, "Floating-point value %f will be rounded to an integer", *v);
+                    v, std::numeric_limits<int>::lowest());
+        else if (double(int(v)) != v)
+            Warning(loc, "Floating-point value %f will be rounded to an integer", v);
 
-        return int(Clamp(*v, std::numeric_limits<int>::lowest(),
+        return int(Clamp(v, std::numeric_limits<int>::lowest(),
                          std::numeric_limits<int>::max()));
     }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
@@ -74,7 +83,8 @@ struct ParameterTypeTraits<ParameterType::Point2f> {
     static constexpr char typeName[] = "point2";
     static constexpr int nPerItem = 2;
     using ReturnType = Point2f;
-    static Point2f Convert(const double *v, const FileLoc *loc) {
+    template <typename T>
+    static Point2f Convert(const T *v, const FileLoc *loc) {
         return Point2f(v[0], v[1]);
     }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
@@ -87,7 +97,8 @@ struct ParameterTypeTraits<ParameterType::Vector2f> {
     static constexpr char typeName[] = "vector2";
     static constexpr int nPerItem = 2;
     using ReturnType = Vector2f;
-    static Vector2f Convert(const double *v, const FileLoc *loc) {
+    template <typename T>
+    static Vector2f Convert(const T *v, const FileLoc *loc) {
         return Vector2f(v[0], v[1]);
     }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
@@ -107,7 +118,8 @@ struct ParameterTypeTraits<ParameterType::Point3f> {
 
     static constexpr int nPerItem = 3;
 
-    static Point3f Convert(const double *v, const FileLoc *loc) {
+    template <typename T>
+    static Point3f Convert(const T *v, const FileLoc *loc) {
         return Point3f(v[0], v[1], v[2]);
     }
 };
@@ -119,7 +131,8 @@ struct ParameterTypeTraits<ParameterType::Vector3f> {
     static constexpr char typeName[] = "vector3";
     static constexpr int nPerItem = 3;
     using ReturnType = Vector3f;
-    static Vector3f Convert(const double *v, const FileLoc *loc) {
+    template <typename T>
+    static Vector3f Convert(const T *v, const FileLoc *loc) {
         return Vector3f(v[0], v[1], v[2]);
     }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
@@ -132,7 +145,8 @@ struct ParameterTypeTraits<ParameterType::Normal3f> {
     static constexpr char typeName[] = "normal";
     static constexpr int nPerItem = 3;
     using ReturnType = Normal3f;
-    static Normal3f Convert(const double *v, const FileLoc *loc) {
+    template <typename T>
+    static Normal3f Convert(const T *v, const FileLoc *loc) {
         return Normal3f(v[0], v[1], v[2]);
     }
     static const auto &GetValues(const ParsedParameter &param) { return param.numbers; }
@@ -199,23 +213,36 @@ typename ParameterTypeTraits<PT>::ReturnType ParameterDictionary::lookupSingle(
     const std::string &name,
     typename ParameterTypeTraits<PT>::ReturnType defaultValue) const {
     // Search _params_ for parameter _name_
+    // Dictionaries hold only a handful of parameters, so this is a linear
+    // scan; comparing the names' precomputed hashes first just avoids most
+    // of the string comparisons.
     using traits = ParameterTypeTraits<PT>;
+    static const InternedString typeName(traits::typeName);
+    uint64_t nameHash = InternedString::HashString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name != name || p->type != traits::typeName)
+        if (p->name.Hash() != nameHash || p->type != typeName || p->name != name)
             continue;
-        // Extract parameter values from _p_
-        const auto &values = traits::GetValues(*p);
+        auto convert = [&](const auto &values) {
+            // Issue error if incorrect number of parameter values were provided
+            if (values.empty())
+                ErrorExit(&p->loc, "No values provided for parameter \"%s\".", name);
+            if (values.size() > traits::nPerItem)
+                ErrorExit(&p->loc,
+                          "More than one value provided for parameter \"%s\".", name);
 
-        // Issue error if incorrect number of parameter values were provided
-        if (values.empty())
-            ErrorExit(&p->loc, "No values provided for parameter \"%s\".", name);
-        if (values.size() > traits::nPerItem)
-            ErrorExit(&p->loc, "More than one value provided for parameter \"%s\".",
-                      name);
+            // Return parameter values as _ReturnType_
+            p->lookedUp = true;
+            return traits::Convert(values.data(), &p->loc);
+        };
 
-        // Return parameter values as _ReturnType_
-        p->lookedUp = true;
-        return traits::Convert(values.data(), &p->loc);
+        // Extract parameter values from _p_
+        if constexpr (PT != ParameterType::Boolean && PT != ParameterType::String) {
+            if (!p->floats.empty())
+                return convert(p->floats);
+            if (!p->ints.empty())
+                return convert(p->ints);
+        }
+        return convert(traits::GetValues(*p));
     }
 
     return defaultValue;
@@ -291,6 +318,16 @@ static std::vector<ReturnType> returnArray(const ValuesType &values,
     param.lookedUp = true;
     size_t n = values.size() / nPerItem;
     std::vector<ReturnType> v(n);
+    // Typed arrays from binary scene files that already match the layout of
+    // _ReturnType_ are copied directly.
+    using ValueType = std::decay_t<decltype(values[0])>;
+    if constexpr ((std::is_same_v<ValueType, float> && std::is_same_v<Float, float>) ||
+                  std::is_same_v<ValueType, int>)
+        if (std::is_trivially_copyable_v<ReturnType> &&
+            sizeof(ReturnType) == nPerItem * sizeof(ValueType)) {
+            std::memcpy(v.data(), values.data(), n * sizeof(ReturnType));
+            return v;
+        }
     for (size_t i = 0; i < n; ++i)
         v[i] = convert(&values[nPerItem * i], &param.loc);
     return v;
@@ -302,8 +339,9 @@ std::vector<ReturnType> ParameterDictionary::lookupArray(const std::string &name
                                                          const char *typeName,
                                                          int nPerItem, G getValues,
                                                          C convert) const {
+    uint64_t nameHash = InternedString::HashString(name);
     for (const ParsedParameter *p : params)
-        if (p->name == name && p->type == typeName)
+        if (p->name.Hash() == nameHash && p->type == typeName && p->name == name)
             return returnArray<ReturnType>(getValues(*p), *p, nPerItem, convert);
 
     return {};
@@ -313,8 +351,25 @@ template <ParameterType PT>
 std::vector<typename ParameterTypeTraits<PT>::ReturnType>
 ParameterDictionary::lookupArray(const std::string &name) const {
     using traits = ParameterTypeTraits<PT>;
+    auto convert = [](const auto *v, const FileLoc *loc) {
+        return traits::Convert(v, loc);
+    };
+    if constexpr (PT != ParameterType::Boolean && PT != ParameterType::String) {
+        static const InternedString typeName(traits::typeName);
+        uint64_t nameHash = InternedString::HashString(name);
+        for (const ParsedParameter *p : params)
+            if (p->name.Hash() == nameHash && p->type == typeName && p->name == name) {
+                if (!p->floats.empty())
+                    return returnArray<typename traits::ReturnType>(
+                        p->floats, *p, traits::nPerItem, convert);
+                if (!p->ints.empty())
+                    return returnArray<typename traits::ReturnType>(
+                        p->ints, *p, traits::nPerItem, convert);
+                break;
+            }
+    }
     return lookupArray<typename traits::ReturnType>(
-        name, PT, traits::typeName, traits::nPerItem, traits::GetValues, traits::Convert);
+        name, PT, traits::typeName, traits::nPerItem, traits::GetValues, convert);
 }
 
 std::vector<Float> ParameterDictionary::GetFloatArray(const std::string &name) const {
@@ -353,10 +408,13 @@ std::vector<Normal3f> ParameterDictionary::GetNormal3fArray(
 }
 
 static std::map<std::string, SpectrumHandle> cachedSpectra;
+// Parameters may be looked up concurrently while the scene is being created.
+static std::mutex cachedSpectraMutex;
 
 // TODO: move this functionality (but not the caching?) to a Spectrum method.
 static SpectrumHandle readSpectrumFromFile(const std::string &filename, Allocator alloc) {
     std::string fn = ResolveFilename(filename);
+    std::lock_guard<std::mutex> lock(cachedSpectraMutex);
     if (cachedSpectra.find(fn) != cachedSpectra.end())
         return cachedSpectra[fn];
 
@@ -591,23 +649,20 @@ void ParameterDictionary::RenameUsedTextures(
 
 void ParameterDictionary::ReportUnused() const {
     // type / name
-    InlinedVector<std::pair<const std::string *, const std::string *>, 16> seen;
+    InlinedVector<std::pair<InternedString, InternedString>, 16> seen;
 
     for (const ParsedParameter *p : params) {
         if (p->mayBeUnused)
             continue;
 
-        bool haveSeen =
-            std::find_if(seen.begin(), seen.end(),
-                         [&p](std::pair<const std::string *, const std::string *> p2) {
-                             return *p2.first == p->type && *p2.second == p->name;
-                         }) != seen.end();
+        bool haveSeen = std::find(seen.begin(), seen.end(),
+                                  std::make_pair(p->type, p->name)) != seen.end();
         if (p->lookedUp) {
             // A parameter may be used when creating an initial Material, say,
             // but then an override from a Shape may shadow it such that its
             // name is already in the seen array.
             if (!haveSeen)
-                seen.push_back(std::make_pair(&p->type, &p->name));
+                seen.push_back(std::make_pair(p->type, p->name));
         } else if (haveSeen) {
             // It's shadowed by another parameter; that's fine.
         } else
@@ -615,6 +670,49 @@ void ParameterDictionary::ReportUnused() const {
     }
 }
 
+uint64_t ParameterDictionary::Hash() const {
+    uint64_t hash = pbrt::Hash(colorSpace, params.size());
+    for (const ParsedParameter *p : params) {
+        hash = pbrt::Hash(hash, p->type.Hash(), p->name.Hash());
+        hash = HashBuffer(p->numbers.data(), p->numbers.size() * sizeof(double), hash);
+        hash = HashBuffer(p->floats.data(), p->floats.size() * sizeof(float), hash);
+        hash = HashBuffer(p->ints.data(), p->ints.size() * sizeof(int), hash);
+        hash = HashBuffer(p->bools.data(), p->bools.size(), hash);
+        for (const std::string &str : p->strings)
+            hash = HashBuffer(str.data(), str.size(), hash);
+    }
+    return hash;
+}
+
+bool ParameterDictionary::HasSameValues(const ParameterDictionary &dict) const {
+    if (colorSpace != dict.colorSpace || params.size() != dict.params.size())
+        return false;
+    auto equal = [](const auto &a, const auto &b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    };
+    for (size_t i = 0; i < params.size(); ++i) {
+        const ParsedParameter *a = params[i], *b = dict.params[i];
+        if (a == b)
+            continue;
+        if (a->type != b->type || a->name != b->name || !equal(a->numbers, b->numbers) ||
+            !equal(a->floats, b->floats) || !equal(a->ints, b->ints) ||
+            !equal(a->bools, b->bools) || !equal(a->strings, b->strings))
+            return false;
+    }
+    return true;
+}
+
+size_t ParameterDictionary::ValueBytes() const {
+    size_t bytes = 0;
+    for (const ParsedParameter *p : params) {
+        bytes += p->numbers.size() * sizeof(double) + p->floats.size() * sizeof(float) +
+                 p->ints.size() * sizeof(int) + p->bools.size();
+        for (const std::string &str : p->strings)
+            bytes += str.size();
+    }
+    return bytes;
+}
+
 std::string ParameterDictionary::ToParameterDefinition(const ParsedParameter *p,
                                                        int indentCount) {
     std::string s = StringPrintf("\"%s %s\" [ ", p->type, p->name);
@@ -635,6 +733,10 @@ std::string ParameterDictionary::ToParameterDefinition(const ParsedParameter *p,
             printOne(StringPrintf("%d ", int(v)));
         else
             printOne(StringPrintf("%f ", Float(v)));
+    for (float v : p->floats)
+        printOne(StringPrintf("%f ", v));
+    for (int v : p->ints)
+        printOne(StringPrintf("%d ", v));
     for (const auto &str : p->strings)
         printOne('"' + str + "\" ");
     for (bool b : p->bools)
@@ -115,6 +115,14 @@ class ParameterDictionary {
 
     void ReportUnused() const;
 
+    // Hash() and HasSameValues() consider the names, types, and values of the
+    // parameters, but not where they were defined or whether they were used.
+    uint64_t Hash() const;
+    bool HasSameValues(const ParameterDictionary &dict) const;
+
+    // Returns the number of bytes used to store the parameters' values.
+    size_t ValueBytes() const;
+
   private:
     friend class TextureParameterDictionary;
     // ParameterDictionary Private Methods
@@ -13,6 +13,7 @@
 #include <pbrt/util/color.h>
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/file.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/memory.h>
 #include <pbrt/util/mesh.h>
 #include <pbrt/util/parallel.h>
@@ -20,8 +21,10 @@
 #include <pbrt/util/spectrum.h>
 #include <pbrt/util/transform.h>
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
+#include <unordered_map>
 
 namespace pbrt {
 
@@ -146,11 +149,34 @@ const Transform *TransformCache::Lookup(const Transform &t) {
     return tptr;
 }
 
+const AffineTransform *TransformCache::LookupAffine(const AffineTransform &t) {
+    ++nTransformCacheLookups;
+
+    if (!affineHashTable.empty()) {
+        size_t offset = t.Hash() % affineHashTable.bucket_count();
+        for (auto iter = affineHashTable.begin(offset);
+             iter != affineHashTable.end(offset); ++iter) {
+            if (**iter == t) {
+                ++nTransformCacheHits;
+                return *iter;
+            }
+        }
+    }
+    AffineTransform *tptr = alloc.new_object<AffineTransform>(t);
+    transformCacheBytes += sizeof(AffineTransform);
+    affineHashTable.insert(tptr);
+    return tptr;
+}
+
 TransformCache::~TransformCache() {
     for (const auto &iter : hashTable) {
         Transform *tptr = iter;
         alloc.delete_object(tptr);
     }
+    for (const auto &iter : affineHashTable) {
+        AffineTransform *tptr = iter;
+        alloc.delete_object(tptr);
+    }
 }
 
 STAT_COUNTER("Scene/Object instances created", nObjectInstancesCreated);
@@ -425,14 +451,132 @@ void ParsedScene::ObjectInstance(const std::string &name, FileLoc loc) {
         instances.push_back(
             InstanceSceneEntity(name, loc, animatedRenderFromInstance, nullptr));
     } else {
-        const class Transform *renderFromInstance =
-            transformCache.Lookup(GetCTM(0) * worldFromRender);
+        class Transform renderFromInstanceTransform = GetCTM(0) * worldFromRender;
+        if (!AffineTransform::IsAffine(renderFromInstanceTransform)) {
+            // AffineTransform can't represent projective transformations, so
+            // keep them in full as a static AnimatedTransform
+            instances.push_back(InstanceSceneEntity(
+                name, loc, AnimatedTransform(renderFromInstanceTransform), nullptr));
+            return;
+        }
+        const AffineTransform *renderFromInstance =
+            transformCache.LookupAffine(AffineTransform(renderFromInstanceTransform));
 
         instances.push_back(
             InstanceSceneEntity(name, loc, AnimatedTransform(), renderFromInstance));
     }
 }
 
+STAT_COUNTER("Scene/Automatic instance definitions", nAutomaticInstanceDefinitions);
+STAT_COUNTER("Scene/Shapes converted to automatic instances", nAutomaticInstances);
+
+void ParsedScene::CreateAutomaticInstances() {
+    // Returns whether the shape can be moved into an instance definition
+    // without changing how it is rendered
+    auto canInstance = [](const ShapeSceneEntity &sh) {
+        return (sh.name == "trianglemesh" || sh.name == "plymesh") &&
+               sh.lightIndex == -1 && !sh.renderFromObject->SwapsHandedness() &&
+               AffineTransform::IsAffine(*sh.renderFromObject);
+    };
+
+    // Group the shapes that have the same parameters and graphics state
+    struct ShapeHash {
+        size_t operator()(const ShapeSceneEntity *sh) const {
+            return Hash(sh->parameters.Hash(), sh->reverseOrientation,
+                        sh->materialIndex, HashBuffer(sh->materialName.data(),
+                                                      sh->materialName.size()));
+        }
+    };
+    struct ShapeEqual {
+        bool operator()(const ShapeSceneEntity *a, const ShapeSceneEntity *b) const {
+            return a->name == b->name && a->reverseOrientation == b->reverseOrientation &&
+                   a->materialIndex == b->materialIndex &&
+                   a->materialName == b->materialName &&
+                   a->insideMedium == b->insideMedium &&
+                   a->outsideMedium == b->outsideMedium &&
+                   a->parameters.HasSameValues(b->parameters);
+        }
+    };
+    std::unordered_map<const ShapeSceneEntity *, int, ShapeHash, ShapeEqual> groupIndex;
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        if (!canInstance(shapes[i]))
+            continue;
+        auto iter = groupIndex.find(&shapes[i]);
+        if (iter != groupIndex.end())
+            groups[iter->second].push_back(i);
+        else {
+            groupIndex[&shapes[i]] = groups.size();
+            groups.push_back({i});
+        }
+    }
+
+    // Create an instance definition with an untransformed copy of each
+    // group's shape and an instance of it for each shape in the group
+    const class Transform *identity = transformCache.Lookup(pbrt::Transform());
+    std::vector<bool> instanced(shapes.size(), false);
+    int nDefinitions = 0, nInstances = 0;
+    for (const std::vector<size_t> &group : groups) {
+        if (group.size() < 2)
+            continue;
+        std::string name;
+        do {
+            name = StringPrintf("__automatic_instance_%d", nDefinitions++);
+        } while (instanceDefinitions.find(name) != instanceDefinitions.end());
+
+        ShapeSceneEntity sh = shapes[group[0]];
+        sh.renderFromObject = sh.objectFromRender = identity;
+        InstanceDefinitionSceneEntity &def = instanceDefinitions[name];
+        def = InstanceDefinitionSceneEntity(name, sh.loc);
+        def.shapes.push_back(std::move(sh));
+
+        for (size_t i : group) {
+            const AffineTransform *renderFromInstance =
+                transformCache.LookupAffine(AffineTransform(*shapes[i].renderFromObject));
+            instances.push_back(InstanceSceneEntity(
+                name, shapes[i].loc, AnimatedTransform(), renderFromInstance));
+            instanced[i] = true;
+            ++nInstances;
+        }
+        ++nAutomaticInstanceDefinitions;
+    }
+    nAutomaticInstances += nInstances;
+
+    size_t n = 0;
+    for (size_t i = 0; i < shapes.size(); ++i)
+        if (!instanced[i])
+            shapes[n++] = std::move(shapes[i]);
+    shapes.erase(shapes.begin() + n, shapes.end());
+    if (nInstances > 0)
+        LOG_VERBOSE("Replaced %d shapes with instances of automatic object definitions",
+                    nInstances);
+}
+
+GeometryEstimate ParsedScene::EstimateGeometryBytes() const {
+    GeometryEstimate estimate;
+    auto addShape = [&estimate](const SceneEntity &sh) {
+        if (sh.name != "plymesh") {
+            estimate.parameterBytes += sh.parameters.ValueBytes();
+            return;
+        }
+        std::string filename =
+            ResolveFilename(sh.parameters.GetOneString("filename", ""));
+        estimate.plyFileBytes += TriQuadMesh::EstimatePLYBytes(filename);
+    };
+
+    for (const ShapeSceneEntity &sh : shapes)
+        addShape(sh);
+    for (const AnimatedShapeSceneEntity &sh : animatedShapes)
+        addShape(sh);
+    for (const auto &def : instanceDefinitions) {
+        for (const ShapeSceneEntity &sh : def.second.shapes)
+            addShape(sh);
+        for (const AnimatedShapeSceneEntity &sh : def.second.animatedShapes)
+            addShape(sh);
+    }
+    return estimate;
+}
+
 void ParsedScene::EndOfFiles() {
     if (currentApiState != APIState::WorldBlock)
         ErrorExitDeferred("End of files before \"WorldBegin\".");
@@ -456,6 +600,130 @@ ParsedScene::~ParsedScene() {
     delete graphicsState;
 }
 
+ParsedScene *ParsedScene::CopyForImport(FileLoc loc) const {
+    if (currentApiState != APIState::WorldBlock)
+        ErrorExit(&loc, "Import is only allowed inside the world block.");
+    if (currentInstance != nullptr)
+        ErrorExit(&loc, "Import is not allowed inside an object instance definition.");
+
+    ParsedScene *importScene = new ParsedScene;
+    importScene->currentApiState = currentApiState;
+    importScene->curTransform = curTransform;
+    importScene->activeTransformBits = activeTransformBits;
+    importScene->namedCoordinateSystems = namedCoordinateSystems;
+    importScene->transformStartTime = transformStartTime;
+    importScene->transformEndTime = transformEndTime;
+    importScene->renderFromWorld = renderFromWorld;
+    *importScene->graphicsState = *graphicsState;
+    // Copy the materials so that the current material index remains valid.
+    importScene->materials = materials;
+    importScene->nInheritedMaterials = materials.size();
+    return importScene;
+}
+
+void ParsedScene::MergeImported(ParsedScene *importScene) {
+    errorExit |= importScene->errorExit;
+
+    // Imported files don't go through EndOfFiles(), so check here for
+    // blocks that they left open. The shapes of an unfinished object
+    // instance definition are dropped rather than merged.
+    for (const auto &open : importScene->pushStack) {
+        const char *block = (open.first == 'a')   ? "AttributeBegin"
+                            : (open.first == 't') ? "TransformBegin"
+                                                  : "ObjectBegin";
+        ErrorExitDeferred(&open.second, "Missing end to %s in imported file", block);
+    }
+    if (importScene->currentInstance != nullptr) {
+        std::string name = importScene->currentInstance->name;
+        importScene->currentInstance = nullptr;
+        importScene->instanceDefinitions.erase(name);
+    }
+
+    // Material indices that refer to materials defined in the imported file
+    // are offset by the number of materials added to this scene since the
+    // import started. Transforms are looked up again in this scene's cache,
+    // since the imported scene's cache is freed along with it.
+    size_t nInherited = importScene->nInheritedMaterials;
+    int materialOffset = int(materials.size()) - int(nInherited);
+    int areaLightOffset = areaLights.size();
+    auto remapShape = [&](auto &shape) {
+        if (shape.materialIndex >= int(nInherited))
+            shape.materialIndex += materialOffset;
+        if (shape.lightIndex != -1)
+            shape.lightIndex += areaLightOffset;
+    };
+    auto mergeShapes = [&](std::vector<ShapeSceneEntity> &from,
+                           std::vector<ShapeSceneEntity> *to) {
+        for (ShapeSceneEntity &shape : from) {
+            remapShape(shape);
+            shape.renderFromObject = transformCache.Lookup(*shape.renderFromObject);
+            shape.objectFromRender = transformCache.Lookup(*shape.objectFromRender);
+            to->push_back(std::move(shape));
+        }
+    };
+    auto mergeAnimatedShapes = [&](std::vector<AnimatedShapeSceneEntity> &from,
+                                   std::vector<AnimatedShapeSceneEntity> *to) {
+        for (AnimatedShapeSceneEntity &shape : from) {
+            remapShape(shape);
+            shape.identity = transformCache.Lookup(*shape.identity);
+            to->push_back(std::move(shape));
+        }
+    };
+
+    for (size_t i = nInherited; i < importScene->materials.size(); ++i)
+        materials.push_back(std::move(importScene->materials[i]));
+    for (SceneEntity &areaLight : importScene->areaLights)
+        areaLights.push_back(std::move(areaLight));
+    mergeShapes(importScene->shapes, &shapes);
+    mergeAnimatedShapes(importScene->animatedShapes, &animatedShapes);
+
+    for (InstanceSceneEntity &instance : importScene->instances) {
+        if (instance.renderFromInstance != nullptr)
+            instance.renderFromInstance =
+                transformCache.LookupAffine(*instance.renderFromInstance);
+        instances.push_back(std::move(instance));
+    }
+    for (auto &def : importScene->instanceDefinitions) {
+        if (instanceDefinitions.find(def.first) != instanceDefinitions.end()) {
+            ErrorExitDeferred(&def.second.loc,
+                              "%s: trying to redefine an object instance", def.first);
+            continue;
+        }
+        InstanceDefinitionSceneEntity &newDef = instanceDefinitions[def.first];
+        newDef = InstanceDefinitionSceneEntity(def.second.name, def.second.loc);
+        mergeShapes(def.second.shapes, &newDef.shapes);
+        mergeAnimatedShapes(def.second.animatedShapes, &newDef.animatedShapes);
+    }
+
+    for (LightSceneEntity &light : importScene->lights)
+        lights.push_back(std::move(light));
+
+    for (auto &medium : importScene->media) {
+        if (media.find(medium.first) != media.end())
+            ErrorExitDeferred(&medium.second.loc, "Named medium \"%s\" redefined.",
+                              medium.first);
+        else
+            media[medium.first] = std::move(medium.second);
+    }
+
+    auto mergeNamed = [&](auto &from, auto *to, const char *errorFormat) {
+        for (auto &entity : from) {
+            // Note: O(n^2), like the checks in Texture() and MakeNamedMaterial().
+            if (std::find_if(to->begin(), to->end(), [&](const auto &e) {
+                    return e.first == entity.first;
+                }) != to->end())
+                ErrorExitDeferred(&entity.second.loc, errorFormat, entity.first);
+            else
+                to->push_back(std::move(entity));
+        }
+    };
+    mergeNamed(importScene->floatTextures, &floatTextures, "Redefining texture \"%s\".");
+    mergeNamed(importScene->spectrumTextures, &spectrumTextures,
+               "Redefining texture \"%s\".");
+    mergeNamed(importScene->namedMaterials, &namedMaterials,
+               "%s: named material redefined.");
+}
+
 void ParsedScene::Option(const std::string &name, const std::string &value, FileLoc loc) {
     std::string nName = normalizeArg(name);
 
@@ -1783,4 +2051,310 @@ void FormattingScene::ObjectInstance(const std::string &name, FileLoc loc) {
 
 void FormattingScene::EndOfFiles() {}
 
+// BinarySceneWriter Method Definitions
+BinarySceneWriter::BinarySceneWriter(FILE *file) : file(file) {
+    writeBytes(BinarySceneMagic, sizeof(BinarySceneMagic));
+    writeValue(BinarySceneVersion);
+}
+
+BinarySceneWriter::~BinarySceneWriter() {
+    if (fflush(file) != 0)
+        ErrorExit("Error writing binary scene: %s", ErrorString());
+    if (errorExit)
+        ErrorExit("Fatal errors during scene updating.");
+}
+
+void BinarySceneWriter::writeBytes(const void *ptr, size_t size, size_t alignment) {
+    static const uint8_t zeros[8] = {};
+    size_t padding = (alignment - offset % alignment) % alignment;
+    CHECK_LE(padding, sizeof(zeros));
+    if (fwrite(zeros, 1, padding, file) != padding || fwrite(ptr, 1, size, file) != size)
+        ErrorExit("Error writing binary scene: %s", ErrorString());
+    offset += padding + size;
+}
+
+void BinarySceneWriter::writeString(const std::string &str) {
+    writeValue<uint32_t>(str.size());
+    writeBytes(str.data(), str.size());
+}
+
+void BinarySceneWriter::writeFloats(const Float *v, int n) {
+    for (int i = 0; i < n; ++i)
+        writeValue<double>(v[i]);
+}
+
+void BinarySceneWriter::writeOp(BinarySceneOp op, const FileLoc &loc) {
+    if (loc.filename != currentFilename) {
+        currentFilename = std::string(loc.filename);
+        writeValue(BinarySceneOp::SetFile);
+        writeValue<uint32_t>(loc.line);
+        writeValue<uint32_t>(loc.column);
+        writeString(currentFilename);
+    }
+    writeValue(op);
+    writeValue<uint32_t>(loc.line);
+    writeValue<uint32_t>(loc.column);
+}
+
+void BinarySceneWriter::writeParameters(const ParsedParameterVector &params) {
+    writeValue<uint32_t>(params.size());
+    for (const ParsedParameter *p : params) {
+        writeString(p->type);
+        writeString(p->name);
+        writeValue<uint32_t>(p->loc.line);
+        writeValue<uint32_t>(p->loc.column);
+
+        auto writeArray = [&](ParameterStorage storage, const auto *v, size_t n) {
+            writeValue(storage);
+            writeValue<uint64_t>(n);
+            writeBytes(v, n * sizeof(*v), sizeof(*v) < 8 ? sizeof(*v) : 1);
+        };
+        if (!p->floats.empty())
+            writeArray(ParameterStorage::Floats, p->floats.data(),
+                       p->floats.size());
+        else if (!p->ints.empty())
+            writeArray(ParameterStorage::Ints, p->ints.data(), p->ints.size());
+        else if (!p->strings.empty()) {
+            writeValue(ParameterStorage::Strings);
+            writeValue<uint64_t>(p->strings.size());
+            for (const std::string &str : p->strings)
+                writeString(str);
+        } else if (!p->bools.empty())
+            writeArray(ParameterStorage::Bools, p->bools.data(), p->bools.size());
+        else {
+            // Parameters that were modified after parsing may still have
+            // values in _numbers_ that can be stored more compactly.
+            size_t n = p->numbers.size();
+            switch (NumericParameterStorage(p->type, p->numbers)) {
+            case ParameterStorage::Ints: {
+                std::vector<int> ints(p->numbers.begin(), p->numbers.end());
+                writeArray(ParameterStorage::Ints, ints.data(), n);
+                break;
+            }
+            case ParameterStorage::Floats: {
+                std::vector<float> floats(p->numbers.begin(), p->numbers.end());
+                writeArray(ParameterStorage::Floats, floats.data(), n);
+                break;
+            }
+            default:
+                writeArray(ParameterStorage::Doubles, p->numbers.data(), n);
+            }
+        }
+    }
+}
+
+void BinarySceneWriter::writeNamedParameters(BinarySceneOp op, const std::string &name,
+                                             const ParsedParameterVector &params,
+                                             const FileLoc &loc) {
+    writeOp(op, loc);
+    writeString(name);
+    writeParameters(params);
+}
+
+void BinarySceneWriter::Option(const std::string &name, const std::string &value,
+                               FileLoc loc) {
+    writeOp(BinarySceneOp::Option, loc);
+    writeString(name);
+    writeString(value);
+}
+
+void BinarySceneWriter::Identity(FileLoc loc) {
+    writeOp(BinarySceneOp::Identity, loc);
+}
+
+void BinarySceneWriter::Translate(Float dx, Float dy, Float dz, FileLoc loc) {
+    writeOp(BinarySceneOp::Translate, loc);
+    Float v[3] = {dx, dy, dz};
+    writeFloats(v, 3);
+}
+
+void BinarySceneWriter::Rotate(Float angle, Float ax, Float ay, Float az, FileLoc loc) {
+    writeOp(BinarySceneOp::Rotate, loc);
+    Float v[4] = {angle, ax, ay, az};
+    writeFloats(v, 4);
+}
+
+void BinarySceneWriter::Scale(Float sx, Float sy, Float sz, FileLoc loc) {
+    writeOp(BinarySceneOp::Scale, loc);
+    Float v[3] = {sx, sy, sz};
+    writeFloats(v, 3);
+}
+
+void BinarySceneWriter::LookAt(Float ex, Float ey, Float ez, Float lx, Float ly,
+                               Float lz, Float ux, Float uy, Float uz, FileLoc loc) {
+    writeOp(BinarySceneOp::LookAt, loc);
+    Float v[9] = {ex, ey, ez, lx, ly, lz, ux, uy, uz};
+    writeFloats(v, 9);
+}
+
+void BinarySceneWriter::ConcatTransform(Float transform[16], FileLoc loc) {
+    writeOp(BinarySceneOp::ConcatTransform, loc);
+    writeFloats(transform, 16);
+}
+
+void BinarySceneWriter::Transform(Float transform[16], FileLoc loc) {
+    writeOp(BinarySceneOp::Transform, loc);
+    writeFloats(transform, 16);
+}
+
+void BinarySceneWriter::CoordinateSystem(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::CoordinateSystem, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::CoordSysTransform(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::CoordSysTransform, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::ActiveTransformAll(FileLoc loc) {
+    writeOp(BinarySceneOp::ActiveTransformAll, loc);
+}
+
+void BinarySceneWriter::ActiveTransformEndTime(FileLoc loc) {
+    writeOp(BinarySceneOp::ActiveTransformEndTime, loc);
+}
+
+void BinarySceneWriter::ActiveTransformStartTime(FileLoc loc) {
+    writeOp(BinarySceneOp::ActiveTransformStartTime, loc);
+}
+
+void BinarySceneWriter::TransformTimes(Float start, Float end, FileLoc loc) {
+    writeOp(BinarySceneOp::TransformTimes, loc);
+    Float v[2] = {start, end};
+    writeFloats(v, 2);
+}
+
+void BinarySceneWriter::ColorSpace(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::ColorSpace, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::PixelFilter(const std::string &name,
+                                    ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::PixelFilter, name, params, loc);
+}
+
+void BinarySceneWriter::Film(const std::string &type, ParsedParameterVector params,
+                             FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Film, type, params, loc);
+}
+
+void BinarySceneWriter::Sampler(const std::string &name, ParsedParameterVector params,
+                                FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Sampler, name, params, loc);
+}
+
+void BinarySceneWriter::Accelerator(const std::string &name,
+                                    ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Accelerator, name, params, loc);
+}
+
+void BinarySceneWriter::Integrator(const std::string &name, ParsedParameterVector params,
+                                   FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Integrator, name, params, loc);
+}
+
+void BinarySceneWriter::Camera(const std::string &name, ParsedParameterVector params,
+                               FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Camera, name, params, loc);
+}
+
+void BinarySceneWriter::MakeNamedMedium(const std::string &name,
+                                        ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::MakeNamedMedium, name, params, loc);
+}
+
+void BinarySceneWriter::MediumInterface(const std::string &insideName,
+                                        const std::string &outsideName, FileLoc loc) {
+    writeOp(BinarySceneOp::MediumInterface, loc);
+    writeString(insideName);
+    writeString(outsideName);
+}
+
+void BinarySceneWriter::WorldBegin(FileLoc loc) {
+    writeOp(BinarySceneOp::WorldBegin, loc);
+}
+
+void BinarySceneWriter::AttributeBegin(FileLoc loc) {
+    writeOp(BinarySceneOp::AttributeBegin, loc);
+}
+
+void BinarySceneWriter::AttributeEnd(FileLoc loc) {
+    writeOp(BinarySceneOp::AttributeEnd, loc);
+}
+
+void BinarySceneWriter::Attribute(const std::string &target,
+                                  ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Attribute, target, params, loc);
+}
+
+void BinarySceneWriter::TransformBegin(FileLoc loc) {
+    writeOp(BinarySceneOp::TransformBegin, loc);
+}
+
+void BinarySceneWriter::TransformEnd(FileLoc loc) {
+    writeOp(BinarySceneOp::TransformEnd, loc);
+}
+
+void BinarySceneWriter::Texture(const std::string &name, const std::string &type,
+                                const std::string &texname, ParsedParameterVector params,
+                                FileLoc loc) {
+    writeOp(BinarySceneOp::Texture, loc);
+    writeString(name);
+    writeString(type);
+    writeString(texname);
+    writeParameters(params);
+}
+
+void BinarySceneWriter::Material(const std::string &name, ParsedParameterVector params,
+                                 FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Material, name, params, loc);
+}
+
+void BinarySceneWriter::MakeNamedMaterial(const std::string &name,
+                                          ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::MakeNamedMaterial, name, params, loc);
+}
+
+void BinarySceneWriter::NamedMaterial(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::NamedMaterial, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::LightSource(const std::string &name,
+                                    ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::LightSource, name, params, loc);
+}
+
+void BinarySceneWriter::AreaLightSource(const std::string &name,
+                                        ParsedParameterVector params, FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::AreaLightSource, name, params, loc);
+}
+
+void BinarySceneWriter::Shape(const std::string &name, ParsedParameterVector params,
+                              FileLoc loc) {
+    writeNamedParameters(BinarySceneOp::Shape, name, params, loc);
+}
+
+void BinarySceneWriter::ReverseOrientation(FileLoc loc) {
+    writeOp(BinarySceneOp::ReverseOrientation, loc);
+}
+
+void BinarySceneWriter::ObjectBegin(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::ObjectBegin, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::ObjectEnd(FileLoc loc) {
+    writeOp(BinarySceneOp::ObjectEnd, loc);
+}
+
+void BinarySceneWriter::ObjectInstance(const std::string &name, FileLoc loc) {
+    writeOp(BinarySceneOp::ObjectInstance, loc);
+    writeString(name);
+}
+
+void BinarySceneWriter::EndOfFiles() {}
+
 }  // namespace pbrt
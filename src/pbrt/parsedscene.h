@@ -198,7 +198,7 @@ struct InstanceSceneEntity : public SceneEntity {
     InstanceSceneEntity() = default;
     InstanceSceneEntity(const std::string &name, FileLoc loc,
                         const AnimatedTransform &renderFromInstanceAnim,
-                        const Transform *renderFromInstance)
+                        const AffineTransform *renderFromInstance)
         : SceneEntity(name, {}, loc),
           renderFromInstanceAnim(renderFromInstanceAnim),
           renderFromInstance(renderFromInstance) {}
@@ -211,13 +211,16 @@ struct InstanceSceneEntity : public SceneEntity {
             renderFromInstance ? renderFromInstance->ToString() : std::string("nullptr"));
     }
 
+    // _renderFromInstanceAnim_ is used if _renderFromInstance_ is nullptr,
+    // which is the case for animated and projective transformations.
     AnimatedTransform renderFromInstanceAnim;
-    const Transform *renderFromInstance;
+    const AffineTransform *renderFromInstance;
 };
 
 // TransformHash Definition
 struct TransformHash {
     size_t operator()(const Transform *t) const { return t->Hash(); }
+    size_t operator()(const AffineTransform *t) const { return t->Hash(); }
 };
 
 // TransformCache Definition
@@ -230,12 +233,16 @@ class TransformCache {
     ~TransformCache();
 
     const Transform *Lookup(const Transform &t);
+    // Object instances' transformations are stored in the more compact
+    // _AffineTransform_ representation.
+    const AffineTransform *LookupAffine(const AffineTransform &t);
 
   private:
     // TransformCache Private Data
     pstd::pmr::monotonic_buffer_resource bufferResource;
     Allocator alloc;
     std::unordered_set<Transform *, TransformHash> hashTable;
+    std::unordered_set<AffineTransform *, TransformHash> affineHashTable;
 };
 
 // MaxTransforms Definition
@@ -271,6 +278,15 @@ struct TransformSet {
     Transform t[MaxTransforms];
 };
 
+// GeometryEstimate Definition
+struct GeometryEstimate {
+    int64_t TotalBytes() const { return parameterBytes + plyFileBytes; }
+
+    // Sizes of the shapes' parameter values and of the meshes in the PLY
+    // files they load
+    int64_t parameterBytes = 0, plyFileBytes = 0;
+};
+
 // ParsedScene Definition
 class ParsedScene : public SceneRepresentation {
   public:
@@ -327,6 +343,22 @@ class ParsedScene : public SceneRepresentation {
 
     void EndOfFiles();
 
+    // Replaces groups of non-emissive triangle meshes that are identical in
+    // object space and differ only in their transformation with instances of
+    // a single object definition.
+    void CreateAutomaticInstances();
+
+    // Returns a rough estimate of how much memory the scene's shapes will use
+    // once they are created, based on the sizes of their parameter arrays and
+    // PLY files.
+    GeometryEstimate EstimateGeometryBytes() const;
+
+    // Returns a new ParsedScene for a file given to the Import directive. It
+    // starts with a copy of this scene's current transformation and graphics
+    // state and is later merged back using MergeImported().
+    ParsedScene *CopyForImport(FileLoc loc) const;
+    void MergeImported(ParsedScene *importScene);
+
     std::string ToString() const;
 
     void CreateTextures(std::map<std::string, FloatTextureHandle> *floatTextureMap,
@@ -388,6 +420,9 @@ class ParsedScene : public SceneRepresentation {
     std::vector<std::pair<char, FileLoc>>
         pushStack;  // 'a': attribute, 't': transform, 'o': object
     InstanceDefinitionSceneEntity *currentInstance = nullptr;
+    // For imported scenes, the number of entries in _materials_ that were
+    // copied from the importing scene.
+    size_t nInheritedMaterials = 0;
 };
 
 class FormattingScene : public SceneRepresentation {
@@ -462,6 +497,79 @@ class FormattingScene : public SceneRepresentation {
     std::map<std::string, std::string> definedObjectInstances;
 };
 
+// BinarySceneWriter Definition
+class BinarySceneWriter : public SceneRepresentation {
+  public:
+    BinarySceneWriter(FILE *file);
+    ~BinarySceneWriter();
+
+    void Option(const std::string &name, const std::string &value, FileLoc loc);
+    void Identity(FileLoc loc);
+    void Translate(Float dx, Float dy, Float dz, FileLoc loc);
+    void Rotate(Float angle, Float ax, Float ay, Float az, FileLoc loc);
+    void Scale(Float sx, Float sy, Float sz, FileLoc loc);
+    void LookAt(Float ex, Float ey, Float ez, Float lx, Float ly, Float lz, Float ux,
+                Float uy, Float uz, FileLoc loc);
+    void ConcatTransform(Float transform[16], FileLoc loc);
+    void Transform(Float transform[16], FileLoc loc);
+    void CoordinateSystem(const std::string &, FileLoc loc);
+    void CoordSysTransform(const std::string &, FileLoc loc);
+    void ActiveTransformAll(FileLoc loc);
+    void ActiveTransformEndTime(FileLoc loc);
+    void ActiveTransformStartTime(FileLoc loc);
+    void TransformTimes(Float start, Float end, FileLoc loc);
+    void ColorSpace(const std::string &n, FileLoc loc);
+    void PixelFilter(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void Film(const std::string &type, ParsedParameterVector params, FileLoc loc);
+    void Sampler(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void Accelerator(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void Integrator(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void Camera(const std::string &, ParsedParameterVector params, FileLoc loc);
+    void MakeNamedMedium(const std::string &name, ParsedParameterVector params,
+                         FileLoc loc);
+    void MediumInterface(const std::string &insideName, const std::string &outsideName,
+                         FileLoc loc);
+    void WorldBegin(FileLoc loc);
+    void AttributeBegin(FileLoc loc);
+    void AttributeEnd(FileLoc loc);
+    void Attribute(const std::string &target, ParsedParameterVector params, FileLoc loc);
+    void TransformBegin(FileLoc loc);
+    void TransformEnd(FileLoc loc);
+    void Texture(const std::string &name, const std::string &type,
+                 const std::string &texname, ParsedParameterVector params, FileLoc loc);
+    void Material(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void MakeNamedMaterial(const std::string &name, ParsedParameterVector params,
+                           FileLoc loc);
+    void NamedMaterial(const std::string &name, FileLoc loc);
+    void LightSource(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void AreaLightSource(const std::string &name, ParsedParameterVector params,
+                         FileLoc loc);
+    void Shape(const std::string &name, ParsedParameterVector params, FileLoc loc);
+    void ReverseOrientation(FileLoc loc);
+    void ObjectBegin(const std::string &name, FileLoc loc);
+    void ObjectEnd(FileLoc loc);
+    void ObjectInstance(const std::string &name, FileLoc loc);
+
+    void EndOfFiles();
+
+  private:
+    void writeBytes(const void *ptr, size_t size, size_t alignment = 1);
+    template <typename T>
+    void writeValue(T v) {
+        writeBytes(&v, sizeof(T));
+    }
+    void writeString(const std::string &str);
+    void writeFloats(const Float *v, int n);
+    void writeOp(BinarySceneOp op, const FileLoc &loc);
+    void writeParameters(const ParsedParameterVector &params);
+    void writeNamedParameters(BinarySceneOp op, const std::string &name,
+                              const ParsedParameterVector &params, const FileLoc &loc);
+
+    FILE *file;
+    size_t offset = 0;
+    std::string currentFilename;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_PARSEDSCENE_H
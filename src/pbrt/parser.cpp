@@ -11,7 +11,9 @@
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
 #include <pbrt/util/memory.h>
+#include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
+#include <pbrt/util/progressreporter.h>
 #include <pbrt/util/stats.h>
 
 #include <double-conversion/double-conversion.h>
@@ -28,8 +30,10 @@
 #elif defined(PBRT_IS_WINDOWS)
 #include <windows.h>  // Windows file mapping API
 #endif
+#include <algorithm>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -55,9 +59,50 @@ void ParsedParameter::AddBool(bool v) {
     bools.push_back(v);
 }
 
+void ParsedParameter::SetNumbers(pstd::span<const double> values, Allocator alloc) {
+    CHECK(numbers.empty() && floats.empty() && ints.empty() && strings.empty() &&
+          bools.empty());
+    switch (NumericParameterStorage(type, values)) {
+    case ParameterStorage::Floats: {
+        float *f = alloc.allocate_object<float>(values.size());
+        std::copy(values.begin(), values.end(), f);
+        floats = pstd::MakeConstSpan(f, values.size());
+        break;
+    }
+    case ParameterStorage::Ints: {
+        int *i = alloc.allocate_object<int>(values.size());
+        std::copy(values.begin(), values.end(), i);
+        ints = pstd::MakeConstSpan(i, values.size());
+        break;
+    }
+    default:
+        numbers.resize(values.size());
+        std::copy(values.begin(), values.end(), numbers.begin());
+    }
+}
+
+ParameterStorage NumericParameterStorage(const std::string &type,
+                                         pstd::span<const double> values) {
+    bool isInt = type == "integer";
+    // Spectral parameters are always handled as doubles.
+    bool isFloat = type == "float" || type == "point2" || type == "vector2" ||
+                   type == "point3" || type == "vector3" || type == "normal";
+    for (double v : values) {
+        isInt &= (v >= std::numeric_limits<int>::lowest() &&
+                  v <= std::numeric_limits<int>::max() && double(int(v)) == v);
+        // Values of these types are converted to Float when they are looked
+        // up, so 32-bit floats only lose precision if Float is double.
+        if (sizeof(Float) > sizeof(float))
+            isFloat &= double(float(v)) == v;
+    }
+    if (values.empty() || (!isInt && !isFloat))
+        return ParameterStorage::Doubles;
+    return isInt ? ParameterStorage::Ints : ParameterStorage::Floats;
+}
+
 std::string ParsedParameter::ToString() const {
     std::string str;
-    str += std::string("\"") + type + " " + name + std::string("\" [ ");
+    str += std::string("\"") + type.str() + " " + name.str() + std::string("\" [ ");
     if (!numbers.empty())
         for (double d : numbers)
             str += StringPrintf("%f ", d);
@@ -67,6 +112,12 @@ std::string ParsedParameter::ToString() const {
     else if (!bools.empty())
         for (bool b : bools)
             str += b ? "true " : "false ";
+    else if (!floats.empty())
+        for (float f : floats)
+            str += StringPrintf("%f ", f);
+    else if (!ints.empty())
+        for (int i : ints)
+            str += StringPrintf("%d ", i);
     str += "] ";
 
     return str;
@@ -416,7 +467,7 @@ static ParsedParameterVector parseParameters(
 
         // Find end of type declaration
         auto typeEnd = skipToSpace(typeBegin);
-        param->type.assign(typeBegin, typeEnd);
+        param->type = InternedString(std::string_view(&*typeBegin, typeEnd - typeBegin));
 
         if (formatting) {  // close enough: upgrade...
             if (param->type == "point")
@@ -431,7 +482,12 @@ static ParsedParameterVector parseParameters(
                       std::string(decl.begin(), decl.end()));
 
         auto nameEnd = skipToSpace(nameBegin);
-        param->name.assign(nameBegin, nameEnd);
+        param->name = InternedString(std::string_view(&*nameBegin, nameEnd - nameBegin));
+
+        // Numeric values are gathered here and then stored in the
+        // parameter's most compact representation once all are known.
+        thread_local std::vector<double> numbers;
+        numbers.clear();
 
         enum ValType { Unknown, String, Bool, Number } valType = Unknown;
 
@@ -491,7 +547,7 @@ static ParsedParameterVector parseParameters(
                     errorCallback(t, "expected bool");
                 }
 
-                param->AddNumber(parseNumber(t));
+                numbers.push_back(parseNumber(t));
             }
         };
 
@@ -508,6 +564,9 @@ static ParsedParameterVector parseParameters(
             addVal(val);
         }
 
+        if (!numbers.empty())
+            param->SetNumbers(numbers, alloc);
+
         if (formatting && param->type == "bool") {
             for (const auto &b : param->strings) {
                 if (b == "true")
@@ -529,10 +588,19 @@ static ParsedParameterVector parseParameters(
     return parameterVector;
 }
 
+static void parseBinary(SceneRepresentation *scene, const std::string &filename);
+
+// ParsedParameters are handed off to the scene and outlive parsing, so each
+// parse allocates them and their values from its own arena, which is never
+// freed.
+static Allocator parameterAllocator() {
+    return Allocator(
+        new TrackedMemoryResource(new pstd::pmr::monotonic_buffer_resource()));
+}
+
 static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
     bool formatting = dynamic_cast<FormattingScene *>(scene) != nullptr;
-    TrackedMemoryResource memoryResource;
-    Allocator alloc(&memoryResource);
+    Allocator alloc = parameterAllocator();
 
     std::vector<std::unique_ptr<Tokenizer>> fileStack;
     fileStack.push_back(std::move(t));
@@ -605,14 +673,57 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
         ErrorExit(&t.loc, "Unknown directive: %s", toString(t.token));
     };
 
+    // Imported files are parsed into separate ParsedScenes, on other threads
+    // when possible. They are merged into _scene_ in the order in which they
+    // were imported once this file has been parsed, so that the result does
+    // not depend on which finishes first.
+    std::vector<std::pair<ParsedScene *, AsyncJob<bool> *>> imports;
+    auto importFile = [&](const std::string &filename, FileLoc loc) {
+        auto parseFile = [parseError](SceneRepresentation *target,
+                                      const std::string &filename) {
+            if (IsBinarySceneFile(filename))
+                parseBinary(target, filename);
+            else if (std::unique_ptr<Tokenizer> t =
+                         Tokenizer::CreateFromFile(filename, parseError))
+                parse(target, std::move(t));
+        };
+
+        ParsedScene *parsedScene = dynamic_cast<ParsedScene *>(scene);
+        if (!parsedScene) {
+            // Other scene representations receive the imported file's
+            // contents directly, within an attribute block.
+            scene->AttributeBegin(loc);
+            parseFile(scene, filename);
+            scene->AttributeEnd(loc);
+            return;
+        }
+
+        ParsedScene *importScene = parsedScene->CopyForImport(loc);
+        if (RunningThreads() == 1) {
+            parseFile(importScene, filename);
+            imports.push_back(std::make_pair(importScene, nullptr));
+        } else
+            imports.push_back(std::make_pair(importScene, RunAsync([=]() {
+                Timer timer;
+                parseFile(importScene, filename);
+                LOG_VERBOSE("Parsed imported file %s in %.3fs", filename,
+                            timer.ElapsedSeconds());
+                return true;
+            })));
+    };
+
     pstd::optional<Token> tok;
-    CheckCallbackScope _([&tok]() -> std::string {
-        if (!tok.has_value())
-            return "";
-        std::string filename(tok->loc.filename.begin(), tok->loc.filename.end());
-        return StringPrintf("Current parser location %s:%d:%d", filename, tok->loc.line,
-                            tok->loc.column);
-    });
+    // The CheckCallbackScope stack is shared by all threads, so only the main
+    // thread, which never runs concurrently with itself, reports its location.
+    std::unique_ptr<CheckCallbackScope> checkScope;
+    if (ThreadIndex == 0)
+        checkScope = std::make_unique<CheckCallbackScope>([&tok]() -> std::string {
+            if (!tok.has_value())
+                return "";
+            std::string filename(tok->loc.filename.begin(), tok->loc.filename.end());
+            return StringPrintf("Current parser location %s:%d:%d", filename,
+                                tok->loc.line, tok->loc.column);
+        });
 
     while (true) {
         tok = nextToken(TokenOptional);
@@ -688,11 +799,25 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
                            dynamic_cast<FormattingScene *>(scene)->indent(), filename);
                 else {
                     filename = ResolveFilename(filename);
-                    std::unique_ptr<Tokenizer> tinc =
-                        Tokenizer::CreateFromFile(filename, parseError);
-                    if (tinc)
-                        fileStack.push_back(std::move(tinc));
+                    if (IsBinarySceneFile(filename))
+                        // Binary files are processed right away, which is
+                        // equivalent to pushing them on the file stack.
+                        parseBinary(scene, filename);
+                    else {
+                        std::unique_ptr<Tokenizer> tinc =
+                            Tokenizer::CreateFromFile(filename, parseError);
+                        if (tinc)
+                            fileStack.push_back(std::move(tinc));
+                    }
                 }
+            } else if (tok->token == "Import") {
+                Token filenameToken = *nextToken(TokenRequired);
+                std::string filename = toString(dequoteString(filenameToken));
+                if (formatting)
+                    Printf("%sImport \"%s\"\n",
+                           dynamic_cast<FormattingScene *>(scene)->indent(), filename);
+                else
+                    importFile(ResolveFilename(filename), tok->loc);
             } else if (tok->token == "Identity")
                 scene->Identity(tok->loc);
             else
@@ -859,6 +984,308 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
             syntaxError(*tok);
         }
     }
+
+    for (auto &import : imports) {
+        if (AsyncJob<bool> *job = import.second) {
+            job->GetResult();
+            delete job;
+        }
+        dynamic_cast<ParsedScene *>(scene)->MergeImported(import.first);
+        delete import.first;
+    }
+}
+
+// Binary Scene Parsing Definitions
+bool IsBinarySceneFile(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    char magic[sizeof(BinarySceneMagic)];
+    bool isBinary = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                    memcmp(magic, BinarySceneMagic, sizeof(magic)) == 0;
+    fclose(f);
+    return isBinary;
+}
+
+// Returns the contents of the given file. The file is never unmapped (or
+// freed), since the typed parameter arrays refer directly to its contents.
+static pstd::span<const uint8_t> mapBinarySceneFile(const std::string &filename) {
+#ifdef PBRT_HAVE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        ErrorExit("%s: %s", filename, ErrorString());
+    struct stat stat;
+    if (fstat(fd, &stat) != 0)
+        ErrorExit("%s: %s", filename, ErrorString());
+    size_t len = stat.st_size;
+    void *ptr = mmap(nullptr, len, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+        ErrorExit("%s: mmap: %s", filename, ErrorString());
+    if (close(fd) != 0)
+        ErrorExit("%s: %s", filename, ErrorString());
+    return {(const uint8_t *)ptr, len};
+#else
+    std::string *contents = new std::string(ReadFileContents(filename));
+    tokenizerMemory += contents->size();
+    return {(const uint8_t *)contents->data(), contents->size()};
+#endif
+}
+
+static void parseBinary(SceneRepresentation *scene, const std::string &filename) {
+    pstd::span<const uint8_t> contents = mapBinarySceneFile(filename);
+    const uint8_t *start = contents.data(), *pos = start, *end = start + contents.size();
+    Allocator alloc = parameterAllocator();
+
+    // As with the Tokenizer, filenames in FileLocs must stay valid after
+    // parsing, so they are leaked.
+    FileLoc loc(*new std::string(filename));
+    auto read = [&](size_t size, size_t alignment = 1) {
+        pos = start + (pos - start + alignment - 1) / alignment * alignment;
+        if (size > size_t(end - pos))
+            ErrorExit(&loc, "%s: premature end of binary scene file", filename);
+        const uint8_t *ptr = pos;
+        pos += size;
+        return ptr;
+    };
+    auto readValue = [&](auto *v) { std::memcpy(v, read(sizeof(*v)), sizeof(*v)); };
+    auto readUInt = [&]() {
+        uint32_t v;
+        readValue(&v);
+        return v;
+    };
+    auto readString = [&]() {
+        uint32_t length = readUInt();
+        return std::string((const char *)read(length), length);
+    };
+    auto readFloats = [&](Float *v, int n) {
+        for (int i = 0; i < n; ++i) {
+            double d;
+            readValue(&d);
+            v[i] = d;
+        }
+    };
+    auto readParameters = [&]() {
+        ParsedParameterVector params;
+        uint32_t nParams = readUInt();
+        for (uint32_t i = 0; i < nParams; ++i) {
+            ParsedParameter *param = alloc.new_object<ParsedParameter>(alloc, loc);
+            param->type = readString();
+            param->name = readString();
+            param->loc.line = readUInt();
+            param->loc.column = readUInt();
+            uint8_t storage;
+            readValue(&storage);
+            uint64_t count;
+            readValue(&count);
+            switch (ParameterStorage(storage)) {
+            case ParameterStorage::Doubles:
+                param->numbers.resize(count);
+                std::memcpy(param->numbers.data(), read(count * sizeof(double)),
+                            count * sizeof(double));
+                break;
+            case ParameterStorage::Floats:
+                param->floats = pstd::MakeConstSpan(
+                    (const float *)read(count * sizeof(float), alignof(float)), count);
+                break;
+            case ParameterStorage::Ints:
+                param->ints = pstd::MakeConstSpan(
+                    (const int *)read(count * sizeof(int), alignof(int)), count);
+                break;
+            case ParameterStorage::Strings:
+                for (uint64_t j = 0; j < count; ++j)
+                    param->AddString(readString());
+                break;
+            case ParameterStorage::Bools:
+                for (uint64_t j = 0; j < count; ++j)
+                    param->AddBool(*read(1) != 0);
+                break;
+            default:
+                ErrorExit(&loc, "%d: unknown parameter storage in binary scene file",
+                          int(storage));
+            }
+            params.push_back(param);
+        }
+        return params;
+    };
+
+    read(sizeof(BinarySceneMagic));
+    if (uint32_t version = readUInt(); version != BinarySceneVersion)
+        ErrorExit("%s: binary scene file version %d not supported (expected %d)",
+                  filename, version, BinarySceneVersion);
+
+    while (pos < end) {
+        uint8_t op;
+        readValue(&op);
+        loc.line = readUInt();
+        loc.column = readUInt();
+
+        switch (BinarySceneOp(op)) {
+        case BinarySceneOp::SetFile:
+            loc.filename = *new std::string(readString());
+            break;
+        case BinarySceneOp::Option: {
+            std::string name = readString();
+            scene->Option(name, readString(), loc);
+            break;
+        }
+        case BinarySceneOp::Identity:
+            scene->Identity(loc);
+            break;
+        case BinarySceneOp::Translate: {
+            Float v[3];
+            readFloats(v, 3);
+            scene->Translate(v[0], v[1], v[2], loc);
+            break;
+        }
+        case BinarySceneOp::Rotate: {
+            Float v[4];
+            readFloats(v, 4);
+            scene->Rotate(v[0], v[1], v[2], v[3], loc);
+            break;
+        }
+        case BinarySceneOp::Scale: {
+            Float v[3];
+            readFloats(v, 3);
+            scene->Scale(v[0], v[1], v[2], loc);
+            break;
+        }
+        case BinarySceneOp::LookAt: {
+            Float v[9];
+            readFloats(v, 9);
+            scene->LookAt(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], loc);
+            break;
+        }
+        case BinarySceneOp::ConcatTransform: {
+            Float m[16];
+            readFloats(m, 16);
+            scene->ConcatTransform(m, loc);
+            break;
+        }
+        case BinarySceneOp::Transform: {
+            Float m[16];
+            readFloats(m, 16);
+            scene->Transform(m, loc);
+            break;
+        }
+        case BinarySceneOp::CoordinateSystem:
+            scene->CoordinateSystem(readString(), loc);
+            break;
+        case BinarySceneOp::CoordSysTransform:
+            scene->CoordSysTransform(readString(), loc);
+            break;
+        case BinarySceneOp::ActiveTransformAll:
+            scene->ActiveTransformAll(loc);
+            break;
+        case BinarySceneOp::ActiveTransformEndTime:
+            scene->ActiveTransformEndTime(loc);
+            break;
+        case BinarySceneOp::ActiveTransformStartTime:
+            scene->ActiveTransformStartTime(loc);
+            break;
+        case BinarySceneOp::TransformTimes: {
+            Float v[2];
+            readFloats(v, 2);
+            scene->TransformTimes(v[0], v[1], loc);
+            break;
+        }
+        case BinarySceneOp::ColorSpace:
+            scene->ColorSpace(readString(), loc);
+            break;
+        case BinarySceneOp::MediumInterface: {
+            std::string inside = readString();
+            scene->MediumInterface(inside, readString(), loc);
+            break;
+        }
+        case BinarySceneOp::WorldBegin:
+            scene->WorldBegin(loc);
+            break;
+        case BinarySceneOp::AttributeBegin:
+            scene->AttributeBegin(loc);
+            break;
+        case BinarySceneOp::AttributeEnd:
+            scene->AttributeEnd(loc);
+            break;
+        case BinarySceneOp::TransformBegin:
+            scene->TransformBegin(loc);
+            break;
+        case BinarySceneOp::TransformEnd:
+            scene->TransformEnd(loc);
+            break;
+        case BinarySceneOp::Texture: {
+            std::string name = readString();
+            std::string type = readString();
+            std::string texName = readString();
+            scene->Texture(name, type, texName, readParameters(), loc);
+            break;
+        }
+        case BinarySceneOp::NamedMaterial:
+            scene->NamedMaterial(readString(), loc);
+            break;
+        case BinarySceneOp::ReverseOrientation:
+            scene->ReverseOrientation(loc);
+            break;
+        case BinarySceneOp::ObjectBegin:
+            scene->ObjectBegin(readString(), loc);
+            break;
+        case BinarySceneOp::ObjectEnd:
+            scene->ObjectEnd(loc);
+            break;
+        case BinarySceneOp::ObjectInstance:
+            scene->ObjectInstance(readString(), loc);
+            break;
+
+        default: {
+            // All remaining operations take a name and a parameter list.
+            void (SceneRepresentation::*apiFunc)(const std::string &,
+                                                 ParsedParameterVector, FileLoc);
+            switch (BinarySceneOp(op)) {
+            case BinarySceneOp::PixelFilter:
+                apiFunc = &SceneRepresentation::PixelFilter;
+                break;
+            case BinarySceneOp::Film:
+                apiFunc = &SceneRepresentation::Film;
+                break;
+            case BinarySceneOp::Sampler:
+                apiFunc = &SceneRepresentation::Sampler;
+                break;
+            case BinarySceneOp::Accelerator:
+                apiFunc = &SceneRepresentation::Accelerator;
+                break;
+            case BinarySceneOp::Integrator:
+                apiFunc = &SceneRepresentation::Integrator;
+                break;
+            case BinarySceneOp::Camera:
+                apiFunc = &SceneRepresentation::Camera;
+                break;
+            case BinarySceneOp::MakeNamedMedium:
+                apiFunc = &SceneRepresentation::MakeNamedMedium;
+                break;
+            case BinarySceneOp::Attribute:
+                apiFunc = &SceneRepresentation::Attribute;
+                break;
+            case BinarySceneOp::Material:
+                apiFunc = &SceneRepresentation::Material;
+                break;
+            case BinarySceneOp::MakeNamedMaterial:
+                apiFunc = &SceneRepresentation::MakeNamedMaterial;
+                break;
+            case BinarySceneOp::LightSource:
+                apiFunc = &SceneRepresentation::LightSource;
+                break;
+            case BinarySceneOp::AreaLightSource:
+                apiFunc = &SceneRepresentation::AreaLightSource;
+                break;
+            case BinarySceneOp::Shape:
+                apiFunc = &SceneRepresentation::Shape;
+                break;
+            default:
+                ErrorExit(&loc, "%d: unknown operation in binary scene file", int(op));
+            }
+            std::string name = readString();
+            (scene->*apiFunc)(name, readParameters(), loc);
+        }
+        }
+    }
 }
 
 void ParseFiles(SceneRepresentation *scene, pstd::span<const std::string> filenames) {
@@ -875,12 +1302,18 @@ void ParseFiles(SceneRepresentation *scene, pstd::span<const std::string> filena
     } else {
         // Parse scene from input files
         for (const std::string &fn : filenames) {
+            Timer timer;
             if (fn != "-")
                 SetSearchDirectory(fn);
 
-            std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile(fn, tokError);
-            if (t)
-                parse(scene, std::move(t));
+            if (fn != "-" && IsBinarySceneFile(fn))
+                parseBinary(scene, fn);
+            else {
+                std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile(fn, tokError);
+                if (t)
+                    parse(scene, std::move(t));
+            }
+            LOG_VERBOSE("Parsed %s in %.3fs", fn, timer.ElapsedSeconds());
         }
     }
 }
@@ -11,6 +11,7 @@
 #include <pbrt/util/containers.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/pstd.h>
+#include <pbrt/util/string.h>
 
 #include <functional>
 #include <memory>
@@ -29,15 +30,24 @@ class ParsedParameter {
     void AddNumber(double d);
     void AddString(std::string_view str);
     void AddBool(bool v);
+    // Stores _values_ in _floats_ or _ints_ (allocated using _alloc_) if
+    // NumericParameterStorage() allows it and in _numbers_ otherwise.
+    void SetNumbers(pstd::span<const double> values, Allocator alloc);
 
     std::string ToString() const;
 
     // ParsedParameter Public Members
-    std::string type, name;
+    InternedString type, name;
     FileLoc loc;
     pstd::vector<double> numbers;
     pstd::vector<std::string> strings;
     pstd::vector<uint8_t> bools;
+    // Numeric values of float-valued types and integers are stored in one
+    // of these instead of _numbers_ when possible. For binary scene
+    // files, they refer directly to the file's contents, which stay mapped
+    // for the rest of the program's execution.
+    pstd::span<const float> floats;
+    pstd::span<const int> ints;
     mutable bool lookedUp = false;
     mutable const RGBColorSpace *colorSpace = nullptr;
     bool mayBeUnused = false;
@@ -138,6 +148,70 @@ class SceneRepresentation {
 void ParseFiles(SceneRepresentation *scene, pstd::span<const std::string> filenames);
 void ParseString(SceneRepresentation *scene, std::string str);
 
+// Binary Scene Format Definitions
+// Binary scene files start with an 8-byte identifier and a 32-bit version
+// number, followed by one record for each SceneRepresentation call.
+constexpr char BinarySceneMagic[8] = {'p', 'b', 'r', 't', '-', 'b', 'i', 'n'};
+constexpr uint32_t BinarySceneVersion = 1;
+
+enum class BinarySceneOp : uint8_t {
+    SetFile,
+    Option,
+    Identity,
+    Translate,
+    Rotate,
+    Scale,
+    LookAt,
+    ConcatTransform,
+    Transform,
+    CoordinateSystem,
+    CoordSysTransform,
+    ActiveTransformAll,
+    ActiveTransformEndTime,
+    ActiveTransformStartTime,
+    TransformTimes,
+    ColorSpace,
+    PixelFilter,
+    Film,
+    Sampler,
+    Accelerator,
+    Integrator,
+    Camera,
+    MakeNamedMedium,
+    MediumInterface,
+    WorldBegin,
+    AttributeBegin,
+    AttributeEnd,
+    Attribute,
+    TransformBegin,
+    TransformEnd,
+    Texture,
+    Material,
+    MakeNamedMaterial,
+    NamedMaterial,
+    LightSource,
+    AreaLightSource,
+    Shape,
+    ReverseOrientation,
+    ObjectBegin,
+    ObjectEnd,
+    ObjectInstance
+};
+
+// How a parameter's values are stored, both in ParsedParameter and in binary
+// scene files. In the latter, float and integer arrays are aligned to 4
+// bytes so that they can be used in place.
+enum class ParameterStorage : uint8_t { Doubles, Floats, Ints, Strings, Bools };
+
+// Returns the most compact storage for the numeric values of a parameter of
+// the given type that loses nothing once they are converted to its type:
+// integers that fit are stored as ints and the values of float, point,
+// vector, and normal parameters as floats, unless Float is double.
+ParameterStorage NumericParameterStorage(const std::string &type,
+                                         pstd::span<const double> values);
+
+bool IsBinarySceneFile(const std::string &filename);
+
 // Token Definition
 struct Token {
     Token() = default;
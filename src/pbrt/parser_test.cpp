@@ -4,12 +4,18 @@
 
 #include <gtest/gtest.h>
 
+#include <pbrt/paramdict.h>
+#include <pbrt/parsedscene.h>
 #include <pbrt/parser.h>
 #include <pbrt/pbrt.h>
+#include <pbrt/util/mesh.h>
+#include <pbrt/util/print.h>
+#include <pbrt/util/progressreporter.h>
 #include <pbrt/util/pstd.h>
 
 #include <fstream>
 #include <initializer_list>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -144,3 +150,268 @@ Integrator "deep" "float density" [ 2 2.66612 -5e-51]
 
     EXPECT_EQ(0, remove(filename.c_str()));
 }
+
+// Records how the numeric parameters of shapes and lights were stored.
+class StorageRecordingScene : public ParsedScene {
+  public:
+    void Shape(const std::string &name, ParsedParameterVector params, FileLoc loc) {
+        record(params);
+        ParsedScene::Shape(name, std::move(params), loc);
+    }
+    void LightSource(const std::string &name, ParsedParameterVector params, FileLoc loc) {
+        record(params);
+        ParsedScene::LightSource(name, std::move(params), loc);
+    }
+
+    std::map<std::string, ParameterStorage> storage;
+
+  private:
+    void record(const ParsedParameterVector &params) {
+        for (const ParsedParameter *p : params) {
+            if (!p->floats.empty())
+                storage[p->name] = ParameterStorage::Floats;
+            else if (!p->ints.empty())
+                storage[p->name] = ParameterStorage::Ints;
+            else if (!p->numbers.empty())
+                storage[p->name] = ParameterStorage::Doubles;
+        }
+    }
+};
+
+TEST(Parser, BinaryRoundTrip) {
+    std::string fn = inTestDir("binary.pbrb");
+    FILE *f = fopen(fn.c_str(), "wb");
+    ASSERT_TRUE(f != nullptr);
+    {
+        BinarySceneWriter writer(f);
+        ParseString(&writer, R"(
+Camera "perspective" "float fov" 45
+WorldBegin
+Translate 1 2 3
+Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 1 1 0.1 ]
+    "integer indices" [ 0 1 2 ] "string emission" "none" "float scale" 0.3
+LightSource "point" "rgb I" [ .1 .25 .125 ]
+)");
+    }
+    fclose(f);
+    EXPECT_TRUE(IsBinarySceneFile(fn));
+
+    StorageRecordingScene scene;
+    std::vector<std::string> filenames = {fn};
+    ParseFiles(&scene, filenames);
+
+    // Float-valued parameters are stored as floats even if they can't be
+    // represented exactly, while spectral ones keep full precision.
+    if (sizeof(Float) == sizeof(float)) {
+        EXPECT_EQ(ParameterStorage::Floats, scene.storage["P"]);
+        EXPECT_EQ(ParameterStorage::Floats, scene.storage["scale"]);
+    }
+    EXPECT_EQ(ParameterStorage::Ints, scene.storage["indices"]);
+    EXPECT_EQ(ParameterStorage::Doubles, scene.storage["I"]);
+
+    ASSERT_EQ(1, scene.shapes.size());
+    const ParameterDictionary &dict = scene.shapes[0].parameters;
+    std::vector<Point3f> P = dict.GetPoint3fArray("P");
+    ASSERT_EQ(3, P.size());
+    EXPECT_EQ(Point3f(1, 1, 0.1f), P[2]);
+    EXPECT_EQ(std::vector<int>({0, 1, 2}), dict.GetIntArray("indices"));
+    EXPECT_EQ("none", dict.GetOneString("emission", ""));
+    EXPECT_EQ(0.3f, dict.GetOneFloat("scale", 0));
+    EXPECT_EQ(45, scene.camera.parameters.GetOneFloat("fov", 0));
+    ASSERT_EQ(1, scene.lights.size());
+
+    EXPECT_EQ(0, remove(fn.c_str()));
+}
+
+TEST(Parser, Import) {
+    std::string fn = inTestDir("import.pbrt");
+    std::ofstream out(fn);
+    out << R"(
+Material "conductor"
+Translate 0 0 5
+AreaLightSource "diffuse" "rgb L" [ 1 1 1 ]
+Shape "sphere"
+MakeNamedMaterial "gold" "string type" "conductor"
+)";
+    out.close();
+
+    ParsedScene scene;
+    ParseString(&scene, StringPrintf(R"(
+WorldBegin
+Translate 1 0 0
+Material "dielectric"
+Import "%s"
+Shape "sphere"
+Material "coateddiffuse"
+Shape "sphere"
+)",
+                                     fn));
+
+    // The imported file's changes to the graphics state and transformation
+    // don't affect the importing file, and its shapes are added after the
+    // importing file's.
+    ASSERT_EQ(3, scene.shapes.size());
+    const ShapeSceneEntity &s0 = scene.shapes[0], &s2 = scene.shapes[2];
+    EXPECT_EQ("dielectric", scene.materials[s0.materialIndex].name);
+    EXPECT_EQ(Point3f(1, 0, 0), (*s0.renderFromObject)(Point3f(0, 0, 0)));
+    EXPECT_EQ(-1, s0.lightIndex);
+    EXPECT_EQ("coateddiffuse", scene.materials[scene.shapes[1].materialIndex].name);
+
+    EXPECT_EQ("conductor", scene.materials[s2.materialIndex].name);
+    EXPECT_EQ(Point3f(1, 0, 5), (*s2.renderFromObject)(Point3f(0, 0, 0)));
+    ASSERT_EQ(1, scene.areaLights.size());
+    EXPECT_EQ(0, s2.lightIndex);
+    ASSERT_EQ(1, scene.namedMaterials.size());
+    EXPECT_EQ("gold", scene.namedMaterials[0].first);
+
+    EXPECT_EQ(0, remove(fn.c_str()));
+}
+
+TEST(Parser, ImportUnclosedBlocks) {
+    std::string fn = inTestDir("import-unclosed.pbrt");
+    std::ofstream out(fn);
+    out << R"(
+AttributeBegin
+Shape "sphere"
+ObjectBegin "open"
+Shape "sphere"
+)";
+    out.close();
+
+    auto parse = [&](ParsedScene *scene) {
+        ParseString(scene, StringPrintf(R"(
+WorldBegin
+Import "%s"
+Shape "sphere"
+)",
+                                        fn));
+    };
+
+    // The definition that was never closed isn't merged.
+    ParsedScene scene;
+    parse(&scene);
+    EXPECT_EQ(2, scene.shapes.size());
+    EXPECT_TRUE(scene.instanceDefinitions.empty());
+
+    EXPECT_DEATH(
+        {
+            ParsedScene s;
+            parse(&s);
+            s.EndOfFiles();
+        },
+        "Missing end to AttributeBegin in imported file");
+    EXPECT_DEATH(
+        {
+            ParsedScene s;
+            parse(&s);
+            s.EndOfFiles();
+        },
+        "Missing end to ObjectBegin in imported file");
+
+    EXPECT_EQ(0, remove(fn.c_str()));
+}
+
+TEST(Parser, AutomaticInstances) {
+    ParsedScene scene;
+    ParseString(&scene, R"(
+WorldBegin
+Material "diffuse"
+AttributeBegin
+  Translate 1 0 0
+  Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+AttributeEnd
+AttributeBegin
+  Rotate 90 0 0 1
+  Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+AttributeEnd
+# Differs in its vertices
+Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 2 0 ] "integer indices" [ 0 1 2 ]
+# Emissive
+AttributeBegin
+  AreaLightSource "diffuse"
+  Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+AttributeEnd
+# Differs in its material
+Material "conductor"
+Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+)");
+    scene.CreateAutomaticInstances();
+
+    // Only the first two meshes are converted to instances.
+    EXPECT_EQ(3, scene.shapes.size());
+    ASSERT_EQ(1, scene.instanceDefinitions.size());
+    const InstanceDefinitionSceneEntity &def = scene.instanceDefinitions.begin()->second;
+    ASSERT_EQ(1, def.shapes.size());
+    EXPECT_TRUE(def.shapes[0].renderFromObject->IsIdentity());
+
+    ASSERT_EQ(2, scene.instances.size());
+    for (const InstanceSceneEntity &inst : scene.instances)
+        EXPECT_EQ(def.name, inst.name);
+    EXPECT_EQ(Point3f(1, 0, 0), (*scene.instances[0].renderFromInstance)(Point3f(0, 0, 0)));
+    Point3f p = (*scene.instances[1].renderFromInstance)(Point3f(1, 0, 0));
+    EXPECT_LT(Distance(Point3f(0, 1, 0), p), 1e-6f);
+}
+
+TEST(Parser, EstimateGeometryBytes) {
+    ParsedScene scene;
+    ParseString(&scene, R"(
+WorldBegin
+Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+ObjectBegin "tri"
+Shape "trianglemesh" "point3 P" [ 0 0 0 1 0 0 0 1 0 ] "integer indices" [ 0 1 2 ]
+ObjectEnd
+Shape "sphere" "float radius" 2
+)");
+
+    // Each triangle mesh has nine floats and three ints; the sphere has one
+    // float.
+    GeometryEstimate estimate = scene.EstimateGeometryBytes();
+    EXPECT_EQ(int64_t(2 * (9 * sizeof(float) + 3 * sizeof(int)) + sizeof(float)),
+              estimate.parameterBytes);
+    EXPECT_EQ(0, estimate.plyFileBytes);
+    EXPECT_EQ(estimate.parameterBytes, estimate.TotalBytes());
+
+    // PLY meshes are estimated from the element counts in their headers:
+    // here, four vertices with positions and uvs and two triangles.
+    std::vector<Point3f> p = {Point3f(0, 0, 0), Point3f(1, 0, 0), Point3f(1, 1, 0),
+                              Point3f(0, 1, 0)};
+    std::vector<Point2f> uv = {Point2f(0, 0), Point2f(1, 0), Point2f(1, 1),
+                               Point2f(0, 1)};
+    TriangleMesh mesh(Transform(), false, {0, 1, 2, 0, 2, 3}, p, {}, {}, uv, {});
+    ASSERT_TRUE(mesh.WritePLY("estimate.ply"));
+    ParsedScene plyScene;
+    ParseString(&plyScene, R"(
+WorldBegin
+Shape "plymesh" "string filename" "estimate.ply"
+)");
+    estimate = plyScene.EstimateGeometryBytes();
+    EXPECT_EQ(0, estimate.parameterBytes);
+    EXPECT_EQ(int64_t(4 * (sizeof(Point3f) + sizeof(Point2f)) + 2 * 3 * sizeof(int)),
+              estimate.plyFileBytes);
+    EXPECT_EQ(0, remove("estimate.ply"));
+}
+
+TEST(Parser, DISABLED_ParseBenchmark) {
+    std::string str = "WorldBegin\n";
+    for (int i = 0; i < 1000000; ++i)
+        str += StringPrintf("Shape \"sphere\" \"float radius\" %d \"float zmin\" -0.5 "
+                            "\"float zmax\" 0.5 \"rgb reflectance\" [ .5 .5 .5 ]\n",
+                            i % 10 + 1);
+
+    ParsedScene scene;
+    Timer parseTimer;
+    ParseString(&scene, str);
+    double parseSeconds = parseTimer.ElapsedSeconds();
+    ASSERT_EQ(1000000, scene.shapes.size());
+
+    Timer lookupTimer;
+    Float sum = 0;
+    for (const auto &shape : scene.shapes)
+        sum += shape.parameters.GetOneFloat("radius", 1) +
+               shape.parameters.GetOneFloat("zmax", 1) +
+               shape.parameters.GetOneFloat("phimax", 360);
+    double lookupSeconds = lookupTimer.ElapsedSeconds();
+
+    printf("Parse %.3fs, parameter lookups %.3fs (sum %f)\n", parseSeconds,
+           lookupSeconds, sum);
+}
@@ -13,6 +13,8 @@
 #include <pbrt/util/display.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/memory.h>
+#include <pbrt/util/mesh.h>
+#include <pbrt/util/mipmap.h>
 #include <pbrt/util/parallel.h>
 #include <pbrt/util/spectrum.h>
 #include <pbrt/util/stats.h>
@@ -61,6 +63,11 @@ void InitPBRT(const PBRTOptions &opt) {
         BilinearPatch::Init({});
     }
 
+    if (Options->textureCacheMB > 0)
+        TextureTileCache::Init(size_t(Options->textureCacheMB) << 20);
+    if (Options->geometryCacheMB > 0 && !Options->useGPU)
+        GeometryStore::Init(size_t(Options->geometryCacheMB) << 20);
+
     if (!Options->displayServer.empty())
         ConnectToDisplayServer(Options->displayServer);
 }
@@ -99,6 +99,7 @@ class Bounds3;
 using Bounds3f = Bounds3<Float>;
 using Bounds3i = Bounds3<int>;
 
+class AffineTransform;
 class AnimatedTransform;
 class BilinearPatchMesh;
 class Interaction;
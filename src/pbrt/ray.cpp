@@ -9,7 +9,8 @@
 namespace pbrt {
 
 std::string Ray::ToString() const {
-    return StringPrintf("[ o: %s d: %s time: %f, medium: %s ]", o, d, time, medium);
+    return StringPrintf("[ o: %s d: %s time: %f, medium: %s spread: %f lodTag: %d ]", o,
+                        d, time, medium, spread, lodTag);
 }
 
 std::string RayDifferential::ToString() const {
@@ -10,6 +10,7 @@
 #include <pbrt/base/medium.h>
 #include <pbrt/util/vecmath.h>
 
+#include <algorithm>
 #include <string>
 
 namespace pbrt {
@@ -36,6 +37,12 @@ class Ray {
     Point3f o;
     Vector3f d;
     Float time = 0;
+    // Angular width of the ray's footprint, which is used to choose
+    // geometric levels of detail; zero if it is unknown.
+    Float spread = 0;
+    // Level of detail used at the intersection the ray was spawned from;
+    // see LODPrimitive. Zero if there was none.
+    uint32_t lodTag = 0;
     MediumHandle medium = nullptr;
 };
 
@@ -54,6 +61,15 @@ class RayDifferential : public Ray {
     PBRT_CPU_GPU
     explicit RayDifferential(const Ray &ray) : Ray(ray) { hasDifferentials = false; }
 
+    PBRT_CPU_GPU
+    Float DifferentialSpread() const {
+        if (!hasDifferentials)
+            return 0;
+        Vector3f dn = Normalize(d);
+        return std::max(AngleBetween(dn, Normalize(rxDirection)),
+                        AngleBetween(dn, Normalize(ryDirection)));
+    }
+
     void ScaleDifferentials(Float s) {
         rxOrigin = o + (rxOrigin - o) * s;
         ryOrigin = o + (ryOrigin - o) * s;
@@ -21,6 +21,10 @@
 #include <pbrt/util/splines.h>
 #include <pbrt/util/stats.h>
 
+#include <functional>
+#include <mutex>
+#include <utility>
+
 #if defined(PBRT_BUILD_GPU_RENDERER)
 #include <cuda.h>
 #endif
@@ -136,6 +140,8 @@ std::string TriangleIntersection::ToString() const {
 }
 
 pstd::vector<const TriangleMesh *> *Triangle::allMeshes;
+// Meshes may be registered concurrently while the scene is being created.
+static std::mutex allTriangleMeshesMutex;
 #if defined(PBRT_BUILD_GPU_RENDERER)
 PBRT_GPU pstd::vector<const TriangleMesh *> *allTriangleMeshesGPU;
 #endif
@@ -154,9 +160,13 @@ STAT_MEMORY_COUNTER("Memory/Triangles", triangleBytes);
 // Triangle Method Definitions
 pstd::vector<ShapeHandle> Triangle::CreateTriangles(const TriangleMesh *mesh,
                                                     Allocator alloc) {
-    CHECK_LT(allMeshes->size(), 1 << 31);
-    int meshIndex = int(allMeshes->size());
-    allMeshes->push_back(mesh);
+    int meshIndex;
+    {
+        std::lock_guard<std::mutex> lock(allTriangleMeshesMutex);
+        CHECK_LT(allMeshes->size(), 1 << 31);
+        meshIndex = int(allMeshes->size());
+        allMeshes->push_back(mesh);
+    }
 
     pstd::vector<ShapeHandle> tris(mesh->nTriangles, alloc);
     Triangle *t = alloc.allocate_object<Triangle>(mesh->nTriangles);
@@ -171,7 +181,7 @@ pstd::vector<ShapeHandle> Triangle::CreateTriangles(const TriangleMesh *mesh,
 Bounds3f Triangle::Bounds() const {
     // Get triangle vertices in _p0_, _p1_, and _p2_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[3 * triIndex];
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
     const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
     const Point3f &p2 = mesh->p[v[2]];
 
@@ -181,7 +191,7 @@ Bounds3f Triangle::Bounds() const {
 DirectionCone Triangle::NormalBounds() const {
     // Get triangle vertices in _p0_, _p1_, and _p2_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[3 * triIndex];
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
     const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
     const Point3f &p2 = mesh->p[v[2]];
 
@@ -189,10 +199,11 @@ DirectionCone Triangle::NormalBounds() const {
     Normal3f n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
     // Ensure correct orientation of the geometric normal; follow the same
     // approach as was used in Triangle::Intersect().
-    if (mesh->n != nullptr) {
+    if (mesh->HasNormals()) {
         // TODO: um, can this be different at different points on the
         // triangle, and if so, what is the implication for NormalBounds()?
-        Normal3f ns(mesh->n[v[0]] + mesh->n[v[1]] + mesh->n[v[2]]);
+        Normal3f ns(mesh->GetNormal(v[0]) + mesh->GetNormal(v[1]) +
+                    mesh->GetNormal(v[2]));
         n = FaceForward(n, ns);
     } else if (mesh->reverseOrientation ^ mesh->transformSwapsHandedness)
         n *= -1;
@@ -201,28 +212,37 @@ DirectionCone Triangle::NormalBounds() const {
 }
 
 pstd::optional<ShapeIntersection> Triangle::Intersect(const Ray &ray, Float tMax) const {
+    pstd::optional<TriangleIntersection> triIsect = IntersectBarycentric(ray, tMax);
+    if (!triIsect)
+        return {};
+    return CompleteIntersection(*triIsect, ray);
+}
+
+pstd::optional<TriangleIntersection> Triangle::IntersectBarycentric(const Ray &ray,
+                                                                    Float tMax) const {
 #ifndef PBRT_IS_GPU_CODE
     ++nTriTests;
 #endif
     // Get triangle vertices in _p0_, _p1_, and _p2_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[3 * triIndex];
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
     const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
     const Point3f &p2 = mesh->p[v[2]];
 
-    pstd::optional<TriangleIntersection> triIsect = Intersect(ray, tMax, p0, p1, p2);
-    if (!triIsect)
-        return {};
+    return Intersect(ray, tMax, p0, p1, p2);
+}
 
-    Float b0 = triIsect->b0, b1 = triIsect->b1, b2 = triIsect->b2;
+pstd::optional<ShapeIntersection> Triangle::CompleteIntersection(
+    const TriangleIntersection &triIsect, const Ray &ray) const {
+    Float b0 = triIsect.b0, b1 = triIsect.b1, b2 = triIsect.b2;
     pstd::optional<SurfaceInteraction> intr = Triangle::InteractionFromIntersection(
-        mesh, triIndex, {b0, b1, b2}, ray.time, -ray.d);
+        GetMesh(), triIndex, {b0, b1, b2}, ray.time, -ray.d);
     if (!intr)
         return {};
 #ifndef PBRT_IS_GPU_CODE
     ++nTriHits;
 #endif
-    return ShapeIntersection{*intr, triIsect->t};
+    return ShapeIntersection{*intr, triIsect.t};
 }
 
 bool Triangle::IntersectP(const Ray &ray, Float tMax) const {
@@ -231,7 +251,7 @@ bool Triangle::IntersectP(const Ray &ray, Float tMax) const {
 #endif
     // Get triangle vertices in _p0_, _p1_, and _p2_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[3 * triIndex];
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
     const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
     const Point3f &p2 = mesh->p[v[2]];
 
@@ -350,7 +370,7 @@ pstd::optional<TriangleIntersection> Triangle::Intersect(const Ray &ray, Float t
 std::string Triangle::ToString() const {
     // Get triangle vertices in _p0_, _p1_, and _p2_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[3 * triIndex];
+    pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
     const Point3f &p0 = mesh->p[v[0]];
     const Point3f &p1 = mesh->p[v[1]];
     const Point3f &p2 = mesh->p[v[2]];
@@ -494,13 +514,31 @@ pstd::vector<ShapeHandle> CreateCurve(const Transform *renderFromObject,
     CurveCommon *common = alloc.new_object<CurveCommon>(
         c, w0, w1, type, norm, renderFromObject, objectFromRender, reverseOrientation);
 
-    const int nSegments = 1 << splitDepth;
+    // Find parametric ranges of the curve's segments
+    std::vector<std::pair<Float, Float>> uRanges;
+    std::function<void(Float, Float, int)> split = [&](Float u0, Float u1, int depth) {
+        Float uMid = (u0 + u1) / 2;
+        bool refine = depth < splitDepth;
+        if (!refine && Options->splitCurves && depth < splitDepth + 4) {
+            // Split further if the halves' bounds have much less surface area
+            Float area = Curve(common, u0, u1).Bounds().SurfaceArea();
+            Float splitArea = Curve(common, u0, uMid).Bounds().SurfaceArea() +
+                              Curve(common, uMid, u1).Bounds().SurfaceArea();
+            refine = splitArea < 0.75f * area;
+        }
+        if (refine) {
+            split(u0, uMid, depth + 1);
+            split(uMid, u1, depth + 1);
+        } else
+            uRanges.push_back({u0, u1});
+    };
+    split(0, 1, 0);
+
+    const int nSegments = uRanges.size();
     pstd::vector<ShapeHandle> segments(nSegments, alloc);
     Curve *curves = alloc.allocate_object<Curve>(nSegments);
     for (int i = 0; i < nSegments; ++i) {
-        Float uMin = i / (Float)nSegments;
-        Float uMax = (i + 1) / (Float)nSegments;
-        alloc.construct(&curves[i], common, uMin, uMax);
+        alloc.construct(&curves[i], common, uRanges[i].first, uRanges[i].second);
         segments[i] = &curves[i];
         ++nSplitCurves;
     }
@@ -510,6 +548,25 @@ pstd::vector<ShapeHandle> CreateCurve(const Transform *renderFromObject,
 }
 
 // Curve Method Definitions
+Curve::Curve(const CurveCommon *common, Float uMin, Float uMax)
+    : common(common), uMin(uMin), uMax(uMax) {
+    // Compute refinement depth for curve, _maxDepth_
+    // The ray coordinate system used in intersect() is a rigid transformation
+    // of object space, so the lengths of the control points' second
+    // differences bound the largest of their components there.
+    pstd::array<Point3f, 4> cp =
+        CubicBezierControlPoints(pstd::MakeConstSpan(common->cpObj), uMin, uMax);
+    Float L0 = 0;
+    for (int i = 0; i < 2; ++i)
+        L0 = std::max(L0, Length(Vector3f(cp[i]) - 2 * Vector3f(cp[i + 1]) +
+                                 Vector3f(cp[i + 2])));
+
+    Float eps = std::max(common->width[0], common->width[1]) * .05f;  // width / 20
+    // Compute log base 4 by dividing log2 in half.
+    int r0 = Log2Int(1.41421356237f * 6.f * L0 / (8.f * eps)) / 2;
+    maxDepth = Clamp(r0, 0, 10);
+}
+
 Bounds3f Curve::Bounds() const {
     Bounds3f b =
         BoundCubicBezier<Bounds3f>(pstd::MakeConstSpan(common->cpObj), uMin, uMax);
@@ -600,19 +657,6 @@ bool Curve::intersect(const Ray &r, Float tMax,
         std::min({cp[0].z, cp[1].z, cp[2].z, cp[3].z}) - 0.5f * maxWidth > zMax)
         return false;
 
-    // Compute refinement depth for curve, _maxDepth_
-    Float L0 = 0;
-    for (int i = 0; i < 2; ++i)
-        L0 = std::max(
-            L0, std::max(std::max(std::abs(cp[i].x - 2 * cp[i + 1].x + cp[i + 2].x),
-                                  std::abs(cp[i].y - 2 * cp[i + 1].y + cp[i + 2].y)),
-                         std::abs(cp[i].z - 2 * cp[i + 1].z + cp[i + 2].z)));
-
-    Float eps = std::max(common->width[0], common->width[1]) * .05f;  // width / 20
-    // Compute log base 4 by dividing log2 in half.
-    int r0 = Log2Int(1.41421356237f * 6.f * L0 / (8.f * eps)) / 2;
-    int maxDepth = Clamp(r0, 0, 10);
-
     return recursiveIntersect(ray, tMax, pstd::MakeConstSpan(cp), Inverse(RayFromObject),
                               uMin, uMax, maxDepth, si);
 }
@@ -1011,12 +1055,18 @@ BilinearPatchMesh *BilinearPatch::CreateMesh(const Transform *renderFromObject,
         std::move(N), std::move(uv), std::move(faceIndices), imageDist);
 }
 
+// Meshes may be registered concurrently while the scene is being created.
+static std::mutex allBilinearMeshesMutex;
+
 pstd::vector<ShapeHandle> BilinearPatch::CreatePatches(const BilinearPatchMesh *mesh,
                                                        Allocator alloc) {
-    CHECK_LT(allMeshes->size(), 1 << 31);
-    int meshIndex = int(allMeshes->size());
-
-    allMeshes->push_back(mesh);
+    int meshIndex;
+    {
+        std::lock_guard<std::mutex> lock(allBilinearMeshesMutex);
+        CHECK_LT(allMeshes->size(), 1 << 31);
+        meshIndex = int(allMeshes->size());
+        allMeshes->push_back(mesh);
+    }
 
     pstd::vector<ShapeHandle> blps(mesh->nPatches, alloc);
     BilinearPatch *patches = alloc.allocate_object<BilinearPatch>(mesh->nPatches);
@@ -1050,7 +1100,7 @@ BilinearPatch::BilinearPatch(int meshIndex, int blpIndex)
     blpBytes += sizeof(*this);
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1086,7 +1136,7 @@ fprintf(stderr, "area old a %f, old b %f, subsampled %f\n", 0.5 * Length(Cross(p
 Bounds3f BilinearPatch::Bounds() const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1100,7 +1150,7 @@ Float BilinearPatch::Area() const {
 bool BilinearPatch::IsQuad() const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1114,7 +1164,7 @@ DirectionCone BilinearPatch::NormalBounds() const {
 
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1143,7 +1193,7 @@ pstd::optional<ShapeIntersection> BilinearPatch::Intersect(const Ray &ray,
                                                            Float tMax) const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1159,7 +1209,7 @@ pstd::optional<ShapeIntersection> BilinearPatch::Intersect(const Ray &ray,
 bool BilinearPatch::IntersectP(const Ray &ray, Float tMax) const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1170,7 +1220,7 @@ pstd::optional<ShapeSample> BilinearPatch::Sample(const ShapeSampleContext &ctx,
                                                   const Point2f &uo) const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1267,7 +1317,7 @@ Float BilinearPatch::PDF(const ShapeSampleContext &ctx, const Vector3f &wi) cons
 
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1309,7 +1359,7 @@ Float BilinearPatch::PDF(const ShapeSampleContext &ctx, const Vector3f &wi) cons
 pstd::optional<ShapeSample> BilinearPatch::Sample(const Point2f &uo) const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1348,7 +1398,7 @@ pstd::optional<ShapeSample> BilinearPatch::Sample(const Point2f &uo) const {
 Float BilinearPatch::PDF(const Interaction &intr) const {
     // Get bilinear patch vertices in _p00_, _p01_, _p10_, and _p11_
     auto mesh = GetMesh();
-    const int *v = &mesh->vertexIndices[4 * blpIndex];
+    pstd::array<int, 4> v = mesh->VertexIndices(blpIndex);
     const Point3f &p00 = mesh->p[v[0]], &p10 = mesh->p[v[1]];
     const Point3f &p01 = mesh->p[v[2]], &p11 = mesh->p[v[3]];
 
@@ -1383,6 +1433,7 @@ pstd::vector<ShapeHandle> ShapeHandle::Create(const std::string &name,
                                               const Transform *objectFromRender,
                                               bool reverseOrientation,
                                               const ParameterDictionary &parameters,
+                                              const LoopSubdivisionView &subdivisionView,
                                               const FileLoc *loc, Allocator alloc) {
     pstd::vector<ShapeHandle> shapes(alloc);
     if (name == "sphere") {
@@ -1433,6 +1484,8 @@ pstd::vector<ShapeHandle> ShapeHandle::Create(const std::string &name,
         }
     } else if (name == "loopsubdiv") {
         int nLevels = parameters.GetOneInt("levels", 3);
+        // Target edge length in pixels for adaptive subdivision; zero disables it.
+        Float edgeLength = parameters.GetOneFloat("edgelength", 0.f);
         std::vector<int> vertexIndices = parameters.GetIntArray("indices");
         if (vertexIndices.empty())
             ErrorExit(loc, "Vertex indices \"indices\" not provided for "
@@ -1446,7 +1499,8 @@ pstd::vector<ShapeHandle> ShapeHandle::Create(const std::string &name,
         std::string scheme = parameters.GetOneString("scheme", "loop");
 
         TriangleMesh *mesh = LoopSubdivide(renderFromObject, reverseOrientation, nLevels,
-                                           vertexIndices, P, alloc);
+                                           vertexIndices, P, alloc, edgeLength,
+                                           subdivisionView);
 
         shapes = Triangle::CreateTriangles(mesh, alloc);
     } else
@@ -891,16 +891,28 @@ class Triangle {
     PBRT_CPU_GPU
     bool IntersectP(const Ray &ray, Float tMax = Infinity) const;
 
+    // Intersect() in two steps, so that callers can inspect the barycentric
+    // coordinates of the hit before its _SurfaceInteraction_ is computed.
+    PBRT_CPU_GPU
+    pstd::optional<TriangleIntersection> IntersectBarycentric(const Ray &ray,
+                                                              Float tMax) const;
+    PBRT_CPU_GPU
+    pstd::optional<ShapeIntersection> CompleteIntersection(
+        const TriangleIntersection &triIsect, const Ray &ray) const;
+
     PBRT_CPU_GPU
     bool OrientationIsReversed() const { return GetMesh()->reverseOrientation; }
     PBRT_CPU_GPU
     bool TransformSwapsHandedness() const { return GetMesh()->transformSwapsHandedness; }
 
+    const TriangleMesh *Mesh() const { return GetMesh(); }
+    int TriangleIndex() const { return triIndex; }
+
     PBRT_CPU_GPU
     Float Area() const {
         // Get triangle vertices in _p0_, _p1_, and _p2_
         auto mesh = GetMesh();
-        const int *v = &mesh->vertexIndices[3 * triIndex];
+        pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
         const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
         const Point3f &p2 = mesh->p[v[2]];
 
@@ -927,7 +939,7 @@ class Triangle {
     static pstd::optional<SurfaceInteraction> InteractionFromIntersection(
         const TriangleMesh *mesh, int triIndex, pstd::array<Float, 3> b, Float time,
         const Vector3f &wo, pstd::optional<Transform> renderFromInstance = {}) {
-        const int *v = &mesh->vertexIndices[3 * triIndex];
+        pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
         Point3f p0 = mesh->p[v[0]], p1 = mesh->p[v[1]], p2 = mesh->p[v[2]];
         if (renderFromInstance) {
             p0 = (*renderFromInstance)(p0);
@@ -937,9 +949,9 @@ class Triangle {
         // Compute triangle partial derivatives
         Vector3f dpdu, dpdv;
         pstd::array<Point2f, 3> triuv =
-            mesh->uv
+            mesh->HasUVs()
                 ? pstd::array<Point2f, 3>(
-                      {mesh->uv[v[0]], mesh->uv[v[1]], mesh->uv[v[2]]})
+                      {mesh->GetUV(v[0]), mesh->GetUV(v[1]), mesh->GetUV(v[2])})
                 : pstd::array<Point2f, 3>({Point2f(0, 0), Point2f(1, 0), Point2f(1, 1)});
         // Compute deltas for triangle partial derivatives
         Vector2f duv02 = triuv[0] - triuv[2], duv12 = triuv[1] - triuv[2];
@@ -986,12 +998,18 @@ class Triangle {
         if (mesh->reverseOrientation ^ mesh->transformSwapsHandedness)
             isect.n = isect.shading.n = -isect.n;
 
-        if (mesh->n || mesh->s) {
+        if (mesh->HasNormals() || mesh->s) {
             // Initialize _Triangle_ shading geometry
+            // Get vertex normals, which may need to be decoded
+            pstd::array<Normal3f, 3> vn;
+            if (mesh->HasNormals())
+                vn = {mesh->GetNormal(v[0]), mesh->GetNormal(v[1]),
+                      mesh->GetNormal(v[2])};
+
             // Compute shading normal _ns_ for triangle
             Normal3f ns;
-            if (mesh->n != nullptr) {
-                ns = (b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] + b[2] * mesh->n[v[2]]);
+            if (mesh->HasNormals()) {
+                ns = (b[0] * vn[0] + b[1] * vn[1] + b[2] * vn[2]);
                 if (renderFromInstance)
                     ns = (*renderFromInstance)(ns);
 
@@ -1023,12 +1041,12 @@ class Triangle {
 
             // Compute $\dndu$ and $\dndv$ for triangle shading geometry
             Normal3f dndu, dndv;
-            if (mesh->n != nullptr) {
+            if (mesh->HasNormals()) {
                 // Compute deltas for triangle partial derivatives of normal
                 Vector2f duv02 = triuv[0] - triuv[2];
                 Vector2f duv12 = triuv[1] - triuv[2];
-                Normal3f dn1 = mesh->n[v[0]] - mesh->n[v[2]];
-                Normal3f dn2 = mesh->n[v[1]] - mesh->n[v[2]];
+                Normal3f dn1 = vn[0] - vn[2];
+                Normal3f dn2 = vn[1] - vn[2];
                 if (renderFromInstance) {
                     dn1 = (*renderFromInstance)(dn1);
                     dn2 = (*renderFromInstance)(dn2);
@@ -1044,8 +1062,8 @@ class Triangle {
                     // (rather than giving up) so that ray differentials for
                     // rays reflected from triangles with degenerate
                     // parameterizations are still reasonable.
-                    Vector3f dn = Cross(Vector3f(mesh->n[v[2]] - mesh->n[v[0]]),
-                                        Vector3f(mesh->n[v[1]] - mesh->n[v[0]]));
+                    Vector3f dn =
+                        Cross(Vector3f(vn[2] - vn[0]), Vector3f(vn[1] - vn[0]));
                     if (renderFromInstance)
                         dn = (*renderFromInstance)(dn);
 
@@ -1074,7 +1092,7 @@ class Triangle {
     pstd::optional<ShapeSample> Sample(const Point2f &u) const {
         // Get triangle vertices in _p0_, _p1_, and _p2_
         auto mesh = GetMesh();
-        const int *v = &mesh->vertexIndices[3 * triIndex];
+        pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
         const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
         const Point3f &p2 = mesh->p[v[2]];
 
@@ -1086,9 +1104,9 @@ class Triangle {
         Normal3f n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
         // Ensure correct orientation of the geometric normal; follow the same
         // approach as was used in Triangle::Intersect().
-        if (mesh->n != nullptr) {
-            Normal3f ns(b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] +
-                        (1 - b[0] - b[1]) * mesh->n[v[2]]);
+        if (mesh->HasNormals()) {
+            Normal3f ns(b[0] * mesh->GetNormal(v[0]) + b[1] * mesh->GetNormal(v[1]) +
+                        (1 - b[0] - b[1]) * mesh->GetNormal(v[2]));
             n = FaceForward(n, ns);
         } else if (mesh->reverseOrientation ^ mesh->transformSwapsHandedness)
             n *= -1;
@@ -1121,7 +1139,7 @@ class Triangle {
                                        const Point2f &uo) const {
         // Get triangle vertices in _p0_, _p1_, and _p2_
         auto mesh = GetMesh();
-        const int *v = &mesh->vertexIndices[3 * triIndex];
+        pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
         const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
         const Point3f &p2 = mesh->p[v[2]];
 
@@ -1173,9 +1191,9 @@ class Triangle {
         Normal3f n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
         // Ensure correct orientation of the geometric normal; follow the same
         // approach as was used in Triangle::Intersect().
-        if (mesh->n != nullptr) {
-            Normal3f ns(b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] +
-                        b[2] * mesh->n[v[2]]);
+        if (mesh->HasNormals()) {
+            Normal3f ns(b[0] * mesh->GetNormal(v[0]) + b[1] * mesh->GetNormal(v[1]) +
+                        b[2] * mesh->GetNormal(v[2]));
             n = FaceForward(n, ns);
         } else if (mesh->reverseOrientation ^ mesh->transformSwapsHandedness)
             n *= -1;
@@ -1215,7 +1233,7 @@ class Triangle {
         if (ctx.ns != Normal3f(0, 0, 0)) {
             // Get triangle vertices in _p0_, _p1_, and _p2_
             auto mesh = GetMesh();
-            const int *v = &mesh->vertexIndices[3 * triIndex];
+            pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
             const Point3f &p0 = mesh->p[v[0]], &p1 = mesh->p[v[1]];
             const Point3f &p2 = mesh->p[v[2]];
 
@@ -1241,7 +1259,7 @@ class Triangle {
     Float SolidAngle(const Point3f &p, int = 0 /*nSamples: unused...*/) const {
         // Project the vertices into the unit sphere around p.
         auto mesh = GetMesh();
-        const int *v = &mesh->vertexIndices[3 * triIndex];
+        pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
         Vector3f a = Normalize(mesh->p[v[0]] - p);
         Vector3f b = Normalize(mesh->p[v[1]] - p);
         Vector3f c = Normalize(mesh->p[v[2]] - p);
@@ -1263,9 +1281,9 @@ class Triangle {
     PBRT_CPU_GPU
     pstd::array<Point2f, 3> GetUVs() const {
         auto mesh = GetMesh();
-        if (mesh->uv) {
-            const int *v = &mesh->vertexIndices[3 * triIndex];
-            return {mesh->uv[v[0]], mesh->uv[v[1]], mesh->uv[v[2]]};
+        if (mesh->HasUVs()) {
+            pstd::array<int, 3> v = mesh->VertexIndices(triIndex);
+            return {mesh->GetUV(v[0]), mesh->GetUV(v[1]), mesh->GetUV(v[2])};
         } else
             return {Point2f(0, 0), Point2f(1, 0), Point2f(1, 1)};
     }
@@ -1334,8 +1352,7 @@ class Curve {
 
     std::string ToString() const;
 
-    Curve(const CurveCommon *common, Float uMin, Float uMax)
-        : common(common), uMin(uMin), uMax(uMax) {}
+    Curve(const CurveCommon *common, Float uMin, Float uMax);
 
     PBRT_CPU_GPU
     DirectionCone NormalBounds() const { return DirectionCone::EntireSphere(); }
@@ -1350,6 +1367,7 @@ class Curve {
     // Curve Private Members
     const CurveCommon *common;
     Float uMin, uMax;
+    int maxDepth;
 };
 
 // BilinearPatch Declarations
@@ -1490,7 +1508,7 @@ class BilinearPatch {
     static SurfaceInteraction InteractionFromIntersection(
         const BilinearPatchMesh *mesh, int patchIndex, const Point2f &uvHit, Float time,
         const Vector3f &wo, pstd::optional<Transform> renderFromInstance = {}) {
-        const int *v = &mesh->vertexIndices[4 * patchIndex];
+        pstd::array<int, 4> v = mesh->VertexIndices(patchIndex);
         Point3f p00 = mesh->p[v[0]], p10 = mesh->p[v[1]], p01 = mesh->p[v[2]],
                 p11 = mesh->p[v[3]];
 
@@ -1508,11 +1526,11 @@ class BilinearPatch {
 
         // Interpolate texture coordinates, if provided
         Point2f uv = uvHit;
-        if (mesh->uv != nullptr) {
-            const Point2f &uv00 = mesh->uv[v[0]];
-            const Point2f &uv10 = mesh->uv[v[1]];
-            const Point2f &uv01 = mesh->uv[v[2]];
-            const Point2f &uv11 = mesh->uv[v[3]];
+        if (mesh->HasUVs()) {
+            Point2f uv00 = mesh->GetUV(v[0]);
+            Point2f uv10 = mesh->GetUV(v[1]);
+            Point2f uv01 = mesh->GetUV(v[2]);
+            Point2f uv11 = mesh->GetUV(v[3]);
 
             Float dsdu =
                 -uv00[0] + uv10[0] + uv[1] * (uv00[0] - uv01[0] - uv10[0] + uv11[0]);
@@ -1582,9 +1600,9 @@ class BilinearPatch {
             pe, uv, wo, dpdu, dpdv, dndu, dndv, time,
             mesh->reverseOrientation ^ mesh->transformSwapsHandedness, faceIndex);
 
-        if (mesh->n != nullptr) {
-            Normal3f n00 = mesh->n[v[0]], n10 = mesh->n[v[1]], n01 = mesh->n[v[2]],
-                     n11 = mesh->n[v[3]];
+        if (mesh->HasNormals()) {
+            Normal3f n00 = mesh->GetNormal(v[0]), n10 = mesh->GetNormal(v[1]);
+            Normal3f n01 = mesh->GetNormal(v[2]), n11 = mesh->GetNormal(v[3]);
             if (renderFromInstance) {
                 n00 = (*renderFromInstance)(n00);
                 n10 = (*renderFromInstance)(n10);
@@ -6,10 +6,20 @@
 
 #include <pbrt/pbrt.h>
 
+#include <pbrt/cpu/accelerators.h>
+#include <pbrt/cpu/primitive.h>
 #include <pbrt/interaction.h>
+#include <pbrt/options.h>
+#include <pbrt/parsedscene.h>
+#include <pbrt/parser.h>
 #include <pbrt/shapes.h>
+#include <pbrt/textures.h>
+#include <pbrt/util/file.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/loopsubdiv.h>
 #include <pbrt/util/lowdiscrepancy.h>
 #include <pbrt/util/memory.h>
+#include <pbrt/util/mesh.h>
 #include <pbrt/util/parallel.h>
 #include <pbrt/util/rng.h>
 #include <pbrt/util/sampling.h>
@@ -442,3 +452,529 @@ TEST(Triangle, BadCases) {
 
     EXPECT_FALSE(tris[0].Intersect(ray).has_value());
 }
+
+TEST(TriangleMesh, Compressed) {
+    // A grid with more than 2^16 vertices, so that vertex indices are
+    // delta-encoded, and a single triangle that uses 16-bit indices directly.
+    for (int res : {300, 1}) {
+        std::vector<Point3f> p;
+        std::vector<Normal3f> n;
+        std::vector<Point2f> uv;
+        for (int y = 0; y <= res; ++y)
+            for (int x = 0; x <= res; ++x) {
+                p.push_back(Point3f(x, y, std::sin(Float(x + y))));
+                n.push_back(Normal3f(std::cos(Float(x)), 1, 2 + std::sin(Float(y))));
+                uv.push_back(Point2f(Float(x) / res * 4 - 1, Float(y) / res));
+            }
+        std::vector<int> indices;
+        for (int y = 0; y < res; ++y)
+            for (int x = 0; x < res; ++x) {
+                int v00 = y * (res + 1) + x, v10 = v00 + 1;
+                int v01 = v00 + res + 1, v11 = v01 + 1;
+                for (int v : {v00, v10, v11, v00, v11, v01})
+                    indices.push_back(v);
+            }
+
+        Transform renderFromObject = Scale(2, 2, 2);
+        TriangleMesh mesh(renderFromObject, false, indices, p, {}, n, uv, {});
+        Options->compressMeshes = true;
+        TriangleMesh compressed(renderFromObject, false, indices, p, {}, n, uv, {});
+        Options->compressMeshes = false;
+
+        EXPECT_TRUE(compressed.vertexIndices == nullptr);
+        EXPECT_EQ(res > 1, compressed.compressed.indexBlockOffsets != nullptr);
+        EXPECT_TRUE(compressed.n == nullptr && compressed.HasNormals());
+        EXPECT_TRUE(compressed.uv == nullptr && compressed.HasUVs());
+
+        for (int i = 0; i < mesh.nTriangles; ++i)
+            EXPECT_EQ(mesh.VertexIndices(i), compressed.VertexIndices(i));
+        for (int i = 0; i < mesh.nVertices; ++i) {
+            // Octahedral encoding normalizes normals.
+            Normal3f ns = Normalize(mesh.GetNormal(i));
+            EXPECT_GT(Dot(ns, compressed.GetNormal(i)), .99999f);
+            EXPECT_LT(Distance(mesh.GetUV(i), compressed.GetUV(i)), 1e-4f);
+        }
+    }
+}
+
+TEST(TriangleMesh, Decimate) {
+    int res = 64;
+    std::vector<Point3f> p;
+    std::vector<Point2f> uv;
+    for (int y = 0; y <= res; ++y)
+        for (int x = 0; x <= res; ++x) {
+            p.push_back(Point3f(Float(x) / res, Float(y) / res, 0));
+            uv.push_back(Point2f(Float(x) / res, Float(y) / res));
+        }
+    std::vector<int> indices;
+    for (int y = 0; y < res; ++y)
+        for (int x = 0; x < res; ++x) {
+            int v00 = y * (res + 1) + x, v10 = v00 + 1;
+            int v01 = v00 + res + 1, v11 = v01 + 1;
+            for (int v : {v00, v10, v11, v00, v11, v01})
+                indices.push_back(v);
+        }
+    TriangleMesh mesh(Transform(), false, indices, p, {}, {}, uv, {});
+    EXPECT_NEAR((2 + std::sqrt(2.f)) / (3 * res), mesh.MeanEdgeLength(), 1e-6f);
+
+    Float cellSize = 4 * mesh.MeanEdgeLength();
+    TriangleMesh *decimated = mesh.Decimate(cellSize, Allocator());
+    ASSERT_TRUE(decimated != nullptr);
+    EXPECT_LT(decimated->nTriangles, mesh.nTriangles / 8);
+    EXPECT_GT(decimated->nTriangles, 0);
+    // The remaining vertices are a subset of the original ones, with their
+    // uvs, and the triangles still cover most of the mesh's area.
+    Float area = 0;
+    for (int i = 0; i < decimated->nTriangles; ++i) {
+        pstd::array<int, 3> v = decimated->VertexIndices(i);
+        for (int j = 0; j < 3; ++j)
+            EXPECT_EQ(Point2f(decimated->p[v[j]].x, decimated->p[v[j]].y),
+                      decimated->GetUV(v[j]));
+        area += Length(Cross(decimated->p[v[1]] - decimated->p[v[0]],
+                             decimated->p[v[2]] - decimated->p[v[0]])) /
+                2;
+    }
+    EXPECT_GT(area, .8f);
+
+    // Everything collapses into a single vertex.
+    EXPECT_TRUE(mesh.Decimate(2, Allocator()) == nullptr);
+}
+
+TEST(Curve, SplitCurves) {
+    // A straight curve along the diagonal, which has loose bounds.
+    ParsedScene scene;
+    ParseString(&scene, R"(WorldBegin
+Shape "curve" "point3 P" [ 0 0 0 1 1 1 2 2 2 3 3 3 ] "float width" [ .01 ])");
+    ASSERT_EQ(1, scene.shapes.size());
+    const ShapeSceneEntity &sh = scene.shapes[0];
+    Transform identity;
+    pstd::vector<ShapeHandle> curves =
+        Curve::Create(&identity, &identity, false, sh.parameters, &sh.loc, Allocator());
+    Options->splitCurves = true;
+    pstd::vector<ShapeHandle> split =
+        Curve::Create(&identity, &identity, false, sh.parameters, &sh.loc, Allocator());
+    Options->splitCurves = false;
+
+    EXPECT_EQ(8, curves.size());
+    EXPECT_GT(split.size(), curves.size());
+    auto surfaceArea = [](const pstd::vector<ShapeHandle> &shapes) {
+        Float area = 0;
+        for (ShapeHandle s : shapes)
+            area += s.Bounds().SurfaceArea();
+        return area;
+    };
+    EXPECT_LT(surfaceArea(split), surfaceArea(curves) / 2);
+
+    // Rays toward points on the curve hit both versions at the same place.
+    auto intersect = [](const pstd::vector<ShapeHandle> &shapes, const Ray &ray) {
+        Float tHit = Infinity;
+        for (ShapeHandle s : shapes)
+            if (pstd::optional<ShapeIntersection> si = s.Intersect(ray, tHit))
+                tHit = si->tHit;
+        return tHit;
+    };
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Float t = Lerp(rng.Uniform<Float>(), .1f, 2.9f);
+        Point3f p(t, t, t);
+        Vector3f w =
+            SampleUniformSphere(Point2f(rng.Uniform<Float>(), rng.Uniform<Float>()));
+        // Skip rays that graze the curve before reaching _p_.
+        if (AbsDot(w, Normalize(Vector3f(1, 1, 1))) > .9f)
+            continue;
+        Ray ray(p + 5 * w, -5 * w);
+        EXPECT_NEAR(1, intersect(curves, ray), 1e-2f);
+        EXPECT_NEAR(1, intersect(split, ray), 1e-2f);
+    }
+}
+
+TEST(OpacityMicromap, MatchesAlpha) {
+    // Alpha is zero on the left half of the image and one on the right,
+    // except for a one-texel hole.
+    Point2i res(16, 16);
+    Image image(PixelFormat::Float, res, {"R", "G", "B"});
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, y}, c, (x >= 8 && !(x == 12 && y == 12)) ? 1 : 0);
+    ASSERT_TRUE(image.Write("alpha.pfm"));
+
+    Allocator alloc;
+    FloatImageTexture texture(alloc.new_object<UVMapping2D>(), "alpha.pfm", "bilinear",
+                              8, WrapMode::Clamp, 1, ColorEncodingHandle::Linear, alloc);
+    TriangleMesh mesh(Transform(), false, {0, 1, 2},
+                      {Point3f(0, 0, 0), Point3f(1, 0, 0), Point3f(0, 1, 0)}, {}, {},
+                      {Point2f(0, 0), Point2f(1, 0), Point2f(0, 1)}, {});
+    pstd::vector<ShapeHandle> tris = Triangle::CreateTriangles(&mesh, alloc);
+    OpacityMicromap *micromap =
+        OpacityMicromap::Create(tris[0].Cast<Triangle>(), FloatTextureHandle(&texture));
+    ASSERT_TRUE(micromap != nullptr);
+
+    // Wherever the micromap is conclusive, it must agree with the texture.
+    // The last 1000 points are on the edge where $b_1 + b_2 = 1$.
+    int nKnown = 0;
+    RNG rng;
+    for (int i = 0; i < 11000; ++i) {
+        Point2f u(rng.Uniform<Float>(), rng.Uniform<Float>());
+        pstd::array<Float, 3> b = SampleUniformTriangle(u);
+        if (i >= 10000)
+            b = {0, (i - 10000 + 0.5f) / 1000, 1 - (i - 10000 + 0.5f) / 1000};
+        OpacityMicromap::State state = micromap->Lookup(b[1], b[2]);
+        pstd::optional<SurfaceInteraction> intr = Triangle::InteractionFromIntersection(
+            &mesh, 0, b, 0, Vector3f(0, 0, 1));
+        ASSERT_TRUE(intr.has_value());
+        Float alpha = texture.Evaluate(*intr);
+        if (state == OpacityMicromap::State::Transparent)
+            EXPECT_EQ(0, alpha);
+        else if (state == OpacityMicromap::State::Opaque)
+            EXPECT_NE(0, alpha);
+        nKnown += (state != OpacityMicromap::State::Unknown);
+    }
+    EXPECT_GT(nKnown, 5000);
+
+    EXPECT_EQ(0, remove("alpha.pfm"));
+}
+
+TEST(LODPrimitive, SpawnedRaysUseSameLevel) {
+    // Level 1 is just below level 0, so that rays leaving a level 1 hit
+    // toward the viewer hit level 0 unless they keep using level 1.
+    auto makeLevel = [](Float z) {
+        static Transform identity;
+        int indices[3] = {0, 1, 2};
+        Point3f v[3] = {Point3f(-10, -10, z), Point3f(10, -10, z), Point3f(0, 10, z)};
+        TriangleMesh *mesh = new TriangleMesh(identity, false, {indices, indices + 3},
+                                              {v, v + 3}, {}, {}, {}, {});
+        pstd::vector<ShapeHandle> tris = Triangle::CreateTriangles(mesh, Allocator());
+        return PrimitiveHandle(new SimplePrimitive(tris[0], nullptr));
+    };
+    LODPrimitive lod({makeLevel(0), makeLevel(-0.01f)}, 0.001f);
+
+    // A wide footprint selects the coarsest level.
+    Ray ray(Point3f(0, 0, 10), Vector3f(0, 0, -1));
+    ray.spread = 0.01f;
+    pstd::optional<ShapeIntersection> si = lod.Intersect(ray, Infinity);
+    ASSERT_TRUE(si.has_value());
+    EXPECT_NEAR(-0.01f, si->intr.p().z, 1e-4f);
+
+    // Shadow rays have no footprint but must still see the same level.
+    Ray shadowRay = si->intr.SpawnRayTo(ray.o);
+    EXPECT_FALSE(lod.IntersectP(shadowRay, 1 - ShadowEpsilon));
+    EXPECT_FALSE(lod.Intersect(si->intr.SpawnRay(-ray.d), Infinity).has_value());
+
+    // Without the level recorded at the hit, the finest level is used.
+    shadowRay.lodTag = 0;
+    EXPECT_TRUE(lod.IntersectP(shadowRay, 1 - ShadowEpsilon));
+
+    // With two instances of the primitive, the level used for one of them
+    // doesn't carry over to the other.
+    AffineTransform identity(Transform{}), farAway(Translate(Vector3f(0, 0, -1000)));
+    TransformedPrimitive nearInstance(&lod, &identity), farInstance(&lod, &farAway);
+
+    // A narrow footprint selects the finest level for the near instance and a
+    // coarser one for the far instance.
+    ray.spread = 1e-5f;
+    si = nearInstance.Intersect(ray, Infinity);
+    ASSERT_TRUE(si.has_value());
+    EXPECT_NEAR(0, si->intr.p().z, 1e-4f);
+    Ray continuation = si->intr.SpawnRay(ray.d);
+    continuation.spread = ray.spread;
+    EXPECT_FALSE(nearInstance.Intersect(continuation, Infinity).has_value());
+    si = farInstance.Intersect(continuation, Infinity);
+    ASSERT_TRUE(si.has_value());
+    EXPECT_NEAR(-1000.01f, si->intr.p().z, 1e-3f);
+
+    // Rays leaving the far instance's coarse level see the near instance's
+    // finest level.
+    Ray back = si->intr.SpawnRay(-ray.d);
+    EXPECT_FALSE(farInstance.Intersect(back, Infinity).has_value());
+    si = nearInstance.Intersect(back, Infinity);
+    ASSERT_TRUE(si.has_value());
+    EXPECT_NEAR(0, si->intr.p().z, 1e-4f);
+}
+
+TEST(LazyBVHAccel, MatchesBVH) {
+    RNG rng;
+    std::vector<PrimitiveHandle> prims;
+    while (prims.size() < 1000) {
+        Triangle *tri = GetRandomTriangle([&]() { return 10 * rng.Uniform<Float>(); });
+        if (tri)
+            prims.push_back(new SimplePrimitive(tri, nullptr));
+    }
+    BVHAccel bvh(prims);
+    LazyBVHAccel lazy(prims);
+
+    // Bounds are available before the BVH is built.
+    EXPECT_EQ(bvh.Bounds(), lazy.Bounds());
+    EXPECT_FALSE(lazy.IsBuilt());
+
+    // All of the threads start with a first intersection; they must all see
+    // the same complete BVH.
+    std::vector<Ray> rays;
+    for (int i = 0; i < 10000; ++i) {
+        Point3f o(20 * rng.Uniform<Float>() - 5, 20 * rng.Uniform<Float>() - 5, -5);
+        Point3f target(10 * rng.Uniform<Float>(), 10 * rng.Uniform<Float>(),
+                       10 * rng.Uniform<Float>());
+        rays.push_back(Ray(o, target - o));
+    }
+    std::atomic<int> nHits{0};
+    ParallelFor(0, rays.size(), [&](int64_t i) {
+        pstd::optional<ShapeIntersection> si = lazy.Intersect(rays[i], Infinity);
+        pstd::optional<ShapeIntersection> bvhSi = bvh.Intersect(rays[i], Infinity);
+        ASSERT_EQ(bvhSi.has_value(), si.has_value());
+        if (si) {
+            EXPECT_EQ(bvhSi->tHit, si->tHit);
+            ++nHits;
+        }
+        EXPECT_EQ(bvh.IntersectP(rays[i], Infinity), lazy.IntersectP(rays[i], Infinity));
+    });
+    EXPECT_TRUE(lazy.IsBuilt());
+    EXPECT_GT(nHits, 1000);
+}
+
+TEST(LoopSubdiv, Octahedron) {
+    std::vector<Point3f> p = {Point3f(1, 0, 0),  Point3f(-1, 0, 0), Point3f(0, 1, 0),
+                              Point3f(0, -1, 0), Point3f(0, 0, 1),  Point3f(0, 0, -1)};
+    std::vector<int> indices = {0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4,
+                                2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5};
+    Transform identity;
+    TriangleMesh *mesh = LoopSubdivide(&identity, false, 2, indices, p, Allocator());
+    EXPECT_EQ(8 * 16, mesh->nTriangles);
+    EXPECT_EQ(66, mesh->nVertices);
+    // The limit surface lies well inside the control mesh and all of the
+    // normals face the same way.
+    for (int i = 0; i < mesh->nVertices; ++i) {
+        EXPECT_LE(Length(Vector3f(mesh->p[i])), .5001f);
+        EXPECT_GT(Length(Vector3f(mesh->p[i])), .4f);
+        EXPECT_GT(Dot(mesh->n[i], Vector3f(mesh->p[i])) *
+                      Dot(mesh->n[0], Vector3f(mesh->p[0])),
+                  0);
+    }
+
+    // Seen from far away, no subdivision is needed.
+    LoopSubdivisionView view{Point3f(1000, 0, 0), Radians(90.f) / 720};
+    mesh = LoopSubdivide(&identity, false, 2, indices, p, Allocator(), 4, view);
+    EXPECT_EQ(8, mesh->nTriangles);
+}
+
+TEST(LoopSubdiv, PlanarBoundary) {
+    std::vector<Point3f> p = {Point3f(0, 0, 0), Point3f(1, 0, 0), Point3f(1, 1, 0),
+                              Point3f(0, 1, 0)};
+    std::vector<int> indices = {0, 1, 2, 0, 2, 3};
+    Transform identity;
+    TriangleMesh *mesh = LoopSubdivide(&identity, false, 2, indices, p, Allocator());
+    EXPECT_EQ(32, mesh->nTriangles);
+    EXPECT_EQ(25, mesh->nVertices);
+    for (int i = 0; i < mesh->nVertices; ++i) {
+        EXPECT_EQ(0, mesh->p[i].z);
+        Normal3f n = Normalize(mesh->n[i]);
+        EXPECT_NEAR(1, std::abs(n.z), 1e-5f);
+    }
+}
+
+TEST(LoopSubdiv, MatchesSDVertexImplementation) {
+    // A fan of five triangles around an irregular interior vertex; all of the
+    // other vertices are on the boundary.
+    std::vector<Point3f> p = {Point3f(0.1f, 0.05f, 1),     Point3f(1, 0, 0),
+                              Point3f(0.3f, 0.9f, 0.2f),   Point3f(-0.8f, 0.6f, 0),
+                              Point3f(-0.7f, -0.7f, 0.3f), Point3f(0.4f, -1, -0.1f)};
+    std::vector<int> indices = {0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 0, 5, 1};
+    Transform identity;
+    TriangleMesh *mesh = LoopSubdivide(&identity, false, 1, indices, p, Allocator());
+
+    // Limit positions, unnormalized normals, and triangles computed by the
+    // SDVertex/SDFace implementation that LoopSubdivide() replaced. The
+    // edge vertices may be numbered differently.
+    struct {
+        Point3f p;
+        Normal3f n;
+    } expected[] = {
+        {Point3f(0.0700000077f, 0.00499999896f, 0.539999962f),
+         Normal3f(-0.100492842f, 0.0424269885f, -1.14285231f)},
+        {Point3f(0.772500038f, -0.0175000057f, 0.0175000019f),
+         Normal3f(-0.268497139f, 0.0238255151f, -0.265872657f)},
+        {Point3f(0.230000004f, 0.689999998f, 0.13000001f),
+         Normal3f(-0.0715572834f, -0.206618741f, -0.259252876f)},
+        {Point3f(-0.590000033f, 0.425000042f, 0.087500006f),
+         Normal3f(0.207628369f, -0.146876544f, -0.302960932f)},
+        {Point3f(-0.524999976f, -0.524999976f, 0.17750001f),
+         Normal3f(0.151869804f, 0.136302084f, -0.33073774f)},
+        {Point3f(0.31250003f, -0.772500038f, -0.0125000011f),
+         Normal3f(-0.150563568f, 0.246435404f, -0.306509197f)},
+        {Point3f(0.47208339f, -0.0017708391f, 0.322291672f),
+         Normal3f(-1.24279237f, 0.119163387f, -1.70077288f)},
+        {Point3f(0.607500017f, 0.417500019f, 0.0925000012f),
+         Normal3f(-0.834414601f, -0.472486466f, -1.05231774f)},
+        {Point3f(0.163749993f, 0.402395815f, 0.377499998f),
+         Normal3f(-0.362787187f, -0.905629337f, -1.67469847f)},
+        {Point3f(-0.230000004f, 0.694999993f, 0.102500007f),
+         Normal3f(0.339060336f, -0.866401017f, -1.13960636f)},
+        {Point3f(-0.295625031f, 0.245104179f, 0.376458317f),
+         Normal3f(0.850339293f, -0.61127311f, -1.85642326f)},
+        {Point3f(-0.694999993f, -0.0499999896f, 0.145000011f),
+         Normal3f(0.956029177f, -0.0605645217f, -1.32975829f)},
+        {Point3f(-0.261250019f, -0.283020824f, 0.398333341f),
+         Normal3f(0.63746047f, 0.635987341f, -1.98066664f)},
+        {Point3f(-0.137499988f, -0.792500079f, 0.0950000063f),
+         Normal3f(-0.0127166705f, 0.971304059f, -1.32130527f)},
+        {Point3f(0.211666673f, -0.426770806f, 0.314999998f),
+         Normal3f(-0.687554896f, 1.09592628f, -1.88034046f)},
+        {Point3f(0.655000031f, -0.470000029f, -0.0350000039f),
+         Normal3f(-0.98519814f, 0.647033453f, -1.17730427f)},
+    };
+    int expectedIndices[] = {
+        0, 6, 8, 6, 1, 7, 8, 7, 2, 6, 7, 8,
+        0, 8, 10, 8, 2, 9, 10, 9, 3, 8, 9, 10,
+        0, 10, 12, 10, 3, 11, 12, 11, 4, 10, 11, 12,
+        0, 12, 14, 12, 4, 13, 14, 13, 5, 12, 13, 14,
+        0, 14, 6, 14, 5, 15, 6, 15, 1, 14, 15, 6
+    };
+    ASSERT_EQ(16, mesh->nVertices);
+    ASSERT_EQ(20, mesh->nTriangles);
+
+    std::vector<int> vertexMap;
+    for (const auto &v : expected) {
+        int match = -1;
+        for (int i = 0; i < mesh->nVertices; ++i)
+            if (Distance(v.p, mesh->p[i]) < 1e-5f)
+                match = i;
+        ASSERT_NE(-1, match);
+        for (int c = 0; c < 3; ++c)
+            EXPECT_NEAR(v.n[c], mesh->GetNormal(match)[c], 1e-5f);
+        vertexMap.push_back(match);
+    }
+    for (int t = 0; t < mesh->nTriangles; ++t)
+        for (int c = 0; c < 3; ++c)
+            EXPECT_EQ(vertexMap[expectedIndices[3 * t + c]], mesh->VertexIndices(t)[c]);
+}
+
+#ifdef PBRT_HAVE_MMAP
+TEST(TriangleMesh, GeometryStore) {
+    // A mesh whose indices and positions span many more pages than the
+    // store's budget, so that they are repeatedly evicted and reloaded.
+    int res = 256;
+    std::vector<Point3f> p;
+    for (int y = 0; y <= res; ++y)
+        for (int x = 0; x <= res; ++x)
+            p.push_back(Point3f(x, y, std::sin(Float(x * y))));
+    std::vector<int> indices;
+    for (int y = 0; y < res; ++y)
+        for (int x = 0; x < res; ++x) {
+            int v00 = y * (res + 1) + x, v10 = v00 + 1;
+            int v01 = v00 + res + 1, v11 = v01 + 1;
+            for (int v : {v00, v10, v11, v00, v11, v01})
+                indices.push_back(v);
+        }
+
+    TriangleMesh mesh(Transform(), false, indices, p, {}, {}, {}, {});
+    GeometryStore::Init(4 * GeometryStore::PageBytes);
+    TriangleMesh paged(Transform(), false, indices, p, {}, {}, {}, {});
+    TriangleMesh paged2(Transform(), false, indices, p, {}, {}, {}, {});
+    EXPECT_TRUE(paged.pagedIndices != nullptr && paged.pagedP != nullptr);
+
+    // Both meshes' buffers are in the same mapped region of the file.
+    EXPECT_EQ(paged.pagedP->data - paged.pagedIndices->data,
+              paged.pagedP->fileOffset - paged.pagedIndices->fileOffset);
+    EXPECT_EQ(paged2.pagedP->data - paged.pagedIndices->data,
+              paged2.pagedP->fileOffset - paged.pagedIndices->fileOffset);
+
+    ParallelFor(0, 16, [&](int64_t i) {
+        RNG rng(i);
+        const TriangleMesh &m = (i & 1) ? paged : paged2;
+        for (int j = 0; j < 10000; ++j) {
+            int tri = rng.Uniform<uint32_t>(mesh.nTriangles);
+            pstd::array<int, 3> v = m.VertexIndices(tri);
+            EXPECT_EQ(mesh.VertexIndices(tri), v);
+            for (int k = 0; k < 3; ++k)
+                EXPECT_EQ(mesh.p[v[k]], m.p[v[k]]);
+        }
+    });
+
+    GeometryStore::Shutdown();
+    EXPECT_FALSE(GeometryStore::Enabled());
+}
+#endif
+
+template <typename T>
+static void AppendBinary(std::string *str, T value) {
+    str->append((const char *)&value, sizeof(T));
+}
+
+TEST(TriQuadMesh, ReadBinaryPLY) {
+    // A triangle and a quad with normals, uvs, and face indices, written both
+    // as ASCII (read with rply) and as binary (read via the fast path).
+    const Float p[5][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {2, 0.5, 1}};
+    std::string header = "element vertex 5\n"
+                         "property float x\nproperty float y\nproperty float z\n"
+                         "property float nx\nproperty float ny\nproperty float nz\n"
+                         "property float u\nproperty float v\n"
+                         "element face 2\n"
+                         "property list uchar int vertex_indices\n"
+                         "property int face_indices\n"
+                         "end_header\n";
+    std::string ascii = "ply\nformat ascii 1.0\n" + header;
+    std::string binary = "ply\nformat binary_little_endian 1.0\n" + header;
+    for (int i = 0; i < 5; ++i) {
+        float values[8] = {float(p[i][0]), float(p[i][1]), float(p[i][2]), 0.f, 0.f,
+                           1.f, float(p[i][0]) / 2, float(p[i][1])};
+        for (float v : values) {
+            ascii += StringPrintf("%f ", v);
+            AppendBinary(&binary, v);
+        }
+        ascii += "\n";
+    }
+    ascii += "3 1 4 2 7\n4 0 1 2 3 9\n";
+    AppendBinary(&binary, uint8_t(3));
+    for (int v : {1, 4, 2})
+        AppendBinary(&binary, v);
+    AppendBinary(&binary, 7);
+    AppendBinary(&binary, uint8_t(4));
+    for (int v : {0, 1, 2, 3})
+        AppendBinary(&binary, v);
+    AppendBinary(&binary, 9);
+
+    ASSERT_TRUE(WriteFile("ascii.ply", ascii));
+    ASSERT_TRUE(WriteFile("binary.ply", binary));
+    TriQuadMesh a = TriQuadMesh::ReadPLY("ascii.ply");
+    TriQuadMesh b = TriQuadMesh::ReadPLY("binary.ply");
+    EXPECT_EQ(0, remove("ascii.ply"));
+    EXPECT_EQ(0, remove("binary.ply"));
+
+    EXPECT_EQ(a.p, b.p);
+    EXPECT_EQ(a.n, b.n);
+    EXPECT_EQ(a.uv, b.uv);
+    EXPECT_EQ(a.triIndices, b.triIndices);
+    EXPECT_EQ(a.quadIndices, b.quadIndices);
+    EXPECT_EQ(a.faceIndices, b.faceIndices);
+    EXPECT_EQ(3, b.triIndices.size());
+    EXPECT_EQ(4, b.quadIndices.size());
+
+    // Many triangles with double-precision positions and no other vertex
+    // attributes, which are decoded in parallel.
+    int nTriangles = 100000;
+    binary = StringPrintf("ply\nformat binary_little_endian 1.0\n"
+                          "element vertex %d\n"
+                          "property double x\nproperty double y\nproperty double z\n"
+                          "element face %d\n"
+                          "property list uchar uint vertex_indices\n"
+                          "end_header\n",
+                          3 * nTriangles, nTriangles);
+    for (int i = 0; i < 3 * nTriangles; ++i)
+        for (double v : {double(i), 2. * i, -.5 * i})
+            AppendBinary(&binary, v);
+    for (int i = 0; i < nTriangles; ++i) {
+        AppendBinary(&binary, uint8_t(3));
+        for (int j = 0; j < 3; ++j)
+            AppendBinary(&binary, uint32_t(3 * nTriangles - 1 - (3 * i + j)));
+    }
+    ASSERT_TRUE(WriteFile("many.ply", binary));
+    TriQuadMesh many = TriQuadMesh::ReadPLY("many.ply");
+    EXPECT_EQ(0, remove("many.ply"));
+
+    ASSERT_EQ(3 * nTriangles, many.p.size());
+    ASSERT_EQ(3 * nTriangles, many.triIndices.size());
+    EXPECT_TRUE(many.n.empty() && many.uv.empty() && many.quadIndices.empty());
+    for (int i = 0; i < 3 * nTriangles; ++i) {
+        EXPECT_EQ(Point3f(i, 2 * i, -.5f * i), many.p[i]);
+        EXPECT_EQ(3 * nTriangles - 1 - i, many.triIndices[i]);
+    }
+}
@@ -18,6 +18,8 @@
 #include <algorithm>
 #include <cstdlib>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <vector>
 
 namespace pbrt {
@@ -220,6 +222,7 @@ const ColorEncodingHandle ColorEncodingHandle::Get(const std::string &name) {
         return sRGB;
     else {
         static std::map<float, ColorEncodingHandle> cache;
+        static std::mutex cacheMutex;
 
         std::vector<std::string> params = SplitStringsFromWhitespace(name);
         if (params.size() != 2 || params[0] != "gamma")
@@ -228,6 +231,7 @@ const ColorEncodingHandle ColorEncodingHandle::Get(const std::string &name) {
         if (gamma == 0)
             ErrorExit("%s: unable to parse gamma value", params[1]);
 
+        std::lock_guard<std::mutex> lock(cacheMutex);
         auto iter = cache.find(gamma);
         if (iter != cache.end())
             return iter->second;
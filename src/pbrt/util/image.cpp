@@ -29,8 +29,10 @@
 #include <ImfStringVectorAttribute.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
+#include <type_traits>
 
 // use lodepng and get 16-bit.
 #define STBI_NO_PNG
@@ -94,7 +96,7 @@ const RGBColorSpace *ImageMetadata::GetColorSpace() const {
 }
 
 template <typename F>
-void ForExtent(const Bounds2i &extent, WrapMode2D wrapMode, Image &image, F op) {
+void ForExtent(const Bounds2i &extent, WrapMode2D wrapMode, const Image &image, F op) {
     CHECK_LT(extent.pMin.x, extent.pMax.x);
     CHECK_LT(extent.pMin.y, extent.pMax.y);
 
@@ -122,6 +124,42 @@ void ForExtent(const Bounds2i &extent, WrapMode2D wrapMode, Image &image, F op)
     }
 }
 
+// Invoke _func_ with the channel count as a compile-time constant for the
+// common cases so that the inner loops over texels can be vectorized.
+template <typename F>
+static void DispatchChannelCount(int nChannels, F func) {
+    switch (nChannels) {
+    case 1:
+        func(std::integral_constant<int, 1>());
+        break;
+    case 3:
+        func(std::integral_constant<int, 3>());
+        break;
+    case 4:
+        func(std::integral_constant<int, 4>());
+        break;
+    default:
+        func(std::integral_constant<int, 0>());
+    }
+}
+
+// Box-filter a block of texels down by two in each dimension. _NC_ is the
+// channel count when known at compile time and zero otherwise.
+template <int NC>
+static void BoxDownsample(const float *in, Point2i inRes, int nChannels, float *out) {
+    int nc = NC > 0 ? NC : nChannels;
+    int inWidth = nc * inRes.x, outRes = inRes.x / 2;
+    for (int y = 0; y < inRes.y / 2; ++y) {
+        const float *r0 = in + 2 * y * inWidth, *r1 = r0 + inWidth;
+        float *o = out + y * nc * outRes;
+        for (int x = 0; x < outRes; ++x)
+            for (int c = 0; c < nc; ++c) {
+                int s = 2 * x * nc + c;
+                o[x * nc + c] = .25f * (r0[s] + r0[s + nc] + r1[s] + r1[s + nc]);
+            }
+    }
+}
+
 // Image Method Definitions
 pstd::vector<Image> Image::GenerateMIPMap(Image image, WrapMode2D wrapMode,
                                           Allocator alloc) {
@@ -129,90 +167,151 @@ pstd::vector<Image> Image::GenerateMIPMap(Image image, WrapMode2D wrapMode,
     int nChannels = image.NChannels();
     ColorEncodingHandle origEncoding = image.encoding;
 
-    // Set things up so we have a power-of-two sized image stored with
-    // floats.
-    if (!IsPowerOf2(image.resolution[0]) || !IsPowerOf2(image.resolution[1])) {
-        // Resample image to power-of-two resolution
+    // Resample image to power-of-two resolution if needed
+    if (!IsPowerOf2(image.resolution[0]) || !IsPowerOf2(image.resolution[1]))
         image = image.FloatResize(
             {RoundUpPow2(image.resolution[0]), RoundUpPow2(image.resolution[1])},
             wrapMode);
-    } else if (!Is32Bit(image.format))
-        image = image.ConvertToFormat(PixelFormat::Float);
-    CHECK(Is32Bit(image.format));
 
-    // Initialize levels of MIPMap from image
+    // Allocate all levels of the MIPMap in the original pixel format
     int nLevels = 1 + Log2Int(std::max(image.resolution[0], image.resolution[1]));
     pstd::vector<Image> pyramid(alloc);
     pyramid.reserve(nLevels);
-
     Point2i levelResolution = image.resolution;
-    for (int i = 0; i < nLevels - 1; ++i) {
-        // Initialize $i+1$st MIPMap level from $i$th level and also convert
-        // i'th level to the internal format
+    for (int i = 0; i < nLevels; ++i) {
         pyramid.push_back(
             Image(origFormat, levelResolution, image.channelNames, origEncoding, alloc));
+        levelResolution = Point2i(std::max(1, levelResolution[0] / 2),
+                                  std::max(1, levelResolution[1] / 2));
+    }
 
-        Point2i nextResolution(std::max(1, levelResolution[0] / 2),
-                               std::max(1, levelResolution[1] / 2));
-        Image nextImage(image.format, nextResolution, image.channelNames, origEncoding);
-
-        // Offsets from the base pixel to the four neighbors that we'll
-        // downfilter.
-        int srcDeltas[4] = {0, nChannels, nChannels * levelResolution[0],
-                            nChannels * levelResolution[0] + nChannels};
-        // Clamp offsets once a dimension has a single texel.
-        if (levelResolution[0] == 1) {
-            srcDeltas[1] = 0;
-            srcDeltas[3] -= nChannels;
-        }
-        if (levelResolution[1] == 1) {
-            srcDeltas[2] = 0;
-            srcDeltas[3] -= nChannels * levelResolution[0];
+    // Generate the finer levels tile by tile: each tile of the base level is
+    // converted to floats once and then repeatedly box filtered in a
+    // thread-local buffer, writing its footprint in each level as it goes.
+    // Since the resolution is a power of two, tiles never share texels until
+    // a tile has been reduced to a single row or column.
+    constexpr int TileSize = 64;
+    Point2i tileRes(std::min(TileSize, image.resolution[0]),
+                    std::min(TileSize, image.resolution[1]));
+    Point2i nTiles(image.resolution[0] / tileRes[0], image.resolution[1] / tileRes[1]);
+    int nTileLevels = Log2Int(std::min(tileRes[0], tileRes[1]));
+    levelResolution = Point2i(image.resolution[0] >> nTileLevels,
+                              image.resolution[1] >> nTileLevels);
+    Image levelImage(PixelFormat::Float, levelResolution, image.channelNames);
+
+    thread_local std::vector<float> tileBuf, nextTileBuf;
+    ParallelFor(0, nTiles[0] * nTiles[1], [&](int64_t tileIndex) {
+        Point2i tile(tileIndex % nTiles[0], tileIndex / nTiles[0]);
+        Point2i res = tileRes;
+        size_t bufSize = nChannels * res[0] * res[1];
+        if (tileBuf.size() < bufSize) {
+            tileBuf.resize(bufSize);
+            nextTileBuf.resize(bufSize);
         }
 
-        // Work in scanlines for best cache coherence (vs 2d tiles).
-        ParallelFor(0, nextResolution[1], [&](int64_t y0, int64_t y1) {
-            for (int y = y0; y < y1; ++y) {
-                // Downfilter with a box filter for the next MIP level
-                int srcOffset = image.PixelOffset({0, 2 * y});
-                int nextOffset = nextImage.PixelOffset({0, y});
-                for (int x = 0; x < nextResolution[0]; ++x) {
-                    for (int c = 0; c < nChannels; ++c) {
-                        nextImage.p32[nextOffset] =
-                            .25f *
-                            (image.p32[srcOffset] + image.p32[srcOffset + srcDeltas[1]] +
-                             image.p32[srcOffset + srcDeltas[2]] +
-                             image.p32[srcOffset + srcDeltas[3]]);
-                        ++srcOffset;
-                        ++nextOffset;
-                    }
-                    srcOffset += nChannels;
-                }
+        Bounds2i extent({tile[0] * res[0], tile[1] * res[1]},
+                        {(tile[0] + 1) * res[0], (tile[1] + 1) * res[1]});
+        image.CopyRectOut(extent, pstd::MakeSpan(tileBuf));
+        pyramid[0].CopyRectIn(extent, tileBuf);
 
-                // Copy the current level out to the current pyramid level
-                int yStart = 2 * y;
-                int yEnd = std::min(2 * y + 2, levelResolution[1]);
-                int offset = image.PixelOffset({0, yStart});
-                size_t count = (yEnd - yStart) * nChannels * levelResolution[0];
-                pyramid[i].CopyRectIn(Bounds2i({0, yStart}, {levelResolution[0], yEnd}),
-                                      {image.p32.data() + offset, count});
-            }
-        });
+        for (int level = 1; level <= nTileLevels; ++level) {
+            DispatchChannelCount(nChannels, [&](auto nc) {
+                BoxDownsample<decltype(nc)::value>(tileBuf.data(), res, nChannels,
+                                                   nextTileBuf.data());
+            });
+            std::swap(tileBuf, nextTileBuf);
+            res = Point2i(res[0] / 2, res[1] / 2);
+            extent = Bounds2i({tile[0] * res[0], tile[1] * res[1]},
+                              {(tile[0] + 1) * res[0], (tile[1] + 1) * res[1]});
+            pyramid[level].CopyRectIn(extent, tileBuf);
+        }
+        // Keep the unquantized texels of the last level for the remaining ones
+        levelImage.CopyRectIn(extent, tileBuf);
+    });
 
-        image = std::move(nextImage);
-        levelResolution = nextResolution;
+    // Downfilter the remaining, much smaller, levels one at a time
+    for (int i = nTileLevels; i < nLevels - 1; ++i) {
+        levelImage = boxDownsampleLevel(levelImage);
+        levelResolution = levelImage.resolution;
+        pyramid[i + 1].CopyRectIn(Bounds2i({0, 0}, levelResolution), levelImage.p32);
     }
-
-    // Top level
     CHECK(levelResolution[0] == 1 && levelResolution[1] == 1);
-    pyramid.push_back(
-        Image(origFormat, levelResolution, image.channelNames, origEncoding, alloc));
-    pyramid[nLevels - 1].CopyRectIn({{0, 0}, {1, 1}},
-                                    {image.p32.data(), size_t(nChannels)});
 
     return pyramid;
 }
 
+void Image::GenerateMIPMapLevels(Image image, WrapMode2D wrapMode,
+                                 std::function<void(int, Image)> levelCallback) {
+    PixelFormat origFormat = image.format;
+    ColorEncodingHandle origEncoding = image.encoding;
+
+    // Resample image to power-of-two resolution if needed
+    if (!IsPowerOf2(image.resolution[0]) || !IsPowerOf2(image.resolution[1]))
+        image = image.FloatResize(
+            {RoundUpPow2(image.resolution[0]), RoundUpPow2(image.resolution[1])},
+            wrapMode);
+
+    // Filter in floating point, quantizing each level to the original format
+    // only when handing it off, just as GenerateMIPMap() does
+    Image levelImage(PixelFormat::Float, image.resolution, image.channelNames);
+    image.CopyRectOut(Bounds2i({0, 0}, image.resolution), pstd::MakeSpan(levelImage.p32));
+    image = Image();
+    for (int level = 0;; ++level) {
+        Point2i res = levelImage.resolution;
+        Image out(origFormat, res, levelImage.channelNames, origEncoding);
+        out.CopyRectIn(Bounds2i({0, 0}, res), levelImage.p32);
+        levelCallback(level, std::move(out));
+        if (res[0] == 1 && res[1] == 1)
+            break;
+        levelImage = boxDownsampleLevel(levelImage);
+    }
+}
+
+Image Image::boxDownsampleLevel(const Image &levelImage) {
+    CHECK(levelImage.format == PixelFormat::Float);
+    Point2i levelResolution = levelImage.resolution;
+    int nChannels = levelImage.NChannels();
+    Point2i nextResolution(std::max(1, levelResolution[0] / 2),
+                           std::max(1, levelResolution[1] / 2));
+    Image nextImage(PixelFormat::Float, nextResolution, levelImage.channelNames);
+
+    // Offsets from the base pixel to the four neighbors that we'll
+    // downfilter.
+    int srcDeltas[4] = {0, nChannels, nChannels * levelResolution[0],
+                        nChannels * levelResolution[0] + nChannels};
+    // Clamp offsets once a dimension has a single texel.
+    if (levelResolution[0] == 1) {
+        srcDeltas[1] = 0;
+        srcDeltas[3] -= nChannels;
+    }
+    if (levelResolution[1] == 1) {
+        srcDeltas[2] = 0;
+        srcDeltas[3] -= nChannels * levelResolution[0];
+    }
+
+    // Work in scanlines for best cache coherence (vs 2d tiles).
+    ParallelFor(0, nextResolution[1], [&](int64_t y0, int64_t y1) {
+        for (int y = y0; y < y1; ++y) {
+            // Downfilter with a box filter for the next MIP level
+            int srcOffset = levelImage.PixelOffset({0, 2 * y});
+            int nextOffset = nextImage.PixelOffset({0, y});
+            for (int x = 0; x < nextResolution[0]; ++x) {
+                for (int c = 0; c < nChannels; ++c) {
+                    nextImage.p32[nextOffset] =
+                        .25f * (levelImage.p32[srcOffset] +
+                                levelImage.p32[srcOffset + srcDeltas[1]] +
+                                levelImage.p32[srcOffset + srcDeltas[2]] +
+                                levelImage.p32[srcOffset + srcDeltas[3]]);
+                    ++srcOffset;
+                    ++nextOffset;
+                }
+                srcOffset += nChannels;
+            }
+        }
+    });
+    return nextImage;
+}
+
 Image::Image(PixelFormat format, Point2i resolution,
              pstd::span<const std::string> channels, ColorEncodingHandle encoding,
              Allocator alloc)
@@ -388,8 +487,7 @@ Image Image::FloatResize(Point2i newResolution, WrapMode2D wrapMode) const {
         // into floats all at once, rather than repeatedly
         // and pixel-by-pixel during the first resampling
         // step.)
-        // FIXME CAST
-        ((Image *)this)->CopyRectOut(inExtent, pstd::MakeSpan(inBuf), wrapMode);
+        CopyRectOut(inExtent, pstd::MakeSpan(inBuf), wrapMode);
 
         // Zoom in x. We need to do this across all scanlines
         // in inExtent's y dimension so we have the border
@@ -402,56 +500,48 @@ Image Image::FloatResize(Point2i newResolution, WrapMode2D wrapMode) const {
         if (xBuf.size() < NChannels() * nyIn * nxOut)
             xBuf.resize(NChannels() * nyIn * nxOut);
 
-        int xBufOffset = 0;
-        for (int y = 0; y < nyIn; ++y) {
-            for (int x = 0; x < nxOut; ++x) {
-                int xOut = x + outExtent[0][0];
-                DCHECK(xOut >= 0 && xOut < xWeights.size());
-                const ResampleWeight &rsw = xWeights[xOut];
-
-                // w.r.t. inBuf
-                int xIn = rsw.firstTexel - inExtent[0][0];
-                DCHECK_GE(xIn, 0);
-                DCHECK_LT(xIn + 3, nxIn);
-
-                int inOffset = NChannels() * (xIn + y * nxIn);
-                DCHECK_GE(inOffset, 0);
-                DCHECK_LT(inOffset + 3 * NChannels(), inBuf.size());
-                for (int c = 0; c < NChannels(); ++c, ++xBufOffset, ++inOffset) {
-                    xBuf[xBufOffset] =
-                        (rsw.weight[0] * inBuf[inOffset] +
-                         rsw.weight[1] * inBuf[inOffset + NChannels()] +
-                         rsw.weight[2] * inBuf[inOffset + 2 * NChannels()] +
-                         rsw.weight[3] * inBuf[inOffset + 3 * NChannels()]);
+        // The x weights are the same for every scanline; process all
+        // channels of all texels of a scanline in a single pass.
+        DispatchChannelCount(NChannels(), [&](auto ncConst) {
+            constexpr int NC = decltype(ncConst)::value;
+            int nc = NC > 0 ? NC : NChannels();
+            for (int y = 0; y < nyIn; ++y) {
+                const float *inRow = inBuf.data() + nc * y * nxIn;
+                float *xRow = xBuf.data() + nc * y * nxOut;
+                for (int x = 0; x < nxOut; ++x) {
+                    const ResampleWeight &rsw = xWeights[x + outExtent[0][0]];
+                    // w.r.t. inBuf
+                    int xIn = rsw.firstTexel - inExtent[0][0];
+                    DCHECK(xIn >= 0 && xIn + 3 < nxIn);
+                    const float *in = inRow + nc * xIn;
+                    for (int c = 0; c < nc; ++c)
+                        xRow[nc * x + c] =
+                            (rsw.weight[0] * in[c] + rsw.weight[1] * in[c + nc] +
+                             rsw.weight[2] * in[c + 2 * nc] +
+                             rsw.weight[3] * in[c + 3 * nc]);
                 }
             }
-        }
+        });
 
         if (outBuf.size() < NChannels() * nxOut * nyOut)
             outBuf.resize(NChannels() * nxOut * nyOut);
 
-        // Zoom in y from xBuf to outBuf
-        for (int x = 0; x < nxOut; ++x) {
-            for (int y = 0; y < nyOut; ++y) {
-                int yOut = y + outExtent[0][1];
-                DCHECK(yOut >= 0 && yOut < yWeights.size());
-                const ResampleWeight &rsw = yWeights[yOut];
-
-                DCHECK_GE(rsw.firstTexel - inExtent[0][1], 0);
-                int xBufOffset =
-                    NChannels() * (x + nxOut * (rsw.firstTexel - inExtent[0][1]));
-                DCHECK_GE(xBufOffset, 0);
-                int step = NChannels() * nxOut;
-                DCHECK_LT(xBufOffset + 3 * step, xBuf.size());
-
-                int outOffset = NChannels() * (x + y * nxOut);
-                for (int c = 0; c < NChannels(); ++c, ++outOffset, ++xBufOffset)
-                    outBuf[outOffset] =
-                        std::max<Float>(0, (rsw.weight[0] * xBuf[xBufOffset] +
-                                            rsw.weight[1] * xBuf[xBufOffset + step] +
-                                            rsw.weight[2] * xBuf[xBufOffset + 2 * step] +
-                                            rsw.weight[3] * xBuf[xBufOffset + 3 * step]));
-            }
+        // Zoom in y from xBuf to outBuf. Each output scanline is a weighted
+        // sum of four contiguous xBuf scanlines, so the inner loop runs
+        // across all texels and channels at once.
+        int rowLength = NChannels() * nxOut;
+        for (int y = 0; y < nyOut; ++y) {
+            const ResampleWeight &rsw = yWeights[y + outExtent[0][1]];
+            int yIn = rsw.firstTexel - inExtent[0][1];
+            DCHECK(yIn >= 0 && yIn + 3 < nyIn);
+            const float *in0 = xBuf.data() + rowLength * yIn, *in1 = in0 + rowLength;
+            const float *in2 = in1 + rowLength, *in3 = in2 + rowLength;
+            Float w0 = rsw.weight[0], w1 = rsw.weight[1], w2 = rsw.weight[2],
+                  w3 = rsw.weight[3];
+            float *out = outBuf.data() + rowLength * y;
+            for (int i = 0; i < rowLength; ++i)
+                out[i] = std::max<Float>(
+                    0, (w0 * in0[i] + w1 * in1[i] + w2 * in2[i] + w3 * in3[i]));
         }
         // Copy out...
         resampledImage.CopyRectIn(outExtent, outBuf);
@@ -657,7 +747,7 @@ ImageChannelValues Image::Average(const ImageChannelDesc &desc) const {
 }
 
 void Image::CopyRectOut(const Bounds2i &extent, pstd::span<float> buf,
-                        WrapMode2D wrapMode) {
+                        WrapMode2D wrapMode) const {
     CHECK_GE(buf.size(), extent.Area() * NChannels());
 
     auto bufIter = buf.begin();
@@ -1350,6 +1440,143 @@ std::string Image::ToString() const {
                         encoding ? encoding.ToString().c_str() : "(nullptr)");
 }
 
+// BlockCompressedImage Method Definitions
+BlockCompressedImage::BlockCompressedImage(const Image &image, Allocator alloc)
+    : resolution(image.Resolution()),
+      nBlocks((resolution.x + BlockSize - 1) / BlockSize,
+              (resolution.y + BlockSize - 1) / BlockSize),
+      nChannels(image.NChannels()),
+      ldrBlocks(alloc),
+      rgbBlocks(alloc),
+      hdrBlocks(alloc) {
+    bool ldr = image.Format() == PixelFormat::U256;
+    size_t nBlocksTotal = size_t(nBlocks.x) * nBlocks.y;
+    if (ldr) {
+        encoding = image.Encoding();
+        if (nChannels == 3)
+            rgbBlocks.resize(nBlocksTotal);
+        else
+            ldrBlocks.resize(nChannels * nBlocksTotal);
+    } else
+        hdrBlocks.resize(nChannels * nBlocksTotal);
+
+    // Quantize each texel to the nearest of the eight values between the
+    // block's endpoints and pack the 3-bit indices
+    auto encodeIndices = [](const Float v[16], Float v0, Float v1, uint8_t indices[6]) {
+        uint64_t bits = 0;
+        if (v1 > v0)
+            for (int i = 0; i < 16; ++i) {
+                int index = std::round(7 * (v[i] - v0) / (v1 - v0));
+                bits |= uint64_t(Clamp(index, 0, 7)) << (3 * i);
+            }
+        for (int i = 0; i < 6; ++i)
+            indices[i] = (bits >> (8 * i)) & 0xff;
+    };
+
+    ParallelFor(0, nBlocks.y, [&](int64_t by) {
+        for (int bx = 0; bx < nBlocks.x; ++bx) {
+            // Gather a channel of the block's texels, replicating edge texels
+            // for partial blocks
+            auto gather = [&](int c, Float v[16]) {
+                for (int i = 0; i < 16; ++i) {
+                    Point2i p(std::min<int>(bx * BlockSize + i % BlockSize,
+                                            resolution.x - 1),
+                              std::min<int>(by * BlockSize + i / BlockSize,
+                                            resolution.y - 1));
+                    if (ldr)
+                        v[i] = ((const uint8_t *)image.RawPointer(p))[c];
+                    else
+                        v[i] = image.GetChannel(p, c);
+                }
+            };
+            size_t block = by * nBlocks.x + bx;
+
+            if (!rgbBlocks.empty()) {
+                // Find the principal axis of the block's colors using power
+                // iteration, starting with the covariance matrix's column for
+                // the channel with the most variance
+                Float v[3][16], mean[3], cov[3][3] = {};
+                for (int c = 0; c < 3; ++c) {
+                    gather(c, v[c]);
+                    mean[c] = std::accumulate(v[c], v[c] + 16, Float(0)) / 16;
+                }
+                for (int i = 0; i < 16; ++i)
+                    for (int c0 = 0; c0 < 3; ++c0)
+                        for (int c1 = 0; c1 < 3; ++c1)
+                            cov[c0][c1] += (v[c0][i] - mean[c0]) * (v[c1][i] - mean[c1]);
+                int cMax = cov[1][1] > cov[0][0] ? 1 : 0;
+                if (cov[2][2] > cov[cMax][cMax])
+                    cMax = 2;
+                Vector3f axis(cov[0][cMax], cov[1][cMax], cov[2][cMax]);
+                for (int iter = 0; iter < 8 && LengthSquared(axis) > 0; ++iter) {
+                    Vector3f a = Normalize(axis);
+                    for (int c = 0; c < 3; ++c)
+                        axis[c] = cov[c][0] * a.x + cov[c][1] * a.y + cov[c][2] * a.z;
+                }
+                if (LengthSquared(axis) > 0)
+                    axis = Normalize(axis);
+
+                // Place the endpoints at the extent of the colors along the axis
+                Float tMin = Infinity, tMax = -Infinity;
+                for (int i = 0; i < 16; ++i) {
+                    Float t = 0;
+                    for (int c = 0; c < 3; ++c)
+                        t += (v[c][i] - mean[c]) * axis[c];
+                    tMin = std::min(tMin, t);
+                    tMax = std::max(tMax, t);
+                }
+                RGBBlock &b = rgbBlocks[block];
+                Vector3f e[2];
+                for (int c = 0; c < 3; ++c) {
+                    e[0][c] = b.endpoints[0][c] =
+                        Clamp(std::round(mean[c] + tMin * axis[c]), 0, 255);
+                    e[1][c] = b.endpoints[1][c] =
+                        Clamp(std::round(mean[c] + tMax * axis[c]), 0, 255);
+                }
+
+                // Encode indices for the colors' positions along the segment
+                // between the rounded endpoints
+                Vector3f d = e[1] - e[0];
+                Float t[16] = {};
+                if (LengthSquared(d) > 0)
+                    for (int i = 0; i < 16; ++i)
+                        t[i] = Dot(Vector3f(v[0][i], v[1][i], v[2][i]) - e[0], d) /
+                               LengthSquared(d);
+                encodeIndices(t, 0, 1, b.indices);
+                continue;
+            }
+
+            for (int c = 0; c < nChannels; ++c) {
+                Float v[16];
+                gather(c, v);
+                Float vMin = *std::min_element(v, v + 16);
+                Float vMax = *std::max_element(v, v + 16);
+                if (ldr) {
+                    LDRBlock &b = ldrBlocks[nChannels * block + c];
+                    b.endpoints[0] = vMin;
+                    b.endpoints[1] = vMax;
+                    encodeIndices(v, vMin, vMax, b.indices);
+                } else {
+                    // Encode indices with respect to the rounded endpoints
+                    HDRBlock &b = hdrBlocks[nChannels * block + c];
+                    b.endpoints[0] = Half(vMin);
+                    b.endpoints[1] = Half(vMax);
+                    encodeIndices(v, Float(b.endpoints[0]), Float(b.endpoints[1]),
+                                  b.indices);
+                }
+            }
+        }
+    });
+}
+
+std::string BlockCompressedImage::ToString() const {
+    return StringPrintf("[ BlockCompressedImage resolution: %s nChannels: %d "
+                        "encoding: %s bytes: %d ]",
+                        resolution, nChannels,
+                        encoding ? encoding.ToString().c_str() : "(nullptr)",
+                        BytesUsed());
+}
+
 bool Image::WritePNG(const std::string &name, const ImageMetadata &metadata) const {
     unsigned int error = 0;
     int nOutOfGamut = 0;
@@ -279,9 +279,8 @@ class Image {
     ImageChannelValues GetChannels(Point2i p, const ImageChannelDesc &desc,
                                    WrapMode2D wrapMode = WrapMode::Clamp) const;
 
-    // FIXME: could be / should be const...
     void CopyRectOut(const Bounds2i &extent, pstd::span<float> buf,
-                     WrapMode2D wrapMode = WrapMode::Clamp);
+                     WrapMode2D wrapMode = WrapMode::Clamp) const;
     void CopyRectIn(const Bounds2i &extent, pstd::span<const float> buf);
 
     PBRT_CPU_GPU
@@ -345,6 +344,10 @@ class Image {
     void FlipY();
     static pstd::vector<Image> GenerateMIPMap(Image image, WrapMode2D wrapMode,
                                               Allocator alloc = {});
+    // Generates the same levels as GenerateMIPMap(), but one at a time,
+    // passing each to _levelCallback_ so that they needn't all be in memory.
+    static void GenerateMIPMapLevels(Image image, WrapMode2D wrapMode,
+                                     std::function<void(int, Image)> levelCallback);
 
     PBRT_CPU_GPU
     PixelFormat Format() const { return format; }
@@ -403,6 +406,7 @@ class Image {
 
   private:
     static std::vector<ResampleWeight> resampleWeights(int oldRes, int newRes);
+    static Image boxDownsampleLevel(const Image &levelImage);
 
     PixelFormat format;
     Point2i resolution;
@@ -420,6 +424,107 @@ class Image {
     pstd::vector<float> p32;
 };
 
+// BlockCompressedImage Definition
+class BlockCompressedImage {
+  public:
+    // BlockCompressedImage Public Methods
+    BlockCompressedImage(Allocator alloc = {})
+        : ldrBlocks(alloc), rgbBlocks(alloc), hdrBlocks(alloc) {}
+    BlockCompressedImage(const Image &image, Allocator alloc = {});
+
+    Point2i Resolution() const { return resolution; }
+    int NChannels() const { return nChannels; }
+    size_t BytesUsed() const {
+        return ldrBlocks.size() * sizeof(LDRBlock) + rgbBlocks.size() * sizeof(RGBBlock) +
+               hdrBlocks.size() * sizeof(HDRBlock);
+    }
+
+    Float GetChannel(Point2i p, int c, WrapMode2D wrapMode = WrapMode::Clamp) const {
+        if (!RemapPixelCoords(&p, resolution, wrapMode))
+            return 0;
+        return DecodeTexel(BlockIndex(p), c, TexelIndex(p));
+    }
+    void GetChannels(Point2i p, WrapMode2D wrapMode, Float *values) const {
+        if (!RemapPixelCoords(&p, resolution, wrapMode)) {
+            for (int c = 0; c < nChannels; ++c)
+                values[c] = 0;
+            return;
+        }
+        size_t block = BlockIndex(p);
+        int texel = TexelIndex(p);
+        for (int c = 0; c < nChannels; ++c)
+            values[c] = DecodeTexel(block, c, texel);
+    }
+
+    std::string ToString() const;
+
+    static constexpr int BlockSize = 4;
+
+  private:
+    // Each block stores a 4x4 footprint as two endpoints and a 3-bit index
+    // per texel that selects one of eight evenly spaced values between
+    // them. 8-bit images keep their encoded values as endpoints; for RGB,
+    // one block holds all three channels and its endpoints are the ends of
+    // the block's principal color axis, which makes it a quarter of the
+    // size of the texels but loses detail where the channels vary
+    // independently. The other images have a block per channel with linear
+    // half-precision endpoints.
+    struct LDRBlock {
+        uint8_t endpoints[2];
+        uint8_t indices[6];
+    };
+    struct RGBBlock {
+        uint8_t endpoints[2][3];
+        uint8_t indices[6];
+    };
+    struct HDRBlock {
+        Half endpoints[2];
+        uint8_t indices[6];
+    };
+
+    // BlockCompressedImage Private Methods
+    size_t BlockIndex(Point2i p) const {
+        return size_t(p.y / BlockSize) * nBlocks.x + size_t(p.x / BlockSize);
+    }
+    static int TexelIndex(Point2i p) {
+        return (p.y % BlockSize) * BlockSize + (p.x % BlockSize);
+    }
+    static int GetIndex(const uint8_t indices[6], int texel) {
+        int bit = 3 * texel, byte = bit / 8, shift = bit % 8;
+        int bits = indices[byte] | (byte < 5 ? (indices[byte + 1] << 8) : 0);
+        return (bits >> shift) & 7;
+    }
+    Float DecodeTexel(size_t block, int c, int texel) const {
+        if (encoding) {
+            uint8_t v;
+            if (!rgbBlocks.empty()) {
+                const RGBBlock &b = rgbBlocks[block];
+                int i = GetIndex(b.indices, texel);
+                v = (b.endpoints[0][c] * (7 - i) + b.endpoints[1][c] * i + 3) / 7;
+            } else {
+                const LDRBlock &b = ldrBlocks[nChannels * block + c];
+                int i = GetIndex(b.indices, texel);
+                v = (b.endpoints[0] * (7 - i) + b.endpoints[1] * i + 3) / 7;
+            }
+            Float r;
+            encoding.ToLinear({&v, 1}, {&r, 1});
+            return r;
+        }
+        const HDRBlock &b = hdrBlocks[nChannels * block + c];
+        return Lerp(GetIndex(b.indices, texel) / Float(7), Float(b.endpoints[0]),
+                    Float(b.endpoints[1]));
+    }
+
+    // BlockCompressedImage Private Members
+    Point2i resolution, nBlocks;
+    int nChannels = 0;
+    // Non-null only for blocks compressed from 8-bit images.
+    ColorEncodingHandle encoding = nullptr;
+    pstd::vector<LDRBlock> ldrBlocks;
+    pstd::vector<RGBBlock> rgbBlocks;
+    pstd::vector<HDRBlock> hdrBlocks;
+};
+
 // ImageAndMetadata Definition
 struct ImageAndMetadata {
     Image image;
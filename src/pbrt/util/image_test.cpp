@@ -6,12 +6,15 @@
 
 #include <pbrt/pbrt.h>
 
+#include <pbrt/options.h>
 #include <pbrt/util/color.h>
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/file.h>
 #include <pbrt/util/float.h>
 #include <pbrt/util/image.h>
 #include <pbrt/util/mipmap.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/progressreporter.h>
 #include <pbrt/util/rng.h>
 #include <pbrt/util/sampling.h>
 
@@ -615,6 +618,175 @@ TEST(Image, Select) {
         }
 }
 
+TEST(Image, GenerateMIPMap) {
+    // Wide enough for several tiles in x but fewer texels than a tile in y,
+    // so that both the per-tile and the per-level downfiltering are used.
+    for (Point2i res : {Point2i(512, 32), Point2i(256, 256), Point2i(1, 8)}) {
+        Image image(PixelFormat::Float, res, {"R", "G", "B"});
+        RNG rng;
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel({x, y}, c, rng.Uniform<Float>());
+
+        pstd::vector<Image> pyramid = Image::GenerateMIPMap(image, WrapMode::Clamp);
+        ASSERT_EQ(1 + Log2Int(std::max(res.x, res.y)), pyramid.size());
+        for (size_t level = 1; level < pyramid.size(); ++level) {
+            const Image &prev = pyramid[level - 1], &cur = pyramid[level];
+            ASSERT_EQ(Point2i(std::max(1, prev.Resolution().x / 2),
+                              std::max(1, prev.Resolution().y / 2)),
+                      cur.Resolution());
+            for (int y = 0; y < cur.Resolution().y; ++y)
+                for (int x = 0; x < cur.Resolution().x; ++x)
+                    for (int c = 0; c < 3; ++c) {
+                        Float v = .25f * (prev.GetChannel({2 * x, 2 * y}, c) +
+                                          prev.GetChannel({2 * x + 1, 2 * y}, c) +
+                                          prev.GetChannel({2 * x, 2 * y + 1}, c) +
+                                          prev.GetChannel({2 * x + 1, 2 * y + 1}, c));
+                        EXPECT_EQ(v, cur.GetChannel({x, y}, c))
+                            << res << " level " << level << " " << x << ", " << y;
+                    }
+        }
+    }
+}
+
+TEST(Image, DISABLED_ResampleBenchmark) {
+    Point2i res(3000, 2000);
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float}) {
+        Image image(format, res, {"R", "G", "B"}, ColorEncodingHandle::sRGB);
+        ParallelFor(0, res.y, [&](int64_t y) {
+            RNG rng(y);
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel({x, int(y)}, c, rng.Uniform<Float>());
+        });
+
+        Timer resizeTimer;
+        Image resized = image.FloatResize({4096, 2048}, WrapMode::Repeat);
+        double resizeSeconds = resizeTimer.ElapsedSeconds();
+
+        Image pow2Image = resized.ConvertToFormat(format, ColorEncodingHandle::sRGB);
+        Timer mipTimer;
+        pstd::vector<Image> pyramid = Image::GenerateMIPMap(pow2Image, WrapMode::Repeat);
+        double mipSeconds = mipTimer.ElapsedSeconds();
+
+        printf("%s: FloatResize %.3fs, GenerateMIPMap (power of 2) %.3fs\n",
+               ToString(format).c_str(), resizeSeconds, mipSeconds);
+    }
+}
+
+TEST(Image, BlockCompressed) {
+    // Odd resolution so that there are partial blocks at the edges
+    Point2i res(37, 22);
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float}) {
+        Image image(format, res, {"R", "G", "B"}, ColorEncodingHandle::Linear);
+        RNG rng;
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel({x, y}, c,
+                                     Float(x + y) / (res.x + res.y) +
+                                         .1f * rng.Uniform<Float>());
+
+        BlockCompressedImage compressed(image);
+        EXPECT_EQ(res, compressed.Resolution());
+        EXPECT_EQ(3, compressed.NChannels());
+        EXPECT_LT(compressed.BytesUsed(), image.BytesUsed());
+
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c) {
+                    // Each texel is within half a step of the block's
+                    // endpoints, plus the endpoints' own quantization error.
+                    int x0 = x / 4 * 4, y0 = y / 4 * 4;
+                    Float vMin = Infinity, vMax = -Infinity;
+                    RGB sum, vs[16];
+                    int n = 0;
+                    for (int yy = y0; yy < std::min(y0 + 4, res.y); ++yy)
+                        for (int xx = x0; xx < std::min(x0 + 4, res.x); ++xx) {
+                            vMin = std::min(vMin, image.GetChannel({xx, yy}, c));
+                            vMax = std::max(vMax, image.GetChannel({xx, yy}, c));
+                            for (int cc = 0; cc < 3; ++cc)
+                                vs[n][cc] = image.GetChannel({xx, yy}, cc);
+                            sum += vs[n++];
+                        }
+                    Float tolerance = (vMax - vMin) / 14 + 2e-3f;
+                    if (format == PixelFormat::U256) {
+                        // 8-bit RGB texels are only as close as the block's
+                        // colors are to the line between its endpoints,
+                        // which is within their distance from the mean.
+                        Float radius = 0;
+                        for (int i = 0; i < n; ++i) {
+                            RGB d = vs[i] - sum / n;
+                            radius = std::max(radius, std::sqrt(Sqr(d.r) + Sqr(d.g) +
+                                                                Sqr(d.b)));
+                        }
+                        tolerance = radius * 8 / 7 + 2.f / 255;
+                    }
+                    EXPECT_LE(std::abs(image.GetChannel({x, y}, c) -
+                                       compressed.GetChannel({x, y}, c)),
+                              tolerance)
+                        << ToString(format) << " " << x << ", " << y;
+                }
+
+        // Constant blocks are exact
+        Image constant(format, {4, 4}, {"Y"}, ColorEncodingHandle::Linear);
+        for (int y = 0; y < 4; ++y)
+            for (int x = 0; x < 4; ++x)
+                constant.SetChannel({x, y}, 0, .5f);
+        BlockCompressedImage compressedConstant(constant);
+        EXPECT_EQ(constant.GetChannel({1, 2}, 0), compressedConstant.GetChannel({1, 2}, 0));
+    }
+}
+
+TEST(Image, DISABLED_BlockCompressedBenchmark) {
+    Point2i res(2048, 2048);
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float}) {
+        // Smooth variation plus some fine detail, roughly like a photographic texture
+        Image image(format, res, {"R", "G", "B"}, ColorEncodingHandle::sRGB);
+        ParallelFor(0, res.y, [&](int64_t y) {
+            RNG rng(y);
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel({x, int(y)}, c,
+                                     .5f + .4f * std::sin(x * .01f * (c + 1)) *
+                                               std::cos(y * .013f) +
+                                         .05f * rng.Uniform<Float>());
+        });
+        BlockCompressedImage compressed(image);
+
+        double sumSquaredError = 0;
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    sumSquaredError += Sqr(image.GetChannel({x, y}, c) -
+                                           compressed.GetChannel({x, y}, c));
+
+        int nLookups = 1 << 24;
+        RNG rng;
+        Float sum = 0;
+        Timer imageTimer;
+        for (int i = 0; i < nLookups; ++i)
+            sum += image.GetChannel({int(rng.Uniform<uint32_t>() % res.x),
+                                     int(rng.Uniform<uint32_t>() % res.y)},
+                                    i % 3);
+        double imageSeconds = imageTimer.ElapsedSeconds();
+        Timer compressedTimer;
+        for (int i = 0; i < nLookups; ++i)
+            sum += compressed.GetChannel({int(rng.Uniform<uint32_t>() % res.x),
+                                          int(rng.Uniform<uint32_t>() % res.y)},
+                                         i % 3);
+        double compressedSeconds = compressedTimer.ElapsedSeconds();
+
+        printf("%s: %zu -> %zu bytes (%.2fx), RMS error %f, "
+               "lookup %.2f ns -> %.2f ns (%f)\n",
+               ToString(format).c_str(), image.BytesUsed(), compressed.BytesUsed(),
+               double(image.BytesUsed()) / compressed.BytesUsed(),
+               std::sqrt(sumSquaredError / (3. * res.x * res.y)),
+               1e9 * imageSeconds / nLookups, 1e9 * compressedSeconds / nLookups, sum);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 static std::string inTestDir(const std::string &path) {
@@ -694,3 +866,196 @@ TEST(ImageIO, RoundTripPFM) {
 TEST(ImageIO, RoundTripPNG) {
     TestRoundTrip("out.png");
 }
+
+TEST(MIPMap, TiledLookupsMatch) {
+    // Odd resolution so that the pyramid is resampled and edge tiles are partial
+    Image image(PixelFormat::Half, {300, 130}, {"R", "G", "B"});
+    RNG rng;
+    for (int y = 0; y < image.Resolution().y; ++y)
+        for (int x = 0; x < image.Resolution().x; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, y}, c, rng.Uniform<Float>());
+
+    MIPMapFilterOptions options;
+    MIPMap mipmap(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(), options);
+
+    // Keep only a handful of tiles resident so that lookups keep evicting
+    TextureTileCache::Init(4 * TiledImagePyramid::TileSize * TiledImagePyramid::TileSize *
+                           3 * TexelBytes(PixelFormat::Half));
+    {
+        // Two pyramids so that they share the scratch tile file
+        MIPMap tiled(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(), options);
+        MIPMap tiled2(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(), options);
+        ASSERT_EQ(mipmap.Levels(), tiled.Levels());
+
+        ParallelFor(0, 4096, [&](int64_t i) {
+            RNG rng(i);
+            Point2f st(2 * rng.Uniform<Float>() - 0.5f, 2 * rng.Uniform<Float>() - 0.5f);
+            Vector2f dst0(0.05f * rng.Uniform<Float>(), 0.01f * rng.Uniform<Float>());
+            Vector2f dst1(-0.01f * rng.Uniform<Float>(), 0.02f * rng.Uniform<Float>());
+            RGB a = mipmap.Lookup<RGB>(st, dst0, dst1);
+            const MIPMap &t = (i & 1) ? tiled : tiled2;
+            RGB b = t.Lookup<RGB>(st, dst0, dst1);
+            for (int c = 0; c < 3; ++c)
+                EXPECT_NEAR(a[c], b[c], 1e-4f) << st;
+        });
+    }
+    TextureTileCache::Shutdown();
+    EXPECT_FALSE(TextureTileCache::Enabled());
+}
+
+TEST(MIPMap, TiledFileRoundTrip) {
+    Image image(PixelFormat::U256, {256, 96}, {"R", "G", "B"},
+                ColorEncodingHandle::sRGB);
+    RNG rng;
+    for (int y = 0; y < image.Resolution().y; ++y)
+        for (int x = 0; x < image.Resolution().x; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, y}, c, rng.Uniform<Float>());
+
+    pstd::vector<Image> pyramid = Image::GenerateMIPMap(image, WrapMode::Clamp);
+    ASSERT_TRUE(
+        TiledImagePyramid::Write("test.txp", pyramid, WrapMode::Clamp, RGBColorSpace::sRGB));
+
+    MIPMapFilterOptions options;
+    MIPMap mipmap(image, RGBColorSpace::sRGB, WrapMode::Clamp, Allocator(), options);
+    std::unique_ptr<MIPMap> fromFile = MIPMap::CreateFromFile(
+        "test.txp", options, WrapMode::Clamp, ColorEncodingHandle::sRGB, Allocator());
+    ASSERT_EQ(mipmap.Levels(), fromFile->Levels());
+    EXPECT_EQ(RGBColorSpace::sRGB, fromFile->GetRGBColorSpace());
+
+    for (int i = 0; i < 1024; ++i) {
+        Point2f st(rng.Uniform<Float>(), rng.Uniform<Float>());
+        Vector2f dst0(0.02f * rng.Uniform<Float>(), 0);
+        Vector2f dst1(0, 0.02f * rng.Uniform<Float>());
+        RGB a = mipmap.Lookup<RGB>(st, dst0, dst1);
+        RGB b = fromFile->Lookup<RGB>(st, dst0, dst1);
+        for (int c = 0; c < 3; ++c)
+            EXPECT_NEAR(a[c], b[c], 1e-4f) << st;
+    }
+
+    // Truncated files are rejected rather than read past their end.
+    std::string contents = ReadFileContents("test.txp");
+    ASSERT_TRUE(WriteFile("test.txp", contents.substr(0, contents.size() - 1)));
+    const RGBColorSpace *colorSpace;
+    WrapMode wrapMode;
+    EXPECT_TRUE(TiledImagePyramid::Read("test.txp", &colorSpace, &wrapMode) == nullptr);
+
+    EXPECT_EQ(0, remove("test.txp"));
+}
+
+TEST(MIPMap, CompressedLookupsMatch) {
+    // MIPMaps aren't compressed if an earlier test left the tile cache on.
+    TextureTileCache::Shutdown();
+
+    for (PixelFormat format : {PixelFormat::Half, PixelFormat::U256}) {
+        // 8-bit RGB blocks share their indices across channels, so the
+        // 8-bit image's channels are correlated, as is typical of textures.
+        Image image(format, {128, 96}, {"R", "G", "B"}, ColorEncodingHandle::Linear);
+        for (int y = 0; y < image.Resolution().y; ++y)
+            for (int x = 0; x < image.Resolution().x; ++x)
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel(
+                        {x, y}, c,
+                        format == PixelFormat::Half
+                            ? .5f + .5f * std::sin(.1f * (x + c * y))
+                            : (.5f + .5f * std::sin(.1f * (x + y))) *
+                                  (.6f + .3f * std::sin(.02f * y + c)));
+
+        // Compressed levels take a quarter of the memory of 8-bit RGB ones
+        // and 10/32 of half-float ones.
+        pstd::vector<Image> levels = Image::GenerateMIPMap(image, WrapMode::Repeat);
+        for (const Image &level : levels) {
+            if (level.Resolution().x % 4 != 0 || level.Resolution().y % 4 != 0)
+                continue;
+            size_t compressedBytes = BlockCompressedImage(level).BytesUsed();
+            if (format == PixelFormat::U256)
+                EXPECT_EQ(level.BytesUsed(), 4 * compressedBytes) << level.Resolution();
+            else
+                EXPECT_EQ(10 * level.BytesUsed(), 32 * compressedBytes)
+                    << level.Resolution();
+        }
+
+        MIPMapFilterOptions options;
+        MIPMap mipmap(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(), options);
+        Options->compressTextures = true;
+        MIPMap compressed(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(),
+                          options);
+        Options->compressTextures = false;
+        ASSERT_EQ(mipmap.Levels(), compressed.Levels());
+
+        RNG rng;
+        for (int i = 0; i < 1024; ++i) {
+            Point2f st(rng.Uniform<Float>(), rng.Uniform<Float>());
+            Vector2f dst0(0.02f * rng.Uniform<Float>(), 0);
+            Vector2f dst1(0, 0.02f * rng.Uniform<Float>());
+            RGB a = mipmap.Lookup<RGB>(st, dst0, dst1);
+            RGB b = compressed.Lookup<RGB>(st, dst0, dst1);
+            for (int c = 0; c < 3; ++c)
+                EXPECT_NEAR(a[c], b[c], .05f) << ToString(format) << " " << st;
+        }
+    }
+}
+
+TEST(MIPMap, StochasticFilterConverges) {
+    Image image(PixelFormat::Float, {64, 64}, {"R", "G", "B"});
+    for (int y = 0; y < image.Resolution().y; ++y)
+        for (int x = 0; x < image.Resolution().x; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, y}, c, .5f + .5f * std::sin(.3f * x + .2f * c * y));
+
+    MIPMapFilterOptions trilinearOptions, stochasticOptions;
+    trilinearOptions.filter = FilterFunction::Trilinear;
+    stochasticOptions.filter = FilterFunction::Stochastic;
+    MIPMap trilinear(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(),
+                     trilinearOptions);
+    MIPMap stochastic(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(),
+                      stochasticOptions);
+
+    RNG rng;
+    for (int i = 0; i < 16; ++i) {
+        Point2f st(rng.Uniform<Float>(), rng.Uniform<Float>());
+        Float width = 0.03f * rng.Uniform<Float>();
+        RGB expected = trilinear.Lookup<RGB>(st, width);
+
+        // Perturb the width imperceptibly so that each lookup hashes
+        // differently
+        RGB sum;
+        int n = 16384;
+        for (int j = 0; j < n; ++j)
+            sum += stochastic.Lookup<RGB>(st, width * (1 + j * 1e-7f));
+        for (int c = 0; c < 3; ++c)
+            EXPECT_NEAR(expected[c], sum[c] / n, .02f) << st << " width " << width;
+    }
+}
+
+TEST(MIPMap, DISABLED_FilterBenchmark) {
+    Image image(PixelFormat::U256, {2048, 2048}, {"R", "G", "B"},
+                ColorEncodingHandle::sRGB);
+    ParallelFor(0, image.Resolution().y, [&](int64_t y) {
+        RNG rng(y);
+        for (int x = 0; x < image.Resolution().x; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, int(y)}, c, rng.Uniform<Float>());
+    });
+
+    for (FilterFunction filter :
+         {FilterFunction::Trilinear, FilterFunction::EWA, FilterFunction::Stochastic}) {
+        MIPMapFilterOptions options;
+        options.filter = filter;
+        MIPMap mipmap(image, RGBColorSpace::sRGB, WrapMode::Repeat, Allocator(), options);
+
+        int nLookups = 1 << 22;
+        RNG rng;
+        RGB sum;
+        Timer timer;
+        for (int i = 0; i < nLookups; ++i) {
+            Point2f st(rng.Uniform<Float>(), rng.Uniform<Float>());
+            Vector2f dst0(0.004f * rng.Uniform<Float>(), 0.001f * rng.Uniform<Float>());
+            Vector2f dst1(-0.001f * rng.Uniform<Float>(), 0.002f * rng.Uniform<Float>());
+            sum += mipmap.Lookup<RGB>(st, dst0, dst1);
+        }
+        printf("%s: %.1f ns per lookup (%s)\n", ToString(filter).c_str(),
+               1e9 * timer.ElapsedSeconds() / nLookups, sum.ToString().c_str());
+    }
+}
@@ -5,119 +5,73 @@
 #include <pbrt/util/loopsubdiv.h>
 
 #include <pbrt/util/containers.h>
-#include <pbrt/util/error.h>
-#include <pbrt/util/memory.h>
+#include <pbrt/util/math.h>
 #include <pbrt/util/mesh.h>
+#include <pbrt/util/parallel.h>
 #include <pbrt/util/pstd.h>
+#include <pbrt/util/stats.h>
 #include <pbrt/util/transform.h>
 #include <pbrt/util/vecmath.h>
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace pbrt {
 
-struct SDFace;
-struct SDVertex;
-
 // LoopSubdiv Macros
 #define NEXT(i) (((i) + 1) % 3)
 #define PREV(i) (((i) + 2) % 3)
 
-// LoopSubdiv Local Structures
-struct SDVertex {
-    // SDVertex Constructor
-    SDVertex(const Point3f &p = Point3f(0, 0, 0)) : p(p) {}
-
-    // SDVertex Methods
-    int valence();
-    void oneRing(Point3f *p);
-    Point3f p;
-    SDFace *startFace = nullptr;
-    SDVertex *child = nullptr;
-    bool regular = false, boundary = false;
-};
-
-struct SDFace {
-    // SDFace Constructor
-    SDFace() {
-        for (int i = 0; i < 3; ++i) {
-            v[i] = nullptr;
-            f[i] = nullptr;
-        }
-        for (int i = 0; i < 4; ++i)
-            children[i] = nullptr;
-    }
-
-    // SDFace Methods
-    int vnum(SDVertex *vert) const {
-        for (int i = 0; i < 3; ++i)
-            if (v[i] == vert)
-                return i;
-        LOG_FATAL("Basic logic error in SDFace::vnum()");
-        return -1;
-    }
-    SDFace *nextFace(SDVertex *vert) { return f[vnum(vert)]; }
-    SDFace *prevFace(SDVertex *vert) { return f[PREV(vnum(vert))]; }
-    SDVertex *nextVert(SDVertex *vert) { return v[NEXT(vnum(vert))]; }
-    SDVertex *prevVert(SDVertex *vert) { return v[PREV(vnum(vert))]; }
-    SDVertex *otherVert(SDVertex *v0, SDVertex *v1) {
-        for (int i = 0; i < 3; ++i)
-            if (v[i] != v0 && v[i] != v1)
-                return v[i];
-        LOG_FATAL("Basic logic error in SDVertex::otherVert()");
-        return nullptr;
+// SubdivisionMesh Definition
+// A level of a Loop subdivision surface. Its connectivity is stored in flat
+// arrays indexed by vertex and by face "corner," 3 * face + k, which also
+// identifies the edge from the face's kth vertex to its next one, so that
+// each level can be built and refined in parallel.
+class SubdivisionMesh {
+  public:
+    // SubdivisionMesh Public Methods
+    SubdivisionMesh(std::vector<int> indices, std::vector<Point3f> p);
+
+    size_t NumFaces() const { return indices.size() / 3; }
+    size_t NumVertices() const { return p.size(); }
+
+    SubdivisionMesh Refine() const;
+    Point3f LimitPosition(int v) const;
+    Normal3f LimitNormal(int v, pstd::span<const Point3f> pLimit) const;
+
+    // SubdivisionMesh Public Members
+    std::vector<int> indices;
+    std::vector<Point3f> p;
+
+  private:
+    // SubdivisionMesh Private Methods
+    // Returns the corner of corner _c_'s vertex in the next face around it
+    // or the previous one, or -1 at a boundary.
+    int NextCorner(int c) const {
+        int e = neighbor[c];
+        return e < 0 ? -1 : 3 * (e / 3) + NEXT(e % 3);
     }
-    SDVertex *v[3];
-    SDFace *f[3];
-    SDFace *children[4];
+    int PrevCorner(int c) const { return neighbor[3 * (c / 3) + PREV(c % 3)]; }
+    int NextVertex(int c) const { return indices[3 * (c / 3) + NEXT(c % 3)]; }
+    int PrevVertex(int c) const { return indices[3 * (c / 3) + PREV(c % 3)]; }
+
+    bool OwnsEdge(int c) const { return neighbor[c] < c; }
+    int Valence(int v) const;
+    void OneRing(int v, pstd::span<const Point3f> pos, Point3f *ring) const;
+    Point3f WeightOneRing(int v, Float beta) const;
+    Point3f WeightBoundary(int v, Float beta) const;
+
+    // SubdivisionMesh Private Members
+    // For each edge, the edge in the adjacent face that runs the other
+    // way, or -1 if it is on the boundary.
+    std::vector<int> neighbor;
+    // A corner at each vertex, or -1 if the vertex isn't used.
+    std::vector<int> vertexCorner;
+    std::vector<uint8_t> boundary;
 };
 
-struct SDEdge {
-    // SDEdge Constructor
-    SDEdge(SDVertex *v0 = nullptr, SDVertex *v1 = nullptr) {
-        v[0] = std::min(v0, v1);
-        v[1] = std::max(v0, v1);
-        f[0] = f[1] = nullptr;
-        f0edgeNum = -1;
-    }
-
-    // SDEdge Comparison Function
-    bool operator<(const SDEdge &e2) const {
-        if (v[0] == e2.v[0])
-            return v[1] < e2.v[1];
-        return v[0] < e2.v[0];
-    }
-    SDVertex *v[2];
-    SDFace *f[2];
-    int f0edgeNum;
-};
-
-// LoopSubdiv Local Declarations
-static Point3f weightOneRing(SDVertex *vert, Float beta);
-static Point3f weightBoundary(SDVertex *vert, Float beta);
-
 // LoopSubdiv Inline Functions
-inline int SDVertex::valence() {
-    SDFace *f = startFace;
-    if (!boundary) {
-        // Compute valence of interior vertex
-        int nf = 1;
-        while ((f = f->nextFace(this)) != startFace)
-            ++nf;
-        return nf;
-    } else {
-        // Compute valence of boundary vertex
-        int nf = 1;
-        while ((f = f->nextFace(this)) != nullptr)
-            ++nf;
-        f = startFace;
-        while ((f = f->prevFace(this)) != nullptr)
-            ++nf;
-        return nf + 1;
-    }
-}
-
 inline Float beta(int valence) {
     if (valence == 3)
         return 3.f / 16.f;
@@ -129,303 +83,288 @@ inline Float loopGamma(int valence) {
     return 1.f / (valence + 3.f / (8.f * beta(valence)));
 }
 
-// LoopSubdiv Function Definitions
-TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
-                            int nLevels, pstd::span<const int> vertexIndices,
-                            pstd::span<const Point3f> p, Allocator alloc) {
-    std::vector<SDVertex *> vertices;
-    std::vector<SDFace *> faces;
-    // Allocate _LoopSubdiv_ vertices and faces
-    std::unique_ptr<SDVertex[]> verts = std::make_unique<SDVertex[]>(p.size());
-    for (int i = 0; i < p.size(); ++i) {
-        verts[i] = SDVertex(p[i]);
-        vertices.push_back(&verts[i]);
-    }
-    size_t nFaces = vertexIndices.size() / 3;
-    std::unique_ptr<SDFace[]> fs = std::make_unique<SDFace[]>(nFaces);
-    for (int i = 0; i < nFaces; ++i)
-        faces.push_back(&fs[i]);
-
-    // Set face to vertex pointers
-    const int *vp = vertexIndices.data();
-    for (size_t i = 0; i < nFaces; ++i, vp += 3) {
-        SDFace *f = faces[i];
-        for (int j = 0; j < 3; ++j) {
-            SDVertex *v = vertices[vp[j]];
-            f->v[j] = v;
-            v->startFace = f;
-        }
-    }
-
-    // Set neighbor pointers in _faces_
-    std::set<SDEdge> edges;
-    for (int i = 0; i < nFaces; ++i) {
-        SDFace *f = faces[i];
-        for (int edgeNum = 0; edgeNum < 3; ++edgeNum) {
-            // Update neighbor pointer for _edgeNum_
-            int v0 = edgeNum, v1 = NEXT(edgeNum);
-            SDEdge e(f->v[v0], f->v[v1]);
-            if (edges.find(e) == edges.end()) {
-                // Handle new edge
-                e.f[0] = f;
-                e.f0edgeNum = edgeNum;
-                edges.insert(e);
-            } else {
-                // Handle previously seen edge
-                e = *edges.find(e);
-                e.f[0]->f[e.f0edgeNum] = f;
-                f->f[edgeNum] = e.f[0];
-                edges.erase(e);
+// SubdivisionMesh Method Definitions
+SubdivisionMesh::SubdivisionMesh(std::vector<int> idx, std::vector<Point3f> pos)
+    : indices(std::move(idx)), p(std::move(pos)) {
+    size_t nCorners = indices.size(), nVertices = p.size();
+    // Find the corners at each vertex
+    std::vector<int> cornerOffsets(nVertices + 1, 0);
+    for (int v : indices)
+        ++cornerOffsets[v + 1];
+    for (size_t v = 0; v < nVertices; ++v)
+        cornerOffsets[v + 1] += cornerOffsets[v];
+    std::vector<int> vertexCorners(nCorners);
+    std::vector<int> next(cornerOffsets.begin(), cornerOffsets.end() - 1);
+    for (size_t c = 0; c < nCorners; ++c)
+        vertexCorners[next[indices[c]]++] = c;
+
+    // Match each edge with the one that runs the other way in another face
+    std::vector<int> match(nCorners);
+    ParallelFor(0, NumFaces(), [&](int64_t f) {
+        for (int k = 0; k < 3; ++k) {
+            int v0 = indices[3 * f + k], v1 = indices[3 * f + NEXT(k)];
+            match[3 * f + k] = -1;
+            for (int i = cornerOffsets[v1]; i < cornerOffsets[v1 + 1]; ++i) {
+                int c = vertexCorners[i];
+                if (c / 3 != f && NextVertex(c) == v0) {
+                    match[3 * f + k] = c;
+                    break;
+                }
             }
         }
+    });
+    // Edges shared by more than two faces may not match symmetrically;
+    // treat those as boundaries.
+    neighbor.resize(nCorners);
+    ParallelFor(0, nCorners, [&](int64_t c) {
+        int e = match[c];
+        neighbor[c] = (e >= 0 && match[e] == c) ? e : -1;
+    });
+
+    // Find whether each vertex is on the boundary
+    vertexCorner.resize(nVertices);
+    boundary.resize(nVertices);
+    ParallelFor(0, nVertices, [&](int64_t v) {
+        if (cornerOffsets[v] == cornerOffsets[v + 1]) {
+            vertexCorner[v] = -1;
+            boundary[v] = false;
+            return;
+        }
+        int start = vertexCorners[cornerOffsets[v]], c = start;
+        do {
+            c = NextCorner(c);
+        } while (c != -1 && c != start);
+        vertexCorner[v] = start;
+        boundary[v] = (c == -1);
+    });
+}
+
+int SubdivisionMesh::Valence(int v) const {
+    int start = vertexCorner[v], nf = 1;
+    if (!boundary[v]) {
+        // Compute valence of interior vertex
+        for (int c = NextCorner(start); c != start; c = NextCorner(c))
+            ++nf;
+        return nf;
+    } else {
+        // Compute valence of boundary vertex
+        for (int c = NextCorner(start); c != -1; c = NextCorner(c))
+            ++nf;
+        for (int c = PrevCorner(start); c != -1; c = PrevCorner(c))
+            ++nf;
+        return nf + 1;
     }
+}
 
-    // Finish vertex initialization
-    for (size_t i = 0; i < p.size(); ++i) {
-        SDVertex *v = vertices[i];
-        SDFace *f = v->startFace;
+void SubdivisionMesh::OneRing(int v, pstd::span<const Point3f> pos,
+                              Point3f *ring) const {
+    int c = vertexCorner[v];
+    if (!boundary[v]) {
+        // Get one-ring vertices for interior vertex
         do {
-            f = f->nextFace(v);
-        } while ((f != nullptr) && f != v->startFace);
-        v->boundary = (f == nullptr);
-        if (!v->boundary && v->valence() == 6)
-            v->regular = true;
-        else if (v->boundary && v->valence() == 4)
-            v->regular = true;
-        else
-            v->regular = false;
+            *ring++ = pos[NextVertex(c)];
+            c = NextCorner(c);
+        } while (c != vertexCorner[v]);
+    } else {
+        // Get one-ring vertices for boundary vertex
+        int c2;
+        while ((c2 = NextCorner(c)) != -1)
+            c = c2;
+        *ring++ = pos[NextVertex(c)];
+        do {
+            *ring++ = pos[PrevVertex(c)];
+            c = PrevCorner(c);
+        } while (c != -1);
     }
+}
 
-    // Refine _LoopSubdiv_ into triangles
-    std::vector<SDFace *> f = faces;
-    std::vector<SDVertex *> v = vertices;
-    pstd::pmr::monotonic_buffer_resource resource;
-    Allocator vertexFaceAllocator(&resource);
-
-    for (int i = 0; i < nLevels; ++i) {
-        // Update _f_ and _v_ for next level of subdivision
-        std::vector<SDFace *> newFaces;
-        std::vector<SDVertex *> newVertices;
-
-        // Allocate next level of children in mesh tree
-        for (SDVertex *vertex : v) {
-            vertex->child = vertexFaceAllocator.new_object<SDVertex>();
-            vertex->child->regular = vertex->regular;
-            vertex->child->boundary = vertex->boundary;
-            newVertices.push_back(vertex->child);
-        }
-        for (SDFace *face : f) {
-            for (int k = 0; k < 4; ++k) {
-                face->children[k] = vertexFaceAllocator.new_object<SDFace>();
-                newFaces.push_back(face->children[k]);
-            }
-        }
+Point3f SubdivisionMesh::WeightOneRing(int v, Float beta) const {
+    // Put _v_'s one-ring in _pRing_
+    int valence = Valence(v);
+    InlinedVector<Point3f, 16> pRing(valence);
+    OneRing(v, p, pRing.data());
 
-        // Update vertex positions and create new edge vertices
+    Point3f pw = (1 - valence * beta) * p[v];
+    for (int i = 0; i < valence; ++i)
+        pw += beta * pRing[i];
+    return pw;
+}
 
-        // Update vertex positions for even vertices
-        for (SDVertex *vertex : v) {
-            if (!vertex->boundary) {
-                // Apply one-ring rule for even vertex
-                if (vertex->regular)
-                    vertex->child->p = weightOneRing(vertex, 1.f / 16.f);
-                else
-                    vertex->child->p = weightOneRing(vertex, beta(vertex->valence()));
+Point3f SubdivisionMesh::WeightBoundary(int v, Float beta) const {
+    // Put _v_'s one-ring in _pRing_
+    int valence = Valence(v);
+    InlinedVector<Point3f, 16> pRing(valence);
+    OneRing(v, p, pRing.data());
+
+    Point3f pw = (1 - 2 * beta) * p[v];
+    pw += beta * pRing[0];
+    pw += beta * pRing[valence - 1];
+    return pw;
+}
+
+SubdivisionMesh SubdivisionMesh::Refine() const {
+    size_t nFaces = NumFaces(), nVertices = NumVertices();
+    // Number the new odd vertices, one per edge, after the even vertices
+    std::vector<int> faceEdgeOffsets(nFaces + 1, 0);
+    for (size_t f = 0; f < nFaces; ++f)
+        faceEdgeOffsets[f + 1] = faceEdgeOffsets[f] + OwnsEdge(3 * f) +
+                                 OwnsEdge(3 * f + 1) + OwnsEdge(3 * f + 2);
+    std::vector<int> edgeVertex(indices.size());
+    ParallelFor(0, nFaces, [&](int64_t f) {
+        int vertex = nVertices + faceEdgeOffsets[f];
+        for (int c = 3 * f; c < 3 * f + 3; ++c)
+            if (OwnsEdge(c))
+                edgeVertex[c] = vertex++;
+    });
+    ParallelFor(0, nFaces, [&](int64_t f) {
+        for (int c = 3 * f; c < 3 * f + 3; ++c)
+            if (!OwnsEdge(c))
+                edgeVertex[c] = edgeVertex[neighbor[c]];
+    });
+
+    // Update vertex positions for even vertices
+    std::vector<Point3f> newP(nVertices + faceEdgeOffsets[nFaces]);
+    ParallelFor(0, nVertices, [&](int64_t v) {
+        if (vertexCorner[v] == -1)
+            newP[v] = p[v];
+        else if (!boundary[v])
+            // Apply one-ring rule for even vertex
+            newP[v] = WeightOneRing(v, beta(Valence(v)));
+        else
+            // Apply boundary rule for even vertex
+            newP[v] = WeightBoundary(v, 1.f / 8.f);
+    });
+
+    // Compute new odd edge vertices
+    ParallelFor(0, nFaces, [&](int64_t f) {
+        for (int c = 3 * f; c < 3 * f + 3; ++c) {
+            if (!OwnsEdge(c))
+                continue;
+            // Apply edge rules to compute new vertex position
+            Point3f p0 = p[indices[c]], p1 = p[NextVertex(c)];
+            Point3f &pe = newP[edgeVertex[c]];
+            if (neighbor[c] == -1) {
+                pe = 0.5f * p0;
+                pe += 0.5f * p1;
             } else {
-                // Apply boundary rule for even vertex
-                vertex->child->p = weightBoundary(vertex, 1.f / 8.f);
+                pe = 3.f / 8.f * p0;
+                pe += 3.f / 8.f * p1;
+                pe += 1.f / 8.f * p[PrevVertex(c)];
+                pe += 1.f / 8.f * p[PrevVertex(neighbor[c])];
             }
         }
+    });
 
-        // Compute new odd edge vertices
-        std::map<SDEdge, SDVertex *> edgeVerts;
-        for (SDFace *face : f) {
-            for (int k = 0; k < 3; ++k) {
-                // Compute odd vertex on _k_th edge
-                SDEdge edge(face->v[k], face->v[NEXT(k)]);
-                SDVertex *vert = edgeVerts[edge];
-                if (vert == nullptr) {
-                    // Create and initialize new odd vertex
-                    vert = vertexFaceAllocator.new_object<SDVertex>();
-                    newVertices.push_back(vert);
-                    vert->regular = true;
-                    vert->boundary = (face->f[k] == nullptr);
-                    vert->startFace = face->children[3];
-
-                    // Apply edge rules to compute new vertex position
-                    if (vert->boundary) {
-                        vert->p = 0.5f * edge.v[0]->p;
-                        vert->p += 0.5f * edge.v[1]->p;
-                    } else {
-                        vert->p = 3.f / 8.f * edge.v[0]->p;
-                        vert->p += 3.f / 8.f * edge.v[1]->p;
-                        vert->p += 1.f / 8.f * face->otherVert(edge.v[0], edge.v[1])->p;
-                        vert->p +=
-                            1.f / 8.f * face->f[k]->otherVert(edge.v[0], edge.v[1])->p;
-                    }
-                    edgeVerts[edge] = vert;
-                }
-            }
+    // Split each face into four
+    std::vector<int> newIndices(4 * indices.size());
+    ParallelFor(0, nFaces, [&](int64_t f) {
+        const int *v = &indices[3 * f], *e = &edgeVertex[3 * f];
+        int *child = &newIndices[12 * f];
+        for (int j = 0; j < 3; ++j) {
+            child[3 * j + j] = v[j];
+            child[3 * j + NEXT(j)] = e[j];
+            child[3 * j + PREV(j)] = e[PREV(j)];
+            child[9 + j] = e[j];
         }
+    });
 
-        // Update new mesh topology
+    return SubdivisionMesh(std::move(newIndices), std::move(newP));
+}
 
-        // Update even vertex face pointers
-        for (SDVertex *vertex : v) {
-            int vertNum = vertex->startFace->vnum(vertex);
-            vertex->child->startFace = vertex->startFace->children[vertNum];
-        }
+Point3f SubdivisionMesh::LimitPosition(int v) const {
+    if (vertexCorner[v] == -1)
+        return p[v];
+    if (boundary[v])
+        return WeightBoundary(v, 1.f / 5.f);
+    return WeightOneRing(v, loopGamma(Valence(v)));
+}
 
-        // Update face neighbor pointers
-        for (SDFace *face : f) {
-            for (int j = 0; j < 3; ++j) {
-                // Update children _f_ pointers for siblings
-                face->children[3]->f[j] = face->children[NEXT(j)];
-                face->children[j]->f[NEXT(j)] = face->children[3];
-
-                // Update children _f_ pointers for neighbor children
-                SDFace *f2 = face->f[j];
-                face->children[j]->f[j] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
-                f2 = face->f[PREV(j)];
-                face->children[j]->f[PREV(j)] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
-            }
+Normal3f SubdivisionMesh::LimitNormal(int v, pstd::span<const Point3f> pLimit) const {
+    if (vertexCorner[v] == -1)
+        return Normal3f(0, 0, 1);
+    int valence = Valence(v);
+    InlinedVector<Point3f, 16> pRing(valence);
+    OneRing(v, pLimit, pRing.data());
+
+    Vector3f S(0, 0, 0), T(0, 0, 0);
+    if (!boundary[v]) {
+        // Compute tangents of interior face
+        for (int j = 0; j < valence; ++j) {
+            S += std::cos(2 * Pi * j / valence) * Vector3f(pRing[j]);
+            T += std::sin(2 * Pi * j / valence) * Vector3f(pRing[j]);
         }
-
-        // Update face vertex pointers
-        for (SDFace *face : f) {
-            for (int j = 0; j < 3; ++j) {
-                // Update child vertex pointer to new even vertex
-                face->children[j]->v[j] = face->v[j]->child;
-
-                // Update child vertex pointer to new odd vertex
-                SDVertex *vert = edgeVerts[SDEdge(face->v[j], face->v[NEXT(j)])];
-                face->children[j]->v[NEXT(j)] = vert;
-                face->children[NEXT(j)]->v[j] = vert;
-                face->children[3]->v[j] = vert;
+    } else {
+        // Compute tangents of boundary face
+        Point3f pv = pLimit[v];
+        S = pRing[valence - 1] - pRing[0];
+        if (valence == 2)
+            T = Vector3f(pRing[0] + pRing[1] - 2 * pv);
+        else if (valence == 3)
+            T = pRing[1] - pv;
+        else if (valence == 4)  // regular
+            T = Vector3f(-1 * pRing[0] + 2 * pRing[1] + 2 * pRing[2] + -1 * pRing[3] +
+                         -2 * pv);
+        else {
+            Float theta = Pi / float(valence - 1);
+            T = Vector3f(std::sin(theta) * (pRing[0] + pRing[valence - 1]));
+            for (int k = 1; k < valence - 1; ++k) {
+                Float wt = (2 * std::cos(theta) - 2) * std::sin((k)*theta);
+                T += Vector3f(wt * pRing[k]);
             }
+            T = -T;
         }
-
-        // Prepare for next level of subdivision
-        f = newFaces;
-        v = newVertices;
     }
+    return Normal3f(Cross(S, T));
+}
 
-    // Push vertices to limit surface
-    std::vector<Point3f> pLimit(v.size());
-    for (size_t i = 0; i < v.size(); ++i) {
-        if (v[i]->boundary)
-            pLimit[i] = weightBoundary(v[i], 1.f / 5.f);
-        else
-            pLimit[i] = weightOneRing(v[i], loopGamma(v[i]->valence()));
-    }
-    for (size_t i = 0; i < v.size(); ++i)
-        v[i]->p = pLimit[i];
-
-    // Compute vertex tangents on limit surface
-    std::vector<Normal3f> Ns;
-    Ns.reserve(v.size());
-    std::vector<Point3f> pRing(16, Point3f());
-    for (SDVertex *vertex : v) {
-        Vector3f S(0, 0, 0), T(0, 0, 0);
-        int valence = vertex->valence();
-        if (valence > (int)pRing.size())
-            pRing.resize(valence);
-        vertex->oneRing(&pRing[0]);
-        if (!vertex->boundary) {
-            // Compute tangents of interior face
-            for (int j = 0; j < valence; ++j) {
-                S += std::cos(2 * Pi * j / valence) * Vector3f(pRing[j]);
-                T += std::sin(2 * Pi * j / valence) * Vector3f(pRing[j]);
-            }
-        } else {
-            // Compute tangents of boundary face
-            S = pRing[valence - 1] - pRing[0];
-            if (valence == 2)
-                T = Vector3f(pRing[0] + pRing[1] - 2 * vertex->p);
-            else if (valence == 3)
-                T = pRing[1] - vertex->p;
-            else if (valence == 4)  // regular
-                T = Vector3f(-1 * pRing[0] + 2 * pRing[1] + 2 * pRing[2] + -1 * pRing[3] +
-                             -2 * vertex->p);
-            else {
-                Float theta = Pi / float(valence - 1);
-                T = Vector3f(std::sin(theta) * (pRing[0] + pRing[valence - 1]));
-                for (int k = 1; k < valence - 1; ++k) {
-                    Float wt = (2 * std::cos(theta) - 2) * std::sin((k)*theta);
-                    T += Vector3f(wt * pRing[k]);
-                }
-                T = -T;
-            }
-        }
-        Ns.push_back(Normal3f(Cross(S, T)));
-    }
+STAT_INT_DISTRIBUTION("Geometry/Loop subdivision levels", subdivisionLevels);
 
-    // Create triangle mesh from subdivision mesh
-    {
-        size_t ntris = f.size();
-        std::vector<int> verts(3 * ntris);
-        int *vp = verts.data();
-        size_t totVerts = v.size();
-        std::map<SDVertex *, int> usedVerts;
-        for (size_t i = 0; i < totVerts; ++i)
-            usedVerts[v[i]] = i;
-        for (size_t i = 0; i < ntris; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                *vp = usedVerts[f[i]->v[j]];
-                ++vp;
-            }
+// LoopSubdiv Function Definitions
+TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
+                            int nLevels, pstd::span<const int> vertexIndices,
+                            pstd::span<const Point3f> p, Allocator alloc,
+                            Float edgeLength, const LoopSubdivisionView &view) {
+    if (edgeLength > 0 && view.pixelAngle > 0) {
+        // Choose number of levels so that edges are about _edgeLength_ pixels
+        Bounds3f bounds;
+        for (Point3f pi : p)
+            bounds = Union(bounds, (*renderFromObject)(pi));
+        Float maxEdge = 0;
+        for (size_t i = 0; i < vertexIndices.size(); ++i) {
+            int v0 = vertexIndices[i];
+            int v1 = vertexIndices[i % 3 == 2 ? i - 2 : i + 1];
+            maxEdge = std::max(maxEdge, Distance((*renderFromObject)(p[v0]),
+                                                 (*renderFromObject)(p[v1])));
+        }
+        Float distance = Distance(view.pCamera, bounds);
+        if (distance > 0) {
+            Float pixels = maxEdge / (distance * view.pixelAngle);
+            if (pixels <= edgeLength)
+                nLevels = 0;
+            else
+                nLevels = std::min(nLevels, int(std::ceil(Log2(pixels / edgeLength))));
         }
-        return alloc.new_object<TriangleMesh>(*renderFromObject, reverseOrientation,
-                                              verts, pLimit, std::vector<Vector3f>(), Ns,
-                                              std::vector<Point2f>(), std::vector<int>());
     }
-}
-
-static Point3f weightOneRing(SDVertex *vert, Float beta) {
-    // Put _vert_ one-ring in _pRing_
-    int valence = vert->valence();
-    InlinedVector<Point3f, 16> pRing(valence);
+    ReportValue(subdivisionLevels, nLevels);
 
-    vert->oneRing(pRing.data());
-    Point3f p = (1 - valence * beta) * vert->p;
-    for (int i = 0; i < valence; ++i)
-        p += beta * pRing[i];
-    return p;
-}
+    SubdivisionMesh mesh(std::vector<int>(vertexIndices.begin(), vertexIndices.end()),
+                         std::vector<Point3f>(p.begin(), p.end()));
+    for (int i = 0; i < nLevels; ++i)
+        mesh = mesh.Refine();
 
-void SDVertex::oneRing(Point3f *p) {
-    if (!boundary) {
-        // Get one-ring vertices for interior vertex
-        SDFace *face = startFace;
-        do {
-            *p++ = face->nextVert(this)->p;
-            face = face->nextFace(this);
-        } while (face != startFace);
-    } else {
-        // Get one-ring vertices for boundary vertex
-        SDFace *face = startFace, *f2;
-        while ((f2 = face->nextFace(this)) != nullptr)
-            face = f2;
-        *p++ = face->nextVert(this)->p;
-        do {
-            *p++ = face->prevVert(this)->p;
-            face = face->prevFace(this);
-        } while (face != nullptr);
-    }
-}
+    // Push vertices to limit surface and compute their normals
+    std::vector<Point3f> pLimit(mesh.NumVertices());
+    ParallelFor(0, mesh.NumVertices(),
+                [&](int64_t v) { pLimit[v] = mesh.LimitPosition(v); });
+    std::vector<Normal3f> Ns(mesh.NumVertices());
+    ParallelFor(0, mesh.NumVertices(),
+                [&](int64_t v) { Ns[v] = mesh.LimitNormal(v, pLimit); });
 
-static Point3f weightBoundary(SDVertex *vert, Float beta) {
-    // Put _vert_ one-ring in _pRing_
-    int valence = vert->valence();
-    InlinedVector<Point3f, 16> pRing(valence);
-
-    vert->oneRing(pRing.data());
-    Point3f p = (1 - 2 * beta) * vert->p;
-    p += beta * pRing[0];
-    p += beta * pRing[valence - 1];
-    return p;
+    // Create triangle mesh from subdivision mesh
+    return alloc.new_object<TriangleMesh>(*renderFromObject, reverseOrientation,
+                                          std::move(mesh.indices), std::move(pLimit),
+                                          std::vector<Vector3f>(), std::move(Ns),
+                                          std::vector<Point2f>(), std::vector<int>());
 }
 
 }  // namespace pbrt
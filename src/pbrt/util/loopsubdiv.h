@@ -8,13 +8,27 @@
 #include <pbrt/pbrt.h>
 
 #include <pbrt/util/pstd.h>
+#include <pbrt/util/vecmath.h>
 
 namespace pbrt {
 
+// LoopSubdivisionView Definition
+// The camera position and the angle subtended by a pixel, in radians, that
+// are used for adaptive subdivision; a zero angle disables it. The view is
+// only meaningful for meshes that are created in render space.
+struct LoopSubdivisionView {
+    Point3f pCamera;
+    Float pixelAngle = 0;
+};
+
 // LoopSubdiv Declarations
+// If _edgeLength_ is positive and _view_ has a pixel angle, no more levels
+// are used than are needed for the mesh's edges to be about that many pixels
+// long at its closest point to the camera.
 TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
                             int nLevels, pstd::span<const int> vertexIndices,
-                            pstd::span<const Point3f> p, Allocator alloc);
+                            pstd::span<const Point3f> p, Allocator alloc,
+                            Float edgeLength = 0, const LoopSubdivisionView &view = {});
 
 }  // namespace pbrt
 
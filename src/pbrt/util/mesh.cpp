@@ -4,16 +4,32 @@
 
 #include <pbrt/util/mesh.h>
 
+#include <pbrt/options.h>
 #include <pbrt/util/buffercache.h>
 #include <pbrt/util/check.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/log.h>
+#include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/stats.h>
+#include <pbrt/util/string.h>
 #include <pbrt/util/transform.h>
 
 #include <rply/rply.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#ifdef PBRT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Mesh indices", meshIndexBytes);
@@ -25,6 +41,7 @@ STAT_MEMORY_COUNTER("Memory/Mesh face indices", meshFaceIndexBytes);
 
 STAT_RATIO("Geometry/Triangles per mesh", nTris, nTriMeshes);
 STAT_MEMORY_COUNTER("Memory/Triangles", triangleBytes);
+STAT_PERCENT("Geometry/PLY files read via binary fast path", nBinaryPLYFiles, nPLYFiles);
 
 static BufferCache<int> *indexBufferCache;
 static BufferCache<Point3f> *pBufferCache;
@@ -32,6 +49,9 @@ static BufferCache<Normal3f> *nBufferCache;
 static BufferCache<Point2f> *uvBufferCache;
 static BufferCache<Vector3f> *sBufferCache;
 static BufferCache<int> *faceIndexBufferCache;
+static BufferCache<uint16_t> *compressedIndexBufferCache;
+static BufferCache<OctahedralVector> *compressedNBufferCache;
+static BufferCache<uint16_t> *compressedUVBufferCache;
 
 void InitBufferCaches(Allocator alloc) {
     CHECK(indexBufferCache == nullptr);
@@ -41,6 +61,9 @@ void InitBufferCaches(Allocator alloc) {
     uvBufferCache = alloc.new_object<BufferCache<Point2f>>(alloc);
     sBufferCache = alloc.new_object<BufferCache<Vector3f>>(alloc);
     faceIndexBufferCache = alloc.new_object<BufferCache<int>>(alloc);
+    compressedIndexBufferCache = alloc.new_object<BufferCache<uint16_t>>(alloc);
+    compressedNBufferCache = alloc.new_object<BufferCache<OctahedralVector>>(alloc);
+    compressedUVBufferCache = alloc.new_object<BufferCache<uint16_t>>(alloc);
 }
 
 void FreeBufferCaches() {
@@ -66,14 +89,250 @@ void FreeBufferCaches() {
     LOG_VERBOSE("face index bytes: %d", faceIndexBufferCache->BytesUsed());
     meshFaceIndexBytes += faceIndexBufferCache->BytesUsed();
     faceIndexBufferCache->Clear();
+
+    // Compressed attributes are included in the totals for the
+    // corresponding full-precision ones.
+    LOG_VERBOSE("compressed index bytes: %d", compressedIndexBufferCache->BytesUsed());
+    meshIndexBytes += compressedIndexBufferCache->BytesUsed();
+    compressedIndexBufferCache->Clear();
+
+    LOG_VERBOSE("compressed n bytes: %d", compressedNBufferCache->BytesUsed());
+    meshNormalBytes += compressedNBufferCache->BytesUsed();
+    compressedNBufferCache->Clear();
+
+    LOG_VERBOSE("compressed uv bytes: %d", compressedUVBufferCache->BytesUsed());
+    meshUVBytes += compressedUVBufferCache->BytesUsed();
+    compressedUVBufferCache->Clear();
+}
+
+// CompressedMeshAttributes Method Definitions
+std::string CompressedMeshAttributes::ToString() const {
+    return StringPrintf("[ CompressedMeshAttributes indices: %p indexBlockOffsets: %p "
+                        "n: %p uv: %p uvMin: %s uvScale: %s ]",
+                        indices, indexBlockOffsets, n, uv, uvMin, uvScale);
+}
+
+STAT_PERCENT("Geometry/Meshes with compressed indices", nCompressedIndexMeshes,
+             nCompressibleMeshes);
+
+// Mesh Attribute Compression Functions
+// These return false, leaving _compressed_ unchanged, if the values can't
+// be represented compactly; the caller then stores them at full precision.
+static bool CompressIndices(const std::vector<int> &indices, int nVertices,
+                            CompressedMeshAttributes *compressed) {
+    ++nCompressibleMeshes;
+    constexpr int blockSize = CompressedMeshAttributes::IndicesPerBlock;
+    std::vector<uint16_t> offsetIndices(indices.size());
+    if (nVertices <= 65536) {
+        std::copy(indices.begin(), indices.end(), offsetIndices.begin());
+        compressed->indices = compressedIndexBufferCache->LookupOrAdd(offsetIndices);
+        ++nCompressedIndexMeshes;
+        return true;
+    }
+
+    // Delta-encode each block of indices with respect to its minimum index
+    std::vector<int> blockOffsets((indices.size() + blockSize - 1) / blockSize);
+    for (size_t block = 0; block < blockOffsets.size(); ++block) {
+        size_t start = block * blockSize;
+        size_t end = std::min(start + blockSize, indices.size());
+        auto [minIter, maxIter] =
+            std::minmax_element(indices.begin() + start, indices.begin() + end);
+        if (*maxIter - *minIter > 65535)
+            return false;
+        blockOffsets[block] = *minIter;
+        for (size_t i = start; i < end; ++i)
+            offsetIndices[i] = indices[i] - *minIter;
+    }
+    compressed->indices = compressedIndexBufferCache->LookupOrAdd(offsetIndices);
+    compressed->indexBlockOffsets = indexBufferCache->LookupOrAdd(blockOffsets);
+    ++nCompressedIndexMeshes;
+    return true;
+}
+
+// Note that normals are normalized by the octahedral encoding.
+static bool CompressNormals(const std::vector<Normal3f> &N,
+                            CompressedMeshAttributes *compressed) {
+    std::vector<OctahedralVector> octN(N.size());
+    for (size_t i = 0; i < N.size(); ++i) {
+        if (LengthSquared(N[i]) == 0)
+            return false;
+        octN[i] = OctahedralVector(Vector3f(N[i]));
+    }
+    compressed->n = compressedNBufferCache->LookupOrAdd(std::move(octN));
+    return true;
+}
+
+static bool CompressUVs(const std::vector<Point2f> &UV,
+                        CompressedMeshAttributes *compressed) {
+    Bounds2f bounds;
+    for (const Point2f &uv : UV)
+        bounds = Union(bounds, uv);
+    Vector2f extent = bounds.Diagonal();
+    if (std::isinf(extent.x) || std::isinf(extent.y))
+        return false;
+
+    std::vector<uint16_t> quantized(2 * UV.size());
+    for (size_t i = 0; i < UV.size(); ++i) {
+        Vector2f o = bounds.Offset(UV[i]);
+        quantized[2 * i] = std::round(o.x * 65535);
+        quantized[2 * i + 1] = std::round(o.y * 65535);
+    }
+    compressed->uv = compressedUVBufferCache->LookupOrAdd(std::move(quantized));
+    compressed->uvMin = bounds.pMin;
+    compressed->uvScale = extent / 65535;
+    return true;
+}
+
+STAT_MEMORY_COUNTER("Memory/Geometry store resident pages", geometryStoreResidentBytes);
+STAT_MEMORY_COUNTER("Memory/Geometry store file", geometryStoreFileBytes);
+STAT_COUNTER("Geometry/Store pages loaded", geometryPagesLoaded);
+STAT_COUNTER("Geometry/Store pages evicted", geometryPagesEvicted);
+
+// GeometryStore Method Definitions
+GeometryStore *GeometryStore::store;
+static std::mutex geometryStoreInitMutex;
+
+void GeometryStore::Init(size_t maxResidentBytes) {
+#ifdef PBRT_HAVE_MMAP
+    std::lock_guard<std::mutex> lock(geometryStoreInitMutex);
+    if (store) {
+        store->maxResidentBytes = maxResidentBytes;
+        return;
+    }
+    FILE *file = tmpfile();
+    if (!file)
+        ErrorExit("Unable to create geometry store file: %s", ErrorString());
+    store = new GeometryStore(maxResidentBytes, file);
+#else
+    Warning("The geometry store requires memory-mapped files, which aren't "
+            "supported on this system. Keeping geometry in memory.");
+#endif
+}
+
+void GeometryStore::Shutdown() {
+    std::lock_guard<std::mutex> lock(geometryStoreInitMutex);
+    if (!store)
+        return;
+#ifdef PBRT_HAVE_MMAP
+    for (const Region &region : store->regions)
+        if (munmap((void *)region.data, region.length) != 0)
+            Error("munmap: %s", ErrorString());
+#endif
+    fclose(store->file);
+    geometryStoreFileBytes -= store->fileBytes;
+    geometryStoreResidentBytes -= store->residentBytes;
+    delete store;
+    store = nullptr;
+}
+
+const GeometryStoreBuffer *GeometryStore::Add(const void *data, size_t bytes) {
+    CHECK(store != nullptr);
+    CHECK_GT(bytes, 0);
+    GeometryStoreBuffer *buffer = new GeometryStoreBuffer;
+    buffer->bytes = bytes;
+    int nPages = (bytes + PageBytes - 1) >> PageShift;
+    buffer->pages.reset(new GeometryStoreBuffer::Page[nPages]);
+#ifdef PBRT_HAVE_MMAP
+    // Append the buffer to the file, starting at a page boundary so that
+    // each of its pages can be released independently
+    std::lock_guard<std::mutex> lock(store->fileMutex);
+    int fd = fileno(store->file);
+    buffer->fileOffset = store->fileBytes;
+    for (size_t written = 0; written < bytes;) {
+        ssize_t n = pwrite(fd, (const uint8_t *)data + written, bytes - written,
+                           buffer->fileOffset + written);
+        if (n <= 0)
+            ErrorExit("Error writing geometry store file: %s", ErrorString());
+        written += n;
+    }
+    int64_t paddedBytes = int64_t(nPages) << PageShift;
+    store->fileBytes += paddedBytes;
+    geometryStoreFileBytes += paddedBytes;
+
+    // Map a new region of the file if the buffer doesn't fit in the current one
+    if (store->regions.empty() ||
+        buffer->fileOffset + paddedBytes > store->regions.back().fileOffset +
+                                               int64_t(store->regions.back().length)) {
+        size_t length = std::max<size_t>(RegionBytes, paddedBytes);
+        // Extend the file over the whole region so that it is all backed by
+        // the file; the unwritten remainder doesn't use any disk space.
+        if (ftruncate(fd, buffer->fileOffset + length) != 0)
+            ErrorExit("Error extending geometry store file: %s", ErrorString());
+        void *mapping =
+            mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, buffer->fileOffset);
+        if (mapping == MAP_FAILED)
+            ErrorExit("Unable to map geometry store file: %s", ErrorString());
+        store->regions.push_back(
+            Region{(const uint8_t *)mapping, buffer->fileOffset, length});
+    }
+    const Region &region = store->regions.back();
+    buffer->data = region.data + (buffer->fileOffset - region.fileOffset);
+    // Let the system drop the newly written data from the file cache; pages
+    // are read back in when they are first used.
+    posix_fadvise(fd, buffer->fileOffset, bytes, POSIX_FADV_DONTNEED);
+#endif
+    store->buffers.push_back(std::unique_ptr<GeometryStoreBuffer>(buffer));
+    std::lock_guard<std::mutex> evictLock(store->evictMutex);
+    for (int page = 0; page < nPages; ++page)
+        store->pages.push_back({buffer, page});
+    return buffer;
 }
 
+void GeometryStore::Load(const GeometryStoreBuffer *buffer, int page) {
+    // Only the thread that marks the page resident accounts for it
+    GeometryStoreBuffer::Page &p = buffer->pages[page];
+    if (p.resident.exchange(true))
+        return;
+    size_t length = PageLength(buffer, page);
+    geometryStoreResidentBytes += length;
+    ++geometryPagesLoaded;
+#ifdef PBRT_HAVE_MMAP
+    // Start reading the page in before the caller's first access to it
+    madvise((void *)(buffer->data + (size_t(page) << PageShift)), length,
+            MADV_WILLNEED);
+#endif
+    // Evict pages if over budget, unless another thread is already doing so
+    if (residentBytes += length; residentBytes > maxResidentBytes) {
+        std::unique_lock<std::mutex> lock(evictMutex, std::try_to_lock);
+        if (lock)
+            Evict();
+    }
+}
+
+void GeometryStore::Evict() {
+    // Run the clock hand over all pages until the resident ones fit in the
+    // budget, giving up after two full sweeps
+    for (size_t i = 0; i < 2 * pages.size() && residentBytes > maxResidentBytes; ++i) {
+        if (clockHand >= pages.size())
+            clockHand = 0;
+        auto [buffer, page] = pages[clockHand++];
+        GeometryStoreBuffer::Page &p = buffer->pages[page];
+        if (!p.resident.load(std::memory_order_relaxed) || p.referenced.exchange(false))
+            continue;
+        if (!p.resident.exchange(false))
+            continue;
+        size_t length = PageLength(buffer, page);
+        residentBytes -= length;
+        geometryStoreResidentBytes -= length;
+        ++geometryPagesEvicted;
+#ifdef PBRT_HAVE_MMAP
+        // Drop the page from both the mapping and the file cache; it is
+        // unmodified, so later reads refetch it from the file.
+        size_t offset = size_t(page) << PageShift;
+        madvise((void *)(buffer->data + offset), length, MADV_DONTNEED);
+        posix_fadvise(fileno(file), buffer->fileOffset + offset, length,
+                      POSIX_FADV_DONTNEED);
+#endif
+    }
+}
+
+// TriangleMesh Method Definitions
 std::string TriangleMesh::ToString() const {
     std::string np = "(nullptr)";
     return StringPrintf(
         "[ TriangleMesh reverseOrientation: %s transformSwapsHandedness: %s "
         "nTriangles: %d nVertices: %d vertexIndices: %s p: %s n: %s "
-        "s: %s uv: %s faceIndices: %s ]",
+        "s: %s uv: %s faceIndices: %s compressed: %s ]",
         reverseOrientation, transformSwapsHandedness, nTriangles, nVertices,
         vertexIndices ? StringPrintf("%s", pstd::MakeSpan(vertexIndices, 3 * nTriangles))
                       : np,
@@ -82,7 +341,8 @@ std::string TriangleMesh::ToString() const {
         s ? StringPrintf("%s", pstd::MakeSpan(s, nVertices)) : nullptr,
         uv ? StringPrintf("%s", pstd::MakeSpan(uv, nVertices)) : nullptr,
         faceIndices ? StringPrintf("%s", pstd::MakeSpan(faceIndices, nTriangles))
-                    : nullptr);
+                    : nullptr,
+        compressed);
 }
 
 TriangleMesh::TriangleMesh(const Transform &renderFromObject, bool reverseOrientation,
@@ -105,19 +365,33 @@ TriangleMesh::TriangleMesh(const Transform &renderFromObject, bool reverseOrient
     // in the indices array...
     CHECK_LE(indices.size(), std::numeric_limits<int>::max());
 
-    vertexIndices = indexBufferCache->LookupOrAdd(std::move(indices));
+    bool compress = Options->compressMeshes && !Options->useGPU;
+    bool page = GeometryStore::Enabled() && !Options->useGPU && nTriangles > 0;
+    if (!compress || !CompressIndices(indices, nVertices, &compressed)) {
+        if (page) {
+            pagedIndices =
+                GeometryStore::Add(indices.data(), indices.size() * sizeof(int));
+            vertexIndices = (const int *)pagedIndices->data;
+        } else
+            vertexIndices = indexBufferCache->LookupOrAdd(std::move(indices));
+    }
 
     triangleBytes += sizeof(*this);
 
     // Transform mesh vertices to world space
     for (Point3f &p : P)
         p = renderFromObject(p);
-    p = pBufferCache->LookupOrAdd(std::move(P));
+    if (page) {
+        pagedP = GeometryStore::Add(P.data(), P.size() * sizeof(Point3f));
+        p = (const Point3f *)pagedP->data;
+    } else
+        p = pBufferCache->LookupOrAdd(std::move(P));
 
     // Copy _UV_, _N_, and _S_ vertex data, if present
     if (!UV.empty()) {
         CHECK_EQ(nVertices, UV.size());
-        uv = uvBufferCache->LookupOrAdd(std::move(UV));
+        if (!compress || !CompressUVs(UV, &compressed))
+            uv = uvBufferCache->LookupOrAdd(std::move(UV));
     }
     if (!N.empty()) {
         CHECK_EQ(nVertices, N.size());
@@ -126,7 +400,8 @@ TriangleMesh::TriangleMesh(const Transform &renderFromObject, bool reverseOrient
             if (reverseOrientation)
                 n = -n;
         }
-        n = nBufferCache->LookupOrAdd(std::move(N));
+        if (!compress || !CompressNormals(N, &compressed))
+            n = nBufferCache->LookupOrAdd(std::move(N));
     }
     if (!S.empty()) {
         CHECK_EQ(nVertices, S.size());
@@ -145,6 +420,19 @@ static void PlyErrorCallback(p_ply, const char *message) {
     Error("PLY writing error: %s", message);
 }
 
+void TriangleMesh::TouchPages(int triIndex) const {
+    // Record use of the pages holding the triangle's indices and vertex
+    // positions with the _GeometryStore_
+    if (pagedIndices)
+        GeometryStore::Touch(pagedIndices, 3 * size_t(triIndex) * sizeof(int),
+                             3 * sizeof(int));
+    for (int i = 0; i < 3; ++i) {
+        int v = vertexIndices ? vertexIndices[3 * triIndex + i]
+                              : compressed.Index(3 * triIndex + i);
+        GeometryStore::Touch(pagedP, v * sizeof(Point3f), sizeof(Point3f));
+    }
+}
+
 bool TriangleMesh::WritePLY(const std::string &filename) const {
     p_ply plyFile =
         ply_create(filename.c_str(), PLY_DEFAULT, PlyErrorCallback, 0, nullptr);
@@ -155,12 +443,12 @@ bool TriangleMesh::WritePLY(const std::string &filename) const {
     ply_add_scalar_property(plyFile, "x", PLY_FLOAT);
     ply_add_scalar_property(plyFile, "y", PLY_FLOAT);
     ply_add_scalar_property(plyFile, "z", PLY_FLOAT);
-    if (n != nullptr) {
+    if (HasNormals()) {
         ply_add_scalar_property(plyFile, "nx", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "ny", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "nz", PLY_FLOAT);
     }
-    if (uv != nullptr) {
+    if (HasUVs()) {
         ply_add_scalar_property(plyFile, "u", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "v", PLY_FLOAT);
     }
@@ -178,22 +466,23 @@ bool TriangleMesh::WritePLY(const std::string &filename) const {
         ply_write(plyFile, p[i].x);
         ply_write(plyFile, p[i].y);
         ply_write(plyFile, p[i].z);
-        if (n != nullptr) {
-            ply_write(plyFile, n[i].x);
-            ply_write(plyFile, n[i].y);
-            ply_write(plyFile, n[i].z);
+        if (HasNormals()) {
+            Normal3f ni = GetNormal(i);
+            ply_write(plyFile, ni.x);
+            ply_write(plyFile, ni.y);
+            ply_write(plyFile, ni.z);
         }
-        if (uv != nullptr) {
-            ply_write(plyFile, uv[i].x);
-            ply_write(plyFile, uv[i].y);
+        if (HasUVs()) {
+            Point2f uvi = GetUV(i);
+            ply_write(plyFile, uvi.x);
+            ply_write(plyFile, uvi.y);
         }
     }
 
     for (int i = 0; i < nTriangles; ++i) {
         ply_write(plyFile, 3);
-        ply_write(plyFile, vertexIndices[3 * i]);
-        ply_write(plyFile, vertexIndices[3 * i + 1]);
-        ply_write(plyFile, vertexIndices[3 * i + 2]);
+        for (int v : VertexIndices(i))
+            ply_write(plyFile, v);
         if (faceIndices != nullptr)
             ply_write(plyFile, faceIndices[i]);
     }
@@ -202,6 +491,78 @@ bool TriangleMesh::WritePLY(const std::string &filename) const {
     return true;
 }
 
+STAT_COUNTER("Geometry/Decimated triangle meshes", nDecimatedMeshes);
+
+Float TriangleMesh::MeanEdgeLength() const {
+    double sum = 0;
+    for (int i = 0; i < nTriangles; ++i) {
+        pstd::array<int, 3> v = VertexIndices(i);
+        sum += Distance(p[v[0]], p[v[1]]) + Distance(p[v[1]], p[v[2]]) +
+               Distance(p[v[2]], p[v[0]]);
+    }
+    return nTriangles > 0 ? Float(sum / (3 * double(nTriangles))) : 0;
+}
+
+TriangleMesh *TriangleMesh::Decimate(Float cellSize, Allocator alloc) const {
+    // Find the extent of the grid of cells covering the mesh
+    Bounds3f bounds;
+    for (int i = 0; i < nVertices; ++i)
+        bounds = Union(bounds, p[i]);
+    if (bounds.IsDegenerate() ||
+        MaxComponentValue(bounds.Diagonal() / cellSize) >= (1 << 21))
+        return nullptr;
+
+    // Merge all of the vertices in each grid cell into the first one found there
+    std::unordered_map<uint64_t, int> cellVertices;
+    std::vector<int> vertexMap(nVertices);
+    std::vector<Point3f> P;
+    std::vector<Vector3f> S;
+    std::vector<Normal3f> N;
+    std::vector<Point2f> UV;
+    for (int i = 0; i < nVertices; ++i) {
+        Vector3f c = (p[i] - bounds.pMin) / cellSize;
+        uint64_t cell = (uint64_t(c.x) << 42) | (uint64_t(c.y) << 21) | uint64_t(c.z);
+        auto iter = cellVertices.find(cell);
+        if (iter != cellVertices.end()) {
+            vertexMap[i] = iter->second;
+            continue;
+        }
+        vertexMap[i] = cellVertices[cell] = int(P.size());
+        P.push_back(p[i]);
+        if (s)
+            S.push_back(s[i]);
+        if (HasNormals()) {
+            // The _TriangleMesh_ constructor will flip them again if needed
+            Normal3f ni = GetNormal(i);
+            N.push_back(reverseOrientation ? -ni : ni);
+        }
+        if (HasUVs())
+            UV.push_back(GetUV(i));
+    }
+
+    // Remap the triangles' vertices and discard the ones that collapsed
+    std::vector<int> indices, fIndices;
+    for (int i = 0; i < nTriangles; ++i) {
+        pstd::array<int, 3> v = VertexIndices(i);
+        int v0 = vertexMap[v[0]], v1 = vertexMap[v[1]], v2 = vertexMap[v[2]];
+        if (v0 == v1 || v1 == v2 || v2 == v0)
+            continue;
+        indices.insert(indices.end(), {v0, v1, v2});
+        if (faceIndices)
+            fIndices.push_back(faceIndices[i]);
+    }
+    if (indices.empty())
+        return nullptr;
+
+    ++nDecimatedMeshes;
+    // The vertices are already in rendering space
+    TriangleMesh *mesh = alloc.new_object<TriangleMesh>(
+        Transform(), reverseOrientation, std::move(indices), std::move(P), std::move(S),
+        std::move(N), std::move(UV), std::move(fIndices));
+    mesh->transformSwapsHandedness = transformSwapsHandedness;
+    return mesh;
+}
+
 STAT_RATIO("Geometry/Bilinear patches per mesh", nBlps, nBilinearMeshes);
 STAT_MEMORY_COUNTER("Memory/Bilinear patches", blpBytes);
 
@@ -224,7 +585,9 @@ BilinearPatchMesh::BilinearPatchMesh(const Transform &renderFromObject,
     CHECK_LE(P.size(), std::numeric_limits<int>::max());
     CHECK_LE(indices.size(), std::numeric_limits<int>::max());
 
-    vertexIndices = indexBufferCache->LookupOrAdd(std::move(indices));
+    bool compress = Options->compressMeshes && !Options->useGPU;
+    if (!compress || !CompressIndices(indices, nVertices, &compressed))
+        vertexIndices = indexBufferCache->LookupOrAdd(std::move(indices));
 
     blpBytes += sizeof(*this);
 
@@ -236,7 +599,8 @@ BilinearPatchMesh::BilinearPatchMesh(const Transform &renderFromObject,
     // Copy _UV_ and _N_ vertex data, if present
     if (!UV.empty()) {
         CHECK_EQ(nVertices, UV.size());
-        uv = uvBufferCache->LookupOrAdd(std::move(UV));
+        if (!compress || !CompressUVs(UV, &compressed))
+            uv = uvBufferCache->LookupOrAdd(std::move(UV));
     }
     if (!N.empty()) {
         CHECK_EQ(nVertices, N.size());
@@ -245,7 +609,8 @@ BilinearPatchMesh::BilinearPatchMesh(const Transform &renderFromObject,
             if (reverseOrientation)
                 n = -n;
         }
-        n = nBufferCache->LookupOrAdd(std::move(N));
+        if (!compress || !CompressNormals(N, &compressed))
+            n = nBufferCache->LookupOrAdd(std::move(N));
     }
 
     if (!fIndices.empty()) {
@@ -260,7 +625,7 @@ std::string BilinearPatchMesh::ToString() const {
         "[ BilinearMatchMesh reverseOrientation: %s transformSwapsHandedness: "
         "%s "
         "nPatches: %d nVertices: %d vertexIndices: %s p: %s n: %s "
-        "uv: %s faceIndices: %s ]",
+        "uv: %s faceIndices: %s compressed: %s ]",
         reverseOrientation, transformSwapsHandedness, nPatches, nVertices,
         vertexIndices ? StringPrintf("%s", pstd::MakeSpan(vertexIndices, 4 * nPatches))
                       : np,
@@ -268,7 +633,8 @@ std::string BilinearPatchMesh::ToString() const {
         n ? StringPrintf("%s", pstd::MakeSpan(n, nVertices)) : nullptr,
         uv ? StringPrintf("%s", pstd::MakeSpan(uv, nVertices)) : nullptr,
         faceIndices ? StringPrintf("%s", pstd::MakeSpan(faceIndices, nPatches))
-                    : nullptr);
+                    : nullptr,
+        compressed);
 }
 
 struct FaceCallbackContext {
@@ -345,7 +711,429 @@ int rply_faceindex_callback(p_ply_argument argument) {
     return 1;
 }
 
-TriQuadMesh TriQuadMesh::ReadPLY(const std::string &filename) {
+// Binary PLY Fast Path Definitions
+enum class PLYScalar { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+static bool ParsePLYScalar(const std::string &str, PLYScalar *type) {
+    static const struct {
+        const char *name;
+        PLYScalar type;
+    } names[] = {{"char", PLYScalar::Int8},     {"int8", PLYScalar::Int8},
+                 {"uchar", PLYScalar::UInt8},   {"uint8", PLYScalar::UInt8},
+                 {"short", PLYScalar::Int16},   {"int16", PLYScalar::Int16},
+                 {"ushort", PLYScalar::UInt16}, {"uint16", PLYScalar::UInt16},
+                 {"int", PLYScalar::Int32},     {"int32", PLYScalar::Int32},
+                 {"uint", PLYScalar::UInt32},   {"uint32", PLYScalar::UInt32},
+                 {"float", PLYScalar::Float32}, {"float32", PLYScalar::Float32},
+                 {"double", PLYScalar::Float64}, {"float64", PLYScalar::Float64}};
+    for (const auto &n : names)
+        if (str == n.name) {
+            *type = n.type;
+            return true;
+        }
+    return false;
+}
+
+static int PLYScalarSize(PLYScalar type) {
+    switch (type) {
+    case PLYScalar::Int8:
+    case PLYScalar::UInt8:
+        return 1;
+    case PLYScalar::Int16:
+    case PLYScalar::UInt16:
+        return 2;
+    case PLYScalar::Int32:
+    case PLYScalar::UInt32:
+    case PLYScalar::Float32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+// Returns the little-endian value of the given type stored at _ptr_, which
+// need not be aligned.
+template <typename T>
+static T ReadPLYScalar(const uint8_t *ptr, PLYScalar type) {
+    switch (type) {
+    case PLYScalar::Int8:
+        return T(int8_t(*ptr));
+    case PLYScalar::UInt8:
+        return T(*ptr);
+    case PLYScalar::Int16: {
+        int16_t v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    case PLYScalar::UInt16: {
+        uint16_t v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    case PLYScalar::Int32: {
+        int32_t v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    case PLYScalar::UInt32: {
+        uint32_t v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    case PLYScalar::Float32: {
+        float v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    default: {
+        double v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return T(v);
+    }
+    }
+}
+
+struct PLYProperty {
+    std::string name;
+    PLYScalar type, countType = PLYScalar::UInt8;
+    bool isList = false;
+    // Byte offset from the start of the element; only meaningful for
+    // properties that precede any list property.
+    int offset = 0;
+};
+
+struct PLYElement {
+    const PLYProperty *Find(const char *name) const {
+        for (const PLYProperty &prop : properties)
+            if (prop.name == name)
+                return &prop;
+        return nullptr;
+    }
+
+    std::string name;
+    size_t count = 0;
+    std::vector<PLYProperty> properties;
+    // Size of each element in bytes, or 0 if it has list properties.
+    int stride = 0;
+};
+
+// MappedFile Definition
+class MappedFile {
+  public:
+    MappedFile(const std::string &filename) {
+#ifdef PBRT_HAVE_MMAP
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        struct stat stat;
+        if (fstat(fd, &stat) == 0 && stat.st_size > 0) {
+            void *ptr = mmap(nullptr, stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED) {
+                data = (const uint8_t *)ptr;
+                size = stat.st_size;
+            }
+        }
+        close(fd);
+#else
+        FILE *f = fopen(filename.c_str(), "rb");
+        if (!f)
+            return;
+        if (fseek(f, 0, SEEK_END) == 0) {
+            long length = ftell(f);
+            if (length > 0 && fseek(f, 0, SEEK_SET) == 0) {
+                contents.resize(length);
+                if (fread(contents.data(), 1, length, f) == size_t(length)) {
+                    data = contents.data();
+                    size = length;
+                }
+            }
+        }
+        fclose(f);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef PBRT_HAVE_MMAP
+        if (data && munmap((void *)data, size) != 0)
+            Error("munmap: %s", ErrorString());
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+  private:
+#ifndef PBRT_HAVE_MMAP
+    std::vector<uint8_t> contents;
+#endif
+};
+
+// Reads binary little-endian PLY files directly from a memory mapping of the
+// file, bypassing rply's per-value callbacks. Returns false for files it
+// doesn't handle, leaving it to the rply-based reader to load them (or to
+// report errors).
+static bool ReadBinaryPLY(const std::string &filename, TriQuadMesh *mesh) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return false;
+#endif
+    MappedFile file(filename);
+    if (!file.data)
+        return false;
+
+    // Parse the PLY header
+    const char *start = (const char *)file.data, *end = start + file.size;
+    const char *pos = start;
+    auto nextLine = [&]() -> pstd::optional<std::vector<std::string>> {
+        const char *eol = (const char *)memchr(pos, '\n', end - pos);
+        if (!eol)
+            return {};
+        std::string_view line(pos, eol - pos);
+        pos = eol + 1;
+        return SplitStringsFromWhitespace(line);
+    };
+
+    pstd::optional<std::vector<std::string>> tokens = nextLine();
+    if (!tokens || tokens->size() != 1 || (*tokens)[0] != "ply")
+        return false;
+    tokens = nextLine();
+    if (!tokens || tokens->size() != 3 || (*tokens)[0] != "format" ||
+        (*tokens)[1] != "binary_little_endian")
+        return false;
+
+    std::vector<PLYElement> elements;
+    while (true) {
+        tokens = nextLine();
+        if (!tokens)
+            return false;
+        if (tokens->empty() || (*tokens)[0] == "comment" || (*tokens)[0] == "obj_info")
+            continue;
+        if ((*tokens)[0] == "end_header")
+            break;
+
+        if ((*tokens)[0] == "element" && tokens->size() == 3) {
+            PLYElement element;
+            element.name = (*tokens)[1];
+            char *countEnd;
+            element.count = strtoull((*tokens)[2].c_str(), &countEnd, 10);
+            if (*countEnd != '\0')
+                return false;
+            elements.push_back(element);
+        } else if ((*tokens)[0] == "property" && !elements.empty()) {
+            PLYProperty prop;
+            if (tokens->size() == 3 && ParsePLYScalar((*tokens)[1], &prop.type))
+                prop.name = (*tokens)[2];
+            else if (tokens->size() == 5 && (*tokens)[1] == "list" &&
+                     ParsePLYScalar((*tokens)[2], &prop.countType) &&
+                     ParsePLYScalar((*tokens)[3], &prop.type)) {
+                prop.isList = true;
+                prop.name = (*tokens)[4];
+            } else
+                return false;
+            elements.back().properties.push_back(prop);
+        } else
+            return false;
+    }
+
+    // Compute property offsets and element sizes
+    for (PLYElement &element : elements) {
+        int offset = 0;
+        bool haveList = false;
+        for (PLYProperty &prop : element.properties) {
+            prop.offset = offset;
+            if (prop.isList)
+                haveList = true;
+            else
+                offset += PLYScalarSize(prop.type);
+        }
+        element.stride = haveList ? 0 : offset;
+    }
+
+    // Find the vertex and face elements; all others must have a fixed size
+    // so that they can be skipped over.
+    const uint8_t *data = (const uint8_t *)pos;
+    const uint8_t *vertexData = nullptr, *faceData = nullptr;
+    const PLYElement *vertices = nullptr, *faces = nullptr;
+    for (const PLYElement &element : elements) {
+        if (element.name == "vertex") {
+            vertices = &element;
+            vertexData = data;
+        } else if (element.name == "face") {
+            faces = &element;
+            faceData = data;
+            // The face element must be last since its size isn't known
+            // without parsing it.
+            if (&element != &elements.back())
+                return false;
+            break;
+        }
+        if (element.stride == 0 ||
+            element.count * element.stride > size_t(file.data + file.size - data))
+            return false;
+        data += element.count * element.stride;
+    }
+    if (!vertices || !faces || vertices->count == 0 || faces->count == 0)
+        return false;
+
+    const PLYProperty *x = vertices->Find("x"), *y = vertices->Find("y"),
+                      *z = vertices->Find("z");
+    if (!x || !y || !z)
+        return false;
+    const PLYProperty *nx = vertices->Find("nx"), *ny = vertices->Find("ny"),
+                      *nz = vertices->Find("nz");
+    const PLYProperty *u = nullptr, *v = nullptr;
+    const char *uvNames[][2] = {
+        {"u", "v"}, {"s", "t"}, {"texture_u", "texture_v"}, {"texture_s", "texture_t"}};
+    for (const auto &names : uvNames)
+        if (!u && vertices->Find(names[0]) && vertices->Find(names[1])) {
+            u = vertices->Find(names[0]);
+            v = vertices->Find(names[1]);
+        }
+
+    // Copy the vertex attributes in parallel
+    size_t nVertices = vertices->count;
+    int vertexStride = vertices->stride;
+    mesh->p.resize(nVertices);
+    if (nx && ny && nz)
+        mesh->n.resize(nVertices);
+    if (u && v)
+        mesh->uv.resize(nVertices);
+    bool packedPositions = sizeof(Point3f) == 12 && vertexStride == 12 &&
+                           x->offset == 0 && y->offset == 4 && z->offset == 8 &&
+                           x->type == PLYScalar::Float32 &&
+                           y->type == PLYScalar::Float32 &&
+                           z->type == PLYScalar::Float32;
+    ParallelFor(0, nVertices, [&](int64_t start, int64_t end) {
+        if (packedPositions)
+            std::memcpy(&mesh->p[start], vertexData + start * 12, (end - start) * 12);
+        for (int64_t i = start; i < end; ++i) {
+            const uint8_t *vertex = vertexData + i * vertexStride;
+            if (!packedPositions)
+                mesh->p[i] = Point3f(ReadPLYScalar<Float>(vertex + x->offset, x->type),
+                                     ReadPLYScalar<Float>(vertex + y->offset, y->type),
+                                     ReadPLYScalar<Float>(vertex + z->offset, z->type));
+            if (!mesh->n.empty())
+                mesh->n[i] =
+                    Normal3f(ReadPLYScalar<Float>(vertex + nx->offset, nx->type),
+                             ReadPLYScalar<Float>(vertex + ny->offset, ny->type),
+                             ReadPLYScalar<Float>(vertex + nz->offset, nz->type));
+            if (!mesh->uv.empty())
+                mesh->uv[i] = Point2f(ReadPLYScalar<Float>(vertex + u->offset, u->type),
+                                      ReadPLYScalar<Float>(vertex + v->offset, v->type));
+        }
+    });
+
+    // Faces must have a single list property, "vertex_indices"; the other
+    // properties are scalars, of which only "face_indices" is used.
+    const PLYProperty *indices = faces->Find("vertex_indices");
+    if (!indices || !indices->isList)
+        return false;
+    int prefixSize = indices->offset, suffixSize = 0;
+    const PLYProperty *faceIndex = faces->Find("face_indices");
+    int faceIndexOffset = -1;
+    for (const PLYProperty &prop : faces->properties) {
+        if (prop.isList && &prop != indices)
+            return false;
+        if (&prop > indices) {
+            if (&prop == faceIndex)
+                faceIndexOffset = suffixSize;
+            suffixSize += PLYScalarSize(prop.type);
+        } else if (&prop == faceIndex)
+            faceIndexOffset = prop.offset;
+    }
+    if (faceIndex && faceIndex->isList)
+        return false;
+    // _faceIndexOffset_ is relative to the start of the face for properties
+    // before the list and to the end of the list for ones after it.
+    bool faceIndexAfterList = faceIndex && faceIndex > indices;
+    int countSize = PLYScalarSize(indices->countType);
+    int indexSize = PLYScalarSize(indices->type);
+
+    // Find the size of each face's index list. In the common case, all faces
+    // have the same number of vertices and the faces can be decoded in parallel.
+    size_t nFaces = faces->count;
+    const uint8_t *faceEnd = file.data + file.size;
+    int64_t firstCount = -1;
+    bool uniform = true;
+    const uint8_t *face = faceData;
+    for (size_t i = 0; i < nFaces; ++i) {
+        if (face + prefixSize + countSize > faceEnd)
+            return false;
+        int64_t count = ReadPLYScalar<int64_t>(face + prefixSize, indices->countType);
+        if (count < 0)
+            return false;
+        if (firstCount == -1)
+            firstCount = count;
+        uniform &= (count == firstCount);
+        face += prefixSize + countSize + count * indexSize + suffixSize;
+        if (face > faceEnd)
+            return false;
+    }
+
+    auto faceIndexValue = [&](const uint8_t *face, int64_t count) {
+        const uint8_t *ptr =
+            faceIndexAfterList ? face + prefixSize + countSize + count * indexSize
+                               : face;
+        return ReadPLYScalar<int>(ptr + faceIndexOffset, faceIndex->type);
+    };
+    auto readIndex = [&](const uint8_t *face, int j) {
+        return ReadPLYScalar<int>(face + prefixSize + countSize + j * indexSize,
+                                  indices->type);
+    };
+
+    if (faceIndex)
+        mesh->faceIndices.resize(nFaces);
+    if (uniform && (firstCount == 3 || firstCount == 4)) {
+        int64_t faceStride = prefixSize + countSize + firstCount * indexSize + suffixSize;
+        std::vector<int> &meshIndices =
+            firstCount == 3 ? mesh->triIndices : mesh->quadIndices;
+        meshIndices.resize(nFaces * firstCount);
+        ParallelFor(0, nFaces, [&](int64_t start, int64_t end) {
+            for (int64_t i = start; i < end; ++i) {
+                const uint8_t *face = faceData + i * faceStride;
+                int *out = &meshIndices[i * firstCount];
+                if (firstCount == 3)
+                    for (int j = 0; j < 3; ++j)
+                        out[j] = readIndex(face, j);
+                else {
+                    // Note: modify order since we're specifying it as a blp...
+                    out[0] = readIndex(face, 0);
+                    out[1] = readIndex(face, 1);
+                    out[2] = readIndex(face, 3);
+                    out[3] = readIndex(face, 2);
+                }
+                if (faceIndex)
+                    mesh->faceIndices[i] = faceIndexValue(face, firstCount);
+            }
+        });
+    } else {
+        face = faceData;
+        for (size_t i = 0; i < nFaces; ++i) {
+            int64_t count = ReadPLYScalar<int64_t>(face + prefixSize, indices->countType);
+            if (count == 3)
+                for (int j = 0; j < 3; ++j)
+                    mesh->triIndices.push_back(readIndex(face, j));
+            else if (count == 4) {
+                mesh->quadIndices.push_back(readIndex(face, 0));
+                mesh->quadIndices.push_back(readIndex(face, 1));
+                mesh->quadIndices.push_back(readIndex(face, 3));
+                mesh->quadIndices.push_back(readIndex(face, 2));
+            } else
+                Warning("plymesh: Ignoring face with %i vertices (only triangles and "
+                        "quads are supported!)",
+                        (int)count);
+            if (faceIndex)
+                mesh->faceIndices[i] = faceIndexValue(face, count);
+            face += prefixSize + countSize + count * indexSize + suffixSize;
+        }
+    }
+
+    return true;
+}
+
+static TriQuadMesh ReadPLYWithRPly(const std::string &filename) {
     TriQuadMesh mesh;
 
     p_ply ply = ply_open(filename.c_str(), rply_message_callback, 0, nullptr);
@@ -434,6 +1222,17 @@ TriQuadMesh TriQuadMesh::ReadPLY(const std::string &filename) {
 
     ply_close(ply);
 
+    return mesh;
+}
+
+TriQuadMesh TriQuadMesh::ReadPLY(const std::string &filename) {
+    ++nPLYFiles;
+    TriQuadMesh mesh;
+    if (ReadBinaryPLY(filename, &mesh))
+        ++nBinaryPLYFiles;
+    else
+        mesh = ReadPLYWithRPly(filename);
+
     for (int idx : mesh.triIndices)
         if (idx < 0 || idx >= mesh.p.size())
             ErrorExit("plymesh: Vertex index %i is out of bounds! "
@@ -448,6 +1247,46 @@ TriQuadMesh TriQuadMesh::ReadPLY(const std::string &filename) {
     return mesh;
 }
 
+int64_t TriQuadMesh::EstimatePLYBytes(const std::string &filename) {
+    p_ply ply = ply_open(filename.c_str(), [](p_ply, const char *) {}, 0, nullptr);
+    if (ply == nullptr)
+        return 0;
+
+    int64_t bytes = 0;
+    if (ply_read_header(ply) != 0) {
+        p_ply_element element = nullptr;
+        while ((element = ply_get_next_element(ply, element)) != nullptr) {
+            const char *name;
+            long nInstances;
+            ply_get_element_info(element, &name, &nInstances);
+            bool isVertex = strcmp(name, "vertex") == 0;
+            if (!isVertex && strcmp(name, "face") != 0)
+                continue;
+
+            // Vertices always have positions; faces are assumed to be
+            // triangles, which are by far the most common.
+            int64_t elementBytes = isVertex ? sizeof(Point3f) : 3 * sizeof(int);
+            p_ply_property prop = nullptr;
+            while ((prop = ply_get_next_property(element, prop)) != nullptr) {
+                const char *propName;
+                ply_get_property_info(prop, &propName, nullptr, nullptr, nullptr);
+                if (isVertex && strcmp(propName, "nx") == 0)
+                    elementBytes += sizeof(Normal3f);
+                else if (isVertex && (strcmp(propName, "u") == 0 ||
+                                      strcmp(propName, "s") == 0 ||
+                                      strcmp(propName, "texture_u") == 0 ||
+                                      strcmp(propName, "texture_s") == 0))
+                    elementBytes += sizeof(Point2f);
+                else if (!isVertex && strcmp(propName, "face_indices") == 0)
+                    elementBytes += sizeof(int);
+            }
+            bytes += int64_t(nInstances) * elementBytes;
+        }
+    }
+    ply_close(ply);
+    return bytes;
+}
+
 void TriQuadMesh::ConvertToOnlyTriangles() {
     if (quadIndices.empty())
         return;
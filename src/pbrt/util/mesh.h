@@ -10,7 +10,13 @@
 #include <pbrt/util/pstd.h>
 #include <pbrt/util/vecmath.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace pbrt {
@@ -18,6 +24,123 @@ namespace pbrt {
 void InitBufferCaches(Allocator alloc);
 void FreeBufferCaches();
 
+// CompressedMeshAttributes Definition
+// Compact representations of a mesh's vertex indices, normals, and uvs that are
+// used when the --compress-meshes option is given. Each is only non-null if
+// the mesh's corresponding full-precision array is null.
+struct CompressedMeshAttributes {
+    // CompressedMeshAttributes Public Methods
+    PBRT_CPU_GPU
+    int Index(size_t i) const {
+        int offset = indexBlockOffsets ? indexBlockOffsets[i / IndicesPerBlock] : 0;
+        return offset + indices[i];
+    }
+
+    PBRT_CPU_GPU
+    Normal3f N(int vertex) const { return Normal3f(Vector3f(n[vertex])); }
+
+    PBRT_CPU_GPU
+    Point2f UV(int vertex) const {
+        return uvMin +
+               Vector2f(uv[2 * vertex] * uvScale.x, uv[2 * vertex + 1] * uvScale.y);
+    }
+
+    std::string ToString() const;
+
+    // CompressedMeshAttributes Public Members
+    // Vertex indices are stored as 16-bit offsets. For meshes with more
+    // than 65536 vertices, each block of _IndicesPerBlock_ indices has its
+    // own 32-bit offset that is added to them; blocks of triangles and
+    // patches usually only span a small range of nearby vertices.
+    static constexpr int IndicesPerBlock = 48;
+    const uint16_t *indices = nullptr;
+    const int *indexBlockOffsets = nullptr;
+    const OctahedralVector *n = nullptr;
+    // Quantized to 16 bits over the mesh's uv bounds.
+    const uint16_t *uv = nullptr;
+    Point2f uvMin;
+    Vector2f uvScale;
+};
+
+// GeometryStoreBuffer Definition
+// A mesh buffer that has been written to the _GeometryStore_'s file. Its
+// contents are always read through the store's mapping of the file at
+// _data_; _pages_ records which of its pages the store currently counts as
+// resident.
+struct GeometryStoreBuffer {
+    struct Page {
+        std::atomic<bool> resident{false}, referenced{false};
+    };
+    const uint8_t *data;
+    size_t bytes;
+    int64_t fileOffset;
+    std::unique_ptr<Page[]> pages;
+};
+
+// GeometryStore Definition
+// With the --geometry-cache-mb option, triangle mesh vertex indices and
+// positions are kept in a memory-mapped scratch file rather than in
+// memory. The file is mapped in large regions so that the number of
+// mappings stays small. Shapes report the pages they use with Touch();
+// once the pages in use exceed the budget, the least recently used ones
+// are released back to the file and faulted in again on their next use.
+// The resident page accounting is approximate so that Touch() needn't
+// take any locks.
+class GeometryStore {
+  public:
+    // GeometryStore Public Methods
+    static void Init(size_t maxResidentBytes);
+    // Unmaps and closes the store's file. Meshes whose buffers were added
+    // to the store must not be used afterward.
+    static void Shutdown();
+    static bool Enabled() { return store != nullptr; }
+
+    static const GeometryStoreBuffer *Add(const void *data, size_t bytes);
+    static void Touch(const GeometryStoreBuffer *buffer, size_t offset, size_t bytes) {
+        int lastPage = (offset + bytes - 1) >> PageShift;
+        for (int page = offset >> PageShift; page <= lastPage; ++page) {
+            GeometryStoreBuffer::Page &p = buffer->pages[page];
+            if (!p.referenced.load(std::memory_order_relaxed))
+                p.referenced.store(true, std::memory_order_relaxed);
+            if (!p.resident.load(std::memory_order_relaxed))
+                store->Load(buffer, page);
+        }
+    }
+
+    static constexpr int PageShift = 16;
+    static constexpr size_t PageBytes = size_t(1) << PageShift;
+    static constexpr size_t RegionBytes = size_t(1) << 30;
+
+  private:
+    // GeometryStore Private Methods
+    GeometryStore(size_t maxResidentBytes, FILE *file)
+        : maxResidentBytes(maxResidentBytes), file(file) {}
+    void Load(const GeometryStoreBuffer *buffer, int page);
+    void Evict();
+    size_t PageLength(const GeometryStoreBuffer *buffer, int page) const {
+        return std::min(PageBytes, buffer->bytes - (size_t(page) << PageShift));
+    }
+
+    // GeometryStore Private Members
+    static GeometryStore *store;
+    std::atomic<size_t> maxResidentBytes, residentBytes{0};
+    FILE *file;
+    struct Region {
+        const uint8_t *data;
+        int64_t fileOffset;
+        size_t length;
+    };
+    // Protects _fileBytes_, _regions_, and _buffers_
+    std::mutex fileMutex;
+    int64_t fileBytes = 0;
+    std::vector<Region> regions;
+    std::vector<std::unique_ptr<GeometryStoreBuffer>> buffers;
+    // Every page of every buffer, swept by the eviction clock hand
+    std::mutex evictMutex;
+    std::vector<std::pair<const GeometryStoreBuffer *, int>> pages;
+    size_t clockHand = 0;
+};
+
 // TriangleMesh Definition
 class TriangleMesh {
   public:
@@ -31,8 +154,37 @@ class TriangleMesh {
 
     bool WritePLY(const std::string &filename) const;
 
+    Float MeanEdgeLength() const;
+    // Returns a simplified version of the mesh in which the vertices in
+    // each cell of a grid with the given cell size have been merged, or
+    // nullptr if no triangles remain.
+    TriangleMesh *Decimate(Float cellSize, Allocator alloc) const;
+
     static void Init(Allocator alloc);
 
+    PBRT_CPU_GPU
+    pstd::array<int, 3> VertexIndices(int triIndex) const {
+#ifndef PBRT_IS_GPU_CODE
+        if (pagedP)
+            TouchPages(triIndex);
+#endif
+        if (vertexIndices)
+            return {vertexIndices[3 * triIndex], vertexIndices[3 * triIndex + 1],
+                    vertexIndices[3 * triIndex + 2]};
+        return {compressed.Index(3 * triIndex), compressed.Index(3 * triIndex + 1),
+                compressed.Index(3 * triIndex + 2)};
+    }
+
+    PBRT_CPU_GPU
+    bool HasNormals() const { return n || compressed.n; }
+    PBRT_CPU_GPU
+    Normal3f GetNormal(int vertex) const { return n ? n[vertex] : compressed.N(vertex); }
+
+    PBRT_CPU_GPU
+    bool HasUVs() const { return uv || compressed.uv; }
+    PBRT_CPU_GPU
+    Point2f GetUV(int vertex) const { return uv ? uv[vertex] : compressed.UV(vertex); }
+
     // TriangleMesh Public Members
     int nTriangles, nVertices;
     const int *vertexIndices = nullptr;
@@ -41,7 +193,14 @@ class TriangleMesh {
     const Vector3f *s = nullptr;
     const Point2f *uv = nullptr;
     const int *faceIndices = nullptr;
+    CompressedMeshAttributes compressed;
+    // Non-null if _vertexIndices_ and _p_ point into the _GeometryStore_.
+    const GeometryStoreBuffer *pagedIndices = nullptr, *pagedP = nullptr;
     bool reverseOrientation, transformSwapsHandedness;
+
+  private:
+    // TriangleMesh Private Methods
+    void TouchPages(int triIndex) const;
 };
 
 // BilinearPatchMesh Definition
@@ -56,6 +215,26 @@ class BilinearPatchMesh {
 
     static void Init(Allocator alloc);
 
+    PBRT_CPU_GPU
+    pstd::array<int, 4> VertexIndices(int patchIndex) const {
+        if (vertexIndices)
+            return {vertexIndices[4 * patchIndex], vertexIndices[4 * patchIndex + 1],
+                    vertexIndices[4 * patchIndex + 2], vertexIndices[4 * patchIndex + 3]};
+        return {compressed.Index(4 * patchIndex), compressed.Index(4 * patchIndex + 1),
+                compressed.Index(4 * patchIndex + 2),
+                compressed.Index(4 * patchIndex + 3)};
+    }
+
+    PBRT_CPU_GPU
+    bool HasNormals() const { return n || compressed.n; }
+    PBRT_CPU_GPU
+    Normal3f GetNormal(int vertex) const { return n ? n[vertex] : compressed.N(vertex); }
+
+    PBRT_CPU_GPU
+    bool HasUVs() const { return uv || compressed.uv; }
+    PBRT_CPU_GPU
+    Point2f GetUV(int vertex) const { return uv ? uv[vertex] : compressed.UV(vertex); }
+
     bool reverseOrientation, transformSwapsHandedness;
     int nPatches, nVertices;
     const int *vertexIndices = nullptr;
@@ -63,11 +242,16 @@ class BilinearPatchMesh {
     const Normal3f *n = nullptr;
     const Point2f *uv = nullptr;
     const int *faceIndices = nullptr;
+    CompressedMeshAttributes compressed;
     PiecewiseConstant2D *imageDistribution;
 };
 
 struct TriQuadMesh {
     static TriQuadMesh ReadPLY(const std::string &filename);
+    // Returns an estimate of how much memory the mesh in the given PLY file
+    // will use once it is read, based on the element counts in its header,
+    // or 0 if its header can't be read.
+    static int64_t EstimatePLYBytes(const std::string &filename);
 
     void ConvertToOnlyTriangles();
     std::string ToString() const;
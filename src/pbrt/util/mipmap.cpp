@@ -4,11 +4,14 @@
 
 #include <pbrt/util/mipmap.h>
 
+#include <pbrt/options.h>
+#include <pbrt/util/bits.h>
 #include <pbrt/util/check.h>
 #include <pbrt/util/color.h>
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/log.h>
 #include <pbrt/util/math.h>
 #include <pbrt/util/print.h>
@@ -16,10 +19,24 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#ifdef PBRT_HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef PBRT_IS_WINDOWS
+#include <unistd.h>
+#endif
 
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Image maps", imageMapBytes);
+STAT_MEMORY_COUNTER("Memory/Texture tile cache", textureTileBytes);
+STAT_PERCENT("Texture/Tile cache hits", textureTileHits, textureTileLookups);
+STAT_COUNTER("Texture/Tiles loaded", textureTilesLoaded);
+STAT_COUNTER("Texture/Tiles evicted", textureTilesEvicted);
 
 ///////////////////////////////////////////////////////////////////////////
 // MIPMap Helper Declarations
@@ -34,6 +51,8 @@ std::string ToString(FilterFunction f) {
         return "Trilinear";
     case FilterFunction::EWA:
         return "EWA";
+    case FilterFunction::Stochastic:
+        return "Stochastic";
     default:
         LOG_FATAL("Unhandled case");
         return "";
@@ -190,25 +209,665 @@ static PBRT_CONST Float weightLut[WeightLUTSize] = {
 
 };
 
+// TextureTile Definition
+struct TextureTile {
+    uint64_t key;
+    size_t bytes;
+    std::unique_ptr<uint8_t[]> data;
+    std::atomic<TextureTile *> next{nullptr};
+    // Set on every hit and cleared by the eviction clock hand
+    std::atomic<bool> referenced{true};
+    uint64_t retireEpoch = 0;
+};
+
+// TiledImageHeader Definition
+// Tiled pyramid files start with this header; the tiles of all levels
+// follow at _TiledImageDataOffset_, in level order and row-major within
+// each level, so that they can be memory-mapped in place.
+struct TiledImageHeader {
+    char magic[8];
+    int32_t version;
+    int32_t format;
+    int32_t nChannels;
+    int32_t tileSize;
+    int32_t wrapMode;
+    // 0: linear, 1: sRGB
+    int32_t encoding;
+    // Chromaticities of the RGB color space's primaries and white point
+    float colorSpace[8];
+    int32_t nLevels;
+    int32_t levelResolution[32][2];
+};
+
+static constexpr char TiledImageMagic[8] = {'p', 'b', 'r', 't', 't', 'x', 'p', '\0'};
+static constexpr int TiledImageVersion = 1;
+static constexpr int64_t TiledImageDataOffset = 4096;
+static_assert(sizeof(TiledImageHeader) <= TiledImageDataOffset, "header too large");
+
+// TiledImagePyramid Method Definitions
+static std::atomic<uint32_t> nextTiledPyramidId{0};
+
+TiledImagePyramid::TiledImagePyramid(PixelFormat format, ColorEncodingHandle encoding,
+                                     int nChannels,
+                                     pstd::span<const Point2i> resolutions)
+    : id(nextTiledPyramidId++), format(format), encoding(encoding), nChannels(nChannels) {
+    CHECK_LT(id, 1u << 24);
+    int64_t offset = TiledImageDataOffset;
+    for (Point2i res : resolutions) {
+        Point2i nTiles((res.x + TileSize - 1) / TileSize,
+                       (res.y + TileSize - 1) / TileSize);
+        CHECK(nTiles.x <= 65536 && nTiles.y <= 65536);
+        levels.push_back(LevelInfo{res, nTiles, offset});
+        offset += int64_t(nTiles.x) * nTiles.y * TileBytes();
+    }
+}
+
+// Tiled pyramids created from images in memory all store their tiles in
+// this scratch file, each in its own range of it.
+static std::mutex scratchTileFileMutex;
+static FILE *scratchTileFile;
+static int64_t scratchTileFileSize;
+
+#ifdef PBRT_IS_WINDOWS
+// Serializes the seek and read or write pairs of tile file accesses.
+static std::mutex tileFileMutex;
+#endif
+
+static bool readTileFile(FILE *f, int64_t offset, uint8_t *dst, size_t size) {
+#ifdef PBRT_IS_WINDOWS
+    std::lock_guard<std::mutex> lock(tileFileMutex);
+    return _fseeki64(f, offset, SEEK_SET) == 0 && fread(dst, 1, size, f) == size;
+#else
+    return pread(fileno(f), dst, size, offset) == ssize_t(size);
+#endif
+}
+
+static bool writeTileFile(FILE *f, int64_t offset, const uint8_t *src, size_t size) {
+#ifdef PBRT_IS_WINDOWS
+    std::lock_guard<std::mutex> lock(tileFileMutex);
+    return _fseeki64(f, offset, SEEK_SET) == 0 && fwrite(src, 1, size, f) == size &&
+           fflush(f) == 0;
+#else
+    return pwrite(fileno(f), src, size, offset) == ssize_t(size);
+#endif
+}
+
+// Copies the texels of the given tile of _image_ to _dst_, padding partial
+// tiles at the edges with zeros.
+static void copyTile(const Image &image, Point2i tile, uint8_t *dst) {
+    constexpr int TileSize = TiledImagePyramid::TileSize;
+    size_t texelBytes = image.NChannels() * TexelBytes(image.Format());
+    std::fill(dst, dst + TileSize * TileSize * texelBytes, 0);
+    Point2i res = image.Resolution();
+    int x0 = tile.x * TileSize, x1 = std::min(x0 + TileSize, res.x);
+    for (int y = tile.y * TileSize; y < std::min((tile.y + 1) * TileSize, res.y); ++y)
+        std::memcpy(dst + (y - tile.y * TileSize) * TileSize * texelBytes,
+                    image.RawPointer({x0, y}), (x1 - x0) * texelBytes);
+}
+
+static std::vector<Point2i> MIPLevelResolutions(Point2i res) {
+    // Match the power-of-two resampling of Image::GenerateMIPMapLevels()
+    res = Point2i(RoundUpPow2(res.x), RoundUpPow2(res.y));
+    std::vector<Point2i> resolutions{res};
+    while (res.x > 1 || res.y > 1) {
+        res = Point2i(std::max(1, res.x / 2), std::max(1, res.y / 2));
+        resolutions.push_back(res);
+    }
+    return resolutions;
+}
+
+TiledImagePyramid::TiledImagePyramid(Image image, WrapMode2D wrapMode)
+    : TiledImagePyramid(image.Format(), image.Encoding(), image.NChannels(),
+                        MIPLevelResolutions(image.Resolution())) {
+    // Reserve this pyramid's range of the scratch file; level offsets leave
+    // room for the header of a standalone file, which isn't stored here
+    const LevelInfo &last = levels.back();
+    int64_t length = last.offset + int64_t(last.nTiles.x) * last.nTiles.y * TileBytes();
+    {
+        std::lock_guard<std::mutex> lock(scratchTileFileMutex);
+        if (!scratchTileFile && !(scratchTileFile = tmpfile()))
+            ErrorExit("Unable to create texture tile file: %s", ErrorString());
+        fileOffset = scratchTileFileSize - TiledImageDataOffset;
+        scratchTileFileSize += length - TiledImageDataOffset;
+    }
+    file = scratchTileFile;
+
+    // Write each level's tiles as soon as the level has been generated
+    std::vector<uint8_t> tileData(TileBytes());
+    Image::GenerateMIPMapLevels(
+        std::move(image), wrapMode, [&](int level, Image levelImage) {
+            const LevelInfo &l = levels[level];
+            for (int ty = 0; ty < l.nTiles.y; ++ty)
+                for (int tx = 0; tx < l.nTiles.x; ++tx) {
+                    copyTile(levelImage, {tx, ty}, tileData.data());
+                    int64_t offset = fileOffset + l.offset +
+                                     (ty * l.nTiles.x + tx) * int64_t(TileBytes());
+                    if (!writeTileFile(file, offset, tileData.data(), tileData.size()))
+                        ErrorExit("Error writing texture tile file: %s", ErrorString());
+                }
+        });
+}
+
+TiledImagePyramid::~TiledImagePyramid() {
+    TextureTileCache::Purge(this);
+    if (file && ownsFile)
+        fclose(file);
+#ifdef PBRT_HAVE_MMAP
+    if (mapping && munmap(mapping, mappingLength) != 0)
+        Error("munmap: %s", ErrorString());
+#endif
+}
+
+bool TiledImagePyramid::Write(const std::string &filename,
+                              pstd::span<const Image> pyramid, WrapMode wrapMode,
+                              const RGBColorSpace *colorSpace) {
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f) {
+        Error("%s: %s", filename, ErrorString());
+        return false;
+    }
+    bool ok = Write(f, pyramid, wrapMode, colorSpace);
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        Error("%s: error writing tiled image: %s", filename, ErrorString());
+    return ok;
+}
+
+bool TiledImagePyramid::Write(FILE *f, pstd::span<const Image> pyramid,
+                              WrapMode wrapMode, const RGBColorSpace *colorSpace) {
+    const Image &image0 = pyramid[0];
+    CHECK(pyramid.size() <= 32);
+    CHECK(!Is8Bit(image0.Format()) || !image0.Encoding().Is<GammaColorEncoding>());
+
+    // Write the header, padded to _TiledImageDataOffset_
+    std::vector<uint8_t> headerBytes(TiledImageDataOffset, 0);
+    TiledImageHeader &header = *(TiledImageHeader *)headerBytes.data();
+    std::memcpy(header.magic, TiledImageMagic, sizeof(TiledImageMagic));
+    header.version = TiledImageVersion;
+    header.format = int32_t(image0.Format());
+    header.nChannels = image0.NChannels();
+    header.tileSize = TileSize;
+    header.wrapMode = int32_t(wrapMode);
+    header.encoding = image0.Encoding().Is<sRGBColorEncoding>() ? 1 : 0;
+    if (colorSpace) {
+        Point2f c[4] = {colorSpace->r, colorSpace->g, colorSpace->b, colorSpace->w};
+        for (int i = 0; i < 4; ++i) {
+            header.colorSpace[2 * i] = c[i].x;
+            header.colorSpace[2 * i + 1] = c[i].y;
+        }
+    }
+    header.nLevels = pyramid.size();
+    for (size_t i = 0; i < pyramid.size(); ++i) {
+        header.levelResolution[i][0] = pyramid[i].Resolution().x;
+        header.levelResolution[i][1] = pyramid[i].Resolution().y;
+    }
+    if (fwrite(headerBytes.data(), 1, headerBytes.size(), f) != headerBytes.size())
+        return false;
+
+    // Write each level's tiles
+    std::vector<uint8_t> tileData(TileSize * TileSize * image0.NChannels() *
+                                  TexelBytes(image0.Format()));
+    for (const Image &image : pyramid) {
+        Point2i res = image.Resolution();
+        for (int ty = 0; ty < (res.y + TileSize - 1) / TileSize; ++ty)
+            for (int tx = 0; tx < (res.x + TileSize - 1) / TileSize; ++tx) {
+                copyTile(image, {tx, ty}, tileData.data());
+                if (fwrite(tileData.data(), 1, tileData.size(), f) != tileData.size())
+                    return false;
+            }
+    }
+    return true;
+}
+
+std::unique_ptr<TiledImagePyramid> TiledImagePyramid::Read(
+    const std::string &filename, const RGBColorSpace **colorSpace, WrapMode *wrapMode) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        Error("%s: %s", filename, ErrorString());
+        return nullptr;
+    }
+    TiledImageHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        std::memcmp(header.magic, TiledImageMagic, sizeof(TiledImageMagic)) != 0 ||
+        header.version != TiledImageVersion || header.tileSize != TileSize ||
+        header.nLevels < 1 || header.nLevels > 32 ||
+        (header.nChannels != 1 && header.nChannels != 3) || header.format < 0 ||
+        header.format > int32_t(PixelFormat::Float)) {
+        Error("%s: not a valid tiled image file", filename);
+        fclose(f);
+        return nullptr;
+    }
+
+    std::vector<Point2i> resolutions;
+    for (int i = 0; i < header.nLevels; ++i)
+        resolutions.push_back(
+            Point2i(header.levelResolution[i][0], header.levelResolution[i][1]));
+    ColorEncodingHandle encoding =
+        header.encoding == 1 ? ColorEncodingHandle::sRGB : ColorEncodingHandle::Linear;
+    std::unique_ptr<TiledImagePyramid> pyramid(new TiledImagePyramid(
+        PixelFormat(header.format), encoding, header.nChannels, resolutions));
+
+    const float *c = header.colorSpace;
+    *colorSpace = RGBColorSpace::Lookup(Point2f(c[0], c[1]), Point2f(c[2], c[3]),
+                                        Point2f(c[4], c[5]), Point2f(c[6], c[7]));
+    *wrapMode = WrapMode(header.wrapMode);
+
+    const LevelInfo &last = pyramid->levels.back();
+    size_t length = last.offset + int64_t(last.nTiles.x) * last.nTiles.y *
+                                      pyramid->TileBytes();
+
+    // Make sure that the file holds all of the tiles the header describes
+#ifdef PBRT_IS_WINDOWS
+    struct _stat64 stat;
+    bool statOk = _fstat64(_fileno(f), &stat) == 0;
+#else
+    struct stat stat;
+    bool statOk = fstat(fileno(f), &stat) == 0;
+#endif
+    if (!statOk || stat.st_size < int64_t(length)) {
+        if (!statOk)
+            Error("%s: %s", filename, ErrorString());
+        else
+            Error("%s: tiled image file is truncated: %d bytes, expected %d", filename,
+                  int64_t(stat.st_size), int64_t(length));
+        fclose(f);
+        return nullptr;
+    }
+
+    if (TextureTileCache::Enabled()) {
+        // Page tiles in through the tile cache
+        pyramid->file = f;
+        pyramid->ownsFile = true;
+        return pyramid;
+    }
+
+#ifdef PBRT_HAVE_MMAP
+    // Map the file so that the OS pages in tiles as they are accessed
+    void *ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fileno(f), 0);
+    fclose(f);
+    if (ptr == MAP_FAILED) {
+        Error("%s: mmap: %s", filename, ErrorString());
+        return nullptr;
+    }
+    pyramid->mapping = ptr;
+    pyramid->mappingLength = length;
+    pyramid->data = (const uint8_t *)ptr;
+#else
+    // Read the entire file into memory
+    pyramid->contents.resize(length);
+    bool ok = fseek(f, 0, SEEK_SET) == 0 &&
+              fread(pyramid->contents.data(), 1, length, f) == length;
+    fclose(f);
+    if (!ok) {
+        Error("%s: error reading tiled image: %s", filename, ErrorString());
+        return nullptr;
+    }
+    pyramid->data = pyramid->contents.data();
+    imageMapBytes += length;
+#endif
+    return pyramid;
+}
+
+void TiledImagePyramid::ReadTile(int level, Point2i tile, uint8_t *dst) const {
+    const LevelInfo &l = levels[level];
+    int64_t offset =
+        fileOffset + l.offset + (tile.y * l.nTiles.x + tile.x) * int64_t(TileBytes());
+    if (!readTileFile(file, offset, dst, TileBytes()))
+        ErrorExit("Error reading texture tile file: %s", ErrorString());
+}
+
+void TiledImagePyramid::GetTexel(int level, Point2i p, WrapMode2D wrapMode,
+                                 Float *values) const {
+    CHECK(level >= 0 && level < levels.size());
+    const LevelInfo &l = levels[level];
+    if (!RemapPixelCoords(&p, l.resolution, wrapMode)) {
+        for (int c = 0; c < nChannels; ++c)
+            values[c] = 0;
+        return;
+    }
+    Point2i tile(p.x / TileSize, p.y / TileSize);
+    int offset = nChannels * ((p.y % TileSize) * TileSize + (p.x % TileSize));
+
+    if (data) {
+        // Read the texel directly from the mapped file
+        int64_t tileOffset =
+            l.offset + (tile.y * l.nTiles.x + tile.x) * int64_t(TileBytes());
+        DecodeTexel(data + tileOffset, offset, values);
+    } else {
+        TextureTileCache::ReadScope scope;
+        const TextureTile *t = TextureTileCache::Lookup(this, level, tile);
+        DecodeTexel(t->data.get(), offset, values);
+    }
+}
+
+void TiledImagePyramid::DecodeTexel(const uint8_t *tile, int offset,
+                                    Float *values) const {
+    switch (format) {
+    case PixelFormat::U256:
+        encoding.ToLinear({tile + offset, size_t(nChannels)},
+                          {values, size_t(nChannels)});
+        break;
+    case PixelFormat::Half: {
+        const Half *h = (const Half *)tile + offset;
+        for (int c = 0; c < nChannels; ++c)
+            values[c] = Float(h[c]);
+        break;
+    }
+    case PixelFormat::Float: {
+        const float *f = (const float *)tile + offset;
+        for (int c = 0; c < nChannels; ++c)
+            values[c] = f[c];
+        break;
+    }
+    default:
+        LOG_FATAL("Unhandled PixelFormat");
+    }
+}
+
+std::string TiledImagePyramid::ToString() const {
+    return StringPrintf("[ TiledImagePyramid id: %d format: %s nChannels: %d "
+                        "levels: %d mapped: %s ]",
+                        id, format, nChannels, levels.size(), data != nullptr);
+}
+
+// TextureTileCache Reader Epochs
+// Each thread that reads tiles publishes the global epoch it started at;
+// retired tiles are only freed once every active reader started later.
+struct alignas(64) TileReaderSlot {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> inUse{true};
+    TileReaderSlot *next = nullptr;
+};
+
+static std::atomic<TileReaderSlot *> tileReaderSlots{nullptr};
+
+struct ThreadTileReaderSlot {
+    ThreadTileReaderSlot() {
+        // Reuse the slot of an exited thread if one is available
+        for (TileReaderSlot *s = tileReaderSlots.load(); s; s = s->next) {
+            bool inUse = false;
+            if (s->inUse.compare_exchange_strong(inUse, true)) {
+                slot = s;
+                return;
+            }
+        }
+        slot = new TileReaderSlot;
+        slot->next = tileReaderSlots.load();
+        while (!tileReaderSlots.compare_exchange_weak(slot->next, slot))
+            ;
+    }
+    ~ThreadTileReaderSlot() { slot->inUse.store(false); }
+
+    TileReaderSlot *slot;
+};
+
+static thread_local ThreadTileReaderSlot threadTileReaderSlot;
+
+// TextureTileCache Method Definitions
+struct alignas(64) TextureTileCache::Shard {
+    std::mutex mutex;
+    int nBuckets;
+    std::unique_ptr<std::atomic<TextureTile *>[]> buckets;
+    std::vector<TextureTile *> resident;
+    size_t clockHand = 0;
+    size_t bytes = 0;
+};
+
+TextureTileCache *TextureTileCache::cache;
+static std::mutex tileCacheInitMutex;
+
+void TextureTileCache::Init(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(tileCacheInitMutex);
+    if (cache)
+        cache->maxBytes = maxBytes;
+    else
+        cache = new TextureTileCache(maxBytes);
+}
+
+void TextureTileCache::Shutdown() {
+    std::lock_guard<std::mutex> lock(tileCacheInitMutex);
+    if (!cache)
+        return;
+    for (int i = 0; i < NShards; ++i)
+        for (TextureTile *t : cache->shards[i].resident) {
+            textureTileBytes -= t->bytes;
+            delete t;
+        }
+    for (TextureTile *t : cache->retired)
+        delete t;
+    delete cache;
+    cache = nullptr;
+}
+
+TextureTileCache::TextureTileCache(size_t maxBytes)
+    : maxBytes(maxBytes), shards(new Shard[NShards]) {
+    // Size the hash buckets for roughly one 4kB tile per bucket
+    int nBuckets = std::max<int>(64, RoundUpPow2(int64_t(maxBytes / 4096 / NShards)));
+    for (int i = 0; i < NShards; ++i) {
+        shards[i].nBuckets = nBuckets;
+        shards[i].buckets.reset(new std::atomic<TextureTile *>[nBuckets]);
+        for (int j = 0; j < nBuckets; ++j)
+            shards[i].buckets[j] = nullptr;
+    }
+}
+
+TextureTileCache::ReadScope::ReadScope() {
+    epoch = &threadTileReaderSlot.slot->epoch;
+    epoch->store(cache->globalEpoch.load());
+}
+
+TextureTileCache::ReadScope::~ReadScope() {
+    epoch->store(0);
+}
+
+const TextureTile *TextureTileCache::Lookup(const TiledImagePyramid *pyramid, int level,
+                                            Point2i tile) {
+    DCHECK(cache != nullptr);
+    uint64_t key = (uint64_t(pyramid->id) << 40) | (uint64_t(level) << 32) |
+                   (uint64_t(tile.y) << 16) | uint64_t(tile.x);
+    uint64_t hash = MixBits(key);
+    Shard &shard = cache->shards[hash % NShards];
+    std::atomic<TextureTile *> &bucket =
+        shard.buckets[(hash / NShards) & (shard.nBuckets - 1)];
+
+    // Search the bucket without locking; tiles unlinked concurrently remain
+    // valid until this thread leaves its _ReadScope_
+    ++textureTileLookups;
+    for (TextureTile *t = bucket.load(); t; t = t->next.load())
+        if (t->key == key) {
+            ++textureTileHits;
+            if (!t->referenced.load(std::memory_order_relaxed))
+                t->referenced.store(true, std::memory_order_relaxed);
+            return t;
+        }
+
+    return cache->Load(shard, key, pyramid, level, tile);
+}
+
+const TextureTile *TextureTileCache::Load(Shard &shard, uint64_t key,
+                                          const TiledImagePyramid *pyramid, int level,
+                                          Point2i tile) {
+    // Read the tile before taking the shard lock
+    TextureTile *t = new TextureTile;
+    t->key = key;
+    t->bytes = pyramid->TileBytes();
+    t->data.reset(new uint8_t[t->bytes]);
+    pyramid->ReadTile(level, tile, t->data.get());
+
+    uint64_t hash = MixBits(key);
+    std::atomic<TextureTile *> &bucket =
+        shard.buckets[(hash / NShards) & (shard.nBuckets - 1)];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Return the tile if another thread loaded it in the meantime
+        for (TextureTile *other = bucket.load(); other; other = other->next.load())
+            if (other->key == key) {
+                delete t;
+                return other;
+            }
+
+        // Publish the new tile at the head of its bucket
+        t->next.store(bucket.load());
+        bucket.store(t);
+        shard.resident.push_back(t);
+        shard.bytes += t->bytes;
+        ++textureTilesLoaded;
+        textureTileBytes += t->bytes;
+        Evict(shard, t);
+    }
+    return t;
+}
+
+void TextureTileCache::Evict(Shard &shard, const TextureTile *keep) {
+    // Run the clock hand over the shard until it is within its share of the budget
+    size_t shardBudget = maxBytes / NShards;
+    bool evicted = false;
+    while (shard.bytes > shardBudget && shard.resident.size() > 1) {
+        if (shard.clockHand >= shard.resident.size())
+            shard.clockHand = 0;
+        TextureTile *t = shard.resident[shard.clockHand];
+        if (t == keep || t->referenced.exchange(false)) {
+            ++shard.clockHand;
+            continue;
+        }
+        Unlink(shard, t);
+        shard.resident[shard.clockHand] = shard.resident.back();
+        shard.resident.pop_back();
+        shard.bytes -= t->bytes;
+        ++textureTilesEvicted;
+        textureTileBytes -= t->bytes;
+        Retire(t);
+        evicted = true;
+    }
+    if (evicted)
+        Reclaim();
+}
+
+void TextureTileCache::Reclaim() {
+    // Free retired tiles that no active reader can still be accessing
+    uint64_t minEpoch = std::numeric_limits<uint64_t>::max();
+    for (TileReaderSlot *s = tileReaderSlots.load(); s; s = s->next)
+        if (uint64_t e = s->epoch.load(); e != 0)
+            minEpoch = std::min(minEpoch, e);
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    auto iter = std::partition(retired.begin(), retired.end(), [&](TextureTile *t) {
+        return t->retireEpoch >= minEpoch;
+    });
+    for (auto it = iter; it != retired.end(); ++it)
+        delete *it;
+    retired.erase(iter, retired.end());
+}
+
+void TextureTileCache::Unlink(Shard &shard, TextureTile *tile) {
+    uint64_t hash = MixBits(tile->key);
+    std::atomic<TextureTile *> *link =
+        &shard.buckets[(hash / NShards) & (shard.nBuckets - 1)];
+    while (link->load() != tile)
+        link = &link->load()->next;
+    link->store(tile->next.load());
+}
+
+void TextureTileCache::Retire(TextureTile *tile) {
+    tile->retireEpoch = globalEpoch++;
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.push_back(tile);
+}
+
+void TextureTileCache::Purge(const TiledImagePyramid *pyramid) {
+    if (!cache)
+        return;
+    for (int i = 0; i < NShards; ++i) {
+        Shard &shard = cache->shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (size_t j = 0; j < shard.resident.size();) {
+            TextureTile *t = shard.resident[j];
+            if ((t->key >> 40) != pyramid->id) {
+                ++j;
+                continue;
+            }
+            cache->Unlink(shard, t);
+            shard.resident[j] = shard.resident.back();
+            shard.resident.pop_back();
+            shard.bytes -= t->bytes;
+            textureTileBytes -= t->bytes;
+            cache->Retire(t);
+        }
+    }
+    cache->Reclaim();
+}
+
 // MIPMap Method Definitions
 MIPMap::MIPMap(Image image, const RGBColorSpace *colorSpace, WrapMode wrapMode,
                Allocator alloc, const MIPMapFilterOptions &options)
-    : colorSpace(colorSpace), wrapMode(wrapMode), options(options) {
+    : compressedPyramid(alloc),
+      colorSpace(colorSpace),
+      wrapMode(wrapMode),
+      options(options) {
     CHECK(colorSpace != nullptr);
     CHECK(image.NChannels() == 1 || image.NChannels() == 3);
+    if (TextureTileCache::Enabled()) {
+        // Write the levels to the tile file as they are generated
+        tiledPyramid = std::make_unique<TiledImagePyramid>(std::move(image), wrapMode);
+        return;
+    }
     pyramid = Image::GenerateMIPMap(std::move(image), wrapMode, alloc);
+    if (Options->compressTextures) {
+        // Replace the levels with their block-compressed versions
+        compressedPyramid.reserve(pyramid.size());
+        for (const Image &level : pyramid) {
+            compressedPyramid.push_back(BlockCompressedImage(level, alloc));
+            imageMapBytes += compressedPyramid.back().BytesUsed();
+        }
+        pyramid.clear();
+        return;
+    }
     std::for_each(pyramid.begin(), pyramid.end(),
                   [](const Image &im) { imageMapBytes += im.BytesUsed(); });
 }
 
+MIPMap::MIPMap(std::unique_ptr<TiledImagePyramid> tiledPyramid,
+               const RGBColorSpace *colorSpace, WrapMode wrapMode,
+               const MIPMapFilterOptions &options)
+    : tiledPyramid(std::move(tiledPyramid)),
+      colorSpace(colorSpace),
+      wrapMode(wrapMode),
+      options(options) {
+    CHECK(colorSpace != nullptr);
+}
+
 template <>
 Float MIPMap::Texel(int level, Point2i st) const {
+    if (tiledPyramid) {
+        Float v[3];
+        tiledPyramid->GetTexel(level, st, wrapMode, v);
+        return v[0];
+    }
+    if (!compressedPyramid.empty()) {
+        CHECK(level >= 0 && level < compressedPyramid.size());
+        return compressedPyramid[level].GetChannel(st, 0, wrapMode);
+    }
     CHECK(level >= 0 && level < pyramid.size());
     return pyramid[level].GetChannel(st, 0, wrapMode);
 }
 
 template <>
 RGB MIPMap::Texel(int level, Point2i st) const {
+    if (tiledPyramid) {
+        Float v[3];
+        tiledPyramid->GetTexel(level, st, wrapMode, v);
+        if (tiledPyramid->NChannels() == 1)
+            return RGB(v[0], v[0], v[0]);
+        return RGB(v[0], v[1], v[2]);
+    }
+    if (!compressedPyramid.empty()) {
+        CHECK(level >= 0 && level < compressedPyramid.size());
+        Float v[3];
+        compressedPyramid[level].GetChannels(st, wrapMode, v);
+        if (compressedPyramid[level].NChannels() == 1)
+            return RGB(v[0], v[0], v[0]);
+        return RGB(v[0], v[1], v[2]);
+    }
     CHECK(level >= 0 && level < pyramid.size());
     if (pyramid[level].NChannels() == 3) {
         RGB rgb;
@@ -239,6 +898,17 @@ T MIPMap::Lookup(const Point2f &st, Float width) const {
         return Texel<T>(iLevel, sti);
     } else if (options.filter == FilterFunction::Bilinear) {
         return Bilerp<T>(iLevel, st);
+    } else if (options.filter == FilterFunction::Stochastic) {
+        // Return a single texel chosen with probability equal to its
+        // trilinear filter weight, using a hash of the lookup as the sample
+        uint64_t hash = Hash(st, width);
+        auto u = [hash](int i) { return ((hash >> (21 * i)) & 0x1fffff) * 0x1p-21f; };
+        if (iLevel > 0 && u(2) < level - iLevel)
+            ++iLevel;
+        Point2i resolution = LevelResolution(iLevel);
+        Float x = st[0] * resolution[0] - 0.5f, y = st[1] * resolution[1] - 0.5f;
+        int xi = std::floor(x), yi = std::floor(y);
+        return Texel<T>(iLevel, {xi + (u(0) < x - xi), yi + (u(1) < y - yi)});
     } else {
         CHECK(options.filter == FilterFunction::Trilinear);
 
@@ -317,23 +987,89 @@ T MIPMap::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
     int t1 = std::floor(st[1] + 2 * invDet * vSqrt);
 
     // Scan over ellipse bound and compute quadratic equation
-    T sum{};
-    Float sumWts = 0;
+    // Scan over ellipse bound one row at a time
+    int ns = std::max(0, s1 - s0 + 1);
+    thread_local std::vector<Float> rowWeights;
+    thread_local std::vector<float> rowTexels;
+    if (rowWeights.size() < ns) {
+        rowWeights.resize(ns);
+        rowTexels.resize(3 * ns);
+    }
+    Float sum[3] = {0, 0, 0}, sumWts = 0;
+    int nChannels = 1;
     for (int it = t0; it <= t1; ++it) {
         Float tt = it - st[1];
-        for (int is = s0; is <= s1; ++is) {
-            Float ss = is - st[0];
-            // Compute squared radius and filter texel if inside ellipse
+        // Compute filter weights for all texels in the row; they are zero
+        // outside the ellipse
+        for (int i = 0; i < ns; ++i) {
+            Float ss = s0 + i - st[0];
             Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
-            if (r2 < 1) {
-                int index = std::min<int>(r2 * WeightLUTSize, WeightLUTSize - 1);
-                Float weight = weightLut[index];
-                sum += weight * Texel<T>(level, {is, it});
-                sumWts += weight;
+            int index = std::min<int>(std::min<Float>(r2, 1) * WeightLUTSize,
+                                      WeightLUTSize - 1);
+            rowWeights[i] = r2 < 1 ? weightLut[index] : 0;
+        }
+
+        // Gather the texels with nonzero weights and accumulate them
+        int first = 0, last = ns - 1;
+        while (first <= last && rowWeights[first] == 0)
+            ++first;
+        while (last >= first && rowWeights[last] == 0)
+            --last;
+        if (first > last)
+            continue;
+        nChannels = TexelRow(level, it, s0 + first, s0 + last, rowTexels.data());
+        for (int i = first; i <= last; ++i) {
+            const float *texel = &rowTexels[nChannels * (i - first)];
+            for (int c = 0; c < nChannels; ++c)
+                sum[c] += rowWeights[i] * texel[c];
+            sumWts += rowWeights[i];
+        }
+    }
+    return TexelSum<T>(sum, nChannels) / sumWts;
+}
+
+int MIPMap::TexelRow(int level, int t, int s0, int s1, float *values) const {
+    if (tiledPyramid || !compressedPyramid.empty() || wrapMode == WrapMode::Black) {
+        // Fetch the texels one at a time
+        int nChannels = 0;
+        for (int s = s0; s <= s1; ++s) {
+            Float v[3];
+            if (tiledPyramid) {
+                tiledPyramid->GetTexel(level, {s, t}, wrapMode, v);
+                nChannels = tiledPyramid->NChannels();
+            } else if (!compressedPyramid.empty()) {
+                compressedPyramid[level].GetChannels({s, t}, wrapMode, v);
+                nChannels = compressedPyramid[level].NChannels();
+            } else {
+                nChannels = pyramid[level].NChannels();
+                for (int c = 0; c < nChannels; ++c)
+                    v[c] = pyramid[level].GetChannel({s, t}, c, wrapMode);
             }
+            for (int c = 0; c < nChannels; ++c)
+                *values++ = v[c];
         }
+        return nChannels;
     }
-    return sum / sumWts;
+
+    // Convert the whole row of texels at once
+    CHECK(level >= 0 && level < pyramid.size());
+    const Image &image = pyramid[level];
+    int nChannels = image.NChannels();
+    image.CopyRectOut(Bounds2i({s0, t}, {s1 + 1, t + 1}),
+                      pstd::span<float>(values, nChannels * (s1 - s0 + 1)), wrapMode);
+    return nChannels;
+}
+
+template <>
+Float MIPMap::TexelSum(const Float sum[3], int nChannels) {
+    return sum[0];
+}
+
+template <>
+RGB MIPMap::TexelSum(const Float sum[3], int nChannels) {
+    if (nChannels == 1)
+        return RGB(sum[0], sum[0], sum[0]);
+    return RGB(sum[0], sum[1], sum[2]);
 }
 
 std::unique_ptr<MIPMap> MIPMap::CreateFromFile(const std::string &filename,
@@ -341,6 +1077,22 @@ std::unique_ptr<MIPMap> MIPMap::CreateFromFile(const std::string &filename,
                                                WrapMode wrapMode,
                                                ColorEncodingHandle encoding,
                                                Allocator alloc) {
+    if (HasExtension(filename, "txp")) {
+        // Use the pre-filtered levels stored in the file
+        const RGBColorSpace *colorSpace = nullptr;
+        WrapMode fileWrapMode;
+        std::unique_ptr<TiledImagePyramid> tiled =
+            TiledImagePyramid::Read(filename, &colorSpace, &fileWrapMode);
+        if (!tiled)
+            ErrorExit("%s: unable to read tiled image", filename);
+        if (fileWrapMode != wrapMode)
+            Warning("%s: image was pre-filtered with \"%s\" wrap mode, not \"%s\"",
+                    filename, pbrt::ToString(fileWrapMode), pbrt::ToString(wrapMode));
+        if (!colorSpace)
+            colorSpace = RGBColorSpace::sRGB;
+        return std::make_unique<MIPMap>(std::move(tiled), colorSpace, wrapMode, options);
+    }
+
     ImageAndMetadata imageAndMetadata = Image::Read(filename, alloc, encoding);
 
     Image &image = imageAndMetadata.image;
@@ -367,31 +1119,61 @@ T MIPMap::Bilerp(int level, Point2f st) const {
     T::unimplemented_function;
 }
 
+template <typename T>
+T MIPMap::TexelBilerp(int level, Point2f st) const {
+    // Follow _Image::BilerpChannel()_ using tiled or compressed texels
+    Point2i res = LevelResolution(level);
+    Float x = st[0] * res.x - 0.5f, y = st[1] * res.y - 0.5f;
+    int xi = std::floor(x), yi = std::floor(y);
+    Float dx = x - xi, dy = y - yi;
+    return ((1 - dx) * (1 - dy)) * Texel<T>(level, {xi, yi}) +
+           (dx * (1 - dy)) * Texel<T>(level, {xi + 1, yi}) +
+           ((1 - dx) * dy) * Texel<T>(level, {xi, yi + 1}) +
+           (dx * dy) * Texel<T>(level, {xi + 1, yi + 1});
+}
+
 template <>
 Float MIPMap::Bilerp(int level, Point2f st) const {
+    if (tiledPyramid || !compressedPyramid.empty())
+        return TexelBilerp<Float>(level, st);
     CHECK(level >= 0 && level < pyramid.size());
     return pyramid[level].BilerpChannel(st, 0, wrapMode);
 }
 
 template <>
 RGB MIPMap::Bilerp(int level, Point2f st) const {
+    if (tiledPyramid || !compressedPyramid.empty())
+        return TexelBilerp<RGB>(level, st);
     CHECK(level >= 0 && level < pyramid.size());
-    if (pyramid[level].NChannels() == 3) {
+    const Image &image = pyramid[level];
+    if (image.NChannels() == 3) {
+        // Follow _Image::BilerpChannel()_, but remap each of the four texels'
+        // coordinates once and fetch all of their channels together
+        Float x = st[0] * image.Resolution().x - 0.5f;
+        Float y = st[1] * image.Resolution().y - 0.5f;
+        int xi = std::floor(x), yi = std::floor(y);
+        Float dx = x - xi, dy = y - yi;
+        ImageChannelValues v[4] = {image.GetChannels({xi, yi}, wrapMode),
+                                   image.GetChannels({xi + 1, yi}, wrapMode),
+                                   image.GetChannels({xi, yi + 1}, wrapMode),
+                                   image.GetChannels({xi + 1, yi + 1}, wrapMode)};
         RGB rgb;
         for (int c = 0; c < 3; ++c)
-            rgb[c] = pyramid[level].BilerpChannel(st, c, wrapMode);
+            rgb[c] = pbrt::Bilerp({dx, dy}, {v[0][c], v[1][c], v[2][c], v[3][c]});
         return rgb;
     } else {
-        CHECK_EQ(1, pyramid[level].NChannels());
-        Float v = pyramid[level].BilerpChannel(st, 0, wrapMode);
+        CHECK_EQ(1, image.NChannels());
+        Float v = image.BilerpChannel(st, 0, wrapMode);
         return RGB(v, v, v);
     }
 }
 
 std::string MIPMap::ToString() const {
-    return StringPrintf("[ MIPMap pyramid: %s colorSpace: %s wrapMode: %s "
-                        "options: %s ]",
-                        pyramid, colorSpace->ToString(), wrapMode, options);
+    std::string tiled = tiledPyramid ? tiledPyramid->ToString() : "(nullptr)";
+    return StringPrintf("[ MIPMap pyramid: %s tiledPyramid: %s compressedPyramid: %s "
+                        "colorSpace: %s wrapMode: %s options: %s ]",
+                        pyramid, tiled, compressedPyramid, colorSpace->ToString(),
+                        wrapMode, options);
 }
 
 // Explicit template instantiation..
@@ -11,13 +11,16 @@
 #include <pbrt/util/pstd.h>
 #include <pbrt/util/vecmath.h>
 
+#include <atomic>
+#include <cstdio>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace pbrt {
 
-enum class FilterFunction { Point, Bilinear, Trilinear, EWA };
+enum class FilterFunction { Point, Bilinear, Trilinear, EWA, Stochastic };
 
 inline pstd::optional<FilterFunction> ParseFilter(const std::string &f) {
     if (f == "ewa" || f == "EWA")
@@ -28,6 +31,8 @@ inline pstd::optional<FilterFunction> ParseFilter(const std::string &f) {
         return FilterFunction::Bilinear;
     else if (f == "point")
         return FilterFunction::Point;
+    else if (f == "stochastic")
+        return FilterFunction::Stochastic;
     else
         return {};
 }
@@ -41,11 +46,126 @@ struct MIPMapFilterOptions {
     std::string ToString() const;
 };
 
+// TiledImagePyramid Definition
+class TiledImagePyramid {
+  public:
+    // TiledImagePyramid Public Methods
+    // Generates the MIP levels of _image_, storing their tiles in a scratch
+    // file that is shared by all pyramids created this way.
+    TiledImagePyramid(Image image, WrapMode2D wrapMode);
+    ~TiledImagePyramid();
+
+    static std::unique_ptr<TiledImagePyramid> Read(const std::string &filename,
+                                                   const RGBColorSpace **colorSpace,
+                                                   WrapMode *wrapMode);
+    static bool Write(const std::string &filename, pstd::span<const Image> pyramid,
+                      WrapMode wrapMode, const RGBColorSpace *colorSpace);
+
+    TiledImagePyramid(const TiledImagePyramid &) = delete;
+    TiledImagePyramid &operator=(const TiledImagePyramid &) = delete;
+
+    int Levels() const { return int(levels.size()); }
+    Point2i LevelResolution(int level) const {
+        CHECK(level >= 0 && level < levels.size());
+        return levels[level].resolution;
+    }
+    int NChannels() const { return nChannels; }
+    size_t TileBytes() const {
+        return size_t(TileSize) * TileSize * nChannels * TexelBytes(format);
+    }
+
+    void GetTexel(int level, Point2i p, WrapMode2D wrapMode, Float *values) const;
+
+    std::string ToString() const;
+
+    static constexpr int TileSize = 64;
+
+  private:
+    friend class TextureTileCache;
+    // TiledImagePyramid Private Methods
+    TiledImagePyramid(PixelFormat format, ColorEncodingHandle encoding, int nChannels,
+                      pstd::span<const Point2i> resolutions);
+    static bool Write(FILE *f, pstd::span<const Image> pyramid, WrapMode wrapMode,
+                      const RGBColorSpace *colorSpace);
+    void ReadTile(int level, Point2i tile, uint8_t *dst) const;
+    void DecodeTexel(const uint8_t *tile, int offset, Float *values) const;
+
+    // TiledImagePyramid Private Members
+    struct LevelInfo {
+        Point2i resolution, nTiles;
+        int64_t offset;
+    };
+    uint32_t id;
+    PixelFormat format;
+    ColorEncodingHandle encoding;
+    int nChannels;
+    std::vector<LevelInfo> levels;
+    // Tiles are either read from _file_ through the _TextureTileCache_ or
+    // accessed directly at _data_, which points to a mapping of the file or
+    // to _contents_. Level offsets are relative to _fileOffset_ in _file_,
+    // which is only closed with the pyramid if _ownsFile_ is set.
+    FILE *file = nullptr;
+    int64_t fileOffset = 0;
+    bool ownsFile = false;
+    const uint8_t *data = nullptr;
+    void *mapping = nullptr;
+    size_t mappingLength = 0;
+    std::vector<uint8_t> contents;
+};
+
+// TextureTileCache Definition
+struct TextureTile;
+
+class TextureTileCache {
+  public:
+    // TextureTileCache Public Methods
+    static void Init(size_t maxBytes);
+    // Frees all cached tiles and disables the cache. Pyramids that were
+    // created while it was enabled must not be used afterward.
+    static void Shutdown();
+    static bool Enabled() { return cache != nullptr; }
+
+    static const TextureTile *Lookup(const TiledImagePyramid *pyramid, int level,
+                                     Point2i tile);
+    static void Purge(const TiledImagePyramid *pyramid);
+
+    // Reads of tiles returned by Lookup() must happen inside a ReadScope.
+    class ReadScope {
+      public:
+        ReadScope();
+        ~ReadScope();
+
+      private:
+        std::atomic<uint64_t> *epoch;
+    };
+
+  private:
+    struct Shard;
+    TextureTileCache(size_t maxBytes);
+    const TextureTile *Load(Shard &shard, uint64_t key, const TiledImagePyramid *pyramid,
+                            int level, Point2i tile);
+    void Evict(Shard &shard, const TextureTile *keep);
+    void Unlink(Shard &shard, TextureTile *tile);
+    void Retire(TextureTile *tile);
+    void Reclaim();
+
+    static TextureTileCache *cache;
+    static constexpr int NShards = 64;
+    std::atomic<size_t> maxBytes;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint64_t> globalEpoch{1};
+    std::mutex retiredMutex;
+    std::vector<TextureTile *> retired;
+};
+
 // MIPMap Definition
 class MIPMap {
   public:
     MIPMap(Image image, const RGBColorSpace *colorSpace, WrapMode wrapMode,
            Allocator alloc, const MIPMapFilterOptions &options);
+    MIPMap(std::unique_ptr<TiledImagePyramid> tiledPyramid,
+           const RGBColorSpace *colorSpace, WrapMode wrapMode,
+           const MIPMapFilterOptions &options);
     static std::unique_ptr<MIPMap> CreateFromFile(const std::string &filename,
                                                   const MIPMapFilterOptions &options,
                                                   WrapMode wrapMode,
@@ -58,24 +178,45 @@ class MIPMap {
     T Lookup(const Point2f &st, Vector2f dstdx, Vector2f dstdy) const;
 
     Point2i LevelResolution(int level) const {
+        if (tiledPyramid)
+            return tiledPyramid->LevelResolution(level);
+        if (!compressedPyramid.empty())
+            return compressedPyramid[level].Resolution();
         CHECK(level >= 0 && level < pyramid.size());
         return pyramid[level].Resolution();
     }
-    int Levels() const { return int(pyramid.size()); }
+    int Levels() const {
+        if (tiledPyramid)
+            return tiledPyramid->Levels();
+        return compressedPyramid.empty() ? int(pyramid.size())
+                                         : int(compressedPyramid.size());
+    }
 
     const RGBColorSpace *GetRGBColorSpace() const { return colorSpace; }
 
+    template <typename T>
+    T Texel(int level, Point2i st) const;
+
     std::string ToString() const;
 
   private:
-    template <typename T>
-    T Texel(int level, Point2i st) const;
     template <typename T>
     T Bilerp(int level, Point2f st) const;
     template <typename T>
+    T TexelBilerp(int level, Point2f st) const;
+    template <typename T>
     T EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const;
+    int TexelRow(int level, int t, int s0, int s1, float *values) const;
+    template <typename T>
+    static T TexelSum(const Float sum[3], int nChannels);
 
     pstd::vector<Image> pyramid;
+    // When the texture tile cache is enabled, _pyramid_ is empty and the
+    // levels are paged in on demand from _tiledPyramid_.
+    std::unique_ptr<TiledImagePyramid> tiledPyramid;
+    // Otherwise, when texture compression is enabled the levels are stored
+    // in _compressedPyramid_ and decoded on lookup.
+    pstd::vector<BlockCompressedImage> compressedPyramid;
     const RGBColorSpace *colorSpace;
     WrapMode wrapMode;
     MIPMapFilterOptions options;
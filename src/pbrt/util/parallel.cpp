@@ -37,32 +37,6 @@ bool Barrier::Block() {
     return --numToExit == 0;
 }
 
-// ParallelJob Definition
-class ParallelJob {
-  public:
-    virtual ~ParallelJob() { DCHECK(removed); }
-
-    // *lock should be locked going in and and unlocked coming out.
-    virtual void RunStep(std::unique_lock<std::mutex> *lock) = 0;
-    virtual bool HaveWork() const = 0;
-
-    bool Finished() const { return !HaveWork() && activeWorkers == 0; }
-
-    virtual std::string ToString() const = 0;
-
-  protected:
-    std::string BaseToString() const {
-        return StringPrintf("activeWorkers: %d removed: %s", activeWorkers, removed);
-    }
-
-  private:
-    friend class ThreadPool;
-
-    ParallelJob *prev = nullptr, *next = nullptr;
-    int activeWorkers = 0;
-    bool removed = false;
-};
-
 // ThreadPool Definition
 class ThreadPool {
   public:
@@ -75,6 +49,7 @@ class ThreadPool {
     void RemoveFromJobList(ParallelJob *job);
 
     void WorkOrWait(std::unique_lock<std::mutex> *lock);
+    void WaitUntilFinished(ParallelJob *job);
 
     void ForEachThread(std::function<void(void)> func);
 
@@ -171,6 +146,12 @@ void ThreadPool::WorkOrWait(std::unique_lock<std::mutex> *lock) {
         jobListCondition.wait(*lock);
 }
 
+void ThreadPool::WaitUntilFinished(ParallelJob *job) {
+    std::unique_lock<std::mutex> lock(jobListMutex);
+    while (!job->Finished())
+        WorkOrWait(&lock);
+}
+
 void ThreadPool::ForEachThread(std::function<void(void)> func) {
     Barrier *barrier = new Barrier(threads.size() + 1);
 
@@ -212,6 +193,24 @@ std::string ThreadPool::ToString() const {
     return s + "]";
 }
 
+// ParallelJob Method Definitions
+std::string ParallelJob::BaseToString() const {
+    return StringPrintf("activeWorkers: %d removed: %s", activeWorkers, removed);
+}
+
+void ParallelJob::Enqueue() {
+    CHECK(threadPool);
+    threadPool->AddToJobList(this);
+}
+
+void ParallelJob::RemoveFromJobList() {
+    threadPool->RemoveFromJobList(this);
+}
+
+void ParallelJob::WaitUntilFinished() {
+    threadPool->WaitUntilFinished(this);
+}
+
 // ParallelForLoop1D Definition
 class ParallelForLoop1D : public ParallelJob {
   public:
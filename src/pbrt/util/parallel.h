@@ -7,7 +7,9 @@
 
 #include <pbrt/pbrt.h>
 
+#include <pbrt/util/check.h>
 #include <pbrt/util/float.h>
+#include <pbrt/util/pstd.h>
 #include <pbrt/util/vecmath.h>
 
 #include <atomic>
@@ -17,6 +19,7 @@
 #include <initializer_list>
 #include <mutex>
 #include <string>
+#include <type_traits>
 
 namespace pbrt {
 
@@ -158,6 +161,72 @@ class Barrier {
     int numToBlock, numToExit;
 };
 
+// ParallelJob Definition
+class ParallelJob {
+  public:
+    virtual ~ParallelJob() { DCHECK(removed); }
+
+    // *lock should be locked going in and and unlocked coming out.
+    virtual void RunStep(std::unique_lock<std::mutex> *lock) = 0;
+    virtual bool HaveWork() const = 0;
+
+    bool Finished() const { return !HaveWork() && activeWorkers == 0; }
+
+    virtual std::string ToString() const = 0;
+
+  protected:
+    std::string BaseToString() const;
+
+    // Add the job to the thread pool's job list.
+    void Enqueue();
+    // Must be called with the job list lock held.
+    void RemoveFromJobList();
+    // Help with parallel work until the job has finished.
+    void WaitUntilFinished();
+
+  private:
+    friend class ThreadPool;
+
+    ParallelJob *prev = nullptr, *next = nullptr;
+    int activeWorkers = 0;
+    bool removed = false;
+};
+
+// AsyncJob Definition
+template <typename T>
+class AsyncJob : public ParallelJob {
+  public:
+    AsyncJob(std::function<T(void)> func) : func(std::move(func)) {}
+
+    void Start() { Enqueue(); }
+
+    bool HaveWork() const { return !started; }
+    void RunStep(std::unique_lock<std::mutex> *lock) {
+        RemoveFromJobList();
+        started = true;
+        lock->unlock();
+        result = func();
+    }
+
+    // Returns the job's result, first running the job or other pending
+    // parallel work in the calling thread until it is available. May only be
+    // called once.
+    T GetResult() {
+        WaitUntilFinished();
+        return std::move(*result);
+    }
+
+    std::string ToString() const {
+        return std::string("[ AsyncJob started: ") + (started ? "true " : "false ") +
+               BaseToString() + " ]";
+    }
+
+  private:
+    std::function<T(void)> func;
+    bool started = false;
+    pstd::optional<T> result;
+};
+
 void ParallelFor(int64_t start, int64_t end, std::function<void(int64_t, int64_t)> func);
 void ParallelFor2D(const Bounds2i &extent, std::function<void(Bounds2i)> func);
 
@@ -178,6 +247,15 @@ inline void ParallelFor2D(const Bounds2i &extent, std::function<void(Point2i)> f
 
 void ForEachThread(std::function<void(void)> func);
 
+// Runs _func_ on the thread pool; the caller owns the returned job and should
+// delete it after calling GetResult().
+template <typename F>
+AsyncJob<std::invoke_result_t<F>> *RunAsync(F func) {
+    auto job = new AsyncJob<std::invoke_result_t<F>>(std::move(func));
+    job->Start();
+    return job;
+}
+
 // ThreadIndex Declaration
 extern thread_local int ThreadIndex;
 
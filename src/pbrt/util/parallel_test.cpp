@@ -44,3 +44,19 @@ TEST(Parallel, ForEachThread) {
     ForEachThread([&count] { --count; });
     EXPECT_EQ(0, count);
 }
+
+TEST(Parallel, RunAsync) {
+    std::atomic<int> counter{0};
+    AsyncJob<int> *outer = RunAsync([&]() {
+        // Nested parallel work must be able to run while the outer job is in flight.
+        ParallelFor(0, 100, [&](int64_t) { ++counter; });
+        return 42;
+    });
+    AsyncJob<int> *other = RunAsync([]() { return 7; });
+
+    EXPECT_EQ(7, other->GetResult());
+    EXPECT_EQ(42, outer->GetResult());
+    EXPECT_EQ(100, counter);
+    delete other;
+    delete outer;
+}
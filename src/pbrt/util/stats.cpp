@@ -345,6 +345,130 @@ static void getCategoryAndTitle(const std::string &str, std::string *category,
     }
 }
 
+static std::string printBytes(size_t bytes) {
+    float kb = (double)bytes / 1024.;
+    if (std::abs(kb) < 1024.)
+        return StringPrintf("%9.2f kB", kb);
+
+    float mib = kb / 1024.;
+    if (std::abs(mib) < 1024.)
+        return StringPrintf("%9.2f MiB", mib);
+
+    float gib = mib / 1024.;
+    return StringPrintf("%9.2f GiB", gib);
+}
+
+// Subsystems that memory counters are attributed to in MemoryReports; counters
+// not listed here are reported under "other".
+static const std::map<std::string, std::string> memorySubsystems = {
+    {"Mesh indices", "meshes"},
+    {"Mesh vertex positions", "meshes"},
+    {"Mesh normals", "meshes"},
+    {"Mesh uvs", "meshes"},
+    {"Mesh tangents", "meshes"},
+    {"Mesh face indices", "meshes"},
+    {"Triangles", "meshes"},
+    {"Bilinear patches", "meshes"},
+    {"Curves", "meshes"},
+    {"Geometry store resident pages", "meshes"},
+    {"BVH tree", "bvh"},
+    {"Primitives", "bvh"},
+    {"Acceleration structures", "bvh"},
+    {"Image maps", "textures"},
+    {"Texture tile cache", "textures"},
+    {"Ptex peak memory used", "textures"},
+    {"ImageTextures", "textures"},
+    {"Measured BRDF data", "textures"},
+    {"Film pixels", "film"},
+    {"Light image and distributions", "lights"},
+    {"Light BVH", "lights"},
+    {"Volume grids", "media"},
+    {"Tokenizer buffers", "parser"},
+    {"TransformCache", "parser"},
+    {"Radiance cache", "integrator"},
+    {"SPPM Pixels", "integrator"},
+    {"SPPM BSDF Memory", "integrator"},
+    {"SPPM Visible Point Grid", "integrator"},
+    {"VCM light vertex cache", "integrator"},
+    {"GPU path integrator pixel state", "integrator"},
+    // The geometry store's backing file is on disk and the redundant buffer
+    // counter records memory that deduplication saved.
+    {"Geometry store file", "nonresident"},
+    {"Redundant vertex and index buffers", "nonresident"}};
+
+static int64_t subsystemBytes(const std::map<std::string, int64_t> &counters) {
+    int64_t total = 0;
+    for (const auto &counter : counters)
+        total += counter.second;
+    return total;
+}
+
+// MemoryReport Method Definitions
+int64_t MemoryReport::TotalBytes() const {
+    int64_t total = 0;
+    for (const auto &subsystem : subsystems)
+        if (subsystem.first != "nonresident")
+            total += subsystemBytes(subsystem.second);
+    return total;
+}
+
+std::string MemoryReport::ToJSON() const {
+    std::string s = StringPrintf("{\n  \"totalBytes\": %d,\n  \"rssBytes\": %d,\n"
+                                 "  \"subsystems\": {",
+                                 TotalBytes(), rssBytes);
+    bool firstSubsystem = true;
+    for (const auto &subsystem : subsystems) {
+        s += StringPrintf("%s\n    \"%s\": {\n      \"totalBytes\": %d,\n"
+                          "      \"counters\": {",
+                          firstSubsystem ? "" : ",", subsystem.first,
+                          subsystemBytes(subsystem.second));
+        bool firstCounter = true;
+        for (const auto &counter : subsystem.second) {
+            s += StringPrintf("%s\n        \"%s\": %d", firstCounter ? "" : ",",
+                              counter.first, counter.second);
+            firstCounter = false;
+        }
+        s += "\n      }\n    }";
+        firstSubsystem = false;
+    }
+    s += "\n  }\n}\n";
+    return s;
+}
+
+std::string MemoryReport::ToString() const {
+    std::string s;
+    for (const auto &subsystem : subsystems) {
+        s += StringPrintf("  %-44s %s\n", subsystem.first,
+                          printBytes(subsystemBytes(subsystem.second)));
+        for (const auto &counter : subsystem.second)
+            s += StringPrintf("    %-42s %s\n", counter.first,
+                              printBytes(counter.second));
+    }
+    s += StringPrintf("  %-44s %s\n", "total (excluding nonresident)",
+                      printBytes(TotalBytes()));
+    s += StringPrintf("  %-44s %s", "resident set size", printBytes(rssBytes));
+    return s;
+}
+
+MemoryReport GetMemoryReport() {
+    // Gather the memory counters from all threads; doing so resets the
+    // per-thread values after adding them to _statsAccumulator_.
+    ForEachThread(ReportThreadStats);
+
+    MemoryReport report;
+    for (const auto &counter : statsAccumulator.MemoryCounters()) {
+        if (counter.second == 0)
+            continue;
+        std::string category, title;
+        getCategoryAndTitle(counter.first, &category, &title);
+        auto iter = memorySubsystems.find(title);
+        std::string subsystem = iter != memorySubsystems.end() ? iter->second : "other";
+        report.subsystems[subsystem][title] = counter.second;
+    }
+    report.rssBytes = GetCurrentRSS();
+    return report;
+}
+
 void StatsAccumulator::Print(FILE *dest) {
     fprintf(dest, "Statistics:\n");
     std::map<std::string, std::vector<std::string>> toPrint;
@@ -359,19 +483,6 @@ void StatsAccumulator::Print(FILE *dest) {
     }
 
     size_t totalMemoryReported = 0;
-    auto printBytes = [](size_t bytes) -> std::string {
-        float kb = (double)bytes / 1024.;
-        if (std::abs(kb) < 1024.)
-            return StringPrintf("%9.2f kB", kb);
-
-        float mib = kb / 1024.;
-        if (std::abs(mib) < 1024.)
-            return StringPrintf("%9.2f MiB", mib);
-
-        float gib = mib / 1024.;
-        return StringPrintf("%9.2f GiB", gib);
-    };
-
     for (auto &counter : stats->memoryCounters) {
         if (counter.second == 0)
             continue;
@@ -501,6 +612,10 @@ bool StatsAccumulator::PrintCheckRare(FILE *dest) {
     return anyFailed;
 }
 
+const std::map<std::string, int64_t> &StatsAccumulator::MemoryCounters() const {
+    return stats->memoryCounters;
+}
+
 void StatsAccumulator::Clear() {
     stats->counters.clear();
     stats->memoryCounters.clear();
@@ -9,6 +9,7 @@
 
 #include <cstdio>
 #include <limits>
+#include <map>
 #include <string>
 
 namespace pbrt {
@@ -38,6 +39,23 @@ bool PrintCheckRare(FILE *dest);
 void ClearStats();
 void ReportThreadStats();
 
+// MemoryReport Definition
+struct MemoryReport {
+    // MemoryReport Public Methods
+    int64_t TotalBytes() const;
+    std::string ToJSON() const;
+    std::string ToString() const;
+
+    // MemoryReport Public Members
+    // Bytes reported by each memory counter, grouped by subsystem ("meshes",
+    // "bvh", "textures", ...). Counters that don't describe resident memory
+    // are in the "nonresident" subsystem and aren't included in the total.
+    std::map<std::string, std::map<std::string, int64_t>> subsystems;
+    int64_t rssBytes = 0;
+};
+
+MemoryReport GetMemoryReport();
+
 // StatsAccumulator Definition
 class StatsAccumulator {
   public:
@@ -61,6 +79,7 @@ class StatsAccumulator {
 
     void Print(FILE *file);
     bool PrintCheckRare(FILE *dest);
+    const std::map<std::string, int64_t> &MemoryCounters() const;
     void Clear();
 
   private:
@@ -4,8 +4,12 @@
 
 #include <pbrt/util/string.h>
 
+#include <pbrt/util/hash.h>
+
 #include <ctype.h>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace pbrt {
 
@@ -111,4 +115,29 @@ pstd::optional<std::vector<double>> SplitStringToDoubles(std::string_view str, c
     return doubles;
 }
 
+// InternedString Method Definitions
+const InternedString::Entry InternedString::emptyEntry{"", HashString("")};
+
+uint64_t InternedString::HashString(std::string_view str) {
+    return HashBuffer(str.data(), str.size());
+}
+
+InternedString::InternedString(std::string_view str) {
+    if (str.empty())
+        return;
+
+    static std::mutex mutex;
+    // The keys refer to the strings in the (never freed) entries.
+    static std::unordered_map<std::string_view, const Entry *> *table =
+        new std::unordered_map<std::string_view, const Entry *>;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto iter = table->find(str); iter != table->end())
+        entry = iter->second;
+    else {
+        Entry *newEntry = new Entry{std::string(str), HashString(str)};
+        table->insert({std::string_view(newEntry->str), newEntry});
+        entry = newEntry;
+    }
+}
+
 }  // namespace pbrt
@@ -26,6 +26,48 @@ pstd::optional<std::vector<int>> SplitStringToInts(std::string_view str, char ch
 pstd::optional<std::vector<Float>> SplitStringToFloats(std::string_view str, char ch);
 pstd::optional<std::vector<double>> SplitStringToDoubles(std::string_view str, char ch);
 
+// InternedString Definition
+class InternedString {
+  public:
+    // InternedString Public Methods
+    InternedString() = default;
+    // All InternedStrings with the same contents share a single copy of the
+    // string, which is never freed.
+    InternedString(std::string_view str);
+    InternedString(const char *str) : InternedString(std::string_view(str)) {}
+    InternedString(const std::string &str) : InternedString(std::string_view(str)) {}
+
+    const std::string &str() const { return entry->str; }
+    operator const std::string &() const { return entry->str; }
+    size_t size() const { return entry->str.size(); }
+    bool empty() const { return entry->str.empty(); }
+
+    // Returns HashString() of the string's contents.
+    uint64_t Hash() const { return entry->hash; }
+    static uint64_t HashString(std::string_view str);
+
+    bool operator==(InternedString s) const { return entry == s.entry; }
+    bool operator!=(InternedString s) const { return entry != s.entry; }
+    bool operator==(const char *s) const { return entry->str == s; }
+    bool operator!=(const char *s) const { return entry->str != s; }
+    bool operator==(const std::string &s) const { return entry->str == s; }
+    bool operator!=(const std::string &s) const { return entry->str != s; }
+    bool operator==(std::string_view s) const { return entry->str == s; }
+    bool operator!=(std::string_view s) const { return entry->str != s; }
+
+    std::string ToString() const { return entry->str; }
+
+  private:
+    struct Entry {
+        std::string str;
+        uint64_t hash;
+    };
+    static const Entry emptyEntry;
+
+    // InternedString Private Members
+    const Entry *entry = &emptyEntry;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_UTIL_STRING_H
@@ -241,6 +241,7 @@ SurfaceInteraction Transform::operator()(const SurfaceInteraction &si) const {
     ret.wo = Normalize(t(si.wo));
     ret.time = si.time;
     ret.mediumInterface = si.mediumInterface;
+    ret.lodTag = si.lodTag;
     ret.uv = si.uv;
     ret.dpdu = t(si.dpdu);
     ret.dpdv = t(si.dpdv);
@@ -320,6 +321,7 @@ Interaction Transform::operator()(const Interaction &in) const {
         ret.wo = Normalize(ret.wo);
     ret.time = in.time;
     ret.mediumInterface = in.mediumInterface;
+    ret.lodTag = in.lodTag;
     return ret;
 }
 
@@ -336,6 +338,7 @@ Interaction Transform::ApplyInverse(const Interaction &in) const {
         ret.wo = Normalize(ret.wo);
     ret.time = in.time;
     ret.mediumInterface = in.mediumInterface;
+    ret.lodTag = in.lodTag;
     return ret;
 }
 
@@ -349,6 +352,7 @@ SurfaceInteraction Transform::ApplyInverse(const SurfaceInteraction &si) const {
     ret.wo = Normalize(t(si.wo));
     ret.time = si.time;
     ret.mediumInterface = si.mediumInterface;
+    ret.lodTag = si.lodTag;
     ret.uv = si.uv;
     ret.dpdu = t(si.dpdu);
     ret.dpdv = t(si.dpdv);
@@ -377,6 +381,69 @@ std::string Transform::ToString() const {
     return StringPrintf("[ m: %s mInv: %s ]", m, mInv);
 }
 
+// AffineTransform Method Definitions
+AffineTransform::AffineTransform(const Transform &t) {
+    CHECK(IsAffine(t));
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 4; ++j) {
+            m[i][j] = t.GetMatrix()[i][j];
+            mInv[i][j] = t.GetInverseMatrix()[i][j];
+        }
+}
+
+bool AffineTransform::operator==(const AffineTransform &t) const {
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 4; ++j)
+            if (m[i][j] != t.m[i][j])
+                return false;
+    return true;
+}
+
+Bounds3f AffineTransform::operator()(const Bounds3f &b) const {
+    Bounds3f bt;
+    for (int i = 0; i < 8; ++i)
+        bt = Union(bt, (*this)(b.Corner(i)));
+    return bt;
+}
+
+SurfaceInteraction AffineTransform::operator()(const SurfaceInteraction &si) const {
+    SurfaceInteraction ret;
+    const AffineTransform &t = *this;
+    ret.pi = t(si.pi);
+    // Transform remaining members of _SurfaceInteraction_
+    ret.n = Normalize(t(si.n));
+    ret.wo = Normalize(t(si.wo));
+    ret.time = si.time;
+    ret.mediumInterface = si.mediumInterface;
+    ret.lodTag = si.lodTag;
+    ret.uv = si.uv;
+    ret.dpdu = t(si.dpdu);
+    ret.dpdv = t(si.dpdv);
+    ret.dndu = t(si.dndu);
+    ret.dndv = t(si.dndv);
+    ret.shading.n = Normalize(t(si.shading.n));
+    ret.shading.dpdu = t(si.shading.dpdu);
+    ret.shading.dpdv = t(si.shading.dpdv);
+    ret.shading.dndu = t(si.shading.dndu);
+    ret.shading.dndv = t(si.shading.dndv);
+    ret.dudx = si.dudx;
+    ret.dvdx = si.dvdx;
+    ret.dudy = si.dudy;
+    ret.dvdy = si.dvdy;
+    ret.dpdx = t(si.dpdx);
+    ret.dpdy = t(si.dpdy);
+    ret.material = si.material;
+    ret.areaLight = si.areaLight;
+    ret.shading.n = FaceForward(ret.shading.n, ret.n);
+    ret.faceIndex = si.faceIndex;
+    return ret;
+}
+
+std::string AffineTransform::ToString() const {
+    return StringPrintf("[ AffineTransform m: %s mInv: %s ]", GetMatrix(),
+                        GetInverseMatrix());
+}
+
 // DirectionCone Function Definitions
 DirectionCone Union(const DirectionCone &a, const DirectionCone &b) {
     Float theta_d = AngleBetween(a.w, b.w);
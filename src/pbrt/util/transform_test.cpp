@@ -70,3 +70,39 @@ TEST(AnimatedTransform, Randoms) {
         }
     }
 }
+
+TEST(AffineTransform, Randoms) {
+    RNG rng;
+    auto r = [&rng]() { return -10. + 20. * rng.Uniform<Float>(); };
+
+    for (int i = 0; i < 200; ++i) {
+        Transform t = RandomTransform(rng);
+        AffineTransform at(t);
+        EXPECT_EQ(t, Transform(at));
+
+        // Rays transformed with the affine fast path should match the
+        // general transformation, including the origin's error offset.
+        Ray ray(Point3f(r(), r(), r()), Vector3f(r(), r(), r()));
+        Float tMax = 100, atMax = 100;
+        Ray tr = t.ApplyInverse(ray, &tMax);
+        Ray atr = at.ApplyInverse(ray, &atMax);
+        for (int c = 0; c < 3; ++c) {
+            EXPECT_FLOAT_EQ(tr.o[c], atr.o[c]);
+            EXPECT_FLOAT_EQ(tr.d[c], atr.d[c]);
+        }
+        EXPECT_FLOAT_EQ(tMax, atMax);
+
+        // So should the point, vector, and normal transformations used for
+        // intersections with instances.
+        Point3fi p(Point3f(r(), r(), r()), Vector3f(0.01f, 0.02f, 0.03f));
+        Point3fi tp = t(p), atp = at(p);
+        Vector3f v(r(), r(), r());
+        Normal3f n(r(), r(), r());
+        for (int c = 0; c < 3; ++c) {
+            EXPECT_FLOAT_EQ(Point3f(tp)[c], Point3f(atp)[c]);
+            EXPECT_FLOAT_EQ(tp.Error()[c], atp.Error()[c]);
+            EXPECT_FLOAT_EQ(t(v)[c], at(v)[c]);
+            EXPECT_FLOAT_EQ(t(n)[c], at(n)[c]);
+        }
+    }
+}
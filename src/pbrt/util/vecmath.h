@@ -1875,6 +1875,57 @@ inline Vector3f FromCylindrical(const Point2f &c) {
     return SphericalDirection(sinTheta, cosTheta, c[1]);
 }
 
+// OctahedralVector Definition
+class OctahedralVector {
+  public:
+    // OctahedralVector Public Methods
+    OctahedralVector() = default;
+    PBRT_CPU_GPU
+    OctahedralVector(Vector3f v) {
+        v /= std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (v.z >= 0) {
+            x = Encode(v.x);
+            y = Encode(v.y);
+        } else {
+            // Encode octahedral vector with $z < 0$
+            x = Encode((1 - std::abs(v.y)) * Sign(v.x));
+            y = Encode((1 - std::abs(v.x)) * Sign(v.y));
+        }
+    }
+
+    PBRT_CPU_GPU
+    explicit operator Vector3f() const {
+        Vector3f v;
+        v.x = -1 + 2 * (x / 65535.f);
+        v.y = -1 + 2 * (y / 65535.f);
+        v.z = 1 - (std::abs(v.x) + std::abs(v.y));
+        // Reparameterize directions in the $z<0$ portion of the octahedron
+        if (v.z < 0) {
+            Float xo = v.x;
+            v.x = (1 - std::abs(v.y)) * Sign(xo);
+            v.y = (1 - std::abs(xo)) * Sign(v.y);
+        }
+        return Normalize(v);
+    }
+
+    std::string ToString() const {
+        return StringPrintf("[ OctahedralVector x: %d y: %d ]", x, y);
+    }
+
+  private:
+    // OctahedralVector Private Methods
+    PBRT_CPU_GPU
+    static Float Sign(Float v) { return std::copysign(Float(1), v); }
+
+    PBRT_CPU_GPU
+    static uint16_t Encode(Float f) {
+        return std::round(Clamp((f + 1) / 2, 0, 1) * 65535.f);
+    }
+
+    // OctahedralVector Private Members
+    uint16_t x, y;
+};
+
 // DirectionCone Definition
 class DirectionCone {
   public: